@@ -21,7 +21,7 @@
 
 */
 
-#include "igraph_adjlist.h"
+#include "igraph_adjlist_internal.h"
 #include "igraph_memory.h"
 #include "igraph_interface.h"
 #include "igraph_interrupt_internal.h"
@@ -66,6 +66,13 @@
  * during the computation.
  * </para>
  *
+ * <para>Compressed adjacency lists cannot be modified, they store
+ * the neighbors and the incident edges of all vertices in a few
+ * arrays. They are cached in the graph itself, so algorithms can
+ * borrow them with \ref igraph_csr_borrow() instead of building their
+ * own adjacency lists. The cache is dropped when the graph is
+ * modified.</para>
+ *
  * <para>
  * \example examples/simple/adjlist.c
  * </para>
@@ -95,16 +102,14 @@
 int igraph_adjlist_init(const igraph_t *graph, igraph_adjlist_t *al, 
 			  igraph_neimode_t mode) {
   igraph_integer_t i;
-  igraph_vector_t tmp;  
+  igraph_csr_t csr;
 
   if (mode != IGRAPH_IN && mode != IGRAPH_OUT && mode != IGRAPH_ALL) {
     IGRAPH_ERROR("Cannot create adjlist view", IGRAPH_EINVMODE);
   }
 
-  igraph_vector_init(&tmp, 0);
-  IGRAPH_FINALLY(igraph_vector_destroy, &tmp);
-
-  if (!igraph_is_directed(graph)) { mode=IGRAPH_ALL; }
+  IGRAPH_CHECK(igraph_csr_borrow(graph, &csr, mode));
+  IGRAPH_FINALLY(igraph_csr_return, &csr);
 
   al->length=igraph_vcount(graph);
   al->adjs=igraph_Calloc(al->length, igraph_vector_int_t);
@@ -114,17 +119,16 @@ int igraph_adjlist_init(const igraph_t *graph, igraph_adjlist_t *al,
 
   IGRAPH_FINALLY(igraph_adjlist_destroy, al);
   for (i=0; i<al->length; i++) {
-    int j, n;
+    long int n=igraph_csr_size(&csr, i);
     IGRAPH_ALLOW_INTERRUPTION();
-    IGRAPH_CHECK(igraph_neighbors(graph, &tmp, i, mode));
-    n=igraph_vector_size(&tmp);
     IGRAPH_CHECK(igraph_vector_int_init(&al->adjs[i], n));
-    for (j=0; j<n; j++) {
-      VECTOR(al->adjs[i])[j] = VECTOR(tmp)[j];
+    if (n > 0) {
+      memcpy(VECTOR(al->adjs[i]), igraph_csr_adj(&csr, i), 
+	     sizeof(igraph_integer_t) * (size_t) n);
     }
   }
 
-  igraph_vector_destroy(&tmp);
+  igraph_csr_return(&csr);
   IGRAPH_FINALLY_CLEAN(2);
   return 0;
 }
@@ -555,17 +559,25 @@ int igraph_inclist_init(const igraph_t *graph,
 			      igraph_inclist_t *il, 
 			      igraph_neimode_t mode) {
   igraph_integer_t i;
-  igraph_vector_t tmp;
+  igraph_csr_t csr1, csr2;
+  igraph_bool_t both;
 
   if (mode != IGRAPH_IN && mode != IGRAPH_OUT && mode != IGRAPH_ALL) {
     IGRAPH_ERROR("Cannot create incidence list view", IGRAPH_EINVMODE);
   }
 
-  igraph_vector_init(&tmp, 0);
-  IGRAPH_FINALLY(igraph_vector_destroy, &tmp);
-
   if (!igraph_is_directed(graph)) { mode=IGRAPH_ALL; }
 
+  /* In directed graphs the out-edges come first, then the in-edges,
+     as in igraph_incident() */
+  both = igraph_is_directed(graph) && mode == IGRAPH_ALL;
+  IGRAPH_CHECK(igraph_csr_borrow(graph, &csr1, both ? IGRAPH_OUT : mode));
+  IGRAPH_FINALLY(igraph_csr_return, &csr1);
+  if (both) {
+    IGRAPH_CHECK(igraph_csr_borrow(graph, &csr2, IGRAPH_IN));
+    IGRAPH_FINALLY(igraph_csr_return, &csr2);
+  }
+
   il->length=igraph_vcount(graph);
   il->incs=igraph_Calloc(il->length, igraph_vector_int_t);
   if (il->incs == 0) {
@@ -574,18 +586,25 @@ int igraph_inclist_init(const igraph_t *graph,
 
   IGRAPH_FINALLY(igraph_inclist_destroy, il);  
   for (i=0; i<il->length; i++) {
-    int j, n;
+    long int n1=igraph_csr_size(&csr1, i);
+    long int n2= both ? igraph_csr_size(&csr2, i) : 0;
     IGRAPH_ALLOW_INTERRUPTION();
-    IGRAPH_CHECK(igraph_incident(graph, &tmp, i, mode));
-    n=igraph_vector_size(&tmp);
-    IGRAPH_CHECK(igraph_vector_int_init(&il->incs[i], n));
-    for (j=0; j<n; j++) {
-      VECTOR(il->incs[i])[j] = VECTOR(tmp)[j];
+    IGRAPH_CHECK(igraph_vector_int_init(&il->incs[i], n1+n2));
+    if (n1 > 0) {
+      memcpy(VECTOR(il->incs[i]), igraph_csr_inc(&csr1, i), 
+	     sizeof(igraph_integer_t) * (size_t) n1);
+    }
+    if (n2 > 0) {
+      memcpy(VECTOR(il->incs[i])+n1, igraph_csr_inc(&csr2, i), 
+	     sizeof(igraph_integer_t) * (size_t) n2);
     }
   }
   
-  igraph_vector_destroy(&tmp);
-  IGRAPH_FINALLY_CLEAN(2);
+  if (both) {
+    igraph_csr_return(&csr2);
+  }
+  igraph_csr_return(&csr1);
+  IGRAPH_FINALLY_CLEAN(both ? 3 : 2);
   return 0;
 }
 
@@ -656,6 +675,255 @@ void igraph_inclist_clear(igraph_inclist_t *il) {
   }
 }
 
+/* 
+ * The cache of a graph. It has a compressed adjacency list for each
+ * mode, built on demand. To be on the safe side, it also remembers
+ * the size and the edge list of the graph it was built for, and it
+ * is dropped if these change. (This can happen if a higher level
+ * interface keeps the cache outside of igraph_t.)
+ */
+
+struct igraph_i_adjcache_t {
+  igraph_csr_t csr[3];		/* IGRAPH_OUT, IGRAPH_IN, IGRAPH_ALL */
+  igraph_bool_t valid[3];
+  igraph_bool_t external;	/* not freed by igraph_destroy() */
+  igraph_integer_t n, m;
+  const void *edges;
+};
+
+static void igraph_i_csr_destroy(igraph_csr_t *csr) {
+  if (csr->start) { igraph_Free(csr->start); }
+  if (csr->adj) { igraph_Free(csr->adj); }
+  if (csr->inc) { igraph_Free(csr->inc); }
+}
+
+/* Same order as igraph_neighbors() */
+
+static int igraph_i_csr_build(const igraph_t *graph, igraph_csr_t *csr,
+			      igraph_neimode_t mode) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int size=0, idx=0, i, j, v;
+
+  if (mode & IGRAPH_OUT) { size += no_of_edges; }
+  if (mode & IGRAPH_IN) { size += no_of_edges; }
+
+  memset(csr, 0, sizeof(igraph_csr_t));
+  csr->length=(igraph_integer_t) no_of_nodes;
+  IGRAPH_FINALLY(igraph_i_csr_destroy, csr);
+  csr->start=igraph_Calloc(no_of_nodes+1, long int);
+  csr->adj=igraph_Calloc(size > 0 ? size : 1, igraph_integer_t);
+  csr->inc=igraph_Calloc(size > 0 ? size : 1, igraph_integer_t);
+  if (!csr->start || !csr->adj || !csr->inc) {
+    IGRAPH_ERROR("Cannot create compressed adjacency list", IGRAPH_ENOMEM);
+  }
+
+  for (v=0; v<no_of_nodes; v++) {
+    csr->start[v]=idx;
+    if (!igraph_is_directed(graph) || mode != IGRAPH_ALL) {
+      if (mode & IGRAPH_OUT) {
+	j=IGRAPH_OS(graph, v+1);
+	for (i=IGRAPH_OS(graph, v); i<j; i++) {
+	  long int e=IGRAPH_OI(graph, i);
+	  csr->adj[idx]=IGRAPH_TO(graph, e);
+	  csr->inc[idx++]=(igraph_integer_t) e;
+	}
+      }
+      if (mode & IGRAPH_IN) {
+	j=IGRAPH_IS(graph, v+1);
+	for (i=IGRAPH_IS(graph, v); i<j; i++) {
+	  long int e=IGRAPH_II(graph, i);
+	  csr->adj[idx]=IGRAPH_FROM(graph, e);
+	  csr->inc[idx++]=(igraph_integer_t) e;
+	}
+      }
+    } else {
+      /* merge the out- and in-neighbors */
+      long int i1=IGRAPH_OS(graph, v), j1=IGRAPH_OS(graph, v+1);
+      long int i2=IGRAPH_IS(graph, v), j2=IGRAPH_IS(graph, v+1);
+      while (i1 < j1 || i2 < j2) {
+	long int e1= i1 < j1 ? IGRAPH_OI(graph, i1) : -1;
+	long int e2= i2 < j2 ? IGRAPH_II(graph, i2) : -1;
+	long int n1= e1 >= 0 ? IGRAPH_TO(graph, e1) : no_of_nodes;
+	long int n2= e2 >= 0 ? IGRAPH_FROM(graph, e2) : no_of_nodes;
+	if (n1 <= n2) {
+	  csr->adj[idx]=(igraph_integer_t) n1;
+	  csr->inc[idx++]=(igraph_integer_t) e1;
+	  i1++;
+	}
+	if (n2 <= n1) {
+	  csr->adj[idx]=(igraph_integer_t) n2;
+	  csr->inc[idx++]=(igraph_integer_t) e2;
+	  i2++;
+	}
+      }
+    }
+  }
+  csr->start[no_of_nodes]=idx;
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/* The cache might be shared by threads that work on the same graph,
+   so it is only accessed in a critical section. The list is built
+   outside of it, and if another thread was faster, then ours is
+   dropped. */
+
+static igraph_bool_t igraph_i_csr_lookup(const igraph_t *graph,
+					 igraph_csr_t *csr, int idx,
+					 igraph_csr_t *built) {
+  struct igraph_i_adjcache_t *cache=graph->cache;
+  igraph_bool_t found;
+
+  if (cache->n != igraph_vcount(graph) || cache->m != igraph_ecount(graph) ||
+      cache->edges != graph->from.stor_begin) {
+    igraph_i_adjcache_invalidate((igraph_t *) graph);
+    cache->n=igraph_vcount(graph);
+    cache->m=igraph_ecount(graph);
+    cache->edges=graph->from.stor_begin;
+  }
+  if (!cache->valid[idx] && built) {
+    cache->csr[idx]=*built;
+    cache->valid[idx]=1;
+    memset(built, 0, sizeof(igraph_csr_t));
+  }
+  found=cache->valid[idx];
+  if (found) {
+    *csr=cache->csr[idx];
+    csr->owned=0;
+  }
+  return found;
+}
+
+/**
+ * \function igraph_csr_borrow
+ * Borrow a compressed adjacency list of a graph
+ * 
+ * A compressed adjacency list stores the neighbors and the incident
+ * edges of all vertices in two arrays, and the start of the
+ * neighbors of each vertex in a third one. It cannot be modified,
+ * but it needs only three allocations, and it is cached in the
+ * graph: it is built when it is first borrowed for a given \p mode,
+ * and it is reused until the graph is modified or destroyed. 
+ * Query it with \ref igraph_csr_size(), \ref igraph_csr_adj() and
+ * \ref igraph_csr_inc().
+ * 
+ * </para><para>
+ * Every borrowed list must be given back with \ref
+ * igraph_csr_return(). If the graph has no cache, then the list is
+ * built for the caller and it is freed at that point.
+ * 
+ * </para><para>
+ * Several threads may borrow lists of the same graph at the same
+ * time, but the graph must not be modified while a list is borrowed.
+ * \param graph The input graph.
+ * \param csr Pointer to an uninitialized
+ *   <type>igraph_csr_t</type> object.
+ * \param mode Constant specifying whether outgoing
+ *   (<code>IGRAPH_OUT</code>), incoming (<code>IGRAPH_IN</code>),
+ *   or both (<code>IGRAPH_ALL</code>) types of neighbors to include.
+ *   It is ignored for undirected networks.
+ * \return Error code.
+ * 
+ * Time complexity: O(|V|+|E|) the first time, O(1) afterwards.
+ */
+
+int igraph_csr_borrow(const igraph_t *graph, igraph_csr_t *csr,
+		      igraph_neimode_t mode) {
+  igraph_csr_t built;
+  igraph_bool_t found;
+  int idx;
+
+  if (mode != IGRAPH_IN && mode != IGRAPH_OUT && mode != IGRAPH_ALL) {
+    IGRAPH_ERROR("Cannot create compressed adjacency list", 
+		 IGRAPH_EINVMODE);
+  }
+  if (!igraph_is_directed(graph)) { mode=IGRAPH_ALL; }
+  idx= mode == IGRAPH_OUT ? 0 : (mode == IGRAPH_IN ? 1 : 2);
+
+  if (!graph->cache) {
+    IGRAPH_CHECK(igraph_i_csr_build(graph, csr, mode));
+    csr->owned=1;
+    return 0;
+  }
+
+#ifdef _OPENMP
+#pragma omp critical (igraph_i_adjcache)
+#endif
+  found=igraph_i_csr_lookup(graph, csr, idx, 0);
+  if (found) { return 0; }
+
+  IGRAPH_CHECK(igraph_i_csr_build(graph, &built, mode));
+#ifdef _OPENMP
+#pragma omp critical (igraph_i_adjcache)
+#endif
+  igraph_i_csr_lookup(graph, csr, idx, &built);
+  igraph_i_csr_destroy(&built);	/* if another thread was faster */
+  
+  return 0;
+}
+
+/**
+ * \function igraph_csr_return
+ * Give back a borrowed compressed adjacency list
+ * 
+ * \param csr The list, it cannot be used afterwards.
+ * 
+ * Time complexity: O(1), or operating system dependent if the
+ * list was not cached.
+ */
+
+void igraph_csr_return(igraph_csr_t *csr) {
+  if (csr->owned) {
+    igraph_i_csr_destroy(csr);
+  }
+  memset(csr, 0, sizeof(igraph_csr_t));
+}
+
+struct igraph_i_adjcache_t *igraph_i_adjcache_create(igraph_bool_t external) {
+  struct igraph_i_adjcache_t *cache=
+    igraph_Calloc(1, struct igraph_i_adjcache_t);
+  if (cache) {
+    cache->external=external;
+    cache->n=-1;
+  }
+  return cache;
+}
+
+void igraph_i_adjcache_destroy(struct igraph_i_adjcache_t *cache) {
+  int i;
+  for (i=0; i<3; i++) {
+    if (cache->valid[i]) { igraph_i_csr_destroy(&cache->csr[i]); }
+  }
+  igraph_Free(cache);
+}
+
+/* Called by igraph_destroy() */
+
+void igraph_i_adjcache_release(igraph_t *graph) {
+  if (graph->cache && !graph->cache->external) {
+    igraph_i_adjcache_destroy(graph->cache);
+  }
+  graph->cache=0;
+}
+
+/* Must be called by all functions that modify the structure of the
+   graph in place */
+
+void igraph_i_adjcache_invalidate(igraph_t *graph) {
+  struct igraph_i_adjcache_t *cache=graph->cache;
+  int i;
+  if (!cache) { return; }
+  for (i=0; i<3; i++) {
+    if (cache->valid[i]) { 
+      igraph_i_csr_destroy(&cache->csr[i]);
+      cache->valid[i]=0;
+    }
+  }
+  cache->n=-1;
+}
+
 /**
  * \function igraph_lazy_adjlist_init
  * Constructor
@@ -37,11 +37,14 @@
 #include "igraph_types_internal.h"
 #include "igraph_stack.h"
 #include "igraph_dqueue.h"
+#include "igraph_threading_internal.h"
 #include "config.h"
+#include "structural_properties_internal.h"
 
 #include "bigint.h"
 #include "prpack.h"
 
+
 int igraph_personalized_pagerank_arpack(const igraph_t *graph, 
 		    igraph_vector_t *vector,
 		    igraph_real_t *value, const igraph_vs_t vids,
@@ -1751,6 +1754,697 @@ void igraph_i_destroy_biguints(igraph_biguint_t *p) {
   igraph_Free(p2);
 }
 
+/* 
+ * Multi-threaded betweenness. The sources are processed in batches,
+ * the sources of a batch are divided among the threads with
+ * IGRAPH_I_SHARE(). Each thread has its
+ * own work buffers and its own partial result vector, and these are
+ * summed in the order of the threads at the end, so the result does
+ * not depend on the scheduling. Everything is allocated before the
+ * threads start, and the threads do not call any function that might
+ * raise an igraph error. Progress is reported and interruption is
+ * checked by the main thread, between the batches.
+ */
+
+#define IGRAPH_I_BTW_BATCH 64	/* sources per thread in a batch */
+
+typedef struct igraph_i_btw_ws_t {
+  const igraph_t *graph;
+  int nthreads;
+  long int no_of_nodes;
+  long int ressize;
+  igraph_real_t cutoff;
+  const igraph_vector_t *weights;
+  igraph_adjlist_t *adj_out, *adj_in;     /* unweighted vertex */
+  igraph_inclist_t *inc_out, *inc_in;     /* edge, and weighted */
+  /* per thread blocks, 'nthreads' times the given size */
+  double *partial;			  /* ressize */
+  double *tmpscore;			  /* no_of_nodes */
+  long int *order;			  /* no_of_nodes */
+  long int *distance;			  /* no_of_nodes, unweighted */
+  unsigned long long int *nrgeo;	  /* no_of_nodes, unweighted */
+  igraph_real_t *wdist;			  /* no_of_nodes, weighted */
+  igraph_real_t *wnrgeo;		  /* no_of_nodes, weighted vertex */
+  long int *lnrgeo;			  /* no_of_nodes, weighted edge */
+  long int *nfathers;			  /* no_of_nodes, weighted */
+  long int *fathers;			  /* fatherstart[no_of_nodes] */
+  long int *fatherstart;		  /* no_of_nodes+1, shared */
+  igraph_2wheap_t *heaps;		  /* one per thread, weighted */
+  int no_of_heaps;
+  igraph_rng_t *rngs;			  /* one per thread, sampling */
+  int no_of_rngs;
+  unsigned long int seed;		  /* sampling */
+} igraph_i_btw_ws_t;
+
+static void igraph_i_btw_ws_destroy(igraph_i_btw_ws_t *ws) {
+  int i;
+  for (i=0; i<ws->no_of_heaps; i++) {
+    igraph_2wheap_destroy(&ws->heaps[i]);
+  }
+  if (ws->heaps) { igraph_Free(ws->heaps); }
+  for (i=0; i<ws->no_of_rngs; i++) {
+    igraph_rng_destroy(&ws->rngs[i]);
+  }
+  if (ws->rngs) { igraph_Free(ws->rngs); }
+  if (ws->partial) { igraph_Free(ws->partial); }
+  if (ws->tmpscore) { igraph_Free(ws->tmpscore); }
+  if (ws->order) { igraph_Free(ws->order); }
+  if (ws->distance) { igraph_Free(ws->distance); }
+  if (ws->nrgeo) { igraph_Free(ws->nrgeo); }
+  if (ws->wdist) { igraph_Free(ws->wdist); }
+  if (ws->wnrgeo) { igraph_Free(ws->wnrgeo); }
+  if (ws->lnrgeo) { igraph_Free(ws->lnrgeo); }
+  if (ws->nfathers) { igraph_Free(ws->nfathers); }
+  if (ws->fathers) { igraph_Free(ws->fathers); }
+  if (ws->fatherstart) { igraph_Free(ws->fatherstart); }
+}
+
+/* Allocates the work buffers of all threads. 'weighted' is zero for
+   the unweighted versions, one for weighted vertex and two for
+   weighted edge betweenness. 'mode' is the mode of the shortest path
+   search, for the weighted versions the father lists are sized by
+   the degrees in the opposite direction. */
+
+static int igraph_i_btw_ws_init(igraph_i_btw_ws_t *ws, 
+				const igraph_t *graph, int nthreads,
+				long int ressize, int weighted,
+				igraph_neimode_t mode) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  size_t nn=(size_t) nthreads * (size_t) no_of_nodes;
+  long int i;
+
+  memset(ws, 0, sizeof(igraph_i_btw_ws_t));
+  ws->graph=graph;
+  ws->nthreads=nthreads;
+  ws->no_of_nodes=no_of_nodes;
+  ws->ressize=ressize;
+  IGRAPH_FINALLY(igraph_i_btw_ws_destroy, ws);
+
+#define IGRAPH_I_BTW_ALLOC(field, size, type) do {			\
+    ws->field=igraph_Calloc((size) > 0 ? (size) : 1, type);		\
+    if (!ws->field) {							\
+      IGRAPH_ERROR("betweenness failed", IGRAPH_ENOMEM);		\
+    }									\
+  } while (0)
+
+  IGRAPH_I_BTW_ALLOC(partial, (size_t) nthreads * (size_t) ressize, double);
+  IGRAPH_I_BTW_ALLOC(tmpscore, nn, double);
+  IGRAPH_I_BTW_ALLOC(order, nn, long int);
+
+  if (!weighted) {
+    IGRAPH_I_BTW_ALLOC(distance, nn, long int);
+    IGRAPH_I_BTW_ALLOC(nrgeo, nn, unsigned long long int);
+  } else {
+    igraph_vector_t deg;
+    IGRAPH_I_BTW_ALLOC(wdist, nn, igraph_real_t);
+    if (weighted == 1) {
+      IGRAPH_I_BTW_ALLOC(wnrgeo, nn, igraph_real_t);
+    } else {
+      IGRAPH_I_BTW_ALLOC(lnrgeo, nn, long int);
+    }
+    IGRAPH_I_BTW_ALLOC(nfathers, nn, long int);
+    
+    /* A vertex can get at most one father for each of its incident
+       edges that the search may traverse towards it */
+    IGRAPH_VECTOR_INIT_FINALLY(&deg, no_of_nodes);
+    IGRAPH_CHECK(igraph_degree(graph, &deg, igraph_vss_all(),
+			       mode==IGRAPH_OUT ? IGRAPH_IN : IGRAPH_ALL,
+			       IGRAPH_LOOPS));
+    IGRAPH_I_BTW_ALLOC(fatherstart, no_of_nodes+1, long int);
+    for (i=0; i<no_of_nodes; i++) {
+      ws->fatherstart[i+1]=ws->fatherstart[i] + (long int) VECTOR(deg)[i];
+    }
+    igraph_vector_destroy(&deg);
+    IGRAPH_FINALLY_CLEAN(1);
+    IGRAPH_I_BTW_ALLOC(fathers, (size_t) nthreads * 
+		       (size_t) ws->fatherstart[no_of_nodes], long int);
+
+    IGRAPH_I_BTW_ALLOC(heaps, nthreads, igraph_2wheap_t);
+    for (i=0; i<nthreads; i++) {
+      IGRAPH_CHECK(igraph_2wheap_init(&ws->heaps[i], no_of_nodes));
+      ws->no_of_heaps++;
+      /* no reallocation is allowed in the threads */
+      IGRAPH_CHECK(igraph_2wheap_reserve(&ws->heaps[i], no_of_nodes));
+    }
+  }
+
+#undef IGRAPH_I_BTW_ALLOC
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/* BFS from 'source', it fills the distances (plus one) and the
+   number of shortest paths, and returns the number of reached
+   vertices, these are in 'order', in BFS order. The fathers of a
+   vertex are not stored, they can be found among its in-neighbors,
+   as the ones on the previous BFS level. */
+
+static long int igraph_i_btw_bfs(igraph_i_btw_ws_t *ws, int t, 
+				 long int source) {
+  long int no_of_nodes=ws->no_of_nodes;
+  long int *distance=ws->distance + t * no_of_nodes;
+  unsigned long long int *nrgeo=ws->nrgeo + t * no_of_nodes;
+  long int *order=ws->order + t * no_of_nodes;
+  igraph_real_t cutoff=ws->cutoff;
+  long int head=0, tail=0, j, nneis;
+  igraph_vector_int_t *neis;
+
+  order[tail++]=source;
+  nrgeo[source]=1;
+  distance[source]=1;
+
+  while (head < tail) {
+    long int actnode=order[head++];
+    if (cutoff >= 0 && distance[actnode] >= cutoff+1) { continue; }
+
+    neis=igraph_adjlist_get(ws->adj_out, actnode);
+    nneis=igraph_vector_int_size(neis);
+    for (j=0; j<nneis; j++) {
+      long int neighbor=(long int) VECTOR(*neis)[j];
+      if (distance[neighbor]==0) {
+	distance[neighbor]=distance[actnode]+1;
+	order[tail++]=neighbor;
+      }
+      if (distance[neighbor]==distance[actnode]+1) {
+	nrgeo[neighbor]+=nrgeo[actnode];
+      }
+    }
+  }
+
+  return tail;
+}
+
+/* Unweighted vertex betweenness, single source. */
+
+static void igraph_i_btw_source(igraph_i_btw_ws_t *ws, int t, 
+				long int source) {
+  long int no_of_nodes=ws->no_of_nodes;
+  long int *distance=ws->distance + t * no_of_nodes;
+  unsigned long long int *nrgeo=ws->nrgeo + t * no_of_nodes;
+  double *tmpscore=ws->tmpscore + t * no_of_nodes;
+  double *partial=ws->partial + t * ws->ressize;
+  long int *order=ws->order + t * no_of_nodes;
+  long int tail=igraph_i_btw_bfs(ws, t, source), j, nneis;
+  igraph_vector_int_t *neis;
+
+  /* Inverse search, starting with the farthest nodes. Vertices that
+     are done are reset right away, they cannot be on the previous
+     level of any vertex that comes later. */
+  while (tail > 0) {
+    long int actnode=order[--tail];
+    if (actnode != source) {
+      neis=igraph_adjlist_get(ws->adj_in, actnode);
+      nneis=igraph_vector_int_size(neis);
+      for (j=0; j<nneis; j++) {
+	long int neighbor=(long int) VECTOR(*neis)[j];
+	if (distance[neighbor]==distance[actnode]-1) {
+	  tmpscore[neighbor] +=  (tmpscore[actnode]+1)*
+	    ((double)(nrgeo[neighbor]))/nrgeo[actnode];
+	}
+      }
+      partial[actnode] += tmpscore[actnode];
+    }
+    distance[actnode]=0;
+    nrgeo[actnode]=0;
+    tmpscore[actnode]=0;
+  }
+}
+
+/* Dijkstra's algorithm from 'source', it fills the distances (plus
+   one), the number of shortest paths and the fathers. These are
+   vertices if ws->wnrgeo is set, and edges if ws->lnrgeo is set. It
+   returns the number of reached vertices, these are in 'order', in
+   the order they were finalized. This is the same search as in the
+   serial versions, but the fathers are kept in preallocated per
+   thread arrays. */
+
+static long int igraph_i_btw_dijkstra(igraph_i_btw_ws_t *ws, int t,
+				      long int source) {
+  const igraph_t *graph=ws->graph;
+  long int no_of_nodes=ws->no_of_nodes;
+  igraph_2wheap_t *Q=&ws->heaps[t];
+  igraph_real_t *dist=ws->wdist + t * no_of_nodes;
+  igraph_real_t *wnrgeo=ws->wnrgeo ? ws->wnrgeo + t * no_of_nodes : 0;
+  long int *lnrgeo=ws->lnrgeo ? ws->lnrgeo + t * no_of_nodes : 0;
+  long int *order=ws->order + t * no_of_nodes;
+  long int *nfathers=ws->nfathers + t * no_of_nodes;
+  long int *fathers=ws->fathers + t * ws->fatherstart[no_of_nodes];
+  const long int *fatherstart=ws->fatherstart;
+  igraph_real_t cutoff=ws->cutoff;
+  const double eps = IGRAPH_SHORTEST_PATH_EPSILON;
+  long int count=0, j;
+  int cmp_result;
+
+  igraph_2wheap_push_with_index(Q, source, 0);
+  dist[source]=1.0;
+  if (wnrgeo) { wnrgeo[source]=1; } else { lnrgeo[source]=1; }
+
+  while (!igraph_2wheap_empty(Q)) {
+    long int minnei=igraph_2wheap_max_index(Q);
+    igraph_real_t mindist=-igraph_2wheap_delete_max(Q);
+    igraph_vector_int_t *neis;
+    long int nlen;
+
+    order[count++]=minnei;
+
+    if (cutoff >=0 && dist[minnei] >= cutoff+1.0) { continue; }
+
+    neis=igraph_inclist_get(ws->inc_out, minnei);
+    nlen=igraph_vector_int_size(neis);
+    for (j=0; j<nlen; j++) {
+      long int edge=(long int) VECTOR(*neis)[j];
+      long int to=IGRAPH_OTHER(graph, edge, minnei);
+      igraph_real_t altdist=mindist + VECTOR(*ws->weights)[edge];
+      igraph_real_t curdist=dist[to];
+      long int father= wnrgeo ? minnei : edge;
+
+      if (curdist == 0) {
+	/* this means curdist is infinity */
+	cmp_result = -1;
+      } else {
+	cmp_result = igraph_cmp_epsilon(altdist, curdist-1, eps);
+      }
+
+      if (curdist == 0 || cmp_result < 0) {
+	/* This is the first or a shorter path */
+	fathers[fatherstart[to]]=father;
+	nfathers[to]=1;
+	if (wnrgeo) { wnrgeo[to]=wnrgeo[minnei]; } 
+	else { lnrgeo[to]=lnrgeo[minnei]; }
+	dist[to]=altdist+1.0;
+	if (curdist == 0) {
+	  igraph_2wheap_push_with_index(Q, to, -altdist);
+	} else {
+	  igraph_2wheap_modify(Q, to, -altdist);
+	}
+      } else if (cmp_result == 0) {
+	fathers[fatherstart[to] + nfathers[to]++]=father;
+	if (wnrgeo) { wnrgeo[to] += wnrgeo[minnei]; } 
+	else { lnrgeo[to] += lnrgeo[minnei]; }
+      }
+    }
+  }
+
+  return count;
+}
+
+/* Weighted vertex (ws->wnrgeo is set) or edge (ws->lnrgeo is set)
+   betweenness, single source. */
+
+static void igraph_i_btw_source_weighted(igraph_i_btw_ws_t *ws, int t,
+					 long int source) {
+  const igraph_t *graph=ws->graph;
+  long int no_of_nodes=ws->no_of_nodes;
+  igraph_real_t *dist=ws->wdist + t * no_of_nodes;
+  igraph_real_t *wnrgeo=ws->wnrgeo ? ws->wnrgeo + t * no_of_nodes : 0;
+  long int *lnrgeo=ws->lnrgeo ? ws->lnrgeo + t * no_of_nodes : 0;
+  double *tmpscore=ws->tmpscore + t * no_of_nodes;
+  double *partial=ws->partial + t * ws->ressize;
+  long int *order=ws->order + t * no_of_nodes;
+  long int *nfathers=ws->nfathers + t * no_of_nodes;
+  long int *fathers=ws->fathers + t * ws->fatherstart[no_of_nodes];
+  const long int *fatherstart=ws->fatherstart;
+  long int count=igraph_i_btw_dijkstra(ws, t, source), j;
+
+  while (count > 0) {
+    long int w=order[--count];
+    long int *fatv=fathers + fatherstart[w];
+    long int fatv_len=nfathers[w];
+    if (wnrgeo) {
+      for (j=0; j<fatv_len; j++) {
+	long int f=fatv[j];
+	tmpscore[f] += wnrgeo[f]/wnrgeo[w] * (1+tmpscore[w]);
+      }
+      if (w!=source) { partial[w] += tmpscore[w]; }
+      wnrgeo[w]=0;
+    } else {
+      for (j=0; j<fatv_len; j++) {
+	long int fedge=fatv[j];
+	long int neighbor=IGRAPH_OTHER(graph, fedge, w);
+	tmpscore[neighbor] += ((double)lnrgeo[neighbor]) /
+	  lnrgeo[w] * (1.0+tmpscore[w]);
+	partial[fedge] += ((tmpscore[w]+1) * lnrgeo[neighbor]) / lnrgeo[w];
+      }
+      lnrgeo[w]=0;
+    }
+    tmpscore[w]=0;
+    dist[w]=0;
+    nfathers[w]=0;
+  }
+}
+
+/* Unweighted edge betweenness, single source. */
+
+static void igraph_i_edge_btw_source(igraph_i_btw_ws_t *ws, int t, 
+				     long int source) {
+  const igraph_t *graph=ws->graph;
+  long int no_of_nodes=ws->no_of_nodes;
+  long int *distance=ws->distance + t * no_of_nodes;
+  unsigned long long int *nrgeo=ws->nrgeo + t * no_of_nodes;
+  double *tmpscore=ws->tmpscore + t * no_of_nodes;
+  double *partial=ws->partial + t * ws->ressize;
+  long int *order=ws->order + t * no_of_nodes;
+  igraph_real_t cutoff=ws->cutoff;
+  long int head=0, tail=0, i, neino;
+  igraph_vector_int_t *neip;
+
+  order[tail++]=source;
+  nrgeo[source]=1;
+  distance[source]=0;
+
+  while (head < tail) {
+    long int actnode=order[head++];
+    if (cutoff > 0 && distance[actnode] >= cutoff ) continue;
+
+    neip=igraph_inclist_get(ws->inc_out, actnode);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int edge=(long int) VECTOR(*neip)[i];
+      long int neighbor=IGRAPH_OTHER(graph, edge, actnode);
+      if (nrgeo[neighbor] != 0) {
+	/* we've already seen this node, another shortest path? */
+	if (distance[neighbor]==distance[actnode]+1) {
+	  nrgeo[neighbor]+=nrgeo[actnode];
+	}
+      } else {
+	/* we haven't seen this node yet */
+	nrgeo[neighbor]+=nrgeo[actnode];
+	distance[neighbor]=distance[actnode]+1;
+	order[tail++]=neighbor;
+      }
+    }
+  }
+
+  /* Inverse search, the source is order[0]. Vertices that are done
+     are reset right away, their zero 'nrgeo' excludes them. */
+  while (tail > 1) {
+    long int actnode=order[--tail];
+    neip=igraph_inclist_get(ws->inc_in, actnode);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int edgeno=(long int) VECTOR(*neip)[i];
+      long int neighbor=IGRAPH_OTHER(graph, edgeno, actnode);
+      if (distance[neighbor]==distance[actnode]-1 &&
+	  nrgeo[neighbor] != 0) {
+	tmpscore[neighbor] +=
+	  (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
+	partial[edgeno] +=
+	  (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
+      }
+    }
+    distance[actnode]=0;
+    nrgeo[actnode]=0;
+    tmpscore[actnode]=0;
+  }
+  distance[source]=0;
+  nrgeo[source]=0;
+  tmpscore[source]=0;
+}
+
+/* One sample of the approximate betweenness: a random vertex pair,
+   and a random shortest path between them, chosen uniformly. The
+   inner vertices of the path get one hit each. The generator of the
+   thread is seeded from the index of the sample, so the result does
+   not depend on the number of threads. */
+
+static void igraph_i_btw_sample(igraph_i_btw_ws_t *ws, int t, 
+				long int sample) {
+  long int no_of_nodes=ws->no_of_nodes;
+  igraph_rng_t *rng=&ws->rngs[t];
+  double *partial=ws->partial + t * ws->ressize;
+  long int *order=ws->order + t * no_of_nodes;
+  long int source, target, count, w, j;
+
+  igraph_rng_seed(rng, ws->seed + (unsigned long int) sample);
+  source=igraph_rng_get_integer(rng, 0, no_of_nodes-1);
+  target=igraph_rng_get_integer(rng, 0, no_of_nodes-2);
+  if (target >= source) { target++; }
+
+  if (ws->weights) {
+    igraph_real_t *dist=ws->wdist + t * no_of_nodes;
+    igraph_real_t *nrgeo=ws->wnrgeo + t * no_of_nodes;
+    long int *nfathers=ws->nfathers + t * no_of_nodes;
+    long int *fathers=ws->fathers + t * ws->fatherstart[no_of_nodes];
+
+    count=igraph_i_btw_dijkstra(ws, t, source);
+    w=target;
+    while (dist[w] != 0) {
+      long int *fatv=fathers + ws->fatherstart[w], nfatv=nfathers[w];
+      long int f=fatv[nfatv-1];
+      igraph_real_t x=igraph_rng_get_unif01(rng) * nrgeo[w], sum=0.0;
+      for (j=0; j<nfatv; j++) {
+	sum += nrgeo[fatv[j]];
+	if (x < sum) { f=fatv[j]; break; }
+      }
+      if (f == source) { break; }
+      partial[f] += 1;
+      w=f;
+    }
+    for (j=0; j<count; j++) {
+      dist[order[j]]=0;
+      nrgeo[order[j]]=0;
+      nfathers[order[j]]=0;
+    }
+
+  } else {
+    long int *distance=ws->distance + t * no_of_nodes;
+    unsigned long long int *nrgeo=ws->nrgeo + t * no_of_nodes;
+
+    count=igraph_i_btw_bfs(ws, t, source);
+    w=target;
+    /* the source is at distance one (plus one) */
+    while (distance[w] > 2) {
+      igraph_vector_int_t *neis=igraph_adjlist_get(ws->adj_in, w);
+      long int nneis=igraph_vector_int_size(neis), f=-1;
+      igraph_real_t x=igraph_rng_get_unif01(rng) * nrgeo[w], sum=0.0;
+      for (j=0; j<nneis; j++) {
+	long int v=(long int) VECTOR(*neis)[j];
+	if (distance[v] == distance[w]-1) {
+	  f=v;
+	  sum += nrgeo[v];
+	  if (x < sum) { break; }
+	}
+      }
+      partial[f] += 1;
+      w=f;
+    }
+    for (j=0; j<count; j++) {
+      distance[order[j]]=0;
+      nrgeo[order[j]]=0;
+    }
+  }
+}
+
+/* Runs 'fun' for tasks 0, ..., 'no_of_tasks'-1 (the sources) and
+   sums the partial results into 'res', which must have 'ws->ressize'
+   elements. */
+
+static int igraph_i_btw_run(igraph_i_btw_ws_t *ws, 
+			    void (*fun)(igraph_i_btw_ws_t *, int, long int),
+			    long int no_of_tasks,
+			    const char *message, igraph_vector_t *res) {
+  long int batch=(long int) ws->nthreads * IGRAPH_I_BTW_BATCH;
+  long int from, i;
+  int t;
+
+  for (from=0; from<no_of_tasks; from += batch) {
+    long int to= from+batch < no_of_tasks ? from+batch : no_of_tasks;
+    IGRAPH_PROGRESS(message, 100.0*from/no_of_tasks, 0);
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    IGRAPH_I_PARALLEL(ws->nthreads)
+    {
+      int me=IGRAPH_I_THREAD_NUM;
+      long int source;
+      IGRAPH_I_SHARE(source, from, to) {
+	fun(ws, me, source);
+      }
+    }
+  }
+
+  for (i=0; i<ws->ressize; i++) {
+    double sum=0.0;
+    for (t=0; t<ws->nthreads; t++) {
+      sum += ws->partial[ (size_t) t * (size_t) ws->ressize + i ];
+    }
+    VECTOR(*res)[i]=sum;
+  }
+
+  IGRAPH_PROGRESS(message, 100.0, 0);
+  return 0;
+}
+
+static int igraph_i_betweenness_parallel(const igraph_t *graph, 
+					 igraph_vector_t *res,
+					 const igraph_vs_t vids, 
+					 igraph_bool_t directed,
+					 igraph_real_t cutoff,
+					 const igraph_vector_t *weights,
+					 int nthreads) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  igraph_i_btw_ws_t ws;
+  igraph_adjlist_t adj_out, adj_in;
+  igraph_inclist_t inclist;
+  igraph_vector_t v_tmpres, *tmpres=&v_tmpres;
+  igraph_vit_t vit;
+  igraph_neimode_t mode;
+  long int j, k;
+
+  if (weights) {
+    if (igraph_vector_size(weights) != no_of_edges) {
+      IGRAPH_ERROR("Weight vector length does not match", IGRAPH_EINVAL);
+    }
+    if (no_of_edges > 0 && igraph_vector_min(weights) <= 0) {
+      IGRAPH_ERROR("Weight vector must be positive", IGRAPH_EINVAL);
+    }
+    mode= directed ? IGRAPH_OUT : IGRAPH_ALL;
+  } else {
+    mode= directed && igraph_is_directed(graph) ? IGRAPH_OUT : IGRAPH_ALL;
+  }
+
+  if (!igraph_vs_is_all(&vids)) {
+    IGRAPH_VECTOR_INIT_FINALLY(tmpres, no_of_nodes);
+  } else {
+    IGRAPH_CHECK(igraph_vector_resize(res, no_of_nodes));
+    tmpres=res;
+  }
+
+  IGRAPH_CHECK(igraph_i_btw_ws_init(&ws, graph, nthreads, no_of_nodes,
+				    weights ? 1 : 0, mode));
+  IGRAPH_FINALLY(igraph_i_btw_ws_destroy, &ws);
+  ws.cutoff=cutoff;
+  ws.weights=weights;
+
+  if (weights) {
+    IGRAPH_CHECK(igraph_inclist_init(graph, &inclist, mode));
+    IGRAPH_FINALLY(igraph_inclist_destroy, &inclist);
+    ws.inc_out=&inclist;
+    IGRAPH_CHECK(igraph_i_btw_run(&ws, igraph_i_btw_source_weighted,
+				  no_of_nodes,
+				  "Betweenness centrality: ", tmpres));
+    igraph_inclist_destroy(&inclist);
+    IGRAPH_FINALLY_CLEAN(1);
+  } else {
+    IGRAPH_CHECK(igraph_adjlist_init(graph, &adj_out, mode));
+    IGRAPH_FINALLY(igraph_adjlist_destroy, &adj_out);
+    IGRAPH_CHECK(igraph_adjlist_init(graph, &adj_in, 
+			     mode==IGRAPH_OUT ? IGRAPH_IN : IGRAPH_ALL));
+    IGRAPH_FINALLY(igraph_adjlist_destroy, &adj_in);
+    ws.adj_out=&adj_out;
+    ws.adj_in=&adj_in;
+    IGRAPH_CHECK(igraph_i_btw_run(&ws, igraph_i_btw_source,
+				  no_of_nodes,
+				  "Betweenness centrality: ", tmpres));
+    igraph_adjlist_destroy(&adj_in);
+    igraph_adjlist_destroy(&adj_out);
+    IGRAPH_FINALLY_CLEAN(2);
+  }
+
+  igraph_i_btw_ws_destroy(&ws);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  /* Keep only the requested vertices */
+  if (!igraph_vs_is_all(&vids)) { 
+    IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
+    IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+    IGRAPH_CHECK(igraph_vector_resize(res, IGRAPH_VIT_SIZE(vit)));
+
+    for (k=0, IGRAPH_VIT_RESET(vit); !IGRAPH_VIT_END(vit);
+	 IGRAPH_VIT_NEXT(vit), k++) {
+      long int node=IGRAPH_VIT_GET(vit);
+      VECTOR(*res)[k] = VECTOR(*tmpres)[node];
+    }
+
+    igraph_vit_destroy(&vit);
+    igraph_vector_destroy(tmpres);
+    IGRAPH_FINALLY_CLEAN(2);
+  }     
+
+  /* divide by 2 for undirected graph */
+  if (!directed || !igraph_is_directed(graph)) {
+    k=igraph_vector_size(res);
+    for (j=0; j<k; j++) {
+      VECTOR(*res)[j] /= 2.0;
+    }
+  }
+
+  return 0;
+}
+
+static int igraph_i_edge_betweenness_parallel(const igraph_t *graph, 
+					      igraph_vector_t *result,
+					      igraph_bool_t directed,
+					      igraph_real_t cutoff,
+					      const igraph_vector_t *weights,
+					      int nthreads) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  igraph_i_btw_ws_t ws;
+  igraph_inclist_t inc_out, inc_in;
+  igraph_neimode_t mode;
+  long int j;
+
+  if (weights) {
+    if (igraph_vector_size(weights) != no_of_edges) {
+      IGRAPH_ERROR("Weight vector length does not match", IGRAPH_EINVAL);
+    }
+    if (no_of_edges > 0 && igraph_vector_min(weights) < 0) {
+      IGRAPH_ERROR("Weight vector must be non-negative", IGRAPH_EINVAL);
+    }
+    mode= directed ? IGRAPH_OUT : IGRAPH_ALL;
+  } else {
+    mode= directed && igraph_is_directed(graph) ? IGRAPH_OUT : IGRAPH_ALL;
+  }
+
+  IGRAPH_CHECK(igraph_vector_resize(result, no_of_edges));
+
+  IGRAPH_CHECK(igraph_i_btw_ws_init(&ws, graph, nthreads, no_of_edges,
+				    weights ? 2 : 0, mode));
+  IGRAPH_FINALLY(igraph_i_btw_ws_destroy, &ws);
+  ws.cutoff=cutoff;
+  ws.weights=weights;
+
+  IGRAPH_CHECK(igraph_inclist_init(graph, &inc_out, mode));
+  IGRAPH_FINALLY(igraph_inclist_destroy, &inc_out);
+  ws.inc_out=&inc_out;
+  
+  if (weights) {
+    IGRAPH_CHECK(igraph_i_btw_run(&ws, igraph_i_btw_source_weighted,
+				  no_of_nodes,
+				  "Edge betweenness centrality: ", result));
+  } else if (mode == IGRAPH_OUT) {
+    IGRAPH_CHECK(igraph_inclist_init(graph, &inc_in, IGRAPH_IN));
+    IGRAPH_FINALLY(igraph_inclist_destroy, &inc_in);
+    ws.inc_in=&inc_in;
+    IGRAPH_CHECK(igraph_i_btw_run(&ws, igraph_i_edge_btw_source,
+				  no_of_nodes,
+				  "Edge betweenness centrality: ", result));
+    igraph_inclist_destroy(&inc_in);
+    IGRAPH_FINALLY_CLEAN(1);
+  } else {
+    ws.inc_in=&inc_out;
+    IGRAPH_CHECK(igraph_i_btw_run(&ws, igraph_i_edge_btw_source,
+				  no_of_nodes,
+				  "Edge betweenness centrality: ", result));
+  }
+
+  igraph_inclist_destroy(&inc_out);
+  igraph_i_btw_ws_destroy(&ws);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  /* divide by 2 for undirected graph */
+  if (!directed || !igraph_is_directed(graph)) {
+    for (j=0; j<no_of_edges; j++) {
+      VECTOR(*result)[j] /= 2.0;
+    }
+  }
+
+  return 0;
+}
+
 /**
  * \ingroup structural
  * \function igraph_betweenness_estimate
@@ -1765,6 +2459,12 @@ void igraph_i_destroy_biguints(igraph_biguint_t *p) {
  * equal to a prescribed length. Note that the estimated centrality
  * will always be less than the real one.
  *
+ * </para><para>
+ * If more than one thread is allowed, see \ref
+ * igraph_set_num_threads(), then the sources are divided among the
+ * threads. This is done for the weighted calculation, and for the
+ * unweighted one if \p nobigint is true.
+ *
  * \param graph The graph object.
  * \param res The result of the computation, a vector containing the
  *        estimated betweenness scores for the specified vertices.
@@ -1824,6 +2524,13 @@ int igraph_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res,
 
   igraph_biguint_t D, R, T;
 
+  int nthreads=igraph_get_num_threads();
+
+  if (nthreads > 1 && (weights || nobigint)) {
+    return igraph_i_betweenness_parallel(graph, res, vids, directed,
+					 cutoff, weights, nthreads);
+  }
+
   if (weights) { 
     return igraph_i_betweenness_estimate_weighted(graph, res, vids, directed,
 						cutoff, weights, nobigint);
@@ -2033,6 +2740,268 @@ int igraph_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res,
   return 0;
 }
 
+/* Upper bound on the number of vertices in a shortest path. This is
+   the size of the largest (weakly connected) component, and for
+   undirected unweighted graphs also at most twice the eccentricity
+   of any vertex in the component, plus one. */
+
+static int igraph_i_btw_vertex_diameter(const igraph_t *graph,
+					igraph_bool_t undirected_unweighted,
+					long int *vd) {
+  long int no_of_nodes=igraph_vcount(graph);
+  igraph_adjlist_t adjlist;
+  igraph_vector_long_t distance, queue;
+  long int i, j, maxsize=0;
+
+  IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist, IGRAPH_ALL));
+  IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist);
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&distance, no_of_nodes);
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&queue, no_of_nodes);
+
+  for (i=0; i<no_of_nodes; i++) {
+    long int head=0, tail=0, compsize, ecc=0;
+    if (VECTOR(distance)[i] != 0) { continue; }
+    IGRAPH_ALLOW_INTERRUPTION();
+    VECTOR(queue)[tail++]=i;
+    VECTOR(distance)[i]=1;
+    while (head < tail) {
+      long int actnode=VECTOR(queue)[head++];
+      igraph_vector_int_t *neis=igraph_adjlist_get(&adjlist, actnode);
+      long int nneis=igraph_vector_int_size(neis);
+      ecc=VECTOR(distance)[actnode]-1;
+      for (j=0; j<nneis; j++) {
+	long int neighbor=(long int) VECTOR(*neis)[j];
+	if (VECTOR(distance)[neighbor] == 0) {
+	  VECTOR(distance)[neighbor]=VECTOR(distance)[actnode]+1;
+	  VECTOR(queue)[tail++]=neighbor;
+	}
+      }
+    }
+    compsize=tail;
+    if (undirected_unweighted && 2*ecc+1 < compsize) { 
+      compsize=2*ecc+1; 
+    }
+    if (compsize > maxsize) { maxsize=compsize; }
+  }
+
+  *vd=maxsize;
+
+  igraph_vector_long_destroy(&queue);
+  igraph_vector_long_destroy(&distance);
+  igraph_adjlist_destroy(&adjlist);
+  IGRAPH_FINALLY_CLEAN(3);
+
+  return 0;
+}
+
+/**
+ * \ingroup structural
+ * \function igraph_betweenness_approx
+ * \brief Approximate betweenness centrality, by sampling shortest paths.
+ * 
+ * </para><para>
+ * This function uses the sampling algorithm of Riondato and
+ * Kornaropoulos: it chooses random vertex pairs, and a uniformly
+ * chosen random shortest path between each pair, and counts how many
+ * sampled paths go through each vertex. The number of samples only
+ * depends on \p epsilon, \p delta and an upper bound on the number
+ * of vertices in shortest paths, so for large graphs this is much
+ * faster than the exact calculation of \ref igraph_betweenness().
+ * 
+ * </para><para>
+ * With probability at least 1-\p delta, the error of all estimates
+ * is at most \p epsilon times the number of vertex pairs (ordered
+ * pairs for directed, unordered pairs for undirected betweenness).
+ * For each vertex a second, empirical Bernstein, bound is also
+ * calculated, this is much tighter for vertices with small
+ * betweenness. The smaller of the two bounds is reported in \p
+ * error. All these bounds hold together, with probability at least
+ * 1-\p delta.
+ * 
+ * </para><para>
+ * The samples are divided among the threads, see \ref
+ * igraph_set_num_threads(). Only a single seed is drawn from \p
+ * rng, and every sample reseeds a private generator from it and the
+ * index of the sample. So neither the result, nor the state of \p rng
+ * afterwards depends on the number of threads.
+ * 
+ * </para><para>
+ * Reference: Matteo Riondato and Evgenios M. Kornaropoulos: Fast
+ * approximation of betweenness centrality through sampling. 
+ * Data Mining and Knowledge Discovery 30, 438--475 (2016).
+ * 
+ * \param graph The graph object.
+ * \param res The estimated betweenness scores of the vertices in \p
+ *        vids, on the same scale as the result of \ref
+ *        igraph_betweenness().
+ * \param error If not a null pointer, then the half width of the
+ *        confidence interval of each estimate is stored here, on the
+ *        same scale as \p res.
+ * \param vids The vertices of which the betweenness centrality scores
+ *        will be estimated.
+ * \param directed Logical, if true directed paths will be considered
+ *        for directed graphs. It is ignored for undirected graphs.
+ * \param weights An optional vector containing positive edge weights
+ *        for weighted betweenness. Supply a null pointer here for
+ *        unweighted betweenness.
+ * \param epsilon The maximum error, relative to the number of vertex
+ *        pairs, it must be between zero and one.
+ * \param delta The probability of larger errors, it must be between
+ *        zero and one.
+ * \param rng The random number generator to use, if a null pointer,
+ *        then the default one is used.
+ * \param samples If not a null pointer, the number of sampled paths
+ *        is stored here.
+ * \return Error code:
+ *        \c IGRAPH_ENOMEM, not enough memory for
+ *        temporary data. 
+ *        \c IGRAPH_EINVVID, invalid vertex id passed in
+ *        \p vids. 
+ *        \c IGRAPH_EINVAL, invalid \p epsilon, \p delta or \p weights.
+ *
+ * Time complexity: O(r(|V|+|E|)) for unweighted and O(r|E|log|V|)
+ * for weighted graphs, where r, the number of samples, is
+ * O((log(D)+log(1/delta))/epsilon^2), and D is the bound on the number
+ * of vertices in shortest paths.
+ * 
+ * \sa \ref igraph_betweenness() and \ref igraph_betweenness_estimate()
+ * for the exact betweenness.
+ */
+int igraph_betweenness_approx(const igraph_t *graph, igraph_vector_t *res,
+			      igraph_vector_t *error,
+			      const igraph_vs_t vids, igraph_bool_t directed,
+			      const igraph_vector_t *weights,
+			      igraph_real_t epsilon, igraph_real_t delta,
+			      igraph_rng_t *rng, igraph_integer_t *samples) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  int nthreads=igraph_get_num_threads();
+  igraph_i_btw_ws_t ws;
+  igraph_adjlist_t adj_out, adj_in;
+  igraph_inclist_t inclist;
+  igraph_vector_t hits;
+  igraph_neimode_t mode;
+  igraph_vit_t vit;
+  long int vd, r=0, k;
+  igraph_real_t pairs;
+
+  if (epsilon <= 0 || epsilon >= 1) {
+    IGRAPH_ERROR("`epsilon' must be between zero and one", IGRAPH_EINVAL);
+  }
+  if (delta <= 0 || delta >= 1) {
+    IGRAPH_ERROR("`delta' must be between zero and one", IGRAPH_EINVAL);
+  }
+  if (weights) {
+    if (igraph_vector_size(weights) != no_of_edges) {
+      IGRAPH_ERROR("Weight vector length does not match", IGRAPH_EINVAL);
+    }
+    if (no_of_edges > 0 && igraph_vector_min(weights) <= 0) {
+      IGRAPH_ERROR("Weight vector must be positive", IGRAPH_EINVAL);
+    }
+  }
+
+  directed=directed && igraph_is_directed(graph);
+  mode= directed ? IGRAPH_OUT : IGRAPH_ALL;
+  if (!rng) { rng=igraph_rng_default(); }
+
+  IGRAPH_VECTOR_INIT_FINALLY(&hits, no_of_nodes);
+
+  if (no_of_nodes >= 2) {
+    IGRAPH_CHECK(igraph_i_btw_vertex_diameter(graph, !directed && !weights,
+					      &vd));
+    /* Half of delta is for the uniform bound, half is for the
+       per vertex bounds. The constant is 0.5, as in the paper. */
+    r=(long int) ceil(0.5 / epsilon / epsilon * 
+		      ((vd > 2 ? floor(log((double) vd-2)/log(2.0)) : 0) + 1 +
+		       log(2.0/delta)));
+    if (r < 2) { r=2; }
+
+    IGRAPH_CHECK(igraph_i_btw_ws_init(&ws, graph, nthreads, no_of_nodes,
+				      weights ? 1 : 0, mode));
+    IGRAPH_FINALLY(igraph_i_btw_ws_destroy, &ws);
+    ws.cutoff=-1;
+    ws.weights=weights;
+    ws.rngs=igraph_Calloc(nthreads, igraph_rng_t);
+    if (!ws.rngs) {
+      IGRAPH_ERROR("Approximate betweenness failed", IGRAPH_ENOMEM);
+    }
+    /* Only the seed comes from \p rng, so neither the result nor
+       the state of \p rng depends on the number of threads. */
+    RNG_BEGIN();
+    ws.seed=(unsigned long int) igraph_rng_get_integer(rng, 0, 0x7FFFFFFFL);
+    RNG_END();
+    for (k=0; k<nthreads; k++) {
+      IGRAPH_CHECK(igraph_rng_init(&ws.rngs[k], &igraph_rngtype_mt19937));
+      ws.no_of_rngs=(int) k+1;
+    }
+
+    if (weights) {
+      IGRAPH_CHECK(igraph_inclist_init(graph, &inclist, mode));
+      IGRAPH_FINALLY(igraph_inclist_destroy, &inclist);
+      ws.inc_out=&inclist;
+      IGRAPH_CHECK(igraph_i_btw_run(&ws, igraph_i_btw_sample, r,
+				    "Approximate betweenness: ", &hits));
+      igraph_inclist_destroy(&inclist);
+      IGRAPH_FINALLY_CLEAN(1);
+    } else {
+      IGRAPH_CHECK(igraph_adjlist_init(graph, &adj_out, mode));
+      IGRAPH_FINALLY(igraph_adjlist_destroy, &adj_out);
+      IGRAPH_CHECK(igraph_adjlist_init(graph, &adj_in, 
+			       mode==IGRAPH_OUT ? IGRAPH_IN : IGRAPH_ALL));
+      IGRAPH_FINALLY(igraph_adjlist_destroy, &adj_in);
+      ws.adj_out=&adj_out;
+      ws.adj_in=&adj_in;
+      IGRAPH_CHECK(igraph_i_btw_run(&ws, igraph_i_btw_sample, r,
+				    "Approximate betweenness: ", &hits));
+      igraph_adjlist_destroy(&adj_in);
+      igraph_adjlist_destroy(&adj_out);
+      IGRAPH_FINALLY_CLEAN(2);
+    }
+
+    igraph_i_btw_ws_destroy(&ws);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  pairs=(igraph_real_t) no_of_nodes * (no_of_nodes-1);
+  if (!directed) { pairs /= 2.0; }
+
+  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
+  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+  IGRAPH_CHECK(igraph_vector_resize(res, IGRAPH_VIT_SIZE(vit)));
+  if (error) {
+    IGRAPH_CHECK(igraph_vector_resize(error, IGRAPH_VIT_SIZE(vit)));
+  }
+
+  for (k=0, IGRAPH_VIT_RESET(vit); !IGRAPH_VIT_END(vit);
+       IGRAPH_VIT_NEXT(vit), k++) {
+    long int node=IGRAPH_VIT_GET(vit);
+    igraph_real_t h=VECTOR(hits)[node];
+    VECTOR(*res)[k] = r > 0 ? h / r * pairs : 0.0;
+    if (error) {
+      igraph_real_t bound=epsilon;
+      if (r > 0) {
+	/* Empirical Bernstein bound, Maurer and Pontil, 2009 */
+	igraph_real_t L=log(4.0 * no_of_nodes / delta);
+	igraph_real_t var=h * (r-h) / r / (r-1);
+	igraph_real_t eb=sqrt(2.0 * var * L / r) + 7.0 * L / 3.0 / (r-1);
+	if (eb < bound) { bound=eb; }
+      } else {
+	bound=0.0;
+      }
+      VECTOR(*error)[k] = bound * pairs;
+    }
+  }
+
+  igraph_vit_destroy(&vit);
+  igraph_vector_destroy(&hits);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  if (samples) { *samples=(igraph_integer_t) r; }
+
+  return 0;
+}
+
 int igraph_i_edge_betweenness_estimate_weighted(const igraph_t *graph, 
 					      igraph_vector_t *result,
 					      igraph_bool_t directed, 
@@ -2248,6 +3217,12 @@ int igraph_edge_betweenness(const igraph_t *graph, igraph_vector_t *result,
  * takes into consideration only those paths that are shorter than or
  * equal to a prescribed length. Note that the estimated centrality
  * will always be less than the real one.
+ *
+ * </para><para>
+ * If more than one thread is allowed, see \ref
+ * igraph_set_num_threads(), then the sources are divided among the
+ * threads.
+ *
  * \param graph The graph object.
  * \param result The result of the computation, vector containing the
  *        betweenness scores for the edges.
@@ -2291,6 +3266,13 @@ int igraph_edge_betweenness_estimate(const igraph_t *graph, igraph_vector_t *res
   long int neino;
   long int i;
 
+  int nthreads=igraph_get_num_threads();
+
+  if (nthreads > 1) {
+    return igraph_i_edge_betweenness_parallel(graph, result, directed,
+					      cutoff, weights, nthreads);
+  }
+
   if (weights) { 
     return igraph_i_edge_betweenness_estimate_weighted(graph, result, 
 						     directed, cutoff, weights);
@@ -2635,6 +3617,33 @@ int igraph_i_closeness_estimate_weighted(const igraph_t *graph,
   return 0;
 }
 
+/* The sums of the distances and the number of reached vertices, for
+   each source. All sources of a group are searched by the same
+   thread, so no synchronization is needed. */
+
+typedef struct igraph_i_closeness_t {
+  igraph_real_t *sum, *reached;
+} igraph_i_closeness_t;
+
+static void igraph_i_closeness_cb(int thread, long int first, int nsrc,
+				  long int level, const long int *reached,
+				  long int no_reached, 
+				  const igraph_i_msbfs_word_t *bits,
+				  void *extra) {
+  igraph_i_closeness_t *data=(igraph_i_closeness_t *) extra;
+  long int i;
+  IGRAPH_UNUSED(thread); IGRAPH_UNUSED(nsrc);
+  for (i=0; i<no_reached; i++) {
+    igraph_i_msbfs_word_t w=bits[reached[i]];
+    while (w) {
+      long int src=first + IGRAPH_I_CTZ(w);
+      data->sum[src] += level;
+      data->reached[src] += 1;
+      w &= w-1;
+    }
+  }
+}
+
 /**
  * \ingroup structural
  * \function igraph_closeness_estimate
@@ -2693,6 +3702,11 @@ int igraph_i_closeness_estimate_weighted(const igraph_t *graph,
  *           invalid mode argument.
  *        \endclist
  *
+ * </para><para>
+ * Without weights, the breadth-first searches of 64 vertices are run
+ * together, with bit-parallel operations, and these groups are
+ * divided among the threads, see \ref igraph_set_num_threads().
+ *
  * Time complexity: O(n|E|),
  * n is the number 
  * of vertices for which the calculation is done and
@@ -2708,16 +3722,10 @@ int igraph_closeness_estimate(const igraph_t *graph, igraph_vector_t *res,
 			      igraph_bool_t normalized) {
 
   long int no_of_nodes=igraph_vcount(graph);
-  igraph_vector_t already_counted;
-  igraph_vector_int_t *neis;
-  long int i, j;
-  long int nodes_reached;
-  igraph_adjlist_t allneis;
-
-  igraph_dqueue_t q;
-  
-  long int nodes_to_calc;
-  igraph_vit_t vit;
+  igraph_vector_t reached;
+  igraph_i_closeness_t data;
+  long int i;
+  igraph_integer_t nodes_to_calc;
 
   igraph_bool_t warning_shown = 0;
   
@@ -2726,61 +3734,30 @@ int igraph_closeness_estimate(const igraph_t *graph, igraph_vector_t *res,
 						weights, normalized);
   }
 
-  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
-  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
-
-  nodes_to_calc=IGRAPH_VIT_SIZE(vit);
-  
   if (mode != IGRAPH_OUT && mode != IGRAPH_IN && 
       mode != IGRAPH_ALL) {
     IGRAPH_ERROR("calculating closeness", IGRAPH_EINVMODE);
   }
 
-  IGRAPH_VECTOR_INIT_FINALLY(&already_counted, no_of_nodes);
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-
-  IGRAPH_CHECK(igraph_adjlist_init(graph, &allneis, mode));
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &allneis);
+  IGRAPH_CHECK(igraph_vs_size(graph, &vids, &nodes_to_calc));
+  IGRAPH_VECTOR_INIT_FINALLY(&reached, nodes_to_calc);
 
   IGRAPH_CHECK(igraph_vector_resize(res, nodes_to_calc));
   igraph_vector_null(res);
-  
-  for (IGRAPH_VIT_RESET(vit), i=0; 
-       !IGRAPH_VIT_END(vit); 
-       IGRAPH_VIT_NEXT(vit), i++) {
-    igraph_dqueue_clear(&q);
-    IGRAPH_CHECK(igraph_dqueue_push(&q, IGRAPH_VIT_GET(vit)));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    nodes_reached=1;
-    VECTOR(already_counted)[(long int)IGRAPH_VIT_GET(vit)]=i+1;
-
-    IGRAPH_PROGRESS("Closeness: ", 100.0*i/no_of_nodes, NULL);
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int act=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-      
-      VECTOR(*res)[i] += actdist;
+  data.sum=VECTOR(*res);
+  data.reached=VECTOR(reached);
 
-      if (cutoff>0 && actdist>=cutoff) continue;   /* NOT break!!! */
-
-      neis=igraph_adjlist_get(&allneis, act);
-      for (j=0; j<igraph_vector_int_size(neis); j++) {
-        long int neighbor=(long int) VECTOR(*neis)[j];
-        if (VECTOR(already_counted)[neighbor] == i+1) { continue; }
-        VECTOR(already_counted)[neighbor] = i+1;
-        nodes_reached++;
-        IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-        IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
-      }
-    }
+  IGRAPH_CHECK(igraph_i_msbfs(graph, vids, mode, cutoff, 
+			      igraph_i_closeness_cb, &data,
+			      igraph_get_num_threads(), "Closeness: "));
 
+  for (i=0; i<nodes_to_calc; i++) {
     /* using igraph_real_t here instead of igraph_integer_t to avoid overflow */
-    VECTOR(*res)[i] += ((igraph_real_t)no_of_nodes * (no_of_nodes-nodes_reached));
+    VECTOR(*res)[i] += ((igraph_real_t)no_of_nodes * 
+			(no_of_nodes-VECTOR(reached)[i]));
     VECTOR(*res)[i] = (no_of_nodes-1) / VECTOR(*res)[i];
 
-    if (no_of_nodes > nodes_reached && !warning_shown) {
+    if (no_of_nodes > VECTOR(reached)[i] && !warning_shown) {
       IGRAPH_WARNING("closeness centrality is not well-defined for disconnected graphs");
       warning_shown = 1;
     }
@@ -2792,14 +3769,9 @@ int igraph_closeness_estimate(const igraph_t *graph, igraph_vector_t *res,
     }
   }
 
-  IGRAPH_PROGRESS("Closeness: ", 100.0, NULL);
-
   /* Clean */
-  igraph_dqueue_destroy(&q);
-  igraph_vector_destroy(&already_counted);
-  igraph_vit_destroy(&vit);
-  igraph_adjlist_destroy(&allneis);
-  IGRAPH_FINALLY_CLEAN(4);
+  igraph_vector_destroy(&reached);
+  IGRAPH_FINALLY_CLEAN(1);
   
   return 0;
 }
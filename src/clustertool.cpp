@@ -61,6 +61,7 @@
 #include "igraph_interface.h"
 #include "igraph_components.h"
 #include "igraph_interrupt_internal.h"
+#include "igraph_threading.h"
 
 int igraph_i_community_spinglass_orig(const igraph_t *graph,
 				      const igraph_vector_t *weights,
@@ -74,7 +75,8 @@ int igraph_i_community_spinglass_orig(const igraph_t *graph,
 				      igraph_real_t stoptemp,
 				      igraph_real_t coolfact,
 				      igraph_spincomm_update_t update_rule,
-				      igraph_real_t gamma);
+				      igraph_real_t gamma,
+				      igraph_integer_t replicas);
 
 int igraph_i_community_spinglass_negative(const igraph_t *graph,
 					  const igraph_vector_t *weights,
@@ -175,6 +177,20 @@ int igraph_i_community_spinglass_negative(const igraph_t *graph,
  *     If this argument is set to zero, the algorithm reduces to a graph
  *     coloring algorithm, using the number of spins as the number of
  *     colors. 
+ * \param replicas Integer, the number of replicas for replica exchange
+ *     Monte Carlo (parallel tempering). If it is one, then a single
+ *     simulated annealing chain is run, as in the original code. If
+ *     it is larger, then the replicas are cooled together, at
+ *     temperatures that span a factor of two, the coldest one follows
+ *     the usual schedule. After every round of sweeps, replicas at
+ *     neighbouring temperatures may swap their configurations, and the
+ *     configuration with the lowest energy that was seen in any
+ *     replica is returned. The replicas are updated in parallel, if
+ *     more than one thread is allowed, see \ref
+ *     igraph_set_num_threads(), the result does not depend on the
+ *     number of threads. This is only implemented in the \c
+ *     IGRAPH_SPINCOMM_IMP_ORIG implementation, for positive
+ *     temperatures and sequential updates.
  * \return Error code.
  * 
  * \sa igraph_community_spinglass_single() for calculating the community
@@ -203,7 +219,8 @@ int igraph_community_spinglass(const igraph_t *graph,
 /* 			       igraph_matrix_t *adhesion, */
 /* 			       igraph_matrix_t *normalised_adhesion, */
 /* 			       igraph_real_t *polarization, */
-			       igraph_real_t gamma_minus) {
+			       igraph_real_t gamma_minus,
+			       igraph_integer_t replicas) {
   
   switch (implementation) {
   case IGRAPH_SPINCOMM_IMP_ORIG:
@@ -211,9 +228,13 @@ int igraph_community_spinglass(const igraph_t *graph,
 					     temperature, membership, csize, 
 					     spins, parupdate, starttemp, 
 					     stoptemp, coolfact, update_rule, 
-					     gamma);
+					     gamma, replicas);
     break;
   case IGRAPH_SPINCOMM_IMP_NEG:
+    if (replicas != 1) {
+      IGRAPH_ERROR("Multiple replicas are not implemented for negative weights",
+		   IGRAPH_UNIMPLEMENTED);
+    }
     return igraph_i_community_spinglass_negative(graph, weights, modularity, 
 						 temperature, membership, csize, 
 						 spins, parupdate, starttemp, 
@@ -231,6 +252,10 @@ int igraph_community_spinglass(const igraph_t *graph,
   return 0;
 }
 
+static void igraph_i_delete_PottsReplicas(PottsReplicas *pr) {
+  delete pr;
+}
+
 int igraph_i_community_spinglass_orig(const igraph_t *graph,
 				      const igraph_vector_t *weights,
 				      igraph_real_t *modularity,
@@ -243,7 +268,8 @@ int igraph_i_community_spinglass_orig(const igraph_t *graph,
 				      igraph_real_t stoptemp,
 				      igraph_real_t coolfact,
 				      igraph_spincomm_update_t update_rule,
-				      igraph_real_t gamma) {
+				      igraph_real_t gamma,
+				      igraph_integer_t replicas) {
 
   unsigned long changes, runs;
   igraph_bool_t use_weights=0;
@@ -278,6 +304,13 @@ int igraph_i_community_spinglass_orig(const igraph_t *graph,
     IGRAPH_ERROR("starttemp should be larger in absolute value than stoptemp",
 		 IGRAPH_EINVAL);
   }
+  if (replicas < 1) {
+    IGRAPH_ERROR("Invalid number of replicas", IGRAPH_EINVAL);
+  }
+  if (replicas > 1 && (parupdate || (starttemp==0.0 && stoptemp==0.0))) {
+    IGRAPH_ERROR("Multiple replicas need sequential updates and positive "
+		 "temperatures", IGRAPH_EINVAL);
+  }
   
   /* Check whether we have a single component */
   igraph_bool_t conn;
@@ -310,7 +343,40 @@ int igraph_i_community_spinglass_orig(const igraph_t *graph,
   runs=0;
   changes=1;
 
-  while (changes>0 && (kT/stoptemp>1.0 || (zeroT && runs<150))) {
+  if (replicas > 1) {
+    int nthreads=igraph_get_num_threads();
+    if (nthreads > replicas) { nthreads=replicas; }
+    if (nthreads < 1) { nthreads=1; }
+    /* the temperatures of the replicas span a factor of two */
+    double ratio=pow(2.0, 1.0/double(replicas-1));
+    int parity=0;
+    PottsReplicas *pr=new PottsReplicas(net, (unsigned int) spins, update_rule,
+					(unsigned int) replicas, nthreads);
+    IGRAPH_FINALLY(igraph_i_delete_PottsReplicas, pr);
+    IGRAPH_CHECK(pr->assign_initial_conf());
+
+    while (changes>0 && kT/stoptemp>1.0) {
+      IGRAPH_ALLOW_INTERRUPTION();
+      runs++;
+      kT*=coolfact;
+      acc=pr->HeatBathSweeps(gamma, prob, kT, ratio, 50);
+      if (acc<(1.0-1.0/double(spins))*0.01) {
+	changes=0;
+      } else {
+	changes=1;
+      }
+      pr->Exchange(kT, ratio, parity);
+      parity=1-parity;
+    }
+
+    /* WriteClusters() below reads the configuration from the network */
+    pr->Set_Best_Conf();
+    delete pr;
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  while (replicas == 1 && changes>0 && 
+	 (kT/stoptemp>1.0 || (zeroT && runs<150))) {
 
     IGRAPH_ALLOW_INTERRUPTION(); /* This is not clean.... */
     
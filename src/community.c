@@ -40,11 +40,14 @@
 #include "igraph_types_internal.h"
 #include "igraph_conversion.h"
 #include "igraph_centrality.h"
+#include "igraph_threading_internal.h"
+#include "igraph_qsort.h"
 #include "config.h"
 
 #include <string.h>
 #include <math.h>
 
+
 #ifdef USING_R
 #include <R.h>
 #endif
@@ -312,6 +315,363 @@ long int igraph_i_vector_which_max_not_null(const igraph_vector_t *v,
   return which;
 }
 
+/* 
+ * After removing an edge, the edge betweenness is only recalculated
+ * in the component that contained it: the shortest paths from the
+ * other components do not use its edges, and the scores of their
+ * edges do not change. The sources of the component are processed
+ * in increasing order, so the result is exactly the same as a full
+ * recalculation.
+ *
+ * With more than one thread the sources are processed in batches,
+ * the sources of a batch are divided among the threads, like in
+ * the betweenness functions. Each thread has its own work buffers
+ * and partial scores, these are summed in the order of the threads,
+ * so the result does not depend on the scheduling. It does depend on
+ * the number of threads, through the order of the additions, unless
+ * all shortest paths are unique: then every score is a sum of
+ * integers, and these are exact. The threads do not allocate memory
+ * and do not raise errors.
+ */
+
+#define IGRAPH_I_EB_BATCH 64	/* sources per thread in a batch */
+
+typedef struct {
+  const igraph_t *graph;
+  int nthreads;
+  long int no_of_nodes, no_of_edges;
+  igraph_inclist_t *elist_out_p, *elist_in_p;
+  const igraph_vector_t *weights;
+  /* per thread blocks, 'nthreads' times the given size */
+  double *partial;			/* no_of_edges */
+  double *distance;			/* no_of_nodes */
+  double *tmpscore;			/* no_of_nodes */
+  unsigned long long int *nrgeo;	/* no_of_nodes */
+  long int *order;			/* no_of_nodes */
+  long int *nfathers;			/* no_of_nodes, weighted */
+  long int *fathers;			/* fatherstart[no_of_nodes], weighted */
+  long int *fatherstart;		/* no_of_nodes+1, shared, weighted */
+  igraph_2wheap_t *heaps;		/* one per thread, weighted */
+  int no_of_heaps;
+} igraph_i_eb_ws_t;
+
+static void igraph_i_eb_ws_destroy(igraph_i_eb_ws_t *ws) {
+  int i;
+  for (i=0; i<ws->no_of_heaps; i++) {
+    igraph_2wheap_destroy(&ws->heaps[i]);
+  }
+  if (ws->heaps) { igraph_Free(ws->heaps); }
+  if (ws->partial) { igraph_Free(ws->partial); }
+  if (ws->distance) { igraph_Free(ws->distance); }
+  if (ws->tmpscore) { igraph_Free(ws->tmpscore); }
+  if (ws->nrgeo) { igraph_Free(ws->nrgeo); }
+  if (ws->order) { igraph_Free(ws->order); }
+  if (ws->nfathers) { igraph_Free(ws->nfathers); }
+  if (ws->fathers) { igraph_Free(ws->fathers); }
+  if (ws->fatherstart) { igraph_Free(ws->fatherstart); }
+}
+
+static int igraph_i_eb_ws_init(igraph_i_eb_ws_t *ws, const igraph_t *graph,
+			       int nthreads, igraph_bool_t directed,
+			       const igraph_vector_t *weights) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  size_t nn=(size_t) nthreads * (size_t) no_of_nodes;
+  long int i;
+
+  memset(ws, 0, sizeof(igraph_i_eb_ws_t));
+  ws->graph=graph;
+  ws->nthreads=nthreads;
+  ws->no_of_nodes=no_of_nodes;
+  ws->no_of_edges=no_of_edges;
+  ws->weights=weights;
+  IGRAPH_FINALLY(igraph_i_eb_ws_destroy, ws);
+
+#define IGRAPH_I_EB_ALLOC(field, size, type) do {			\
+    ws->field=igraph_Calloc((size) > 0 ? (size) : 1, type);		\
+    if (!ws->field) {							\
+      IGRAPH_ERROR("edge betweenness community structure failed",	\
+		   IGRAPH_ENOMEM);					\
+    }									\
+  } while (0)
+
+  IGRAPH_I_EB_ALLOC(partial, (size_t) nthreads * (size_t) no_of_edges,
+		    double);
+  IGRAPH_I_EB_ALLOC(distance, nn, double);
+  IGRAPH_I_EB_ALLOC(tmpscore, nn, double);
+  IGRAPH_I_EB_ALLOC(nrgeo, nn, unsigned long long int);
+  IGRAPH_I_EB_ALLOC(order, nn, long int);
+
+  if (weights) {
+    igraph_vector_t deg;
+    IGRAPH_I_EB_ALLOC(nfathers, nn, long int);
+
+    /* A vertex can get at most one father for each incident edge */
+    IGRAPH_VECTOR_INIT_FINALLY(&deg, no_of_nodes);
+    IGRAPH_CHECK(igraph_degree(graph, &deg, igraph_vss_all(),
+			       directed ? IGRAPH_IN : IGRAPH_ALL,
+			       IGRAPH_LOOPS));
+    IGRAPH_I_EB_ALLOC(fatherstart, no_of_nodes+1, long int);
+    for (i=0; i<no_of_nodes; i++) {
+      ws->fatherstart[i+1]=ws->fatherstart[i] + (long int) VECTOR(deg)[i];
+    }
+    igraph_vector_destroy(&deg);
+    IGRAPH_FINALLY_CLEAN(1);
+    IGRAPH_I_EB_ALLOC(fathers, (size_t) nthreads *
+		      (size_t) ws->fatherstart[no_of_nodes], long int);
+
+    IGRAPH_I_EB_ALLOC(heaps, nthreads, igraph_2wheap_t);
+    for (i=0; i<nthreads; i++) {
+      IGRAPH_CHECK(igraph_2wheap_init(&ws->heaps[i], no_of_nodes));
+      ws->no_of_heaps++;
+      /* no reallocation is allowed in the threads */
+      IGRAPH_CHECK(igraph_2wheap_reserve(&ws->heaps[i], no_of_nodes));
+    }
+  }
+
+#undef IGRAPH_I_EB_ALLOC
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/* Unweighted edge betweenness scores from a single source, they are
+   added to the partial scores of thread 't'. */
+static void igraph_i_eb_source(igraph_i_eb_ws_t *ws, int t, 
+			       long int source) {
+  const igraph_t *graph=ws->graph;
+  long int no_of_nodes=ws->no_of_nodes;
+  double *distance=ws->distance + t * no_of_nodes;
+  double *tmpscore=ws->tmpscore + t * no_of_nodes;
+  unsigned long long int *nrgeo=ws->nrgeo + t * no_of_nodes;
+  long int *order=ws->order + t * no_of_nodes;
+  double *partial=ws->partial + t * ws->no_of_edges;
+  long int head=0, tail=0, i, neino;
+  igraph_vector_int_t *neip;
+
+  order[tail++]=source;
+  nrgeo[source]=1;
+  distance[source]=0;
+
+  while (head < tail) {
+    long int actnode=order[head++];
+    neip=igraph_inclist_get(ws->elist_out_p, actnode);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int edge=(long int) VECTOR(*neip)[i];
+      long int neighbor=IGRAPH_OTHER(graph, edge, actnode);
+      if (nrgeo[neighbor] != 0) {
+	/* we've already seen this node, another shortest path? */
+	if (distance[neighbor]==distance[actnode]+1) {
+	  nrgeo[neighbor]+=nrgeo[actnode];
+	}
+      } else {
+	/* we haven't seen this node yet */
+	nrgeo[neighbor]+=nrgeo[actnode];
+	distance[neighbor]=distance[actnode]+1;
+	order[tail++]=neighbor;
+      }
+    }
+  }
+
+  /* Inverse search, starting with the farthest nodes, the source is
+     order[0] */
+  for (head=tail-1; head > 0; head--) {
+    long int actnode=order[head];
+    neip=igraph_inclist_get(ws->elist_in_p, actnode);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int edge=(long int) VECTOR(*neip)[i];
+      long int neighbor=IGRAPH_OTHER(graph, edge, actnode);
+      if (distance[neighbor]==distance[actnode]-1 &&
+	  nrgeo[neighbor] != 0) {
+	tmpscore[neighbor] +=
+	  (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
+	partial[edge] +=
+	  (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
+      }
+    }
+  }
+
+  for (head=0; head<tail; head++) {
+    long int actnode=order[head];
+    distance[actnode]=0;
+    nrgeo[actnode]=0;
+    tmpscore[actnode]=0;
+  }
+}
+
+/* Weighted edge betweenness scores from a single source, they are
+   added to the partial scores of thread 't'. */
+static void igraph_i_eb_source_weighted(igraph_i_eb_ws_t *ws, int t,
+					long int source) {
+  const igraph_t *graph=ws->graph;
+  long int no_of_nodes=ws->no_of_nodes;
+  double *distance=ws->distance + t * no_of_nodes;
+  double *tmpscore=ws->tmpscore + t * no_of_nodes;
+  unsigned long long int *nrgeo=ws->nrgeo + t * no_of_nodes;
+  long int *order=ws->order + t * no_of_nodes;
+  long int *nfathers=ws->nfathers + t * no_of_nodes;
+  long int *fathers=ws->fathers + t * ws->fatherstart[no_of_nodes];
+  const long int *fatherstart=ws->fatherstart;
+  double *partial=ws->partial + t * ws->no_of_edges;
+  igraph_2wheap_t *heap=&ws->heaps[t];
+  long int count=0, i, neino;
+  igraph_vector_int_t *neip;
+
+  igraph_2wheap_push_with_index(heap, source, 0);
+  distance[source]=1.0;
+  nrgeo[source]=1;
+
+  while (!igraph_2wheap_empty(heap)) {
+    long int minnei=igraph_2wheap_max_index(heap);
+    igraph_real_t mindist=-igraph_2wheap_delete_max(heap);
+
+    order[count++]=minnei;
+
+    neip=igraph_inclist_get(ws->elist_out_p, minnei);
+    neino=igraph_vector_int_size(neip);
+    for (i=0; i<neino; i++) {
+      long int edge=(long int) VECTOR(*neip)[i];
+      long int to=IGRAPH_OTHER(graph, edge, minnei);
+      igraph_real_t altdist=mindist + VECTOR(*ws->weights)[edge];
+      igraph_real_t curdist=distance[to];
+
+      if (curdist == 0) {
+	/* This is the first finite distance to 'to' */
+	fathers[fatherstart[to]]=edge;
+	nfathers[to]=1;
+	nrgeo[to]=nrgeo[minnei];
+	distance[to]=altdist + 1.0;
+	igraph_2wheap_push_with_index(heap, to, -altdist);
+      } else if (altdist < curdist-1) {
+	/* This is a shorter path */
+	fathers[fatherstart[to]]=edge;
+	nfathers[to]=1;
+	nrgeo[to]=nrgeo[minnei];
+	distance[to]=altdist + 1.0;
+	igraph_2wheap_modify(heap, to, -altdist);
+      } else if (altdist == curdist-1) {
+	/* Another path with the same length */
+	fathers[fatherstart[to] + nfathers[to]++]=edge;
+	nrgeo[to] += nrgeo[minnei];
+      }
+    }
+  }
+
+  while (count > 0) {
+    long int w=order[--count];
+    long int *fatv=fathers + fatherstart[w];
+    long int fatv_len=nfathers[w];
+
+    for (i=0; i<fatv_len; i++) {
+      long int fedge=fatv[i];
+      long int neighbor=IGRAPH_OTHER(graph, fedge, w);
+      tmpscore[neighbor] += (tmpscore[w] + 1) * nrgeo[neighbor] / nrgeo[w];
+      partial[fedge] += (tmpscore[w] + 1) * nrgeo[neighbor] / nrgeo[w];
+    }
+
+    tmpscore[w]=0;
+    distance[w]=0;
+    nrgeo[w]=0;
+    nfathers[w]=0;
+  }
+}
+
+/* Recalculates the edge betweenness of the edges of the vertices in
+   'comp', using these as sources. 'comp' must contain whole
+   components, in increasing order. */
+static int igraph_i_eb_update(igraph_i_eb_ws_t *ws, const long int *comp,
+			      long int ncomp, igraph_vector_t *eb) {
+  void (*fun)(igraph_i_eb_ws_t *, int, long int) = 
+    ws->weights ? igraph_i_eb_source_weighted : igraph_i_eb_source;
+  long int batch=(long int) ws->nthreads * IGRAPH_I_EB_BATCH;
+  long int from, i, j;
+  int t;
+
+  for (i=0; i<ncomp; i++) {
+    igraph_vector_int_t *neip=igraph_inclist_get(ws->elist_out_p, comp[i]);
+    long int neino=igraph_vector_int_size(neip);
+    for (j=0; j<neino; j++) {
+      long int edge=(long int) VECTOR(*neip)[j];
+      for (t=0; t<ws->nthreads; t++) {
+	ws->partial[ (size_t) t * (size_t) ws->no_of_edges + edge ]=0;
+      }
+    }
+  }
+
+  for (from=0; from<ncomp; from += batch) {
+    long int to= from+batch < ncomp ? from+batch : ncomp;
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    IGRAPH_I_PARALLEL(ws->nthreads)
+    {
+      int me=IGRAPH_I_THREAD_NUM;
+      long int k;
+      IGRAPH_I_SHARE(k, from, to) {
+	fun(ws, me, comp[k]);
+      }
+    }
+  }
+
+  for (i=0; i<ncomp; i++) {
+    igraph_vector_int_t *neip=igraph_inclist_get(ws->elist_out_p, comp[i]);
+    long int neino=igraph_vector_int_size(neip);
+    for (j=0; j<neino; j++) {
+      long int edge=(long int) VECTOR(*neip)[j];
+      double sum=0.0;
+      for (t=0; t<ws->nthreads; t++) {
+	sum += ws->partial[ (size_t) t * (size_t) ws->no_of_edges + edge ];
+      }
+      VECTOR(*eb)[edge]=sum;
+    }
+  }
+
+  return 0;
+}
+
+static int igraph_i_eb_cmp(const void *a, const void *b) {
+  long int da=*(const long int *) a, db=*(const long int *) b;
+  return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+/* Collects the vertices of the (weak) components of 'from' and 'to'
+   into 'comp', in increasing order, and returns their number. 'seen'
+   must be all zero, it is restored before returning. */
+static long int igraph_i_eb_component(igraph_i_eb_ws_t *ws, long int from,
+				      long int to, char *seen, long int *comp) {
+  const igraph_t *graph=ws->graph;
+  long int head=0, tail=0, i, j, k;
+
+  comp[tail++]=from;
+  seen[from]=1;
+  if (!seen[to]) {
+    comp[tail++]=to;
+    seen[to]=1;
+  }
+  while (head < tail) {
+    long int actnode=comp[head++];
+    for (k=0; k<2; k++) {
+      igraph_vector_int_t *neip=igraph_inclist_get(k ? ws->elist_in_p : 
+						   ws->elist_out_p, actnode);
+      long int neino=igraph_vector_int_size(neip);
+      if (k == 1 && ws->elist_in_p == ws->elist_out_p) { break; }
+      for (j=0; j<neino; j++) {
+	long int neighbor=IGRAPH_OTHER(graph, VECTOR(*neip)[j], actnode);
+	if (!seen[neighbor]) {
+	  seen[neighbor]=1;
+	  comp[tail++]=neighbor;
+	}
+      }
+    }
+  }
+
+  for (i=0; i<tail; i++) { seen[comp[i]]=0; }
+  igraph_qsort(comp, (size_t) tail, sizeof(long int), igraph_i_eb_cmp);
+
+  return tail;
+}
+
 /**
  * \function igraph_community_edge_betweenness
  * \brief Community finding based on edge betweenness
@@ -332,6 +692,17 @@ long int igraph_i_vector_which_max_not_null(const igraph_vector_t *v,
  * then after a while one of these components falls off to two smaller 
  * components, etc. until all edges are removed. This is a divisive
  * hierarchical approach, the result is a dendrogram.
+ *
+ * </para><para>
+ * After removing an edge, only the edge betweenness scores in its
+ * component are recalculated, the others do not change. If more than
+ * one thread is allowed, see \ref igraph_set_num_threads(), then the
+ * shortest paths from the different sources are calculated in
+ * parallel. Each thread needs memory linear in the number of edges.
+ * The scores are summed in a fixed order, but it depends on the
+ * number of threads, so they might be different in the last
+ * bits, and ties might be broken differently. This does not happen
+ * if all shortest paths are unique, e.g. with generic real weights.
  * \param graph The input graph.
  * \param result Pointer to an initialized vector, the result will be
  *     stored here, the ids of the removed edges in the order of their 
@@ -369,7 +740,8 @@ long int igraph_i_vector_which_max_not_null(const igraph_vector_t *v,
  * igraph_community_spinglass(), \ref igraph_community_walktrap().
  * 
  * Time complexity: O(|V||E|^2), as the betweenness calculation requires
- * O(|V||E|) and we do it |E|-1 times.
+ * O(|V||E|) and we do it |E|-1 times. It is much less if the graph
+ * falls apart into several components quickly.
  * 
  * \example examples/simple/igraph_community_edge_betweenness.c
  */
@@ -386,11 +758,9 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
   
   long int no_of_nodes=igraph_vcount(graph);
   long int no_of_edges=igraph_ecount(graph);
-  double *distance, *tmpscore;
-  unsigned long long int *nrgeo;
-  long int source, i, e;
+  long int i, e;
   
-  igraph_inclist_t elist_out, elist_in, fathers;
+  igraph_inclist_t elist_out, elist_in;
   igraph_inclist_t *elist_out_p, *elist_in_p;
   igraph_vector_int_t *neip;
   long int neino;
@@ -398,16 +768,11 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
   long int maxedge, pos;
   igraph_integer_t from, to;
   igraph_bool_t result_owned = 0;
-  igraph_stack_t stack=IGRAPH_STACK_NULL;
   igraph_real_t steps, steps_done;
+  igraph_i_eb_ws_t ws;
+  long int *comp, ncomp;
 
-  char *passive;
-
-  /* Needed only for the unweighted case */
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-
-  /* Needed only for the weighted case */
-  igraph_2wheap_t heap;
+  char *passive, *seen;
 
   if (result == 0) {
     result = igraph_Calloc(1, igraph_vector_t);
@@ -432,25 +797,7 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
     elist_out_p=elist_in_p=&elist_out;
   }
   
-  distance=igraph_Calloc(no_of_nodes, double);
-  if (distance==0) {
-    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, distance);
-  nrgeo=igraph_Calloc(no_of_nodes, unsigned long long int);
-  if (nrgeo==0) {
-    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, nrgeo);
-  tmpscore=igraph_Calloc(no_of_nodes, double);
-  if (tmpscore==0) {
-    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, tmpscore);
-
-  if (weights == 0) {
-    IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-  } else {
+  if (weights != 0) {
     if (igraph_vector_min(weights) <= 0) {
       IGRAPH_ERROR("weights must be strictly positive", IGRAPH_EINVAL);
     }
@@ -466,17 +813,25 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
           "weights as similarities while edge betwenness treats them as "\
           "distances");
     }
+  }
 
-    IGRAPH_CHECK(igraph_2wheap_init(&heap, no_of_nodes));
-    IGRAPH_FINALLY(igraph_2wheap_destroy, &heap);
-    IGRAPH_CHECK(igraph_inclist_init_empty(&fathers, 
-					   (igraph_integer_t) no_of_nodes));
-    IGRAPH_FINALLY(igraph_inclist_destroy, &fathers);
+  IGRAPH_CHECK(igraph_i_eb_ws_init(&ws, graph, igraph_get_num_threads(),
+				   directed, weights));
+  IGRAPH_FINALLY(igraph_i_eb_ws_destroy, &ws);
+  ws.elist_out_p=elist_out_p;
+  ws.elist_in_p=elist_in_p;
+
+  comp=igraph_Calloc(no_of_nodes > 0 ? no_of_nodes : 1, long int);
+  if (!comp) {
+    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
   }
+  IGRAPH_FINALLY(igraph_free, comp);
+  seen=igraph_Calloc(no_of_nodes > 0 ? no_of_nodes : 1, char);
+  if (!seen) {
+    IGRAPH_ERROR("edge betweenness community structure failed", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_free, seen);
 
-  IGRAPH_CHECK(igraph_stack_init(&stack, no_of_nodes));
-  IGRAPH_FINALLY(igraph_stack_destroy, &stack);
-  
   IGRAPH_CHECK(igraph_vector_resize(result, no_of_edges));
   if (edge_betweenness) {
     IGRAPH_CHECK(igraph_vector_resize(edge_betweenness, no_of_edges));
@@ -500,157 +855,17 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
   steps = no_of_edges / 2.0 * (no_of_edges+1);
   steps_done = 0;
 
+  /* All scores are calculated first */
+  for (i=0; i<no_of_nodes; i++) {
+    comp[i]=i;
+  }
+  ncomp=no_of_nodes;
+
   for (e=0; e<no_of_edges; steps_done += no_of_edges-e, e++) {
     IGRAPH_PROGRESS("Edge betweenness community detection: ",
         100.0*steps_done/steps, NULL);
 
-    igraph_vector_null(&eb);
-
-    if (weights == 0) {
-      /* Unweighted variant follows */
-
-      /* The following for loop is copied almost intact from
-       * igraph_edge_betweenness_estimate */
-      for (source=0; source<no_of_nodes; source++) {
-
-        IGRAPH_ALLOW_INTERRUPTION();
-
-        memset(distance, 0, (size_t) no_of_nodes*sizeof(double));
-        memset(nrgeo, 0, (size_t) no_of_nodes*sizeof(unsigned long long int));
-        memset(tmpscore, 0, (size_t) no_of_nodes*sizeof(double));
-        igraph_stack_clear(&stack); /* it should be empty anyway... */
-        
-        IGRAPH_CHECK(igraph_dqueue_push(&q, source));
-        
-        nrgeo[source]=1;
-        distance[source]=0;
-        
-        while (!igraph_dqueue_empty(&q)) {
-          long int actnode=(long int) igraph_dqueue_pop(&q);
-          
-          neip=igraph_inclist_get(elist_out_p, actnode);
-          neino=igraph_vector_int_size(neip);
-          for (i=0; i<neino; i++) {
-            igraph_integer_t edge=(igraph_integer_t) VECTOR(*neip)[i], from, to;
-            long int neighbor;
-            igraph_edge(graph, edge, &from, &to);
-            neighbor = actnode!=from ? from : to;
-            if (nrgeo[neighbor] != 0) {
-              /* we've already seen this node, another shortest path? */
-              if (distance[neighbor]==distance[actnode]+1) {
-                nrgeo[neighbor]+=nrgeo[actnode];
-              }
-            } else {
-              /* we haven't seen this node yet */
-              nrgeo[neighbor]+=nrgeo[actnode];
-              distance[neighbor]=distance[actnode]+1;
-              IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-              IGRAPH_CHECK(igraph_stack_push(&stack, neighbor));
-            }
-          }
-        } /* while !igraph_dqueue_empty */
-        
-        /* Ok, we've the distance of each node and also the number of
-           shortest paths to them. Now we do an inverse search, starting
-           with the farthest nodes. */
-        while (!igraph_stack_empty(&stack)) {
-          long int actnode=(long int) igraph_stack_pop(&stack);
-          if (distance[actnode]<1) { continue; } /* skip source node */
-          
-          /* set the temporary score of the friends */
-          neip=igraph_inclist_get(elist_in_p, actnode);
-          neino=igraph_vector_int_size(neip);
-          for (i=0; i<neino; i++) {
-            long int edge = (long int) VECTOR(*neip)[i];
-            long int neighbor = IGRAPH_OTHER(graph, edge, actnode);
-            if (distance[neighbor]==distance[actnode]-1 &&
-                nrgeo[neighbor] != 0) {
-              tmpscore[neighbor] +=
-                (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
-              VECTOR(eb)[edge] +=
-                (tmpscore[actnode]+1)*nrgeo[neighbor]/nrgeo[actnode];
-            }
-          }
-        }
-        /* Ok, we've the scores for this source */
-      } /* for source <= no_of_nodes */
-    } else {
-      /* Weighted variant follows */
-
-      /* The following for loop is copied almost intact from
-       * igraph_i_edge_betweenness_estimate_weighted */
-      for (source=0; source<no_of_nodes; source++) {
-        /* This will contain the edge betweenness in the current step */
-        IGRAPH_ALLOW_INTERRUPTION();
-
-        memset(distance, 0, (size_t) no_of_nodes*sizeof(double));
-        memset(nrgeo, 0, (size_t) no_of_nodes*sizeof(unsigned long long int));
-        memset(tmpscore, 0, (size_t) no_of_nodes*sizeof(double));
-
-        igraph_2wheap_push_with_index(&heap, source, 0);
-        distance[source]=1.0;
-        nrgeo[source]=1;
-
-        while (!igraph_2wheap_empty(&heap)) {
-          long int minnei = igraph_2wheap_max_index(&heap);
-          igraph_real_t mindist = -igraph_2wheap_delete_max(&heap);
-
-          igraph_stack_push(&stack, minnei);
-
-          neip=igraph_inclist_get(elist_out_p, minnei);
-          neino=igraph_vector_int_size(neip);
-
-          for (i=0; i<neino; i++) {
-            long int edge=VECTOR(*neip)[i];
-            long int to=IGRAPH_OTHER(graph, edge, minnei);
-            igraph_real_t altdist = mindist + VECTOR(*weights)[edge];
-            igraph_real_t curdist = distance[to];
-            igraph_vector_int_t *v;
-
-            if (curdist == 0) {
-              /* This is the first finite distance to 'to' */
-              v = igraph_inclist_get(&fathers, to);
-              igraph_vector_int_resize(v, 1);
-              VECTOR(*v)[0] = edge;
-              nrgeo[to] = nrgeo[minnei];
-              distance[to] = altdist + 1.0;
-              IGRAPH_CHECK(igraph_2wheap_push_with_index(&heap, to, -altdist));
-            } else if (altdist < curdist-1) {
-              /* This is a shorter path */
-              v = igraph_inclist_get(&fathers, to);
-              igraph_vector_int_resize(v, 1);
-              VECTOR(*v)[0] = edge;
-              nrgeo[to] = nrgeo[minnei];
-              distance[to] = altdist + 1.0;
-              IGRAPH_CHECK(igraph_2wheap_modify(&heap, to, -altdist));
-            } else if (altdist == curdist-1) {
-              /* Another path with the same length */
-              v = igraph_inclist_get(&fathers, to);
-              igraph_vector_int_push_back(v, edge);
-              nrgeo[to] += nrgeo[minnei];
-            }
-          }
-        } /* igraph_2wheap_empty(&Q) */
-
-        while (!igraph_stack_empty(&stack)) {
-          long int w = (long int) igraph_stack_pop(&stack);
-          igraph_vector_int_t *fatv = igraph_inclist_get(&fathers, w);
-          long int fatv_len = igraph_vector_int_size(fatv);
-
-          for (i = 0; i < fatv_len; i++) {
-            long int fedge = (long int) VECTOR(*fatv)[i];
-            long int neighbor = IGRAPH_OTHER(graph, fedge, w);
-            tmpscore[neighbor] += (tmpscore[w] + 1) * nrgeo[neighbor] / nrgeo[w];
-            VECTOR(eb)[fedge] += (tmpscore[w] + 1) * nrgeo[neighbor] / nrgeo[w];
-          }
-
-          tmpscore[w] = 0;
-          distance[w] = 0;
-          nrgeo[w] = 0;
-          igraph_vector_int_clear(fatv);
-        }
-      } /* source < no_of_nodes */
-    }
+    IGRAPH_CHECK(igraph_i_eb_update(&ws, comp, ncomp, &eb));
     
     /* Now look for the smallest edge betweenness */
     /* and eliminate that edge from the network */
@@ -676,27 +891,19 @@ int igraph_community_edge_betweenness(const igraph_t *graph,
     igraph_vector_int_search(neip, 0, maxedge, &pos);
     VECTOR(*neip)[pos]=VECTOR(*neip)[neino-1];
     igraph_vector_int_pop_back(neip);
+
+    /* Only the component(s) of the removed edge change */
+    ncomp=igraph_i_eb_component(&ws, from, to, seen, comp);
   }
 
   IGRAPH_PROGRESS("Edge betweenness community detection: ", 100.0, NULL);
 
   igraph_free(passive);
   igraph_vector_destroy(&eb);
-  igraph_stack_destroy(&stack);
-  IGRAPH_FINALLY_CLEAN(3);
-
-  if (weights == 0) {
-    igraph_dqueue_destroy(&q);
-    IGRAPH_FINALLY_CLEAN(1);
-  } else {
-    igraph_2wheap_destroy(&heap);
-    igraph_inclist_destroy(&fathers);
-    IGRAPH_FINALLY_CLEAN(2);
-  }
-  igraph_free(tmpscore);
-  igraph_free(nrgeo);
-  igraph_free(distance);
-  IGRAPH_FINALLY_CLEAN(3);
+  igraph_free(seen);
+  igraph_free(comp);
+  igraph_i_eb_ws_destroy(&ws);
+  IGRAPH_FINALLY_CLEAN(5);
 
   if (directed) {
     igraph_inclist_destroy(&elist_out);
@@ -1142,19 +1349,20 @@ int igraph_reindex_membership(igraph_vector_t *membership,
  * </para>
  */
 
+/* The modularity matrix of the community being split is multiplied
+ * through a compact CSR copy of the subgraph of the community, that is
+ * built once for every split. idx2 values refer to the position of the
+ * vertices within the community. The diagonal correction term (the
+ * -d_ij summa l in G B_il term of the generalized modularity matrix)
+ * does not depend on the vector, so it is calculated only once, too. */
+
 typedef struct igraph_i_community_leading_eigenvector_data_t {
-  igraph_vector_t *idx;
-  igraph_vector_t *idx2;
-  igraph_adjlist_t *adjlist;
-  igraph_inclist_t *inclist;
-  igraph_vector_t *tmp;
-  long int no_of_edges;
-  igraph_vector_t *mymembership;
-  long int comm;
-  const igraph_vector_t *weights;
-  const igraph_t *graph;
-  igraph_vector_t *strength;
-  igraph_real_t sumweights;
+  igraph_vector_int_t *first;	/* CSR row starts, size+1 elements */
+  igraph_vector_int_t *nei;	/* CSR columns, positions in the community */
+  igraph_vector_t *w;		/* CSR weights, or NULL if unweighted */
+  igraph_vector_t *degree;	/* (weighted) degree of each row */
+  igraph_vector_t *tmp;		/* diagonal correction of each row */
+  igraph_real_t sumweights;	/* number of edges, or sum of weights */
 } igraph_i_community_leading_eigenvector_data_t;
 
 int igraph_i_community_leading_eigenvector(igraph_real_t *to,
@@ -1162,259 +1370,166 @@ int igraph_i_community_leading_eigenvector(igraph_real_t *to,
 					   int n, void *extra) {
   
   igraph_i_community_leading_eigenvector_data_t *data=extra;
-  long int j, k, nlen, size=n;
-  igraph_vector_t *idx=data->idx;
-  igraph_vector_t *idx2=data->idx2;
-  igraph_vector_t *tmp=data->tmp;
-  igraph_adjlist_t *adjlist=data->adjlist;
-  igraph_real_t ktx, ktx2;
-  long int no_of_edges=data->no_of_edges;
-  igraph_vector_t *mymembership=data->mymembership;
-  long int comm=data->comm;
+  long int j, k, size=n;
+  igraph_integer_t *first=VECTOR(*data->first);
+  igraph_integer_t *nei=VECTOR(*data->nei);
+  igraph_real_t *w=data->w ? VECTOR(*data->w) : 0;
+  igraph_real_t *degree=VECTOR(*data->degree);
+  igraph_real_t *tmp=VECTOR(*data->tmp);
+  igraph_real_t ktx;
 
   /* Ax */
   for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_vector_int_t *neis=igraph_adjlist_get(adjlist, oldid);
-    nlen=igraph_vector_int_size(neis);
     to[j]=0.0;
-    VECTOR(*tmp)[j]=0.0;
-    for (k=0; k<nlen; k++) {
-      long int nei=(long int) VECTOR(*neis)[k];
-      long int neimemb=(long int) VECTOR(*mymembership)[nei];
-      if (neimemb==comm) {
-	to[j] += from[ (long int) VECTOR(*idx2)[nei] ];
-	VECTOR(*tmp)[j] += 1;
+    if (w) {
+      for (k=first[j]; k<first[j+1]; k++) {
+	to[j] += from[ nei[k] ] * w[k];
+      }
+    } else {
+      for (k=first[j]; k<first[j+1]; k++) {
+	to[j] += from[ nei[k] ];
       }
     }
   }
   
   /* Now calculate k^Tx/2m */
-  ktx=0.0; ktx2=0.0;
-  for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_vector_int_t *neis=igraph_adjlist_get(adjlist, oldid);
-    long int degree=igraph_vector_int_size(neis);
-    ktx += from[j] * degree;
-    ktx2 += degree;
-  }
-  ktx = ktx / no_of_edges/2.0;
-  ktx2 = ktx2 / no_of_edges/2.0;
-  
-  /* Now calculate Bx */
+  ktx=0.0;
   for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_vector_int_t *neis=igraph_adjlist_get(adjlist, oldid);
-    igraph_real_t degree=igraph_vector_int_size(neis);
-    to[j] = to[j] - ktx*degree;
-    VECTOR(*tmp)[j] = VECTOR(*tmp)[j] - ktx2*degree;
+    ktx += from[j] * degree[j];
   }
+  ktx = ktx / data->sumweights / 2.0;
   
-  /* -d_ij summa l in G B_il */
+  /* Now calculate Bx, and -d_ij summa l in G B_il */
   for (j=0; j<size; j++) {
-    to[j] -= VECTOR(*tmp)[j] * from[j];
+    to[j] = to[j] - ktx*degree[j];
+    to[j] -= tmp[j] * from[j];
   }
 
   return 0;
 }
 
+/* The same for the modularity matrix with its last row and column
+ * deleted */
+
 int igraph_i_community_leading_eigenvector2(igraph_real_t *to,
 					    const igraph_real_t *from,
 					    int n, void *extra) {
   
   igraph_i_community_leading_eigenvector_data_t *data=extra;
-  long int j, k, nlen, size=n;
-  igraph_vector_t *idx=data->idx;
-  igraph_vector_t *idx2=data->idx2;
-  igraph_vector_t *tmp=data->tmp;
-  igraph_adjlist_t *adjlist=data->adjlist;
-  igraph_real_t ktx, ktx2;
-  long int no_of_edges=data->no_of_edges;
-  igraph_vector_t *mymembership=data->mymembership;
-  long int comm=data->comm;
+  long int j, k, size=n;
+  igraph_integer_t *first=VECTOR(*data->first);
+  igraph_integer_t *nei=VECTOR(*data->nei);
+  igraph_real_t *w=data->w ? VECTOR(*data->w) : 0;
+  igraph_real_t *degree=VECTOR(*data->degree);
+  igraph_real_t *tmp=VECTOR(*data->tmp);
+  igraph_real_t ktx;
 
   /* Ax */
   for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_vector_int_t *neis=igraph_adjlist_get(adjlist, oldid);
-    nlen=igraph_vector_int_size(neis);
     to[j]=0.0;
-    VECTOR(*tmp)[j]=0.0;
-    for (k=0; k<nlen; k++) {
-      long int nei=(long int) VECTOR(*neis)[k];
-      long int neimemb=(long int) VECTOR(*mymembership)[nei];
-      if (neimemb==comm) {
-	long int fi=(long int) VECTOR(*idx2)[nei];
-	if (fi < size) {
-	  to[j] += from[fi];
-	}
-	VECTOR(*tmp)[j] += 1;
+    for (k=first[j]; k<first[j+1]; k++) {
+      long int fi=nei[k];
+      if (fi < size) {
+	to[j] += w ? from[fi] * w[k] : from[fi];
       }
     }
   }
   
   /* Now calculate k^Tx/2m */
-  ktx=0.0; ktx2=0.0;
-  for (j=0; j<size+1; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_vector_int_t *neis=igraph_adjlist_get(adjlist, oldid);
-    long int degree=igraph_vector_int_size(neis);
-    if (j<size) {
-      ktx += from[j] * degree;
-    }
-    ktx2 += degree;
-  }
-  ktx = ktx / no_of_edges/2.0;
-  ktx2 = ktx2 / no_of_edges/2.0;
-  
-  /* Now calculate Bx */
+  ktx=0.0;
   for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_vector_int_t *neis=igraph_adjlist_get(adjlist, oldid);
-    igraph_real_t degree=igraph_vector_int_size(neis);
-    to[j] = to[j] - ktx*degree;
-    VECTOR(*tmp)[j] = VECTOR(*tmp)[j] - ktx2*degree;
+    ktx += from[j] * degree[j];
   }
+  ktx = ktx / data->sumweights / 2.0;
   
-  /* -d_ij summa l in G B_il */
+  /* Now calculate Bx, and -d_ij summa l in G B_il */
   for (j=0; j<size; j++) {
-    to[j] -= VECTOR(*tmp)[j] * from[j];
+    to[j] = to[j] - ktx*degree[j];
+    to[j] -= tmp[j] * from[j];
   }
 
   return 0;
 }
 
-int igraph_i_community_leading_eigenvector_weighted(igraph_real_t *to,
-					    const igraph_real_t *from,
-					    int n, void *extra) {
+/* Builds the CSR copy of community comm for the matrix-vector
+ * products, idx and idx2 must be already filled for the community. */
 
-  igraph_i_community_leading_eigenvector_data_t *data=extra;
-  long int j, k, nlen, size=n;
-  igraph_vector_t *idx=data->idx;
-  igraph_vector_t *idx2=data->idx2;
-  igraph_vector_t *tmp=data->tmp;
-  igraph_inclist_t *inclist=data->inclist;
-  igraph_real_t ktx, ktx2;
-  igraph_vector_t *mymembership=data->mymembership;
-  long int comm=data->comm;
-  const igraph_vector_t *weights=data->weights;
-  const igraph_t *graph=data->graph;
-  igraph_vector_t *strength=data->strength;
-  igraph_real_t sw=data->sumweights;
-  
-  /* Ax */
-  for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_vector_int_t *inc=igraph_inclist_get(inclist, oldid);
-    nlen=igraph_vector_int_size(inc);
-    to[j]=0.0;
-    VECTOR(*tmp)[j]=0.0;
-    for (k=0; k<nlen; k++) {
-      long int edge=(long int) VECTOR(*inc)[k];
-      igraph_real_t w=VECTOR(*weights)[edge];
-      long int nei=IGRAPH_OTHER(graph, edge, oldid);
-      long int neimemb=(long int) VECTOR(*mymembership)[nei];
-      if (neimemb==comm) {
-	to[j] += from[ (long int) VECTOR(*idx2)[nei] ] * w;
-	VECTOR(*tmp)[j] += w;
-      }
-    }
-  }
+static void igraph_i_community_leading_eigenvector_csr(
+	const igraph_t *graph,
+	const igraph_adjlist_t *adjlist, const igraph_inclist_t *inclist,
+	const igraph_vector_t *weights, const igraph_vector_t *strength,
+	const igraph_vector_t *mymembership, long int comm, long int size,
+	const igraph_vector_t *idx, const igraph_vector_t *idx2,
+	igraph_i_community_leading_eigenvector_data_t *data) {
 
-  /* k^Tx/2m */
-  ktx=0.0; ktx2=0.0;
-  for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_real_t str=VECTOR(*strength)[oldid];
-    ktx += from[j] * str;
-    ktx2 += str;
-  }
-  ktx = ktx / sw / 2.0;
-  ktx2 = ktx2 / sw / 2.0;
+  long int j, k, nlen, pos=0;
+  igraph_real_t ktx2=0.0;
 
-  /* Bx */
   for (j=0; j<size; j++) {
     long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_real_t str=VECTOR(*strength)[oldid];
-    to[j] = to[j] - ktx * str;
-    VECTOR(*tmp)[j] = VECTOR(*tmp)[j] - ktx2*str;
+    igraph_real_t intra=0.0;
+    VECTOR(*data->first)[j]=(igraph_integer_t) pos;
+    if (!weights) {
+      igraph_vector_int_t *neis=igraph_adjlist_get(adjlist, oldid);
+      nlen=igraph_vector_int_size(neis);
+      for (k=0; k<nlen; k++) {
+	long int nei=(long int) VECTOR(*neis)[k];
+	if (VECTOR(*mymembership)[nei]==comm) {
+	  VECTOR(*data->nei)[pos++]=(igraph_integer_t) VECTOR(*idx2)[nei];
+	  intra += 1;
+	}
+      }
+    } else {
+      igraph_vector_int_t *inc=igraph_inclist_get(inclist, oldid);
+      nlen=igraph_vector_int_size(inc);
+      for (k=0; k<nlen; k++) {
+	long int edge=(long int) VECTOR(*inc)[k];
+	long int nei=IGRAPH_OTHER(graph, edge, oldid);
+	if (VECTOR(*mymembership)[nei]==comm) {
+	  igraph_real_t w=VECTOR(*weights)[edge];
+	  VECTOR(*data->nei)[pos]=(igraph_integer_t) VECTOR(*idx2)[nei];
+	  VECTOR(*data->w)[pos++]=w;
+	  intra += w;
+	}
+      }
+    }
+    VECTOR(*data->tmp)[j]=intra;
+    VECTOR(*data->degree)[j]=VECTOR(*strength)[oldid];
+    ktx2 += VECTOR(*strength)[oldid];
   }
+  VECTOR(*data->first)[size]=(igraph_integer_t) pos;
 
-  /* -d_ij summa l in G B_il */
+  ktx2 = ktx2 / data->sumweights / 2.0;
   for (j=0; j<size; j++) {
-    to[j] -= VECTOR(*tmp)[j] * from[j];
+    VECTOR(*data->tmp)[j] = VECTOR(*data->tmp)[j] - 
+      ktx2*VECTOR(*data->degree)[j];
   }
-
-  return 0;
 }
 
-int igraph_i_community_leading_eigenvector2_weighted(igraph_real_t *to,
-					    const igraph_real_t *from,
-					    int n, void *extra) {
-  
-  igraph_i_community_leading_eigenvector_data_t *data=extra;
-  long int j, k, nlen, size=n;
-  igraph_vector_t *idx=data->idx;
-  igraph_vector_t *idx2=data->idx2;
-  igraph_vector_t *tmp=data->tmp;
-  igraph_inclist_t *inclist=data->inclist;
-  igraph_real_t ktx, ktx2;
-  igraph_vector_t *mymembership=data->mymembership;
-  long int comm=data->comm;
-  const igraph_vector_t *weights=data->weights;
-  const igraph_t *graph=data->graph;
-  igraph_vector_t *strength=data->strength;
-  igraph_real_t sw=data->sumweights;
+/* Fills the ARPACK starting vector from the eigenvector that was found
+ * when the parent of the community was split. The constant component
+ * is removed, because the all-ones vector is an eigenvector of the
+ * generalized modularity matrix, with a zero eigenvalue. Returns
+ * zero if there is no usable starting vector. */
 
-  /* Ax */
-  for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_vector_int_t *inc=igraph_inclist_get(inclist, oldid);
-    nlen=igraph_vector_int_size(inc);
-    to[j]=0.0;
-    VECTOR(*tmp)[j]=0.0;
-    for (k=0; k<nlen; k++) {
-      long int edge=(long int) VECTOR(*inc)[k];
-      igraph_real_t w=VECTOR(*weights)[edge];
-      long int nei=IGRAPH_OTHER(graph, edge, oldid);
-      long int neimemb=(long int) VECTOR(*mymembership)[nei];
-      if (neimemb==comm) {
-	long int fi=(long int) VECTOR(*idx2)[nei];
-	if (fi < size) {
-	  to[j] += from[fi] * w;
-	}
-	VECTOR(*tmp)[j] += w;
-      }
-    }
-  }
-  
-  /* k^Tx/2m */
-  ktx=0.0; ktx2=0.0;
-  for (j=0; j<size+1; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_real_t str=VECTOR(*strength)[oldid];
-    if (j<size) { 
-      ktx += from[j] * str;
-    } 
-    ktx2 += str;
-  }
-  ktx = ktx / sw / 2.0;
-  ktx2 = ktx2 / sw / 2.0;
+static int igraph_i_community_leading_eigenvector_warm(
+	const igraph_vector_t *warm, const igraph_vector_t *idx,
+	long int size, igraph_real_t *resid) {
+
+  long int j;
+  igraph_real_t mean=0.0, norm=0.0;
 
-  /* Bx */
   for (j=0; j<size; j++) {
-    long int oldid=(long int) VECTOR(*idx)[j];
-    igraph_real_t str=VECTOR(*strength)[oldid];
-    to[j] = to[j] - ktx * str;
-    VECTOR(*tmp)[j] = VECTOR(*tmp)[j] - ktx2 * str;
+    resid[j]=VECTOR(*warm)[ (long int) VECTOR(*idx)[j] ];
+    mean += resid[j];
   }
-
-  /* -d_ij summa l in G B_il */
+  mean /= size;
   for (j=0; j<size; j++) {
-    to[j] -= VECTOR(*tmp)[j] * from[j];
+    resid[j] -= mean;
+    norm += resid[j] * resid[j];
   }
 
-  return 0;
+  return norm > 1e-12;
 }
 
 void igraph_i_levc_free(igraph_vector_ptr_t *ptr) { 
@@ -1527,6 +1642,11 @@ void igraph_i_error_handler_none(const char *reason, const char *file,
  *    igraph_community_leading_eigenvector_callback_t. 
  * \param callback_extra Extra argument to pass to the callback
  *    function.
+ * \param warm_start Boolean, whether to start ARPACK from the
+ *    eigenvector of the parent community when splitting a community
+ *    that was created by an earlier split. This usually needs fewer
+ *    matrix-vector products for the deeper splits. Otherwise a random
+ *    starting vector is used.
  * \return Error code.
  * 
  * \sa \ref igraph_community_walktrap() and \ref
@@ -1550,13 +1670,15 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
 	igraph_vector_ptr_t *eigenvectors,
 	igraph_vector_t *history,
         igraph_community_leading_eigenvector_callback_t *callback,
-        void *callback_extra) {
+        void *callback_extra,
+        igraph_bool_t warm_start) {
 
   long int no_of_nodes=igraph_vcount(graph);
   long int no_of_edges=igraph_ecount(graph);
   igraph_dqueue_t tosplit;
   igraph_vector_t idx, idx2, mymerges;
-  igraph_vector_t strength, tmp;
+  igraph_vector_t strength, tmp, degree, csr_w, warm;
+  igraph_vector_int_t csr_first, csr_nei;
   long int staken=0;
   igraph_adjlist_t adjlist;
   igraph_inclist_t inclist;
@@ -1566,12 +1688,8 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
   igraph_i_community_leading_eigenvector_data_t extra;
   igraph_arpack_storage_t storage;
   igraph_real_t mod=0;
-  igraph_arpack_function_t *arpcb1 = 
-    weights ? igraph_i_community_leading_eigenvector_weighted : 
-    igraph_i_community_leading_eigenvector;
-  igraph_arpack_function_t *arpcb2 = 
-    weights ? igraph_i_community_leading_eigenvector2_weighted : 
-    igraph_i_community_leading_eigenvector2;
+  igraph_arpack_function_t *arpcb1 = igraph_i_community_leading_eigenvector;
+  igraph_arpack_function_t *arpcb2 = igraph_i_community_leading_eigenvector2;
   igraph_real_t sumweights=0.0;
 
   if (weights && no_of_edges != igraph_vector_size(weights)) {
@@ -1680,18 +1798,33 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
   IGRAPH_CHECK(igraph_vector_resize(&idx, no_of_nodes));
   igraph_vector_null(&idx);
   IGRAPH_VECTOR_INIT_FINALLY(&idx2, no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&strength, no_of_nodes);
   if (!weights) { 
     IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist, IGRAPH_ALL));
     IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist);
+    for (i=0; i<no_of_nodes; i++) {
+      VECTOR(strength)[i]=igraph_vector_int_size(igraph_adjlist_get(&adjlist, i));
+    }
+    sumweights=no_of_edges;
   } else {
     IGRAPH_CHECK(igraph_inclist_init(graph, &inclist, IGRAPH_ALL));
     IGRAPH_FINALLY(igraph_inclist_destroy, &inclist);
-    IGRAPH_VECTOR_INIT_FINALLY(&strength, no_of_nodes);
     IGRAPH_CHECK(igraph_strength(graph, &strength, igraph_vss_all(), 
 				 IGRAPH_ALL, IGRAPH_LOOPS, weights));
     sumweights=igraph_vector_sum(weights);
   }
 
+  /* The CSR copy of the community that is being split */
+  IGRAPH_CHECK(igraph_vector_int_init(&csr_first, no_of_nodes+1));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &csr_first);
+  IGRAPH_CHECK(igraph_vector_int_init(&csr_nei, 2*no_of_edges));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &csr_nei);
+  IGRAPH_VECTOR_INIT_FINALLY(&csr_w, weights ? 2*no_of_edges : 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&degree, no_of_nodes);
+
+  /* The eigenvector of the last split of each vertex' community */
+  IGRAPH_VECTOR_INIT_FINALLY(&warm, warm_start ? no_of_nodes : 0);
+
   options->ncv = 0;   /* 0 means "automatic" in igraph_arpack_rssolve */
   options->start = 0;
   options->which[0]='L'; options->which[1]='A';
@@ -1702,23 +1835,19 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
   IGRAPH_CHECK(igraph_arpack_storage_init(&storage, (int) no_of_nodes, 20,
 					  (int) no_of_nodes, 1));
   IGRAPH_FINALLY(igraph_arpack_storage_destroy, &storage);
-  extra.idx=&idx;
-  extra.idx2=&idx2;
+  extra.first=&csr_first;
+  extra.nei=&csr_nei;
+  extra.w=weights ? &csr_w : 0;
+  extra.degree=&degree;
   extra.tmp=&tmp;
-  extra.adjlist=&adjlist;
-  extra.inclist=&inclist;
-  extra.weights=weights;
   extra.sumweights=sumweights;
-  extra.graph=graph;
-  extra.strength=&strength;
-  extra.no_of_edges=no_of_edges;
-  extra.mymembership=mymembership;
 
   while (!igraph_dqueue_empty(&tosplit) && staken < steps) {
     long int comm=(long int) igraph_dqueue_pop_back(&tosplit); 
 				/* depth first search */
     long int size=0;
     igraph_real_t tmpev;
+    igraph_bool_t has_warm=0;
 
     IGRAPH_STATUSF(("Trying to split community %li... ", 0, comm));
     IGRAPH_ALLOW_INTERRUPTION();
@@ -1735,6 +1864,16 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
       continue;
     }
 
+    igraph_i_community_leading_eigenvector_csr(graph, &adjlist, &inclist,
+					       weights, &strength, 
+					       mymembership, comm, size,
+					       &idx, &idx2, &extra);
+    if (warm_start) {
+      has_warm=igraph_i_community_leading_eigenvector_warm(&warm, &idx, 
+							   size, 
+							   storage.resid);
+    }
+
     /* We solve two eigenproblems, one for the original modularity
        matrix, and one for the modularity matrix after deleting the
        last row and last column from it. This is a trick to find
@@ -1751,12 +1890,12 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
     options->ncv = 0;   /* 0 means "automatic" in igraph_arpack_rssolve */
     options->nconv = 0;
     options->lworkl = 0;		/* we surely have enough space */
-    extra.comm=comm;
+    options->start = has_warm;
 
-    /* We try calling the solver twice, once from a random starting
-       point, once from a fixed one. This is because for some hard
-       cases it tends to fail. We need to suppress error handling for
-       the first call. */
+    /* We try calling the solver twice, once from a random (or the
+       warm) starting point, once from a fixed one. This is because
+       for some hard cases it tends to fail. We need to suppress error
+       handling for the first call. */
     {
       int i;
       igraph_error_handler_t *errh=
@@ -1797,6 +1936,12 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
     options->nconv=0;
     options->lworkl = 0;	/* we surely have enough space */
     options->ncv = 0;   /* 0 means "automatic" in igraph_arpack_rssolve */
+    if (has_warm) {
+      /* resid was overwritten by the first solver */
+      igraph_i_community_leading_eigenvector_warm(&warm, &idx, size, 
+						  storage.resid);
+    }
+    options->start = has_warm;
     
     {
       int i;
@@ -1903,6 +2048,12 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
       continue;
     }
 
+    if (warm_start) {
+      for (j=0; j<size; j++) {
+	VECTOR(warm)[ (long int) VECTOR(idx)[j] ]=storage.v[j];
+      }
+    }
+
     /* Count the number of vertices in each community after the split */
     l=0;
     for (j=0; j<size; j++) {
@@ -1969,15 +2120,19 @@ int igraph_community_leading_eigenvector(const igraph_t *graph,
   }
   
   igraph_arpack_storage_destroy(&storage);
-  IGRAPH_FINALLY_CLEAN(1);
+  igraph_vector_destroy(&warm);
+  igraph_vector_destroy(&degree);
+  igraph_vector_destroy(&csr_w);
+  igraph_vector_int_destroy(&csr_nei);
+  igraph_vector_int_destroy(&csr_first);
+  IGRAPH_FINALLY_CLEAN(6);
   if (!weights) { 
     igraph_adjlist_destroy(&adjlist);
-    IGRAPH_FINALLY_CLEAN(1);
   } else {
     igraph_inclist_destroy(&inclist);
-    igraph_vector_destroy(&strength);
-    IGRAPH_FINALLY_CLEAN(2);
   }
+  igraph_vector_destroy(&strength);
+  IGRAPH_FINALLY_CLEAN(2);
   igraph_dqueue_destroy(&tosplit);
   igraph_vector_destroy(&tmp);
   igraph_vector_destroy(&idx2);
@@ -2111,61 +2266,363 @@ int igraph_le_community_to_membership(const igraph_matrix_t *merges,
 
 /********************************************************************/
 
-/**
- * \ingroup communities
- * \function igraph_community_label_propagation
- * \brief Community detection based on label propagation
+/*
+ * The frontier variant of label propagation. In the first round every
+ * vertex that is not fixed is examined, later only the vertices that
+ * have an in-neighbor whose label changed. A vertex keeps its label if
+ * it is among the dominant ones, so that unchanged areas of the graph
+ * are not visited again.
  *
- * This function implements the community detection method described in:
- * Raghavan, U.N. and Albert, R. and Kumara, S.: Near linear time algorithm
- * to detect community structures in large-scale networks. Phys Rev E
- * 76, 036106. (2007). This version extends the original method by
- * the ability to take edge weights into consideration and also
- * by allowing some labels to be fixed.
- * 
- * </para><para>
- * Weights are taken into account as follows: when the new label of node
- * i is determined, the algorithm iterates over all edges incident on
- * node i and calculate the total weight of edges leading to other
- * nodes with label 0, 1, 2, ..., k-1 (where k is the number of possible
- * labels). The new label of node i will then be the label whose edges
- * (among the ones incident on node i) have the highest total weight.
- * 
- * \param graph The input graph, should be undirected to make sense.
- * \param membership The membership vector, the result is returned here.
- *    For each vertex it gives the ID of its community (label).
- * \param weights The weight vector, it should contain a positive
- *    weight for all the edges.
- * \param initial The initial state. If NULL, every vertex will have
- *   a different label at the beginning. Otherwise it must be a vector
- *   with an entry for each vertex. Non-negative values denote different
- *   labels, negative entries denote vertices without labels.
- * \param fixed Boolean vector denoting which labels are fixed. Of course
- *   this makes sense only if you provided an initial state, otherwise
- *   this element will be ignored. Also note that vertices without labels
- *   cannot be fixed.
- * \param modularity If not a null pointer, then it must be a pointer
- *   to a real number. The modularity score of the detected community
- *   structure is stored here.
- * \return Error code.
- * 
- * Time complexity: O(m+n)
- * 
- * \example examples/simple/igraph_community_label_propagation.c
+ * The vertices of the frontier are updated in a random order, one by
+ * one. With multiple threads the new labels of the frontier are
+ * computed in advance, in parallel, from the labels at the start of
+ * the round. Such a label is used if no in-neighbor of the vertex has
+ * changed its label earlier in the same round, otherwise it is
+ * computed again. The random numbers for breaking the ties are drawn
+ * before the parallel step, so the result is the same as that of the
+ * sequential update, it does not depend on the number of threads.
+ * The threads do not allocate memory and do not raise errors.
  */
-int igraph_community_label_propagation(const igraph_t *graph,
-                                       igraph_vector_t *membership,
-                                       const igraph_vector_t *weights,
-                                       const igraph_vector_t *initial,
-                                       igraph_vector_bool_t *fixed, 
-				       igraph_real_t *modularity) {
-  long int no_of_nodes=igraph_vcount(graph);
-  long int no_of_edges=igraph_ecount(graph);
-  long int no_of_not_fixed_nodes=no_of_nodes;
-  long int i, j, k;
-  igraph_adjlist_t al;
-  igraph_inclist_t il;
-  igraph_bool_t running = 1;
+
+typedef struct {
+  const igraph_t *graph;
+  const igraph_vector_t *weights;
+  igraph_adjlist_t *al;		/* in-neighbors, unweighted */
+  igraph_inclist_t *il;		/* in-edges, weighted */
+  int nthreads;
+  long int no_of_nodes, maxdeg;
+  /* per thread blocks, 'nthreads' times the given size */
+  double *counters;		/* no_of_nodes+1 */
+  long int *nonzero;		/* maxdeg */
+  long int *dominant;		/* maxdeg */
+} igraph_i_lpa_ws_t;
+
+static void igraph_i_lpa_ws_destroy(igraph_i_lpa_ws_t *ws) {
+  if (ws->counters) { igraph_Free(ws->counters); }
+  if (ws->nonzero) { igraph_Free(ws->nonzero); }
+  if (ws->dominant) { igraph_Free(ws->dominant); }
+}
+
+static int igraph_i_lpa_ws_init(igraph_i_lpa_ws_t *ws, const igraph_t *graph,
+				const igraph_vector_t *weights,
+				igraph_adjlist_t *al, igraph_inclist_t *il,
+				int nthreads) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int i, deg;
+
+  memset(ws, 0, sizeof(igraph_i_lpa_ws_t));
+  ws->graph=graph;
+  ws->weights=weights;
+  ws->al=al;
+  ws->il=il;
+  ws->nthreads=nthreads < 1 ? 1 : nthreads;
+  ws->no_of_nodes=no_of_nodes;
+  for (i=0; i<no_of_nodes; i++) {
+    deg=weights ? igraph_vector_int_size(igraph_inclist_get(il, i)) :
+      igraph_vector_int_size(igraph_adjlist_get(al, i));
+    if (deg > ws->maxdeg) { ws->maxdeg=deg; }
+  }
+  IGRAPH_FINALLY(igraph_i_lpa_ws_destroy, ws);
+
+  ws->counters=igraph_Calloc((size_t) ws->nthreads *
+			     (size_t) (no_of_nodes+1), double);
+  ws->nonzero=igraph_Calloc((size_t) ws->nthreads *
+			    (size_t) (ws->maxdeg+1), long int);
+  ws->dominant=igraph_Calloc((size_t) ws->nthreads *
+			     (size_t) (ws->maxdeg+1), long int);
+  if (!ws->counters || !ws->nonzero || !ws->dominant) {
+    IGRAPH_ERROR("label propagation failed", IGRAPH_ENOMEM);
+  }
+
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+/* The new label of 'v', computed by thread 't', or zero if 'v' keeps
+   its current label. 'u' is a uniform random number from [0,1) to
+   choose from the dominant labels. */
+static long int igraph_i_lpa_label(igraph_i_lpa_ws_t *ws, int t,
+				   const igraph_vector_t *membership,
+				   long int v, double u) {
+  double *counters=ws->counters + (size_t) t * (size_t) (ws->no_of_nodes+1);
+  long int *nonzero=ws->nonzero + (size_t) t * (size_t) (ws->maxdeg+1);
+  long int *dominant=ws->dominant + (size_t) t * (size_t) (ws->maxdeg+1);
+  long int nnonzero=0, ndominant=0, cur=(long int) VECTOR(*membership)[v];
+  long int j, k, num_neis, res=0;
+  double max_count=0.0;
+
+  if (ws->weights) {
+    igraph_vector_int_t *ineis=igraph_inclist_get(ws->il, v);
+    num_neis=igraph_vector_int_size(ineis);
+    for (j=0; j<num_neis; j++) {
+      long int edge=VECTOR(*ineis)[j];
+      igraph_bool_t was_zero;
+      k=(long int) VECTOR(*membership)[
+		(long int) IGRAPH_OTHER(ws->graph, edge, v) ];
+      if (k == 0) { continue; }
+      was_zero=(counters[k] == 0);
+      counters[k] += VECTOR(*ws->weights)[edge];
+      if (was_zero && counters[k] != 0) {
+	nonzero[nnonzero++]=k;
+      }
+      if (max_count < counters[k]) {
+	max_count=counters[k];
+	dominant[0]=k; ndominant=1;
+      } else if (max_count == counters[k]) {
+	dominant[ndominant++]=k;
+      }
+    }
+  } else {
+    igraph_vector_int_t *neis=igraph_adjlist_get(ws->al, v);
+    num_neis=igraph_vector_int_size(neis);
+    for (j=0; j<num_neis; j++) {
+      k=(long int) VECTOR(*membership)[(long int) VECTOR(*neis)[j]];
+      if (k == 0) { continue; }
+      counters[k] += 1;
+      if (counters[k] == 1) {
+	nonzero[nnonzero++]=k;
+      }
+      if (max_count < counters[k]) {
+	max_count=counters[k];
+	dominant[0]=k; ndominant=1;
+      } else if (max_count == counters[k]) {
+	dominant[ndominant++]=k;
+      }
+    }
+  }
+
+  if (ndominant > 0 && (cur == 0 || counters[cur] != max_count)) {
+    j=(long int) (u * ndominant);
+    res=dominant[j < ndominant ? j : ndominant-1];
+  }
+
+  for (j=0; j<nnonzero; j++) {
+    counters[nonzero[j]]=0;
+  }
+
+  return res;
+}
+
+static int igraph_i_label_propagation_frontier(const igraph_t *graph,
+					       igraph_vector_t *membership,
+					       const igraph_vector_t *weights,
+					       igraph_adjlist_t *al,
+					       igraph_inclist_t *il,
+					       const igraph_vector_bool_t *fixed) {
+  long int no_of_nodes=igraph_vcount(graph);
+  igraph_bool_t directed=igraph_is_directed(graph);
+  igraph_i_lpa_ws_t lpa_ws, *ws=&lpa_ws;
+  igraph_adjlist_t outal;
+  igraph_vector_long_t front, next, tmp;
+  igraph_vector_t rand;
+  igraph_vector_long_t prop;
+  igraph_vector_char_t queued, changed;
+  long int i, j, nfront;
+
+  IGRAPH_CHECK(igraph_i_lpa_ws_init(ws, graph, weights, al, il,
+				    igraph_get_num_threads()));
+  IGRAPH_FINALLY(igraph_i_lpa_ws_destroy, ws);
+
+  /* The labels are read from the in-neighbors, so a change must be
+     propagated to the out-neighbors */
+  if (directed) {
+    IGRAPH_CHECK(igraph_adjlist_init(graph, &outal, IGRAPH_OUT));
+    IGRAPH_FINALLY(igraph_adjlist_destroy, &outal);
+  }
+
+  IGRAPH_CHECK(igraph_vector_long_init(&front, 0));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &front);
+  IGRAPH_CHECK(igraph_vector_long_init(&next, 0));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &next);
+  IGRAPH_CHECK(igraph_vector_long_init(&prop, ws->nthreads > 1 ?
+				       no_of_nodes : 0));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &prop);
+  IGRAPH_VECTOR_INIT_FINALLY(&rand, no_of_nodes);
+  IGRAPH_CHECK(igraph_vector_char_init(&queued, no_of_nodes));
+  IGRAPH_FINALLY(igraph_vector_char_destroy, &queued);
+  IGRAPH_CHECK(igraph_vector_char_init(&changed, no_of_nodes));
+  IGRAPH_FINALLY(igraph_vector_char_destroy, &changed);
+  IGRAPH_CHECK(igraph_vector_long_reserve(&front, no_of_nodes));
+  IGRAPH_CHECK(igraph_vector_long_reserve(&next, no_of_nodes));
+
+  for (i=0; i<no_of_nodes; i++) {
+    if (!fixed || !VECTOR(*fixed)[i]) {
+      igraph_vector_long_push_back(&front, i); /* reserved */
+    }
+  }
+
+  while ((nfront=igraph_vector_long_size(&front)) > 0) {
+
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    IGRAPH_CHECK(igraph_vector_long_shuffle(&front));
+    for (i=0; i<nfront; i++) {
+      VECTOR(rand)[i]=RNG_UNIF01();
+    }
+
+    if (ws->nthreads > 1) {
+      IGRAPH_I_PARALLEL(ws->nthreads)
+      {
+	int me=IGRAPH_I_THREAD_NUM;
+	long int k;
+	IGRAPH_I_SHARE(k, 0, nfront) {
+	  VECTOR(prop)[k]=igraph_i_lpa_label(ws, me, membership,
+					     VECTOR(front)[k],
+					     VECTOR(rand)[k]);
+	}
+      }
+    }
+
+    /* 'queued' marks the vertices of the next frontier from now on */
+    for (i=0; i<nfront; i++) {
+      VECTOR(queued)[ VECTOR(front)[i] ]=0;
+    }
+    igraph_vector_long_clear(&next);
+
+    for (i=0; i<nfront; i++) {
+      long int v=VECTOR(front)[i], num_neis, label;
+      igraph_bool_t stale=1;
+      igraph_vector_int_t *neis;
+
+      if (ws->nthreads > 1) {
+	stale=0;
+	if (weights) {
+	  neis=igraph_inclist_get(il, v);
+	  num_neis=igraph_vector_int_size(neis);
+	  for (j=0; !stale && j<num_neis; j++) {
+	    stale=VECTOR(changed)[ (long int)
+		   IGRAPH_OTHER(graph, VECTOR(*neis)[j], v) ];
+	  }
+	} else {
+	  neis=igraph_adjlist_get(al, v);
+	  num_neis=igraph_vector_int_size(neis);
+	  for (j=0; !stale && j<num_neis; j++) {
+	    stale=VECTOR(changed)[ (long int) VECTOR(*neis)[j] ];
+	  }
+	}
+      }
+
+      /* computed from an old label (or not computed yet) */
+      label=stale ? igraph_i_lpa_label(ws, 0, membership, v,
+				       VECTOR(rand)[i]) : VECTOR(prop)[i];
+      if (label == 0) { continue; }
+
+      VECTOR(*membership)[v]=label;
+      VECTOR(changed)[v]=1;
+
+      neis=directed ? igraph_adjlist_get(&outal, v) :
+	(weights ? igraph_inclist_get(il, v) : igraph_adjlist_get(al, v));
+      num_neis=igraph_vector_int_size(neis);
+      for (j=0; j<num_neis; j++) {
+	long int w=(long int) VECTOR(*neis)[j];
+	if (!directed && weights) { w=IGRAPH_OTHER(graph, w, v); }
+	if (!VECTOR(queued)[w] && (!fixed || !VECTOR(*fixed)[w])) {
+	  VECTOR(queued)[w]=1;
+	  igraph_vector_long_push_back(&next, w); /* reserved */
+	}
+      }
+    }
+
+    for (i=0; i<nfront; i++) {
+      VECTOR(changed)[ VECTOR(front)[i] ]=0;
+    }
+    /* both are registered in the finally stack, swap the contents */
+    tmp=front; front=next; next=tmp;
+  }
+
+  igraph_vector_char_destroy(&changed);
+  igraph_vector_char_destroy(&queued);
+  igraph_vector_destroy(&rand);
+  igraph_vector_long_destroy(&prop);
+  igraph_vector_long_destroy(&next);
+  igraph_vector_long_destroy(&front);
+  IGRAPH_FINALLY_CLEAN(6);
+  if (directed) {
+    igraph_adjlist_destroy(&outal);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+  igraph_i_lpa_ws_destroy(ws);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
+}
+
+/********************************************************************/
+
+/**
+ * \ingroup communities
+ * \function igraph_community_label_propagation
+ * \brief Community detection based on label propagation
+ *
+ * This function implements the community detection method described in:
+ * Raghavan, U.N. and Albert, R. and Kumara, S.: Near linear time algorithm
+ * to detect community structures in large-scale networks. Phys Rev E
+ * 76, 036106. (2007). This version extends the original method by
+ * the ability to take edge weights into consideration and also
+ * by allowing some labels to be fixed.
+ * 
+ * </para><para>
+ * Weights are taken into account as follows: when the new label of node
+ * i is determined, the algorithm iterates over all edges incident on
+ * node i and calculate the total weight of edges leading to other
+ * nodes with label 0, 1, 2, ..., k-1 (where k is the number of possible
+ * labels). The new label of node i will then be the label whose edges
+ * (among the ones incident on node i) have the highest total weight.
+ * 
+ * \param graph The input graph, should be undirected to make sense.
+ * \param membership The membership vector, the result is returned here.
+ *    For each vertex it gives the ID of its community (label).
+ * \param weights The weight vector, it should contain a positive
+ *    weight for all the edges.
+ * \param initial The initial state. If NULL, every vertex will have
+ *   a different label at the beginning. Otherwise it must be a vector
+ *   with an entry for each vertex. Non-negative values denote different
+ *   labels, negative entries denote vertices without labels.
+ * \param fixed Boolean vector denoting which labels are fixed. Of course
+ *   this makes sense only if you provided an initial state, otherwise
+ *   this element will be ignored. Also note that vertices without labels
+ *   cannot be fixed.
+ * \param modularity If not a null pointer, then it must be a pointer
+ *   to a real number. The modularity score of the detected community
+ *   structure is stored here.
+ * \param mode How the labels are updated. Possible values:
+ *   \clist
+ *   \cli IGRAPH_LPA_SWEEP
+ *     all vertices that are not fixed are updated in every
+ *     iteration, in a random order, until each of them has a dominant
+ *     label in its neighborhood. This is the original method.
+ *   \cli IGRAPH_LPA_FRONTIER
+ *     only the vertices that have a neighbor (an in-neighbor for
+ *     directed graphs) whose label changed are examined again, and a
+ *     vertex only changes its label if its current label is not
+ *     dominant. This is usually much faster on large graphs, as the
+ *     converged parts of the graph are not visited again. The new
+ *     labels of the frontier are computed in parallel, see \ref
+ *     igraph_set_num_threads(); the result does not depend on the
+ *     number of threads.
+ *   \endclist
+ * \return Error code.
+ * 
+ * Time complexity: O(m+n) per iteration for \c IGRAPH_LPA_SWEEP, for
+ * \c IGRAPH_LPA_FRONTIER the total number of examined vertices is
+ * usually only a small multiple of n.
+ * 
+ * \example examples/simple/igraph_community_label_propagation.c
+ */
+int igraph_community_label_propagation(const igraph_t *graph,
+                                       igraph_vector_t *membership,
+                                       const igraph_vector_t *weights,
+                                       const igraph_vector_t *initial,
+                                       igraph_vector_bool_t *fixed, 
+				       igraph_real_t *modularity,
+				       igraph_lpa_mode_t mode) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int no_of_not_fixed_nodes=no_of_nodes;
+  long int i, j, k;
+  igraph_adjlist_t al;
+  igraph_inclist_t il;
+  igraph_bool_t running = 1;
 
   igraph_vector_t label_counters, dominant_labels, nonzero_labels, node_order;
 
@@ -2189,6 +2646,9 @@ int igraph_community_label_propagation(const igraph_t *graph,
   if (fixed && !initial) {
     IGRAPH_WARNING("Ignoring fixed vertices as no initial labeling given");
   }
+  if (mode != IGRAPH_LPA_SWEEP && mode != IGRAPH_LPA_FRONTIER) {
+    IGRAPH_ERROR("Invalid label propagation mode", IGRAPH_EINVAL);
+  }
 
   IGRAPH_CHECK(igraph_vector_resize(membership, no_of_nodes));
 
@@ -2263,7 +2723,14 @@ int igraph_community_label_propagation(const igraph_t *graph,
     IGRAPH_FINALLY(igraph_vector_destroy, &node_order);
   }
 
-  running = 1;
+  if (mode == IGRAPH_LPA_FRONTIER) {
+    IGRAPH_CHECK(igraph_i_label_propagation_frontier(graph, membership,
+						     weights, &al, &il,
+						     fixed));
+    running = 0;
+  } else {
+    running = 1;
+  }
   while (running) {
     long int v1, num_neis;
     igraph_real_t max_count;
@@ -2392,6 +2859,41 @@ int igraph_community_label_propagation(const igraph_t *graph,
 
 /********************************************************************/
 
+/*
+ * The multi-level method works on a compressed adjacency list of
+ * the graph of each level. Every non-loop edge appears in the lists
+ * of both of its endpoints, the loop edges are only counted in
+ * 'loop'. The next level is created directly from this, without an
+ * intermediate igraph_t: the adjacency lists of the members of each
+ * community are merged, and the edges inside the community become
+ * its loop weight.
+ *
+ * In the sequential variant the vertices are moved one by one, in the
+ * order of their ids. In the parallel variant the vertices are
+ * colored greedily, so that adjacent vertices have different colors,
+ * and the vertices of a color are processed together, in chunks: all
+ * of them choose their new community in parallel, based on the same
+ * state, and then the moves are applied in vertex order. Adjacent
+ * vertices never move at the same time, so the weights towards the
+ * neighboring communities are exact, only the total weights of the
+ * communities might be outdated. See H Lu, M Halappanavar and A
+ * Kalyanaraman: Parallel heuristics for scalable community detection,
+ * Parallel Computing 47, 19-37 (2015). The result of the parallel
+ * variant does not depend on the number of threads, not even if it
+ * is one, but it is usually different from the sequential result.
+ * The variant is chosen by the caller, never by the number of
+ * threads. Shrinking the communities is parallel in both variants,
+ * its result does not depend on the number of threads either.
+ */
+
+/* The vertices of a color are processed in chunks, the moves are
+   applied after each chunk. Larger chunks would be more parallel,
+   but then many vertices might join the same community based on its
+   old size, and the passes oscillate. Small chunks are processed by
+   a single thread. */
+#define IGRAPH_I_MULTILEVEL_CHUNK 16384
+#define IGRAPH_I_MULTILEVEL_MIN_PARALLEL 1024
+
 /* Structure storing a community */
 typedef struct {
   igraph_integer_t size;           /* Size of the community */
@@ -2400,481 +2902,493 @@ typedef struct {
                                       in the community */
 } igraph_i_multilevel_community;
 
-/* Global community list structure */
+/* The graph of a level */
 typedef struct {
-  long int communities_no, vertices_no;  /* Number of communities, number of vertices */
-  igraph_real_t weight_sum;              /* Sum of edges weight in the whole graph */
-  igraph_i_multilevel_community *item;   /* List of communities */
-  igraph_vector_t *membership;           /* Community IDs */
-  igraph_vector_t *weights;        /* Graph edge weights */
-} igraph_i_multilevel_community_list;
-
-/* Computes the modularity of a community partitioning */
-igraph_real_t igraph_i_multilevel_community_modularity(
-  const igraph_i_multilevel_community_list *communities) {
-  igraph_real_t result = 0;
-  long int i;
-  igraph_real_t m = communities->weight_sum;
-  
-  for (i = 0; i < communities->vertices_no; i++) {
-    if (communities->item[i].size > 0) {
-      result += (communities->item[i].weight_inside - communities->item[i].weight_all*communities->item[i].weight_all/m)/m;
-    } 
-  }
-
-  return result;
-}
-
+  long int n;			/* Number of vertices */
+  long int *start;		/* Start of the neighbors, n+1 */
+  igraph_integer_t *nei;	/* Neighbors, start[n] */
+  igraph_real_t *w;		/* Edge weights, start[n] */
+  igraph_real_t *loop;		/* Weight of the loop edges, n */
+} igraph_i_multilevel_graph;
+
+/* Work buffers, sized for the first level */
 typedef struct {
-  long int from;
-  long int to;
-  long int id;
-} igraph_i_multilevel_link;
-
-int igraph_i_multilevel_link_cmp(const void *a, const void *b)
-{
-  long int r = (((igraph_i_multilevel_link*)a)->from -
-                ((igraph_i_multilevel_link*)b)->from);
-  if (r != 0) return (int) r;
-  
-  return (int) (((igraph_i_multilevel_link*)a)->to -
-		((igraph_i_multilevel_link*)b)->to);
+  int nthreads;
+  igraph_bool_t parallel;	/* Use the parallel variant of the moves */
+  long int n;
+  igraph_i_multilevel_community *item;	/* n */
+  igraph_real_t *k;		/* Weighted degree, n */
+  long int *memb, *saved;	/* Communities, and the ones before a pass */
+  long int *order, *cstart;	/* Vertices by color, n and n+1 */
+  long int *best;		/* Chosen communities, by position in 'order' */
+  igraph_real_t *w_old, *w_new;	/* And the weights towards them */
+  /* per thread blocks of size n */
+  igraph_real_t *acc;
+  long int *mark, *slot;
+} igraph_i_multilevel_ws;
+
+static void igraph_i_multilevel_graph_destroy(igraph_i_multilevel_graph *g) {
+  if (g->start) { igraph_Free(g->start); }
+  if (g->nei) { igraph_Free(g->nei); }
+  if (g->w) { igraph_Free(g->w); }
+  if (g->loop) { igraph_Free(g->loop); }
 }
 
-/* removes multiple edges and returns new edge id's for each edge in |E|log|E| */
-int igraph_i_multilevel_simplify_multiple(igraph_t *graph, igraph_vector_t *eids) {
-  long int ecount = igraph_ecount(graph);
-  long int i, l = -1, last_from = -1, last_to = -1;
-  igraph_bool_t directed = igraph_is_directed(graph);
-  igraph_integer_t from, to;
-  igraph_vector_t edges;
-  igraph_i_multilevel_link *links;
+static void igraph_i_multilevel_ws_destroy(igraph_i_multilevel_ws *ws) {
+  if (ws->item) { igraph_Free(ws->item); }
+  if (ws->k) { igraph_Free(ws->k); }
+  if (ws->memb) { igraph_Free(ws->memb); }
+  if (ws->saved) { igraph_Free(ws->saved); }
+  if (ws->order) { igraph_Free(ws->order); }
+  if (ws->cstart) { igraph_Free(ws->cstart); }
+  if (ws->best) { igraph_Free(ws->best); }
+  if (ws->w_old) { igraph_Free(ws->w_old); }
+  if (ws->w_new) { igraph_Free(ws->w_new); }
+  if (ws->acc) { igraph_Free(ws->acc); }
+  if (ws->mark) { igraph_Free(ws->mark); }
+  if (ws->slot) { igraph_Free(ws->slot); }
+}
 
-  /* Make sure there's enough space in eids to store the new edge IDs */
-  IGRAPH_CHECK(igraph_vector_resize(eids, ecount));
+static int igraph_i_multilevel_ws_init(igraph_i_multilevel_ws *ws,
+				       long int n, int nthreads) {
+  size_t size= n > 0 ? (size_t) n : 1;
+  size_t tsize=size * (size_t) nthreads;
+  memset(ws, 0, sizeof(igraph_i_multilevel_ws));
+  ws->nthreads=nthreads;
+  ws->n=n;
+  ws->item=igraph_Calloc(size, igraph_i_multilevel_community);
+  ws->k=igraph_Calloc(size, igraph_real_t);
+  ws->memb=igraph_Calloc(size, long int);
+  ws->saved=igraph_Calloc(size, long int);
+  ws->order=igraph_Calloc(size, long int);
+  ws->cstart=igraph_Calloc(size+1, long int);
+  ws->best=igraph_Calloc(size, long int);
+  ws->w_old=igraph_Calloc(size, igraph_real_t);
+  ws->w_new=igraph_Calloc(size, igraph_real_t);
+  ws->acc=igraph_Calloc(tsize, igraph_real_t);
+  ws->mark=igraph_Calloc(tsize, long int);
+  ws->slot=igraph_Calloc(tsize, long int);
+  if (!ws->item || !ws->k || !ws->memb || !ws->saved || !ws->order ||
+      !ws->cstart || !ws->best || !ws->w_old || !ws->w_new || 
+      !ws->acc || !ws->mark || !ws->slot) {
+    igraph_i_multilevel_ws_destroy(ws);
+    IGRAPH_ERROR("multi-level community structure detection failed",
+		 IGRAPH_ENOMEM);
+  }
+  return 0;
+}
 
-  links = igraph_Calloc(ecount, igraph_i_multilevel_link);
-  if (links == 0) {
-    IGRAPH_ERROR("multi-level community structure detection failed", IGRAPH_ENOMEM);
+/* The first level, from the input graph */
+static int igraph_i_multilevel_graph_init(const igraph_t *graph,
+					  const igraph_vector_t *weights,
+					  igraph_i_multilevel_graph *g) {
+  long int no_of_nodes=igraph_vcount(graph);
+  long int no_of_edges=igraph_ecount(graph);
+  long int v, i, j, p=0;
+  igraph_csr_t csr;
+
+  IGRAPH_CHECK(igraph_csr_borrow(graph, &csr, IGRAPH_ALL));
+  IGRAPH_FINALLY(igraph_csr_return, &csr);
+
+  memset(g, 0, sizeof(igraph_i_multilevel_graph));
+  g->n=no_of_nodes;
+  g->start=igraph_Calloc(no_of_nodes+1, long int);
+  g->nei=igraph_Calloc(no_of_edges > 0 ? 2*no_of_edges : 1, 
+		       igraph_integer_t);
+  g->w=igraph_Calloc(no_of_edges > 0 ? 2*no_of_edges : 1, igraph_real_t);
+  g->loop=igraph_Calloc(no_of_nodes > 0 ? no_of_nodes : 1, igraph_real_t);
+  if (!g->start || !g->nei || !g->w || !g->loop) {
+    igraph_i_multilevel_graph_destroy(g);
+    IGRAPH_ERROR("multi-level community structure detection failed",
+		 IGRAPH_ENOMEM);
+  }
+
+  for (v=0; v<no_of_nodes; v++) {
+    const igraph_integer_t *neis=igraph_csr_adj(&csr, v);
+    const igraph_integer_t *edges=igraph_csr_inc(&csr, v);
+    long int n=igraph_csr_size(&csr, v);
+    g->start[v]=p;
+    for (j=0; j<n; j++) {
+      if (neis[j] != v) {
+	g->nei[p]=neis[j];
+	g->w[p++]= weights ? VECTOR(*weights)[(long int) edges[j]] : 1.0;
+      }
+    }
   }
-  IGRAPH_FINALLY(free, links);
+  g->start[no_of_nodes]=p;
 
-  for (i = 0; i < ecount; i++) {
+  for (i=0; i<no_of_edges; i++) {
+    igraph_integer_t from, to;
     igraph_edge(graph, (igraph_integer_t) i, &from, &to);
-    links[i].from = from;
-    links[i].to = to;
-    links[i].id = i;
-  }  
-
-  qsort((void*)links, (size_t) ecount, sizeof(igraph_i_multilevel_link),
-      igraph_i_multilevel_link_cmp);
-
-  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
-  for (i = 0; i < ecount; i++) {
-    if (links[i].from == last_from && links[i].to == last_to) {
-      VECTOR(*eids)[links[i].id] = l;
-      continue;
+    if (from == to) {
+      g->loop[(long int) from] += weights ? VECTOR(*weights)[i] : 1.0;
     }
-
-    last_from = links[i].from;
-    last_to = links[i].to;
-
-    igraph_vector_push_back(&edges, last_from);
-    igraph_vector_push_back(&edges, last_to);
-
-    l++;
-
-    VECTOR(*eids)[links[i].id] = l;
   }
 
-  free(links);
-  IGRAPH_FINALLY_CLEAN(1);
-
-  igraph_destroy(graph);
-  IGRAPH_CHECK(igraph_create(graph, &edges, igraph_vcount(graph), directed));
-
-  igraph_vector_destroy(&edges);
+  igraph_csr_return(&csr);
   IGRAPH_FINALLY_CLEAN(1);
 
   return 0;
 }
 
-typedef struct {
-  long int community;
-  igraph_real_t weight;
-} igraph_i_multilevel_community_link;
-
-int igraph_i_multilevel_community_link_cmp(const void *a, const void *b)
-{
-  return (int) (((igraph_i_multilevel_community_link*)a)->community -
-		((igraph_i_multilevel_community_link*)b)->community);
-}
-
-/**
- * Given a graph, a community structure and a vertex ID, this method
- * calculates:
- *
- * - edges: the list of edge IDs that are incident on the vertex
- * - weight_all: the total weight of these edges
- * - weight_inside: the total weight of edges that stay within the same
- *   community where the given vertex is right now, excluding loop edges
- * - weight_loop: the total weight of loop edges
- * - links_community and links_weight: together these two vectors list the
- *   communities incident on this vertex and the total weight of edges
- *   pointing to these communities
- */
-int igraph_i_multilevel_community_links(const igraph_t *graph,
-  const igraph_i_multilevel_community_list *communities,
-  igraph_integer_t vertex, igraph_vector_t *edges,
-  igraph_real_t *weight_all, igraph_real_t *weight_inside, igraph_real_t *weight_loop,
-  igraph_vector_t *links_community, igraph_vector_t *links_weight) {
-  
-  long int i, n, last = -1, c = -1;
-  igraph_real_t weight = 1;
-  long int to, to_community;
-  long int community = (long int) VECTOR(*(communities->membership))[(long int)vertex];
-  igraph_i_multilevel_community_link *links;
-
-  *weight_all = *weight_inside = *weight_loop = 0;
-
-  igraph_vector_clear(links_community);
-  igraph_vector_clear(links_weight);
-
-  /* Get the list of incident edges */
-  igraph_incident(graph, edges, vertex, IGRAPH_ALL);
-
-  n = igraph_vector_size(edges);
-  links = igraph_Calloc(n, igraph_i_multilevel_community_link);
-  if (links == 0) {
-    IGRAPH_ERROR("multi-level community structure detection failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, links);
+/* Computes the modularity of a community partitioning */
+static igraph_real_t igraph_i_multilevel_modularity(
+  const igraph_i_multilevel_community *item, long int n, igraph_real_t m) {
+  igraph_real_t result = 0;
+  long int i;
 
   for (i = 0; i < n; i++) {
-    long int eidx = (long int) VECTOR(*edges)[i];
-    weight = VECTOR(*communities->weights)[eidx];
-
-    to = IGRAPH_OTHER(graph, eidx, vertex);
-
-    *weight_all += weight;
-    if (to == vertex) {
-      *weight_loop += weight;
-      
-      links[i].community = community;
-      links[i].weight = 0;
-      continue;
+    if (item[i].size > 0) {
+      result += (item[i].weight_inside - item[i].weight_all*item[i].weight_all/m)/m;
     }
+  }
 
-    to_community = (long int)VECTOR(*(communities->membership))[to];
-    if (community == to_community)
-      *weight_inside += weight;
+  return result;
+}
 
-    /* debug("Link %ld (C: %ld) <-> %ld (C: %ld)\n", vertex, community, to, to_community); */
-    
-    links[i].community = to_community;
-    links[i].weight = weight;
+/* Finds the community with the largest modularity gain for vertex
+ * 'v'. If 'removed' is false, then 'v' is still counted in its own
+ * community. Ties are broken in favor of the smaller community ID,
+ * and 'v' only moves if the gain is positive. The weight of the
+ * edges towards its own community and towards the chosen community
+ * is returned in 'w_old' and 'w_new'. 'mark' must be all -1, it is
+ * restored before returning. */
+static long int igraph_i_multilevel_best(const igraph_i_multilevel_graph *g,
+	 const igraph_i_multilevel_community *item, const long int *memb,
+	 igraph_real_t kv, igraph_real_t m, long int v, igraph_bool_t removed,
+	 igraph_real_t *acc, long int *mark, long int *touched,
+	 igraph_real_t *w_old, igraph_real_t *w_new) {
+
+  long int i, ntouched=0, old=memb[v], best=old;
+  igraph_real_t max_q_gain=0;
+
+  for (i=g->start[v]; i<g->start[v+1]; i++) {
+    long int c=memb[(long int) g->nei[i]];
+    if (mark[c] != v) {
+      mark[c]=v;
+      acc[c]=0;
+      touched[ntouched++]=c;
+    }
+    acc[c] += g->w[i];
+  }
+
+  for (i=0; i<ntouched; i++) {
+    long int c=touched[i];
+    igraph_real_t all=item[c].weight_all;
+    igraph_real_t q_gain;
+    if (c == old && !removed) { all -= kv; }
+    q_gain=acc[c] - all*kv/m;
+    if (q_gain > max_q_gain || 
+	(q_gain == max_q_gain && q_gain > 0 && c < best)) {
+      best=c;
+      max_q_gain=q_gain;
+    }
   }
 
-  /* Sort links by community ID and merge the same */
-  qsort((void*)links, (size_t) n, sizeof(igraph_i_multilevel_community_link),
-      igraph_i_multilevel_community_link_cmp);
-  for (i = 0; i < n; i++) {
-    to_community = links[i].community;
-    if (to_community != last) {
-      igraph_vector_push_back(links_community, to_community);
-      igraph_vector_push_back(links_weight, links[i].weight);
-      last = to_community;
-      c++;
-    } else {    
-      VECTOR(*links_weight)[c] += links[i].weight;
+  *w_old= mark[old] == v ? acc[old] : 0.0;
+  *w_new= mark[best] == v ? acc[best] : 0.0;
+  for (i=0; i<ntouched; i++) { mark[touched[i]]=-1; }
+  return best;
+}
+
+/* Greedy coloring, in the order of vertex IDs. The vertices are
+   sorted by their colors into 'order', the vertices of color 'c' are
+   at positions cstart[c] ... cstart[c+1]-1. */
+static long int igraph_i_multilevel_color(const igraph_i_multilevel_graph *g,
+					  igraph_i_multilevel_ws *ws) {
+  long int n=g->n, v, i, c, no_of_colors=0;
+  long int *color=ws->best, *forbidden=ws->mark, *pos=ws->slot;
+
+  for (v=0; v<n; v++) { forbidden[v]=-1; }
+  for (v=0; v<n; v++) {
+    for (i=g->start[v]; i<g->start[v+1]; i++) {
+      long int u=(long int) g->nei[i];
+      if (u < v) { forbidden[color[u]]=v; }
     }
+    for (c=0; forbidden[c] == v; c++) ;
+    color[v]=c;
+    if (c >= no_of_colors) { no_of_colors=c+1; }
   }
 
-  igraph_free(links);
-  IGRAPH_FINALLY_CLEAN(1);
-
-  return 0;
-}
+  memset(ws->cstart, 0, sizeof(long int) * (size_t) (no_of_colors+1));
+  for (v=0; v<n; v++) { ws->cstart[color[v]+1] += 1; }
+  for (c=0; c<no_of_colors; c++) { 
+    ws->cstart[c+1] += ws->cstart[c];
+    pos[c]=ws->cstart[c];
+  }
+  for (v=0; v<n; v++) { ws->order[pos[color[v]]++]=v; }
 
-igraph_real_t igraph_i_multilevel_community_modularity_gain(
-  const igraph_i_multilevel_community_list *communities,
-  igraph_integer_t community, igraph_integer_t vertex,
-  igraph_real_t weight_all, igraph_real_t weight_inside) {
-  IGRAPH_UNUSED(vertex);
-  return weight_inside -
-      communities->item[(long int)community].weight_all*weight_all/communities->weight_sum;
+  return no_of_colors;
 }
 
-/* Shrinks communities into single vertices, keeping all the edges.
- * This method is internal because it destroys the graph in-place and
- * creates a new one -- this is fine for the multilevel community
- * detection where a copy of the original graph is used anyway.
- * The membership vector will also be rewritten by the underlying
- * igraph_membership_reindex call */
-int igraph_i_multilevel_shrink(igraph_t *graph, igraph_vector_t *membership) {
-  igraph_vector_t edges;
-  long int no_of_nodes = igraph_vcount(graph);
-  long int no_of_edges = igraph_ecount(graph);
-  igraph_bool_t directed = igraph_is_directed(graph);
-
+/* Chooses the new communities of the vertices in positions 'from',
+   'from'+'step', ... of 'order', without changing the communities.
+   Called from several threads. */
+static void igraph_i_multilevel_choose(const igraph_i_multilevel_graph *g,
+				       igraph_i_multilevel_ws *ws,
+				       igraph_real_t m, long int from,
+				       long int to, long int step,
+				       int thread) {
+  size_t off=(size_t) thread * (size_t) ws->n;
   long int i;
-  igraph_eit_t eit;
-
-  if (no_of_nodes == 0)
-    return 0;
-
-  if (igraph_vector_size(membership) < no_of_nodes) {
-    IGRAPH_ERROR("cannot shrink graph, membership vector too short",
-        IGRAPH_EINVAL);
+  for (i=from; i<to; i += step) {
+    long int v=ws->order[i];
+    ws->best[i]=igraph_i_multilevel_best(g, ws->item, ws->memb, ws->k[v],
+					 m, v, /*removed=*/ 0,
+					 ws->acc+off, ws->mark+off,
+					 ws->slot+off, &ws->w_old[i], 
+					 &ws->w_new[i]);
   }
+}
 
-  IGRAPH_VECTOR_INIT_FINALLY(&edges, no_of_edges * 2);
+static void igraph_i_multilevel_move(const igraph_i_multilevel_graph *g,
+				     igraph_i_multilevel_ws *ws, long int v,
+				     long int new_id, igraph_real_t w_old,
+				     igraph_real_t w_new) {
+  long int old_id=ws->memb[v];
+  igraph_i_multilevel_community *item=ws->item;
+  item[old_id].size--;
+  item[old_id].weight_all -= ws->k[v];
+  item[old_id].weight_inside -= 2*w_old + 2*g->loop[v];
+  ws->memb[v]=new_id;
+  item[new_id].size++;
+  item[new_id].weight_all += ws->k[v];
+  item[new_id].weight_inside += 2*w_new + 2*g->loop[v];
+}
 
-  IGRAPH_CHECK(igraph_reindex_membership(membership, 0));
+/* Processes the vertices in positions 'from' ... 'to'-1 of 'order',
+   these all have the same color. Returns the number of moves. */
+static long int igraph_i_multilevel_chunk(const igraph_i_multilevel_graph *g,
+					  igraph_i_multilevel_ws *ws,
+					  igraph_real_t m, long int from,
+					  long int to) {
+  long int i, changed=0;
 
-  /* Create the new edgelist */
-  igraph_eit_create(graph, igraph_ess_all(IGRAPH_EDGEORDER_ID), &eit);
-  IGRAPH_FINALLY(igraph_eit_destroy, &eit);
-  i = 0;
-  while (!IGRAPH_EIT_END(eit)) {
-    igraph_integer_t from, to;
-    IGRAPH_CHECK(igraph_edge(graph, IGRAPH_EIT_GET(eit), &from, &to));
-    VECTOR(edges)[i++] = VECTOR(*membership)[(long int) from];
-    VECTOR(edges)[i++] = VECTOR(*membership)[(long int) to];
-    IGRAPH_EIT_NEXT(eit);
+  if (to - from >= IGRAPH_I_MULTILEVEL_MIN_PARALLEL) {
+    IGRAPH_I_PARALLEL(ws->nthreads)
+    {
+      int me=IGRAPH_I_THREAD_NUM;
+      igraph_i_multilevel_choose(g, ws, m, from+me, to, IGRAPH_I_NUM_THREADS,
+				 me);
+    }
+  } else {
+    igraph_i_multilevel_choose(g, ws, m, from, to, 1, 0);
   }
-  igraph_eit_destroy(&eit);
-  IGRAPH_FINALLY_CLEAN(1);
 
-  /* Create the new graph */
-  igraph_destroy(graph);
-  no_of_nodes = (long int) igraph_vector_max(membership)+1;
-  IGRAPH_CHECK(igraph_create(graph, &edges, (igraph_integer_t) no_of_nodes,
-			     directed));
-
-  igraph_vector_destroy(&edges);
-  IGRAPH_FINALLY_CLEAN(1);
+  for (i = from; i < to; i++) {
+    long int v=ws->order[i];
+    if (ws->best[i] != ws->memb[v]) {
+      igraph_i_multilevel_move(g, ws, v, ws->best[i], ws->w_old[i], 
+			       ws->w_new[i]);
+      changed++;
+    }
+  }
 
-  return 0;
+  return changed;
 }
 
 /**
- * \ingroup communities
- * \function igraph_i_community_multilevel_step
- * \brief Performs a single step of the multi-level modularity optimization method
- *
- * This function implements a single step of the multi-level modularity optimization
- * algorithm for finding community structure, see VD Blondel, J-L Guillaume,
- * R Lambiotte and E Lefebvre: Fast unfolding of community hierarchies in large
- * networks, http://arxiv.org/abs/0803.0476 for the details.
- *
- * This function was contributed by Tom Gregorovic.
- *
- * \param graph   The input graph. It must be an undirected graph.
- * \param weights Numeric vector containing edge weights. If \c NULL, every edge
- *     has equal weight. The weights are expected to be non-negative.
- * \param membership The membership vector, the result is returned here.
- *     For each vertex it gives the ID of its community.
- * \param modularity The modularity of the partition is returned here.
- *     \c NULL means that the modularity is not needed.
- * \return Error code.
- *
- * Time complexity: in average near linear on sparse graphs.
+ * Performs a single step of the multi-level modularity optimization
+ * method: vertices are moved between the communities, as long as the
+ * modularity increases. The communities are returned in ws->memb,
+ * numbered from zero, and their number in no_of_communities.
  */
-int igraph_i_community_multilevel_step(igraph_t *graph,
-  igraph_vector_t *weights, igraph_vector_t *membership,
-  igraph_real_t *modularity) {
-  
-  long int i, j;
-  long int vcount = igraph_vcount(graph);
-  long int ecount = igraph_ecount(graph);
-  igraph_integer_t ffrom, fto;
-  igraph_real_t q, pass_q;
-  int pass;
-  igraph_bool_t changed = 0;
-  igraph_vector_t links_community;
-  igraph_vector_t links_weight;
-  igraph_vector_t edges;
-  igraph_vector_t temp_membership;
-  igraph_i_multilevel_community_list communities;
-
-  /* Initial sanity checks on the input parameters */
-  if (igraph_is_directed(graph)) {
-    IGRAPH_ERROR("multi-level community detection works for undirected graphs only",
-        IGRAPH_UNIMPLEMENTED);
-  }
-  if (igraph_vector_size(weights) < igraph_ecount(graph))
-    IGRAPH_ERROR("multi-level community detection: weight vector too short", IGRAPH_EINVAL);
-  if (igraph_vector_any_smaller(weights, 0))
-    IGRAPH_ERROR("weights must be positive", IGRAPH_EINVAL);
-
-  /* Initialize data structures */
-  IGRAPH_VECTOR_INIT_FINALLY(&links_community, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&links_weight, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&temp_membership, vcount);
-  IGRAPH_CHECK(igraph_vector_resize(membership, vcount));
- 
-  /* Initialize list of communities from graph vertices */
-  communities.vertices_no = vcount;
-  communities.communities_no = vcount;
-  communities.weights = weights;
-  communities.weight_sum = 2 * igraph_vector_sum(weights);
-  communities.membership = membership;
-  communities.item = igraph_Calloc(vcount, igraph_i_multilevel_community);
-  if (communities.item == 0) {
-    IGRAPH_ERROR("multi-level community structure detection failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, communities.item);
-
-  /* Still initializing the communities data structure */
-  for (i=0; i < vcount; i++) {
-    VECTOR(*communities.membership)[i] = i;
-    communities.item[i].size = 1;
-    communities.item[i].weight_inside = 0;
-    communities.item[i].weight_all = 0;
+static int igraph_i_multilevel_step(const igraph_i_multilevel_graph *g,
+				    igraph_i_multilevel_ws *ws,
+				    igraph_real_t *modularity,
+				    long int *no_of_communities) {
+
+  long int n=g->n, i, j, no_of_colors=0, changed;
+  long int *memb=ws->memb;
+  igraph_i_multilevel_community *item=ws->item;
+  igraph_real_t m=0, q, pass_q;
+  igraph_bool_t parallel=ws->parallel;
+
+  /* Every vertex is in its own community */
+  for (i=0; i<n; i++) {
+    igraph_real_t k=2*g->loop[i];
+    for (j=g->start[i]; j<g->start[i+1]; j++) { k += g->w[j]; }
+    ws->k[i]=k;
+    m += k;
+    memb[i]=i;
+    item[i].size=1;
+    item[i].weight_inside=2*g->loop[i];
+    item[i].weight_all=k;
   }
 
-  /* Some more initialization :) */
-  for (i = 0; i < ecount; i++) {
-    igraph_real_t weight = 1;
-    igraph_edge(graph, (igraph_integer_t) i, &ffrom, &fto);
-
-    weight = VECTOR(*weights)[i];
-    communities.item[(long int) ffrom].weight_all += weight;
-    communities.item[(long int) fto].weight_all += weight;
-    if (ffrom == fto)
-      communities.item[(long int) ffrom].weight_inside += 2*weight;
+  if (parallel) { 
+    no_of_colors=igraph_i_multilevel_color(g, ws);
   }
+  for (i=0; i<(long int) ws->nthreads * ws->n; i++) { ws->mark[i]=-1; }
 
-  q = igraph_i_multilevel_community_modularity(&communities);
-  pass = 1;
-
-  do { /* Pass begin */
-    long int temp_communities_no = communities.communities_no;
+  q = igraph_i_multilevel_modularity(item, n, m);
 
+  while (1) { /* Pass begin */
     pass_q = q;
     changed = 0;
-    
-    /* Save the current membership, it will be restored in case of worse result */
-    IGRAPH_CHECK(igraph_vector_update(&temp_membership, communities.membership));
 
-    for (i = 0; i < vcount; i++) {
-      /* Exclude vertex from its current community */
-      igraph_real_t weight_all = 0;
-      igraph_real_t weight_inside = 0;
-      igraph_real_t weight_loop = 0;
-      igraph_real_t max_q_gain = 0;
-      igraph_real_t max_weight;
-      long int old_id, new_id, n;
-
-      igraph_i_multilevel_community_links(graph, &communities, 
-					  (igraph_integer_t) i, &edges,
-					  &weight_all, &weight_inside, 
-					  &weight_loop, &links_community,
-					  &links_weight);
-
-      old_id = (long int)VECTOR(*(communities.membership))[i];
-      new_id = old_id;
-
-      /* Update old community */
-      igraph_vector_set(communities.membership, i, -1);
-      communities.item[old_id].size--;
-      if (communities.item[old_id].size == 0) {communities.communities_no--;}
-      communities.item[old_id].weight_all -= weight_all;
-      communities.item[old_id].weight_inside -= 2*weight_inside + weight_loop;
-
-      /* debug("Remove %ld all: %lf Inside: %lf\n", i, -weight_all, -2*weight_inside + weight_loop); */
-
-      /* Find new community to join with the best modification gain */
-      max_q_gain = 0;
-      max_weight = weight_inside;
-      n = igraph_vector_size(&links_community);
-
-      for (j = 0; j < n; j++) {
-        long int c = (long int) VECTOR(links_community)[j];
-        igraph_real_t w = VECTOR(links_weight)[j];
-
-        igraph_real_t q_gain = 
-	  igraph_i_multilevel_community_modularity_gain(&communities, 
-							(igraph_integer_t) c, 
-							(igraph_integer_t) i,
-							weight_all, w);
-        /* debug("Link %ld -> %ld weight: %lf gain: %lf\n", i, c, (double) w, (double) q_gain); */
-        if (q_gain > max_q_gain) {
-          new_id = c;
-          max_q_gain = q_gain;
-          max_weight = w;
-        }
+    /* Save the current membership, it will be restored in case of worse result */
+    memcpy(ws->saved, memb, sizeof(long int) * (size_t) n);
+
+    if (!parallel) {
+      for (i = 0; i < n; i++) {
+	igraph_real_t w_old, w_new;
+	long int old_id = memb[i], new_id;
+	/* Exclude vertex from its current community */
+	item[old_id].size--;
+	item[old_id].weight_all -= ws->k[i];
+	new_id=igraph_i_multilevel_best(g, item, memb, ws->k[i], m, i,
+					/*removed=*/ 1, ws->acc, ws->mark,
+					ws->slot, &w_old, &w_new);
+	item[old_id].weight_inside -= 2*w_old + 2*g->loop[i];
+	/* Add vertex to "new" community and update it */
+	memb[i] = new_id;
+	item[new_id].size++;
+	item[new_id].weight_all += ws->k[i];
+	item[new_id].weight_inside += 2*w_new + 2*g->loop[i];
+	if (new_id != old_id) {
+	  changed++;
+	}
       }
-
-      /* debug("Added vertex %ld to community %ld (gain %lf).\n", i, new_id, (double) max_q_gain); */
-
-      /* Add vertex to "new" community and update it */
-      igraph_vector_set(communities.membership, i, new_id);
-      if (communities.item[new_id].size == 0) {communities.communities_no++;}
-      communities.item[new_id].size++;
-      communities.item[new_id].weight_all += weight_all;
-      communities.item[new_id].weight_inside += 2*max_weight + weight_loop;
-
-      if (new_id != old_id) {
-        changed++;
+    } else {
+      long int c, from, to;
+      for (c = 0; c < no_of_colors; c++) {
+	for (from = ws->cstart[c]; from < ws->cstart[c+1]; from = to) {
+	  to = from + IGRAPH_I_MULTILEVEL_CHUNK < ws->cstart[c+1] ?
+	    from + IGRAPH_I_MULTILEVEL_CHUNK : ws->cstart[c+1];
+	  changed += igraph_i_multilevel_chunk(g, ws, m, from, to);
+	}
       }
     }
 
-    q = igraph_i_multilevel_community_modularity(&communities);
+    q = igraph_i_multilevel_modularity(item, n, m);
 
-    if (changed && (q > pass_q)) { 
-      /* debug("Pass %d (changed: %d) Communities: %ld Modularity from %lf to %lf\n",
-        pass, changed, communities.communities_no, (double) pass_q, (double) q); */
-      pass++;
-    } else {
+    if (!changed || q <= pass_q) {
       /* No changes or the modularity became worse, restore last membership */
-      IGRAPH_CHECK(igraph_vector_update(communities.membership, &temp_membership));
-      communities.communities_no = temp_communities_no;
+      memcpy(memb, ws->saved, sizeof(long int) * (size_t) n);
       break;
     }
 
     IGRAPH_ALLOW_INTERRUPTION();
-  } while (changed && (q > pass_q)); /* Pass end */
+  } /* Pass end */
 
   if (modularity) {
     *modularity = q;
   }
 
-  /* debug("Result Communities: %ld Modularity: %lf\n",
-    communities.communities_no, (double) q); */
+  /* Renumber the communities, keeping their order */
+  for (i = 0; i < n; i++) { ws->slot[i] = -1; }
+  for (i = 0; i < n; i++) { ws->slot[memb[i]] = 0; }
+  for (i = 0, j = 0; i < n; i++) { 
+    if (ws->slot[i] == 0) { ws->slot[i] = j++; }
+  }
+  for (i = 0; i < n; i++) { memb[i] = ws->slot[memb[i]]; }
+  *no_of_communities = j;
 
-  IGRAPH_CHECK(igraph_reindex_membership(membership, 0));
+  return 0;
+}
 
-  /* Shrink the nodes of the graph according to the present community structure
-   * and simplify the resulting graph */
+/* Shrinks communities into single vertices, the edges between two
+   communities are merged into a single edge, and the edges inside a
+   community become a loop edge. The communities must be numbered
+   from zero, in ws->memb. */
+static int igraph_i_multilevel_shrink(igraph_i_multilevel_graph *g,
+				      igraph_i_multilevel_ws *ws,
+				      long int no_of_comms) {
+  igraph_i_multilevel_graph newg;
+  long int n=g->n, i, c;
+  long int *memb=ws->memb, *members=ws->order, *mstart=ws->cstart;
+  long int *bound=ws->saved;	/* no_of_comms < n */
+  igraph_integer_t *nei;
+  igraph_real_t *w;
+
+  memset(&newg, 0, sizeof(newg));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &newg);
+
+  /* The members of each community, in vertex order */
+  memset(mstart, 0, sizeof(long int) * (size_t) (no_of_comms+1));
+  for (i=0; i<n; i++) { mstart[memb[i]+1] += 1; }
+  for (c=0; c<no_of_comms; c++) { 
+    mstart[c+1] += mstart[c];
+    ws->slot[c]=mstart[c];
+  }
+  for (i=0; i<n; i++) { members[ws->slot[memb[i]]++]=i; }
+
+  /* Upper bound on the number of neighbors */
+  bound[0]=0;
+  for (c=0; c<no_of_comms; c++) {
+    bound[c+1]=bound[c];
+    for (i=mstart[c]; i<mstart[c+1]; i++) {
+      long int v=members[i];
+      bound[c+1] += g->start[v+1] - g->start[v];
+    }
+  }
 
-  /* TODO: check if we really need to copy temp_membership */
-  IGRAPH_CHECK(igraph_vector_update(&temp_membership, membership));
-  IGRAPH_CHECK(igraph_i_multilevel_shrink(graph, &temp_membership));
-  igraph_vector_destroy(&temp_membership);
-  IGRAPH_FINALLY_CLEAN(1);  
-  
-  /* Update edge weights after shrinking and simplification */
-  /* Here we reuse the edges vector as we don't need the previous contents anymore */
-  /* TODO: can we use igraph_simplify here? */
-  IGRAPH_CHECK(igraph_i_multilevel_simplify_multiple(graph, &edges));
-
-  /* We reuse the links_weight vector to store the old edge weights */
-  IGRAPH_CHECK(igraph_vector_update(&links_weight, weights));
-  igraph_vector_fill(weights, 0);
-   
-  for (i = 0; i < ecount; i++) {
-    VECTOR(*weights)[(long int)VECTOR(edges)[i]] += VECTOR(links_weight)[i];
+  newg.n=no_of_comms;
+  newg.start=igraph_Calloc(no_of_comms+1, long int);
+  newg.nei=igraph_Calloc(bound[no_of_comms] > 0 ? bound[no_of_comms] : 1,
+			 igraph_integer_t);
+  newg.w=igraph_Calloc(bound[no_of_comms] > 0 ? bound[no_of_comms] : 1,
+		       igraph_real_t);
+  newg.loop=igraph_Calloc(no_of_comms > 0 ? no_of_comms : 1, igraph_real_t);
+  if (!newg.start || !newg.nei || !newg.w || !newg.loop) {
+    IGRAPH_ERROR("multi-level community structure detection failed",
+		 IGRAPH_ENOMEM);
+  }
+
+  IGRAPH_I_PARALLEL(ws->nthreads)
+  {
+    size_t off=(size_t) IGRAPH_I_THREAD_NUM * (size_t) ws->n;
+    long int *mark=ws->mark+off, *slot=ws->slot+off;
+    long int c2, j, k;
+    for (c2=0; c2<no_of_comms; c2++) { mark[c2]=-1; }
+    IGRAPH_I_SHARE(c2, 0, no_of_comms) {
+      long int p=bound[c2];
+      igraph_real_t inside=0, loop=0;
+      for (j=mstart[c2]; j<mstart[c2+1]; j++) {
+	long int v=members[j];
+	loop += g->loop[v];
+	for (k=g->start[v]; k<g->start[v+1]; k++) {
+	  long int d=memb[(long int) g->nei[k]];
+	  if (d == c2) {
+	    inside += g->w[k];
+	  } else if (mark[d] != c2) {
+	    mark[d]=c2;
+	    slot[d]=p;
+	    newg.nei[p]=(igraph_integer_t) d;
+	    newg.w[p++]=g->w[k];
+	  } else {
+	    newg.w[slot[d]] += g->w[k];
+	  }
+	}
+      }
+      /* both directions of the inside edges were counted */
+      newg.loop[c2]=loop + inside/2;
+      newg.start[c2+1]=p-bound[c2];
+    }
   }
 
-  igraph_free(communities.item);
-  igraph_vector_destroy(&links_community);
-  igraph_vector_destroy(&links_weight);
-  igraph_vector_destroy(&edges);
-  IGRAPH_FINALLY_CLEAN(4);
-  
+  /* Remove the gaps */
+  newg.start[0]=0;
+  for (c=0; c<no_of_comms; c++) {
+    long int size=newg.start[c+1];
+    memmove(newg.nei+newg.start[c], newg.nei+bound[c], 
+	    sizeof(igraph_integer_t) * (size_t) size);
+    memmove(newg.w+newg.start[c], newg.w+bound[c], 
+	    sizeof(igraph_real_t) * (size_t) size);
+    newg.start[c+1]=newg.start[c]+size;
+  }
+  if (newg.start[no_of_comms] > 0) {
+    nei=igraph_Realloc(newg.nei, newg.start[no_of_comms], igraph_integer_t);
+    if (nei) { newg.nei=nei; }
+    w=igraph_Realloc(newg.w, newg.start[no_of_comms], igraph_real_t);
+    if (w) { newg.w=w; }
+  }
+
+  igraph_i_multilevel_graph_destroy(g);
+  *g=newg;
+  IGRAPH_FINALLY_CLEAN(1);
+
   return 0;
 }
 
@@ -2898,6 +3412,18 @@ int igraph_i_community_multilevel_step(igraph_t *graph,
  * The process stops when there is only a single vertex left or when the modularity
  * cannot be increased any more in a step.
  *
+ * </para><para>
+ * If \p parallel is true, then the vertices are colored, so that
+ * adjacent vertices have different colors, and the vertices of the
+ * same color choose their new communities at the same time, on as
+ * many threads as allowed by \ref igraph_set_num_threads(). The
+ * result of this variant does not depend on the number of threads,
+ * but it is usually different from the result of the sequential
+ * variant. The sequential variant gives the same result with any
+ * number of threads, too. Each thread needs memory linear in the
+ * number of vertices.
+ *
+ * </para><para>
  * This function was contributed by Tom Gregorovic.
  *
  * \param graph The input graph. It must be an undirected graph.
@@ -2912,6 +3438,8 @@ int igraph_i_community_multilevel_step(igraph_t *graph,
  * \param modularity Numeric vector that will contain the modularity score
  *     after each level, if not \c NULL. It must be initialized and it
  *     will be resized accordingly.
+ * \param parallel Logical, whether to use the parallel variant, in
+ *     which the vertices of the same color are moved together.
  * \return Error code.
  *
  * Time complexity: in average near linear on sparse graphs.
@@ -2921,34 +3449,40 @@ int igraph_i_community_multilevel_step(igraph_t *graph,
 
 int igraph_community_multilevel(const igraph_t *graph,
   const igraph_vector_t *weights, igraph_vector_t *membership,
-  igraph_matrix_t *memberships, igraph_vector_t *modularity) {
+  igraph_matrix_t *memberships, igraph_vector_t *modularity,
+  igraph_bool_t parallel) {
  
-  igraph_t g;
-  igraph_vector_t w, m, level_membership;
+  igraph_i_multilevel_graph g;
+  igraph_i_multilevel_ws ws;
+  igraph_vector_t level_membership;
   igraph_real_t prev_q = -1, q = -1;
   int i, level = 1;
   long int vcount = igraph_vcount(graph);
 
-  /* Make a copy of the original graph, we will do the merges on the copy */
-  IGRAPH_CHECK(igraph_copy(&g, graph));
-  IGRAPH_FINALLY(igraph_destroy, &g);
-
-  if (weights) {
-    IGRAPH_CHECK(igraph_vector_copy(&w, weights));   
-    IGRAPH_FINALLY(igraph_vector_destroy, &w);  
-  } else {
-    IGRAPH_VECTOR_INIT_FINALLY(&w, igraph_ecount(&g));
-    igraph_vector_fill(&w, 1);
+  /* Initial sanity checks on the input parameters */
+  if (igraph_is_directed(graph)) {
+    IGRAPH_ERROR("multi-level community detection works for undirected graphs only",
+        IGRAPH_UNIMPLEMENTED);
   }
+  if (weights && igraph_vector_size(weights) < igraph_ecount(graph))
+    IGRAPH_ERROR("multi-level community detection: weight vector too short", IGRAPH_EINVAL);
+  if (weights && igraph_vector_any_smaller(weights, 0))
+    IGRAPH_ERROR("weights must be positive", IGRAPH_EINVAL);
+
+  /* The graph of the first level, we will do the merges on this */
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(graph, weights, &g));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &g);
+
+  IGRAPH_CHECK(igraph_i_multilevel_ws_init(&ws, vcount, 
+					   igraph_get_num_threads()));
+  IGRAPH_FINALLY(igraph_i_multilevel_ws_destroy, &ws);
+  ws.parallel=parallel;
 
-  IGRAPH_VECTOR_INIT_FINALLY(&m, vcount);
   IGRAPH_VECTOR_INIT_FINALLY(&level_membership, vcount);
 
-  if (memberships || membership) {
-    /* Put each vertex in its own community */
-    for (i = 0; i < vcount; i++) {
-      VECTOR(level_membership)[i] = i;
-    }
+  /* Put each vertex in its own community */
+  for (i = 0; i < vcount; i++) {
+    VECTOR(level_membership)[i] = i;
   }
   if (memberships) {
     /* Resize the membership matrix to have vcount columns and no rows */
@@ -2961,20 +3495,18 @@ int igraph_community_multilevel(const igraph_t *graph,
   
   while (1) {
     /* Remember the previous modularity and vertex count, do a single step */
-    igraph_integer_t step_vcount = igraph_vcount(&g);
+    long int step_vcount = g.n, no_of_comms;
 
     prev_q = q;
-    IGRAPH_CHECK(igraph_i_community_multilevel_step(&g, &w, &m, &q));
+    IGRAPH_CHECK(igraph_i_multilevel_step(&g, &ws, &q, &no_of_comms));
 
     /* Were there any merges? If not, we have to stop the process */
-    if (igraph_vcount(&g) == step_vcount || q < prev_q)
+    if (no_of_comms == step_vcount || q < prev_q)
       break;
 
-    if (memberships || membership) {
-      for (i = 0; i < vcount; i++) {
-        /* Readjust the membership vector */
-        VECTOR(level_membership)[i] = VECTOR(m)[(long int) VECTOR(level_membership)[i]];
-      }
+    for (i = 0; i < vcount; i++) {
+      /* Readjust the membership vector */
+      VECTOR(level_membership)[i] = ws.memb[(long int) VECTOR(level_membership)[i]];
     }
 
     if (modularity) {
@@ -2989,8 +3521,8 @@ int igraph_community_multilevel(const igraph_t *graph,
       IGRAPH_CHECK(igraph_matrix_set_row(memberships, &level_membership, level - 1));
     }
 
-    /* debug("Level: %d Communities: %ld Modularity: %f\n", level, (long int) igraph_vcount(&g),
-      (double) q); */
+    /* Shrink the communities into single vertices */
+    IGRAPH_CHECK(igraph_i_multilevel_shrink(&g, &ws, no_of_comms));
 
     /* Increase the level counter */
     level++;
@@ -3013,441 +3545,812 @@ int igraph_community_multilevel(const igraph_t *graph,
 
   /* If we need the final membership vector, copy it to the output */
   if (membership) {
-    IGRAPH_CHECK(igraph_vector_resize(membership, vcount));   
-    for (i = 0; i < vcount; i++) {
-      VECTOR(*membership)[i] = VECTOR(level_membership)[i];
-    }
+    IGRAPH_CHECK(igraph_vector_update(membership, &level_membership));
   }
 
-  /* Destroy the copy of the graph */
-  igraph_destroy(&g);
-
-  /* Destroy the temporary vectors */
-  igraph_vector_destroy(&m);
-  igraph_vector_destroy(&w);
   igraph_vector_destroy(&level_membership);
-  IGRAPH_FINALLY_CLEAN(4);
+  igraph_i_multilevel_ws_destroy(&ws);
+  igraph_i_multilevel_graph_destroy(&g);
+  IGRAPH_FINALLY_CLEAN(3);
 
   return 0;
 }
 
 
-int igraph_i_compare_communities_vi(const igraph_vector_t *v1,
-    const igraph_vector_t *v2, igraph_real_t* result);
-int igraph_i_compare_communities_nmi(const igraph_vector_t *v1,
-    const igraph_vector_t *v2, igraph_real_t* result);
-int igraph_i_compare_communities_rand(const igraph_vector_t *v1,
-    const igraph_vector_t *v2, igraph_real_t* result, igraph_bool_t adjust);
-int igraph_i_split_join_distance(const igraph_vector_t *v1,
-    const igraph_vector_t *v2, igraph_integer_t* distance12,
-    igraph_integer_t* distance21);
-
-/**
- * \ingroup communities
- * \function igraph_compare_communities
- * \brief Compares community structures using various metrics
- *
- * This function assesses the distance between two community structures
- * using the variation of information (VI) metric of Meila (2003), the
- * normalized mutual information (NMI) of Danon et al (2005), the
- * split-join distance of van Dongen (2000), the Rand index of Rand (1971)
- * or the adjusted Rand index of Hubert and Arabie (1985).
- *
- * </para><para>
- * References:
- *
- * </para><para>
- * Meila M: Comparing clusterings by the variation of information.
- * In: Schölkopf B, Warmuth MK (eds.). Learning Theory and Kernel Machines:
- * 16th Annual Conference on Computational Learning Theory and 7th Kernel
- * Workshop, COLT/Kernel 2003, Washington, DC, USA. Lecture Notes in Computer
- * Science, vol. 2777, Springer, 2003. ISBN: 978-3-540-40720-1.
- *
- * </para><para>
- * Danon L, Diaz-Guilera A, Duch J, Arenas A: Comparing community structure
- * identification. J Stat Mech P09008, 2005.
- *
- * </para><para>
- * van Dongen S: Performance criteria for graph clustering and Markov cluster
- * experiments. Technical Report INS-R0012, National Research Institute for
- * Mathematics and Computer Science in the Netherlands, Amsterdam, May 2000.
- * 
- * </para><para>
- * Rand WM: Objective criteria for the evaluation of clustering methods.
- * J Am Stat Assoc 66(336):846-850, 1971.
- *
- * </para><para>
- * Hubert L and Arabie P: Comparing partitions. Journal of Classification
- * 2:193-218, 1985.
+/*
+ * The Leiden method, see VA Traag, L Waltman and NJ van Eck: From
+ * Louvain to Leiden: guaranteeing well-connected communities,
+ * Scientific Reports 9, 5233 (2019). It uses the level graphs and the
+ * shrinking of the multi-level method, with two differences:
  *
- * \param  comm1   the membership vector of the first community structure
- * \param  comm2   the membership vector of the second community structure
- * \param  result  the result is stored here.
- * \param  method  the comparison method to use. \c IGRAPH_COMMCMP_VI
- *                 selects the variation of information (VI) metric of
- *                 Meila (2003), \c IGRAPH_COMMCMP_NMI selects the
- *                 normalized mutual information measure proposed by
- *                 Danon et al (2005), \c IGRAPH_COMMCMP_SPLIT_JOIN
- *                 selects the split-join distance of van Dongen (2000),
- *                 \c IGRAPH_COMMCMP_RAND selects the unadjusted Rand
- *                 index (1971) and \c IGRAPH_COMMCMP_ADJUSTED_RAND
- *                 selects the adjusted Rand index.
+ * The vertices are moved using a queue. Initially all vertices are
+ * in the queue, and when a vertex moves to another community, its
+ * neighbors outside of that community are queued again. So there is
+ * only one full pass over the vertices, after that only the
+ * neighborhoods that changed are revisited.
  *
- * \return  Error code.
+ * The communities are refined before shrinking them. Within each
+ * community the vertices start in singleton sub-communities, and a
+ * singleton vertex joins the neighboring sub-community with the
+ * largest gain, if both are well connected to the rest of the
+ * community. The refined sub-communities are connected, they become
+ * the vertices of the next level, and the communities of the next
+ * level start from the unrefined communities.
  *
- * Time complexity: O(n log(n)).
+ * The refinement is the greedy variant of the paper, it does not
+ * choose the sub-communities randomly, so the result is
+ * deterministic.
  */
-int igraph_compare_communities(const igraph_vector_t *comm1,
-    const igraph_vector_t *comm2, igraph_real_t* result,
-    igraph_community_comparison_t method) {
-  igraph_vector_t c1, c2;
 
-  if (igraph_vector_size(comm1) != igraph_vector_size(comm2)) {
-    IGRAPH_ERROR("community membership vectors have different lengths", IGRAPH_EINVAL);
+/* Work buffers of the Leiden method, in addition to the multi-level
+   ones, sized for the first level */
+typedef struct {
+  long int *part;		/* Communities of the moving phase, n */
+  long int *queue;		/* Circular queue of vertices, n */
+  char *queued;			/* Whether a vertex is in the queue, n */
+  long int *empty;		/* Stack of empty communities, n */
+  igraph_real_t *kin;		/* Weight towards the own community, n */
+  igraph_real_t *rext;		/* Weight from a refined community to the
+				   rest of its community, n */
+  igraph_real_t *rk;		/* Degree of a refined community, n */
+  long int *rsize;		/* Size of a refined community, n */
+} igraph_i_leiden_ws;
+
+static void igraph_i_leiden_ws_destroy(igraph_i_leiden_ws *lws) {
+  if (lws->part) { igraph_Free(lws->part); }
+  if (lws->queue) { igraph_Free(lws->queue); }
+  if (lws->queued) { igraph_Free(lws->queued); }
+  if (lws->empty) { igraph_Free(lws->empty); }
+  if (lws->kin) { igraph_Free(lws->kin); }
+  if (lws->rext) { igraph_Free(lws->rext); }
+  if (lws->rk) { igraph_Free(lws->rk); }
+  if (lws->rsize) { igraph_Free(lws->rsize); }
+}
+
+static int igraph_i_leiden_ws_init(igraph_i_leiden_ws *lws, long int n) {
+  size_t size= n > 0 ? (size_t) n : 1;
+  memset(lws, 0, sizeof(igraph_i_leiden_ws));
+  lws->part=igraph_Calloc(size, long int);
+  lws->queue=igraph_Calloc(size, long int);
+  lws->queued=igraph_Calloc(size, char);
+  lws->empty=igraph_Calloc(size, long int);
+  lws->kin=igraph_Calloc(size, igraph_real_t);
+  lws->rext=igraph_Calloc(size, igraph_real_t);
+  lws->rk=igraph_Calloc(size, igraph_real_t);
+  lws->rsize=igraph_Calloc(size, long int);
+  if (!lws->part || !lws->queue || !lws->queued || !lws->empty ||
+      !lws->kin || !lws->rext || !lws->rk || !lws->rsize) {
+    igraph_i_leiden_ws_destroy(lws);
+    IGRAPH_ERROR("Leiden community structure detection failed",
+		 IGRAPH_ENOMEM);
   }
+  return 0;
+}
 
-  /* Copy and reindex membership vectors to make sure they are continuous */
-  IGRAPH_CHECK(igraph_vector_copy(&c1, comm1));
-  IGRAPH_FINALLY(igraph_vector_destroy, &c1);
+/* Modularity with a resolution parameter */
+static igraph_real_t igraph_i_leiden_quality(
+  const igraph_i_multilevel_community *item, long int n, igraph_real_t m,
+  igraph_real_t resolution) {
+  igraph_real_t result = 0;
+  long int i;
 
-  IGRAPH_CHECK(igraph_vector_copy(&c2, comm2));
-  IGRAPH_FINALLY(igraph_vector_destroy, &c2);
+  for (i = 0; i < n; i++) {
+    if (item[i].size > 0) {
+      result += (item[i].weight_inside - 
+		 resolution*item[i].weight_all*item[i].weight_all/m)/m;
+    }
+  }
 
-  IGRAPH_CHECK(igraph_reindex_membership(&c1, 0));
-  IGRAPH_CHECK(igraph_reindex_membership(&c2, 0));
+  return result;
+}
 
-  switch (method) {
-    case IGRAPH_COMMCMP_VI:
-      IGRAPH_CHECK(igraph_i_compare_communities_vi(&c1, &c2, result));
-      break;
+/* The fast local moving phase. The vertices are taken from the
+   queue, and each is moved to the community with the largest gain,
+   or to an empty community, if it is better alone. The neighbors of
+   a moved vertex are queued again, unless they are in its new
+   community. The communities are in lws->part, their IDs must be
+   smaller than the number of vertices. The number of moves is
+   returned in 'moves'. */
+static int igraph_i_leiden_move(const igraph_i_multilevel_graph *g,
+				igraph_i_multilevel_ws *ws,
+				igraph_i_leiden_ws *lws,
+				igraph_real_t resolution, igraph_real_t m,
+				long int *moves) {
+  long int n=g->n, i, j, head=0, len=n, nempty=0, evals=0;
+  long int *part=lws->part, *mark=ws->mark, *touched=ws->slot;
+  igraph_real_t *acc=ws->acc;
+  igraph_i_multilevel_community *item=ws->item;
 
-    case IGRAPH_COMMCMP_NMI:
-      IGRAPH_CHECK(igraph_i_compare_communities_nmi(&c1, &c2, result));
-      break;
+  for (i=0; i<n; i++) {
+    item[i].size=0;
+    item[i].weight_inside=0;
+    item[i].weight_all=0;
+    mark[i]=-1;
+  }
+  for (i=0; i<n; i++) {
+    long int c=part[i];
+    item[c].size++;
+    item[c].weight_all += ws->k[i];
+    item[c].weight_inside += 2*g->loop[i];
+    for (j=g->start[i]; j<g->start[i+1]; j++) {
+      if (part[(long int) g->nei[j]] == c) { 
+	item[c].weight_inside += g->w[j];
+      }
+    }
+  }
+  for (i=n-1; i>=0; i--) {
+    if (item[i].size == 0) { lws->empty[nempty++]=i; }
+  }
+  for (i=0; i<n; i++) { 
+    lws->queue[i]=i;
+    lws->queued[i]=1;
+  }
+  *moves=0;
 
-    case IGRAPH_COMMCMP_SPLIT_JOIN:
-      {
-        igraph_integer_t d12, d21;
-        IGRAPH_CHECK(igraph_i_split_join_distance(&c1, &c2, &d12, &d21));
-        *result = d12 + d21;
+  while (len > 0) {
+    long int v=lws->queue[head], old=part[v], best=old, ntouched=0;
+    igraph_real_t kv=ws->k[v], best_gain, w_old, w_new;
+    igraph_bool_t to_empty=0;
+
+    head = head+1 < n ? head+1 : 0;
+    len--;
+    lws->queued[v]=0;
+
+    /* Exclude vertex from its current community */
+    item[old].size--;
+    item[old].weight_all -= kv;
+
+    for (j=g->start[v]; j<g->start[v+1]; j++) {
+      long int c=part[(long int) g->nei[j]];
+      if (mark[c] != v) {
+	mark[c]=v;
+	acc[c]=0;
+	touched[ntouched++]=c;
       }
-      break;
+      acc[c] += g->w[j];
+    }
 
-    case IGRAPH_COMMCMP_RAND:
-    case IGRAPH_COMMCMP_ADJUSTED_RAND:
-      IGRAPH_CHECK(igraph_i_compare_communities_rand(&c1, &c2, result,
-            method == IGRAPH_COMMCMP_ADJUSTED_RAND));
-      break;
+    /* Staying wins ties, then the smaller community ID */
+    w_old= mark[old] == v ? acc[old] : 0.0;
+    best_gain=w_old - resolution*item[old].weight_all*kv/m;
+    for (j=0; j<ntouched; j++) {
+      long int c=touched[j];
+      igraph_real_t gain=acc[c] - resolution*item[c].weight_all*kv/m;
+      if (gain > best_gain || 
+	  (gain == best_gain && best != old && c < best)) {
+	best=c;
+	best_gain=gain;
+      }
+    }
+    if (best_gain < 0 && item[old].size > 0) {
+      /* there is always an empty community in this case */
+      best=lws->empty[nempty-1];
+      to_empty=1;
+    }
+    w_new= mark[best] == v ? acc[best] : 0.0;
+    for (j=0; j<ntouched; j++) { mark[touched[j]]=-1; }
+
+    item[old].weight_inside -= 2*w_old + 2*g->loop[v];
+    part[v]=best;
+    item[best].size++;
+    item[best].weight_all += kv;
+    item[best].weight_inside += 2*w_new + 2*g->loop[v];
+
+    if (best != old) {
+      if (to_empty) { nempty--; }
+      if (item[old].size == 0) { lws->empty[nempty++]=old; }
+      for (j=g->start[v]; j<g->start[v+1]; j++) {
+	long int u=(long int) g->nei[j];
+	if (part[u] != best && !lws->queued[u]) {
+	  lws->queue[(head+len) % n]=u;
+	  lws->queued[u]=1;
+	  len++;
+	}
+      }
+      (*moves)++;
+    }
 
-    default:
-      IGRAPH_ERROR("unknown community comparison method", IGRAPH_EINVAL);
+    if (++evals % n == 0) {
+      IGRAPH_ALLOW_INTERRUPTION();
+    }
   }
 
-  /* Clean up everything */
-  igraph_vector_destroy(&c1);
-  igraph_vector_destroy(&c2);
-  IGRAPH_FINALLY_CLEAN(2);
-
   return 0;
 }
 
+/* Refines the communities in lws->part, the item array must belong
+   to them. The refined communities are written to ws->memb, numbered
+   from zero, and their number is returned. */
+static long int igraph_i_leiden_refine(const igraph_i_multilevel_graph *g,
+				       igraph_i_multilevel_ws *ws,
+				       igraph_i_leiden_ws *lws,
+				       igraph_real_t resolution,
+				       igraph_real_t m) {
+  long int n=g->n, v, j, no=0;
+  long int *part=lws->part, *rmemb=ws->memb, *mark=ws->mark;
+  long int *touched=ws->slot;
+  igraph_real_t *acc=ws->acc;
+
+  for (v=0; v<n; v++) {
+    igraph_real_t kin=0;
+    for (j=g->start[v]; j<g->start[v+1]; j++) {
+      if (part[(long int) g->nei[j]] == part[v]) { kin += g->w[j]; }
+    }
+    lws->kin[v]=kin;
+    lws->rext[v]=kin;
+    lws->rk[v]=ws->k[v];
+    lws->rsize[v]=1;
+    rmemb[v]=v;
+  }
+
+  for (v=0; v<n; v++) {
+    long int c=part[v], best=v, ntouched=0;
+    igraph_real_t kv=ws->k[v], tot=ws->item[c].weight_all, best_gain=0;
+
+    /* Only singletons move, if they are well connected */
+    if (rmemb[v] != v || lws->rsize[v] != 1) { continue; }
+    if (lws->kin[v] < resolution*kv*(tot-kv)/m) { continue; }
+
+    for (j=g->start[v]; j<g->start[v+1]; j++) {
+      long int u=(long int) g->nei[j], r;
+      if (part[u] != c) { continue; }
+      r=rmemb[u];
+      if (mark[r] != v) {
+	mark[r]=v;
+	acc[r]=0;
+	touched[ntouched++]=r;
+      }
+      acc[r] += g->w[j];
+    }
+
+    for (j=0; j<ntouched; j++) {
+      long int r=touched[j];
+      igraph_real_t gain;
+      mark[r]=-1;
+      if (acc[r] <= 0 || 
+	  lws->rext[r] < resolution*lws->rk[r]*(tot-lws->rk[r])/m) {
+	continue;
+      }
+      gain=acc[r] - resolution*kv*lws->rk[r]/m;
+      if (gain > best_gain || (gain == best_gain && best != v && r < best)) {
+	best=r;
+	best_gain=gain;
+      }
+    }
+
+    if (best != v) {
+      lws->rext[best] += lws->kin[v] - 2*acc[best];
+      lws->rk[best] += kv;
+      lws->rsize[best]++;
+      lws->rsize[v]=0;
+      rmemb[v]=best;
+    }
+  }
+
+  /* Renumber, in the order of the first members */
+  for (v=0; v<n; v++) { touched[v]=-1; }
+  for (v=0; v<n; v++) {
+    if (touched[rmemb[v]] < 0) { touched[rmemb[v]]=no++; }
+    rmemb[v]=touched[rmemb[v]];
+  }
+
+  return no;
+}
+
 /**
  * \ingroup communities
- * \function igraph_split_join_distance
- * \brief Calculates the split-join distance of two community structures
- *
- * The split-join distance between partitions A and B is the sum of the
- * projection distance of A from B and the projection distance of B from
- * A. The projection distance is an asymmetric measure and it is defined
- * as follows:
+ * \function igraph_community_leiden
+ * \brief Finding community structure with the Leiden algorithm
  *
- * </para><para>
- * First, each set in partition A is evaluated against all sets in partition
- * B. For each set in partition A, the best matching set in partition B is
- * found and the overlap size is calculated. (Matching is quantified by the
- * size of the overlap between the two sets). Then, the maximal overlap sizes
- * for each set in A are summed together and subtracted from the number of
- * elements in A.
+ * This function implements the Leiden algorithm of VA Traag, L
+ * Waltman and NJ van Eck: From Louvain to Leiden: guaranteeing
+ * well-connected communities, Scientific Reports 9, 5233 (2019).
+ * It improves the multi-level modularity optimization of \ref
+ * igraph_community_multilevel() in two ways.
  *
  * </para><para>
- * The split-join distance will be returned in two arguments, \c distance12
- * will contain the projection distance of the first partition from the
- * second, while \c distance21 will be the projection distance of the second
- * partition from the first. This makes it easier to detect whether a
- * partition is a subpartition of the other, since in this case, the
- * corresponding distance will be zero.
+ * First, the vertices are moved using a queue: after the first pass
+ * over all vertices only the neighbors of the moved vertices are
+ * visited again, so usually much fewer vertices are evaluated.
  *
  * </para><para>
- * Reference:
+ * Second, the communities are refined before merging them into single
+ * vertices for the next level: each community is split into connected
+ * sub-communities, that are well connected to the rest of the community.
+ * The merged vertices of the next level are these sub-communities,
+ * but they start from their unrefined communities. So the vertices
+ * of a community can still be moved separately on the next
+ * level, and the final communities are guaranteed to be connected.
  *
  * </para><para>
- * van Dongen S: Performance criteria for graph clustering and Markov cluster
- * experiments. Technical Report INS-R0012, National Research Institute for
- * Mathematics and Computer Science in the Netherlands, Amsterdam, May 2000.
- * 
- * \param  comm1       the membership vector of the first community structure
- * \param  comm2       the membership vector of the second community structure
- * \param  distance12  pointer to an \c igraph_integer_t, the projection distance
- *                     of the first community structure from the second one will be
- *                     returned here.
- * \param  distance21  pointer to an \c igraph_integer_t, the projection distance
- *                     of the second community structure from the first one will be
- *                     returned here.
- * \return  Error code.
+ * The vertices of the refined sub-communities are merged greedily,
+ * the function is deterministic.
  *
- * \see \ref igraph_compare_communities() with the \c IGRAPH_COMMCMP_SPLIT_JOIN
- * method if you are not interested in the individual distances but only the sum
- * of them.
+ * \param graph The input graph. It must be an undirected graph.
+ * \param weights Numeric vector containing edge weights. If \c NULL, every edge
+ *    has equal weight. The weights are expected to be non-negative.
+ * \param resolution The resolution parameter, the expected number of
+ *    edges within the communities is multiplied by this. Larger
+ *    values give more and smaller communities. Use 1 to optimize the
+ *    usual modularity. It must not be negative.
+ * \param membership The membership vector, the result is returned here.
+ *    For each vertex it gives the ID of its community. The vector
+ *    must be initialized and it will be resized accordingly.
+ * \param memberships Numeric matrix that will contain the membership
+ *     vector after each level, if not \c NULL. It must be initialized and
+ *     it will be resized accordingly.
+ * \param modularity Numeric vector that will contain the modularity score
+ *     after each level, if not \c NULL. The modularity is calculated
+ *     with the given resolution parameter. It must be initialized
+ *     and it will be resized accordingly.
+ * \return Error code.
  *
- * Time complexity: O(n log(n)).
+ * Time complexity: in average near linear on sparse graphs.
  */
-int igraph_split_join_distance(const igraph_vector_t *comm1,
-    const igraph_vector_t *comm2, igraph_integer_t *distance12,
-    igraph_integer_t *distance21) {
-  igraph_vector_t c1, c2;
 
-  if (igraph_vector_size(comm1) != igraph_vector_size(comm2)) {
-    IGRAPH_ERROR("community membership vectors have different lengths", IGRAPH_EINVAL);
-  }
-
-  /* Copy and reindex membership vectors to make sure they are continuous */
-  IGRAPH_CHECK(igraph_vector_copy(&c1, comm1));
-  IGRAPH_FINALLY(igraph_vector_destroy, &c1);
-
-  IGRAPH_CHECK(igraph_vector_copy(&c2, comm2));
-  IGRAPH_FINALLY(igraph_vector_destroy, &c2);
-
-  IGRAPH_CHECK(igraph_reindex_membership(&c1, 0));
-  IGRAPH_CHECK(igraph_reindex_membership(&c2, 0));
+int igraph_community_leiden(const igraph_t *graph,
+  const igraph_vector_t *weights, igraph_real_t resolution,
+  igraph_vector_t *membership, igraph_matrix_t *memberships, 
+  igraph_vector_t *modularity) {
+
+  igraph_i_multilevel_graph g;
+  igraph_i_multilevel_ws ws;
+  igraph_i_leiden_ws lws;
+  igraph_vector_t level_membership, result;
+  igraph_real_t q = 0;
+  long int i, j, level = 0, no_of_levels = 0;
+  long int vcount = igraph_vcount(graph);
 
-  IGRAPH_CHECK(igraph_i_split_join_distance(&c1, &c2, distance12, distance21));
+  if (igraph_is_directed(graph)) {
+    IGRAPH_ERROR("Leiden community detection works for undirected graphs only",
+        IGRAPH_UNIMPLEMENTED);
+  }
+  if (weights && igraph_vector_size(weights) < igraph_ecount(graph))
+    IGRAPH_ERROR("Leiden community detection: weight vector too short", IGRAPH_EINVAL);
+  if (weights && igraph_vector_any_smaller(weights, 0))
+    IGRAPH_ERROR("weights must be positive", IGRAPH_EINVAL);
+  if (resolution < 0)
+    IGRAPH_ERROR("resolution must not be negative", IGRAPH_EINVAL);
 
-  /* Clean up everything */
-  igraph_vector_destroy(&c1);
-  igraph_vector_destroy(&c2);
-  IGRAPH_FINALLY_CLEAN(2);
+  IGRAPH_CHECK(igraph_i_multilevel_graph_init(graph, weights, &g));
+  IGRAPH_FINALLY(igraph_i_multilevel_graph_destroy, &g);
 
-  return 0;
-}
+  IGRAPH_CHECK(igraph_i_multilevel_ws_init(&ws, vcount, 
+					   igraph_get_num_threads()));
+  IGRAPH_FINALLY(igraph_i_multilevel_ws_destroy, &ws);
 
-/**
- * Calculates the entropy and the mutual information for two reindexed community
- * membership vectors v1 and v2. This is needed by both Meila's and Danon's
- * community comparison measure.
- */
-int igraph_i_entropy_and_mutual_information(const igraph_vector_t* v1,
-    const igraph_vector_t* v2, double* h1, double* h2, double* mut_inf) {
-  long int i, n = igraph_vector_size(v1);
-  long int k1 = (long int)igraph_vector_max(v1)+1;
-  long int k2 = (long int)igraph_vector_max(v2)+1;
-  double *p1, *p2;
-  igraph_spmatrix_t m;
-  igraph_spmatrix_iter_t mit;
-
-  p1 = igraph_Calloc(k1, double);
-  if (p1 == 0) {
-    IGRAPH_ERROR("igraph_i_entropy_and_mutual_information failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, p1);
-  p2 = igraph_Calloc(k2, double);
-  if (p2 == 0) {
-    IGRAPH_ERROR("igraph_i_entropy_and_mutual_information failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, p2);
-
-  /* Calculate the entropy of v1 */
-  *h1 = 0.0;
-  for (i = 0; i < n; i++)
-    p1[(long int)VECTOR(*v1)[i]]++;
-  for (i = 0; i < k1; i++) {
-    p1[i] /= n;
-    *h1 -= p1[i] * log(p1[i]);
-  }
+  IGRAPH_CHECK(igraph_i_leiden_ws_init(&lws, vcount));
+  IGRAPH_FINALLY(igraph_i_leiden_ws_destroy, &lws);
 
-  /* Calculate the entropy of v2 */
-  *h2 = 0.0;
-  for (i = 0; i < n; i++)
-    p2[(long int)VECTOR(*v2)[i]]++;
-  for (i = 0; i < k2; i++) {
-    p2[i] /= n;
-    *h2 -= p2[i] * log(p2[i]);
-  }
+  IGRAPH_VECTOR_INIT_FINALLY(&level_membership, vcount);
+  IGRAPH_VECTOR_INIT_FINALLY(&result, vcount);
 
-  /* We will only need the logs of p1 and p2 from now on */
-  for (i = 0; i < k1; i++) {
-    p1[i] = log(p1[i]);
-  }
-  for (i = 0; i < k2; i++) {
-    p2[i] = log(p2[i]);
+  /* Each vertex is a vertex of the first level, in its own community */
+  for (i = 0; i < vcount; i++) {
+    VECTOR(level_membership)[i] = i;
+    VECTOR(result)[i] = i;
+    lws.part[i] = i;
   }
-
-  /* Calculate the mutual information of v1 and v2 */
-  *mut_inf = 0.0;
-  IGRAPH_CHECK(igraph_spmatrix_init(&m, k1, k2));
-  IGRAPH_FINALLY(igraph_spmatrix_destroy, &m);
-  for (i = 0; i < n; i++) {
-    IGRAPH_CHECK(igraph_spmatrix_add_e(&m,
-          (int)VECTOR(*v1)[i], (int)VECTOR(*v2)[i], 1));
+  if (memberships) {
+    IGRAPH_CHECK(igraph_matrix_resize(memberships, 0, vcount));
   }
-  IGRAPH_CHECK(igraph_spmatrix_iter_create(&mit, &m));
-  IGRAPH_FINALLY(igraph_spmatrix_iter_destroy, &mit);
-  while (!igraph_spmatrix_iter_end(&mit)) {
-    double p = mit.value / n;
-    *mut_inf += p * (log(p) - p1[mit.ri] - p2[mit.ci]);
-    igraph_spmatrix_iter_next(&mit);
+  if (modularity) {
+    igraph_vector_clear(modularity);
   }
 
-  igraph_spmatrix_iter_destroy(&mit);
-  igraph_spmatrix_destroy(&m);
-  free(p1); free(p2);
+  while (1) {
+    long int n = g.n, no_of_comms = 0, no_of_refined, moves;
+    igraph_real_t m = 0;
 
-  IGRAPH_FINALLY_CLEAN(4);
+    level++;
+    for (i = 0; i < n; i++) {
+      igraph_real_t k = 2*g.loop[i];
+      for (j = g.start[i]; j < g.start[i+1]; j++) { k += g.w[j]; }
+      ws.k[i] = k;
+      m += k;
+    }
 
-  return 0;
-}
+    /* No edges, or all weights are zero */
+    if (m == 0) {
+      q = 0;
+      break;
+    }
 
-/**
- * Implementation of the normalized mutual information (NMI) measure of
- * Danon et al. This function assumes that the community membership
- * vectors have already been normalized using igraph_reindex_communities().
- *
- * </para><para>
- * Reference: Danon L, Diaz-Guilera A, Duch J, Arenas A: Comparing community
- * structure identification. J Stat Mech P09008, 2005.
- *
- * </para><para>
- * Time complexity: O(n log(n))
- */
-int igraph_i_compare_communities_nmi(const igraph_vector_t *v1, const igraph_vector_t *v2,
-    igraph_real_t* result) {
-  double h1, h2, mut_inf;
+    IGRAPH_CHECK(igraph_i_leiden_move(&g, &ws, &lws, resolution, m, &moves));
+    q = igraph_i_leiden_quality(ws.item, n, m, resolution);
+    for (i = 0; i < n; i++) {
+      if (ws.item[i].size > 0) { no_of_comms++; }
+    }
 
-  IGRAPH_CHECK(igraph_i_entropy_and_mutual_information(v1, v2, &h1, &h2, &mut_inf));
+    /* Store the communities of this level, if they changed */
+    if (moves > 0 && (level > 1 || no_of_comms < n)) {
+      long int *map = ws.order, next = 0;
+      for (i = 0; i < n; i++) { map[i] = -1; }
+      for (i = 0; i < vcount; i++) {
+	long int c = lws.part[(long int) VECTOR(level_membership)[i]];
+	if (map[c] < 0) { map[c] = next++; }
+	VECTOR(result)[i] = map[c];
+      }
+      if (modularity) {
+	IGRAPH_CHECK(igraph_vector_push_back(modularity, q));
+      }
+      if (memberships) {
+	IGRAPH_CHECK(igraph_matrix_add_rows(memberships, 1));
+	IGRAPH_CHECK(igraph_matrix_set_row(memberships, &result, 
+					   no_of_levels));
+      }
+      no_of_levels++;
+    }
 
-  if (h1 == 0 && h2 == 0)
-    *result = 1;
-  else
-    *result = 2 * mut_inf / (h1 + h2);
+    if (no_of_comms == n) {
+      break;
+    }
+
+    /* Nothing to merge */
+    no_of_refined = igraph_i_leiden_refine(&g, &ws, &lws, resolution, m);
+    if (no_of_refined == n) {
+      break;
+    }
+
+    /* The starting communities of the next level, from the
+       communities of the refined communities */
+    for (i = 0; i < n; i++) { lws.queue[ws.memb[i]] = lws.part[i]; }
+    for (i = 0; i < n; i++) { lws.empty[i] = -1; }
+    for (i = 0, j = 0; i < no_of_refined; i++) {
+      long int c = lws.queue[i];
+      if (lws.empty[c] < 0) { lws.empty[c] = j++; }
+      lws.queue[i] = lws.empty[c];
+    }
+    for (i = 0; i < vcount; i++) {
+      VECTOR(level_membership)[i] = ws.memb[(long int) VECTOR(level_membership)[i]];
+    }
+
+    IGRAPH_CHECK(igraph_i_multilevel_shrink(&g, &ws, no_of_refined));
+    memcpy(lws.part, lws.queue, sizeof(long int) * (size_t) no_of_refined);
+
+    IGRAPH_ALLOW_INTERRUPTION();
+  }
+
+  /* If no vertices were merged, then every vertex stays in its own
+     community, we still return the modularity of that */
+  if (modularity && no_of_levels == 0) {
+    IGRAPH_CHECK(igraph_vector_push_back(modularity, q));
+  }
+
+  if (membership) {
+    IGRAPH_CHECK(igraph_vector_update(membership, &result));
+  }
+
+  igraph_vector_destroy(&result);
+  igraph_vector_destroy(&level_membership);
+  igraph_i_leiden_ws_destroy(&lws);
+  igraph_i_multilevel_ws_destroy(&ws);
+  igraph_i_multilevel_graph_destroy(&g);
+  IGRAPH_FINALLY_CLEAN(5);
+
+  return 0;
+}
+
+
+/* Contingency table of two partitions. The membership vectors are
+ * reindexed to 0..k-1, then the elements are grouped by their first
+ * community with a counting sort, and the nonzero cells of each row
+ * are collected with the help of a column-indexed mark vector. The
+ * cells of a row are consecutive in the cell vectors. Everything takes
+ * O(n) time and memory, and the first partition can be reused for
+ * comparing it with several others. */
+
+typedef struct igraph_i_contingency_t {
+  long int n, k1, k2, ncells;
+  igraph_vector_long_t memb1, memb2;
+  igraph_vector_long_t rowsums, colsums;
+  igraph_vector_long_t rowstart, order;
+  igraph_vector_long_t mark;
+  igraph_vector_long_t cellrow, cellcol, cellcount;
+} igraph_i_contingency_t;
+
+static void igraph_i_contingency_destroy(igraph_i_contingency_t *ct) {
+  igraph_vector_long_destroy(&ct->cellcount);
+  igraph_vector_long_destroy(&ct->cellcol);
+  igraph_vector_long_destroy(&ct->cellrow);
+  igraph_vector_long_destroy(&ct->mark);
+  igraph_vector_long_destroy(&ct->order);
+  igraph_vector_long_destroy(&ct->rowstart);
+  igraph_vector_long_destroy(&ct->colsums);
+  igraph_vector_long_destroy(&ct->rowsums);
+  igraph_vector_long_destroy(&ct->memb2);
+  igraph_vector_long_destroy(&ct->memb1);
+}
+
+static int igraph_i_contingency_init(igraph_i_contingency_t *ct, long int n) {
+  ct->n = n;
+  ct->k1 = ct->k2 = ct->ncells = 0;
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->memb1, n));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->memb1);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->memb2, n));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->memb2);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->rowsums, n));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->rowsums);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->colsums, n));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->colsums);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->rowstart, n+1));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->rowstart);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->order, n));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->order);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->mark, n));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->mark);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->cellrow, n));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->cellrow);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->cellcol, n));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &ct->cellcol);
+  IGRAPH_CHECK(igraph_vector_long_init(&ct->cellcount, n));
+  IGRAPH_FINALLY_CLEAN(9);
+  return 0;
+}
+
+/* Mixes the bits of a community id, for the hash table below */
+static unsigned long int igraph_i_contingency_hash(igraph_real_t x) {
+  unsigned long long h = 0;
+  if (x == 0) { x = 0; }		/* -0.0 and 0.0 are the same */
+  memcpy(&h, &x, sizeof(x) < sizeof(h) ? sizeof(x) : sizeof(h));
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return (unsigned long int) h;
+}
+
+/* Reindexes a membership vector into res, the new ids are assigned in
+ * the order of the first occurrence. If the ids are small non-negative
+ * integers (the usual case), then they are used as indices directly,
+ * otherwise an open addressing hash table is used. The number of
+ * communities is returned in k. res and mark must have at least n
+ * elements, mark is overwritten. */
+static int igraph_i_contingency_reindex(const igraph_vector_t *memb,
+					igraph_vector_long_t *res,
+					igraph_vector_long_t *mark,
+					long int *k) {
+  long int i, n = igraph_vector_size(memb);
+  igraph_bool_t direct = 1;
+
+  *k = 0;
+  for (i = 0; i < n; i++) {
+    igraph_real_t x = VECTOR(*memb)[i];
+    if (!(x >= 0 && x < n && x == (long int) x)) {
+      direct = 0;
+      break;
+    }
+  }
+
+  if (direct) {
+    igraph_vector_long_fill(mark, -1);
+    for (i = 0; i < n; i++) {
+      long int x = (long int) VECTOR(*memb)[i];
+      if (VECTOR(*mark)[x] < 0) {
+	VECTOR(*mark)[x] = (*k)++;
+      }
+      VECTOR(*res)[i] = VECTOR(*mark)[x];
+    }
+  } else {
+    unsigned long int size = 2, mask, h;
+    igraph_real_t *keys;
+    long int *vals;
+    while (size < 2 * (unsigned long int) n) { size *= 2; }
+    mask = size - 1;
+    keys = igraph_Calloc(size, igraph_real_t);
+    if (keys == 0) {
+      IGRAPH_ERROR("Cannot compare communities", IGRAPH_ENOMEM);
+    }
+    IGRAPH_FINALLY(igraph_free, keys);
+    vals = igraph_Calloc(size, long int);
+    if (vals == 0) {
+      IGRAPH_ERROR("Cannot compare communities", IGRAPH_ENOMEM);
+    }
+    IGRAPH_FINALLY(igraph_free, vals);
+    for (h = 0; h < size; h++) { vals[h] = -1; }
+    for (i = 0; i < n; i++) {
+      igraph_real_t x = VECTOR(*memb)[i];
+      h = igraph_i_contingency_hash(x) & mask;
+      while (vals[h] >= 0 && keys[h] != x) {
+	h = (h + 1) & mask;
+      }
+      if (vals[h] < 0) {
+	keys[h] = x;
+	vals[h] = (*k)++;
+      }
+      VECTOR(*res)[i] = vals[h];
+    }
+    igraph_free(vals);
+    igraph_free(keys);
+    IGRAPH_FINALLY_CLEAN(2);
+  }
+
+  return 0;
+}
+
+/* Sets the first partition, and sorts the elements by it */
+static int igraph_i_contingency_set_first(igraph_i_contingency_t *ct,
+					  const igraph_vector_t *comm) {
+  long int i, n = ct->n;
+
+  IGRAPH_CHECK(igraph_i_contingency_reindex(comm, &ct->memb1, &ct->mark,
+					    &ct->k1));
+  for (i = 0; i < ct->k1; i++) {
+    VECTOR(ct->rowsums)[i] = 0;
+  }
+  for (i = 0; i < n; i++) {
+    VECTOR(ct->rowsums)[ VECTOR(ct->memb1)[i] ] += 1;
+  }
+  VECTOR(ct->rowstart)[0] = 0;
+  for (i = 0; i < ct->k1; i++) {
+    VECTOR(ct->rowstart)[i+1] = VECTOR(ct->rowstart)[i] +
+      VECTOR(ct->rowsums)[i];
+  }
+  /* use mark as the insertion position of each row */
+  for (i = 0; i < ct->k1; i++) {
+    VECTOR(ct->mark)[i] = VECTOR(ct->rowstart)[i];
+  }
+  for (i = 0; i < n; i++) {
+    long int r = VECTOR(ct->memb1)[i];
+    VECTOR(ct->order)[ VECTOR(ct->mark)[r]++ ] = i;
+  }
+
+  return 0;
+}
 
-  return IGRAPH_SUCCESS;
+/* Sets the second partition, and collects the nonzero cells */
+static int igraph_i_contingency_set_second(igraph_i_contingency_t *ct,
+					   const igraph_vector_t *comm) {
+  long int i, r, n = ct->n, ncells = 0;
+  long int *memb2, *mark, *order, *rowstart;
+  long int *cellrow, *cellcol, *cellcount;
+
+  IGRAPH_CHECK(igraph_i_contingency_reindex(comm, &ct->memb2, &ct->mark,
+					    &ct->k2));
+  for (i = 0; i < ct->k2; i++) {
+    VECTOR(ct->colsums)[i] = 0;
+    VECTOR(ct->mark)[i] = -1;
+  }
+  for (i = 0; i < n; i++) {
+    VECTOR(ct->colsums)[ VECTOR(ct->memb2)[i] ] += 1;
+  }
+
+  memb2 = VECTOR(ct->memb2);
+  mark = VECTOR(ct->mark);
+  order = VECTOR(ct->order);
+  rowstart = VECTOR(ct->rowstart);
+  cellrow = VECTOR(ct->cellrow);
+  cellcol = VECTOR(ct->cellcol);
+  cellcount = VECTOR(ct->cellcount);
+  for (r = 0; r < ct->k1; r++) {
+    long int first = ncells;
+    for (i = rowstart[r]; i < rowstart[r+1]; i++) {
+      long int c = memb2[ order[i] ];
+      if (mark[c] < first) {
+	mark[c] = ncells;
+	cellrow[ncells] = r;
+	cellcol[ncells] = c;
+	cellcount[ncells] = 0;
+	ncells++;
+      }
+      cellcount[ mark[c] ] += 1;
+    }
+  }
+  ct->ncells = ncells;
+
+  return 0;
 }
 
 /**
- * Implementation of the variation of information metric (VI) of
- * Meila et al. This function assumes that the community membership
- * vectors have already been normalized using igraph_reindex_communities().
- *
- * </para><para>
- * Reference: Meila M: Comparing clusterings by the variation of information.
- * In: Schölkopf B, Warmuth MK (eds.). Learning Theory and Kernel Machines:
- * 16th Annual Conference on Computational Learning Theory and 7th Kernel
- * Workshop, COLT/Kernel 2003, Washington, DC, USA. Lecture Notes in Computer
- * Science, vol. 2777, Springer, 2003. ISBN: 978-3-540-40720-1.
- *
- * </para><para>
- * Time complexity: O(n log(n))
+ * Calculates the entropy and the mutual information for the two
+ * partitions of a contingency table. This is needed by both Meila's
+ * and Danon's community comparison measure.
  */
-int igraph_i_compare_communities_vi(const igraph_vector_t *v1, const igraph_vector_t *v2,
-    igraph_real_t* result) {
-  double h1, h2, mut_inf;
+static void igraph_i_entropy_and_mutual_information(
+	const igraph_i_contingency_t *ct, double* h1, double* h2, 
+	double* mut_inf) {
+  long int i;
+  double n = ct->n, p;
 
-  IGRAPH_CHECK(igraph_i_entropy_and_mutual_information(v1, v2, &h1, &h2, &mut_inf));
-  *result = h1 + h2 - 2*mut_inf;
+  *h1 = 0.0;
+  for (i = 0; i < ct->k1; i++) {
+    p = VECTOR(ct->rowsums)[i] / n;
+    *h1 -= p * log(p);
+  }
+  *h2 = 0.0;
+  for (i = 0; i < ct->k2; i++) {
+    p = VECTOR(ct->colsums)[i] / n;
+    *h2 -= p * log(p);
+  }
 
-  return IGRAPH_SUCCESS;
+  *mut_inf = 0.0;
+  for (i = 0; i < ct->ncells; i++) {
+    p = VECTOR(ct->cellcount)[i] / n;
+    *mut_inf += p * (log(p) - 
+		     log(VECTOR(ct->rowsums)[ VECTOR(ct->cellrow)[i] ] / n) -
+		     log(VECTOR(ct->colsums)[ VECTOR(ct->cellcol)[i] ] / n));
+  }
 }
 
 /**
- * \brief Calculates the confusion matrix for two clusterings.
- *
- * </para><para>
- * This function assumes that the community membership vectors have already
- * been normalized using igraph_reindex_communities().
+ * Implementation of the normalized mutual information (NMI) measure of
+ * Danon et al.
  *
  * </para><para>
- * Time complexity: O(n log(max(k1, k2))), where n is the number of vertices, k1
- * and k2 are the number of clusters in each of the clusterings.
+ * Reference: Danon L, Diaz-Guilera A, Duch J, Arenas A: Comparing community
+ * structure identification. J Stat Mech P09008, 2005.
  */
-int igraph_i_confusion_matrix(const igraph_vector_t *v1, const igraph_vector_t *v2,
-    igraph_spmatrix_t *m) {
-  long int k1 = (long int)igraph_vector_max(v1)+1;
-  long int k2 = (long int)igraph_vector_max(v2)+1;
-  long int i, n = igraph_vector_size(v1);
+static igraph_real_t igraph_i_compare_communities_nmi(
+	const igraph_i_contingency_t *ct) {
+  double h1, h2, mut_inf;
 
-  IGRAPH_CHECK(igraph_spmatrix_resize(m, k1, k2));
-  for (i = 0; i < n; i++) {
-    IGRAPH_CHECK(igraph_spmatrix_add_e(m,
-          (int)VECTOR(*v1)[i], (int)VECTOR(*v2)[i], 1));
-  }
+  igraph_i_entropy_and_mutual_information(ct, &h1, &h2, &mut_inf);
 
-  return IGRAPH_SUCCESS;
+  if (h1 == 0 && h2 == 0)
+    return 1;
+  else
+    return 2 * mut_inf / (h1 + h2);
 }
 
 /**
- * Implementation of the split-join distance of van Dongen.
+ * Implementation of the variation of information metric (VI) of
+ * Meila et al.
  *
  * </para><para>
- * This function assumes that the community membership vectors have already
- * been normalized using igraph_reindex_communities().
+ * Reference: Meila M: Comparing clusterings by the variation of information.
+ * In: Schölkopf B, Warmuth MK (eds.). Learning Theory and Kernel Machines:
+ * 16th Annual Conference on Computational Learning Theory and 7th Kernel
+ * Workshop, COLT/Kernel 2003, Washington, DC, USA. Lecture Notes in Computer
+ * Science, vol. 2777, Springer, 2003. ISBN: 978-3-540-40720-1.
+ */
+static igraph_real_t igraph_i_compare_communities_vi(
+	const igraph_i_contingency_t *ct) {
+  double h1, h2, mut_inf;
+
+  igraph_i_entropy_and_mutual_information(ct, &h1, &h2, &mut_inf);
+  return h1 + h2 - 2*mut_inf;
+}
+
+/**
+ * Implementation of the split-join distance of van Dongen. The mark
+ * vector of the contingency table is overwritten.
  *
  * </para><para>
  * Reference: van Dongen S: Performance criteria for graph clustering and Markov
  * cluster experiments. Technical Report INS-R0012, National Research Institute
  * for Mathematics and Computer Science in the Netherlands, Amsterdam, May 2000.
- *
- * </para><para>
- * Time complexity: O(n log(max(k1, k2))), where n is the number of vertices, k1
- * and k2 are the number of clusters in each of the clusterings.
  */
-int igraph_i_split_join_distance(const igraph_vector_t *v1, const igraph_vector_t *v2,
+static void igraph_i_split_join_distance(igraph_i_contingency_t *ct,
     igraph_integer_t* distance12, igraph_integer_t* distance21) {
-  long int n = igraph_vector_size(v1);
-  igraph_vector_t rowmax, colmax;
-  igraph_spmatrix_t m;
-  igraph_spmatrix_iter_t mit;
-
-  /* Calculate the confusion matrix */
-  IGRAPH_CHECK(igraph_spmatrix_init(&m, 1, 1));
-  IGRAPH_FINALLY(igraph_spmatrix_destroy, &m);
-  IGRAPH_CHECK(igraph_i_confusion_matrix(v1, v2, &m));
-
-  /* Initialize vectors that will store the row/columnwise maxima */
-  IGRAPH_VECTOR_INIT_FINALLY(&rowmax, igraph_spmatrix_nrow(&m));
-  IGRAPH_VECTOR_INIT_FINALLY(&colmax, igraph_spmatrix_ncol(&m));
-
-  /* Find the row/columnwise maxima */
-  IGRAPH_CHECK(igraph_spmatrix_iter_create(&mit, &m));
-  IGRAPH_FINALLY(igraph_spmatrix_iter_destroy, &mit);
-  while (!igraph_spmatrix_iter_end(&mit)) {
-    if (mit.value > VECTOR(rowmax)[mit.ri])
-      VECTOR(rowmax)[mit.ri] = mit.value;
-    if (mit.value > VECTOR(colmax)[mit.ci])
-      VECTOR(colmax)[mit.ci] = mit.value;
-    igraph_spmatrix_iter_next(&mit);
-  }
-  igraph_spmatrix_iter_destroy(&mit);
-  IGRAPH_FINALLY_CLEAN(1);
-
-  /* Calculate the distances */
-  *distance12 = (igraph_integer_t) (n - igraph_vector_sum(&rowmax));
-  *distance21 = (igraph_integer_t) (n - igraph_vector_sum(&colmax));
+  long int i, rowmaxsum = 0, colmaxsum = 0, rowmax = 0;
 
-  igraph_vector_destroy(&rowmax);
-  igraph_vector_destroy(&colmax);
-  igraph_spmatrix_destroy(&m);
-  IGRAPH_FINALLY_CLEAN(3);
+  /* The cells of each row are consecutive */
+  for (i = 0; i < ct->k2; i++) {
+    VECTOR(ct->mark)[i] = 0;
+  }
+  for (i = 0; i < ct->ncells; i++) {
+    long int c = VECTOR(ct->cellcol)[i], v = VECTOR(ct->cellcount)[i];
+    if (i > 0 && VECTOR(ct->cellrow)[i] != VECTOR(ct->cellrow)[i-1]) {
+      rowmaxsum += rowmax;
+      rowmax = 0;
+    }
+    if (v > rowmax) { rowmax = v; }
+    if (v > VECTOR(ct->mark)[c]) { VECTOR(ct->mark)[c] = v; }
+  }
+  rowmaxsum += rowmax;
+  for (i = 0; i < ct->k2; i++) {
+    colmaxsum += VECTOR(ct->mark)[i];
+  }
 
-  return IGRAPH_SUCCESS;
+  *distance12 = (igraph_integer_t) (ct->n - rowmaxsum);
+  *distance21 = (igraph_integer_t) (ct->n - colmaxsum);
 }
 
 /**
  * Implementation of the adjusted and unadjusted Rand indices.
  *
  * </para><para>
- * This function assumes that the community membership vectors have already
- * been normalized using igraph_reindex_communities().
- *
- * </para><para>
  * References:
  *
  * </para><para>
@@ -3457,25 +4360,13 @@ int igraph_i_split_join_distance(const igraph_vector_t *v1, const igraph_vector_
  * </para><para>
  * Hubert L and Arabie P: Comparing partitions. Journal of Classification
  * 2:193-218, 1985.
- *
- * </para><para>
- * Time complexity: O(n log(max(k1, k2))), where n is the number of vertices, k1
- * and k2 are the number of clusters in each of the clusterings.
  */
-int igraph_i_compare_communities_rand(const igraph_vector_t *v1,
-    const igraph_vector_t *v2, igraph_real_t *result, igraph_bool_t adjust) {
-  igraph_spmatrix_t m;
-  igraph_spmatrix_iter_t mit;
-  igraph_vector_t rowsums, colsums;
-  long int i, nrow, ncol;
-  double rand, n;
+static igraph_real_t igraph_i_compare_communities_rand(
+	const igraph_i_contingency_t *ct, igraph_bool_t adjust) {
+  long int i;
+  double rand, n = ct->n;
   double frac_pairs_in_1, frac_pairs_in_2;
 
-  /* Calculate the confusion matrix */
-  IGRAPH_CHECK(igraph_spmatrix_init(&m, 1, 1));
-  IGRAPH_FINALLY(igraph_spmatrix_destroy, &m);
-  IGRAPH_CHECK(igraph_i_confusion_matrix(v1, v2, &m));
-
   /* The unadjusted Rand index is defined as (a+d) / (a+b+c+d), where:
    *
    * - a is the number of pairs in the same cluster both in v1 and v2. This
@@ -3505,32 +4396,21 @@ int igraph_i_compare_communities_rand(const igraph_vector_t *v1,
    *   + sum( n(i,j)/n * (n(i,j)-1)/(n-1) ) * 2
    */
 
-  /* Calculate row and column sums */
-  nrow = igraph_spmatrix_nrow(&m);
-  ncol = igraph_spmatrix_ncol(&m);
-  n = igraph_vector_size(v1) + 0.0;
-  IGRAPH_VECTOR_INIT_FINALLY(&rowsums, nrow);
-  IGRAPH_VECTOR_INIT_FINALLY(&colsums, ncol);
-  IGRAPH_CHECK(igraph_spmatrix_rowsums(&m, &rowsums));
-  IGRAPH_CHECK(igraph_spmatrix_colsums(&m, &colsums));
-
   /* Start calculating the unadjusted Rand index */
   rand = 0.0;
-  IGRAPH_CHECK(igraph_spmatrix_iter_create(&mit, &m));
-  IGRAPH_FINALLY(igraph_spmatrix_iter_destroy, &mit);
-  while (!igraph_spmatrix_iter_end(&mit)) {
-    rand += (mit.value / n) * (mit.value-1) / (n-1);
-    igraph_spmatrix_iter_next(&mit);
+  for (i = 0; i < ct->ncells; i++) {
+    double v = VECTOR(ct->cellcount)[i];
+    rand += (v / n) * (v-1) / (n-1);
   }
-  igraph_spmatrix_iter_destroy(&mit);
-  IGRAPH_FINALLY_CLEAN(1);
 
   frac_pairs_in_1 = frac_pairs_in_2 = 0.0;
-  for (i = 0; i < nrow; i++) {
-    frac_pairs_in_1 += (VECTOR(rowsums)[i] / n) * (VECTOR(rowsums)[i]-1) / (n-1);
+  for (i = 0; i < ct->k1; i++) {
+    double v = VECTOR(ct->rowsums)[i];
+    frac_pairs_in_1 += (v / n) * (v-1) / (n-1);
   }
-  for (i = 0; i < ncol; i++) {
-    frac_pairs_in_2 += (VECTOR(colsums)[i] / n) * (VECTOR(colsums)[i]-1) / (n-1);
+  for (i = 0; i < ct->k2; i++) {
+    double v = VECTOR(ct->colsums)[i];
+    frac_pairs_in_2 += (v / n) * (v-1) / (n-1);
   }
 
   rand = 1.0 + 2 * rand - frac_pairs_in_1 - frac_pairs_in_2;
@@ -3541,12 +4421,260 @@ int igraph_i_compare_communities_rand(const igraph_vector_t *v1,
     rand = (rand - expected) / (1 - expected);
   }
 
-  igraph_vector_destroy(&rowsums);
-  igraph_vector_destroy(&colsums);
-  igraph_spmatrix_destroy(&m);
-  IGRAPH_FINALLY_CLEAN(3);
+  return rand;
+}
+
+/* Calculates the given measure from a contingency table */
+static int igraph_i_compare_communities_ct(igraph_i_contingency_t *ct,
+    igraph_real_t *result, igraph_community_comparison_t method) {
+
+  switch (method) {
+    case IGRAPH_COMMCMP_VI:
+      *result = igraph_i_compare_communities_vi(ct);
+      break;
+
+    case IGRAPH_COMMCMP_NMI:
+      *result = igraph_i_compare_communities_nmi(ct);
+      break;
+
+    case IGRAPH_COMMCMP_SPLIT_JOIN:
+      {
+        igraph_integer_t d12, d21;
+        igraph_i_split_join_distance(ct, &d12, &d21);
+        *result = d12 + d21;
+      }
+      break;
+
+    case IGRAPH_COMMCMP_RAND:
+    case IGRAPH_COMMCMP_ADJUSTED_RAND:
+      *result = igraph_i_compare_communities_rand(ct,
+            method == IGRAPH_COMMCMP_ADJUSTED_RAND);
+      break;
+
+    default:
+      IGRAPH_ERROR("unknown community comparison method", IGRAPH_EINVAL);
+  }
+
+  return 0;
+}
+
+/**
+ * \ingroup communities
+ * \function igraph_compare_communities
+ * \brief Compares community structures using various metrics
+ *
+ * This function assesses the distance between two community structures
+ * using the variation of information (VI) metric of Meila (2003), the
+ * normalized mutual information (NMI) of Danon et al (2005), the
+ * split-join distance of van Dongen (2000), the Rand index of Rand (1971)
+ * or the adjusted Rand index of Hubert and Arabie (1985).
+ *
+ * </para><para>
+ * The community ids can be arbitrary numbers, they do not need to be
+ * consecutive. Only the nonzero cells of the contingency table of the
+ * two community structures are stored, in a table built by
+ * counting sort, so the two community structures can have any
+ * number of communities.
+ *
+ * </para><para>
+ * References:
+ *
+ * </para><para>
+ * Meila M: Comparing clusterings by the variation of information.
+ * In: Schölkopf B, Warmuth MK (eds.). Learning Theory and Kernel Machines:
+ * 16th Annual Conference on Computational Learning Theory and 7th Kernel
+ * Workshop, COLT/Kernel 2003, Washington, DC, USA. Lecture Notes in Computer
+ * Science, vol. 2777, Springer, 2003. ISBN: 978-3-540-40720-1.
+ *
+ * </para><para>
+ * Danon L, Diaz-Guilera A, Duch J, Arenas A: Comparing community structure
+ * identification. J Stat Mech P09008, 2005.
+ *
+ * </para><para>
+ * van Dongen S: Performance criteria for graph clustering and Markov cluster
+ * experiments. Technical Report INS-R0012, National Research Institute for
+ * Mathematics and Computer Science in the Netherlands, Amsterdam, May 2000.
+ * 
+ * </para><para>
+ * Rand WM: Objective criteria for the evaluation of clustering methods.
+ * J Am Stat Assoc 66(336):846-850, 1971.
+ *
+ * </para><para>
+ * Hubert L and Arabie P: Comparing partitions. Journal of Classification
+ * 2:193-218, 1985.
+ *
+ * \param  comm1   the membership vector of the first community structure
+ * \param  comm2   the membership vector of the second community structure
+ * \param  result  the result is stored here.
+ * \param  method  the comparison method to use. \c IGRAPH_COMMCMP_VI
+ *                 selects the variation of information (VI) metric of
+ *                 Meila (2003), \c IGRAPH_COMMCMP_NMI selects the
+ *                 normalized mutual information measure proposed by
+ *                 Danon et al (2005), \c IGRAPH_COMMCMP_SPLIT_JOIN
+ *                 selects the split-join distance of van Dongen (2000),
+ *                 \c IGRAPH_COMMCMP_RAND selects the unadjusted Rand
+ *                 index (1971) and \c IGRAPH_COMMCMP_ADJUSTED_RAND
+ *                 selects the adjusted Rand index.
+ *
+ * \return  Error code.
+ *
+ * \sa \ref igraph_compare_communities_batch() to compare a community
+ * structure to many others.
+ *
+ * Time complexity: O(n), the number of elements, in the expected
+ * case.
+ */
+int igraph_compare_communities(const igraph_vector_t *comm1,
+    const igraph_vector_t *comm2, igraph_real_t* result,
+    igraph_community_comparison_t method) {
+  igraph_i_contingency_t ct;
+
+  if (igraph_vector_size(comm1) != igraph_vector_size(comm2)) {
+    IGRAPH_ERROR("community membership vectors have different lengths", IGRAPH_EINVAL);
+  }
+
+  IGRAPH_CHECK(igraph_i_contingency_init(&ct, igraph_vector_size(comm1)));
+  IGRAPH_FINALLY(igraph_i_contingency_destroy, &ct);
 
-  *result = rand;
+  IGRAPH_CHECK(igraph_i_contingency_set_first(&ct, comm1));
+  IGRAPH_CHECK(igraph_i_contingency_set_second(&ct, comm2));
+  IGRAPH_CHECK(igraph_i_compare_communities_ct(&ct, result, method));
 
-  return IGRAPH_SUCCESS;
+  igraph_i_contingency_destroy(&ct);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
+}
+
+/**
+ * \ingroup communities
+ * \function igraph_compare_communities_batch
+ * \brief Compares a community structure to many others
+ *
+ * This is the same as calling \ref igraph_compare_communities() for
+ * each element of \p comms, but the first community structure is
+ * processed only once, and the memory is reused between the
+ * comparisons.
+ *
+ * \param  comm     the membership vector of the reference community
+ *                  structure.
+ * \param  comms    a pointer vector of membership vectors
+ *                  (<type>igraph_vector_t</type> objects), the community
+ *                  structures to compare to \p comm. They must have the
+ *                  same length as \p comm.
+ * \param  result   an initialized vector, the results are stored here,
+ *                  the ith element belongs to the ith element of
+ *                  \p comms. It will be resized as needed.
+ * \param  method   the comparison method to use, see \ref
+ *                  igraph_compare_communities() for the possible
+ *                  values. For \c IGRAPH_COMMCMP_SPLIT_JOIN the sum of
+ *                  the two projection distances is returned.
+ *
+ * \return  Error code.
+ *
+ * Time complexity: O(n*m), n is the number of elements, m is the
+ * number of community structures in \p comms, in the expected case.
+ */
+int igraph_compare_communities_batch(const igraph_vector_t *comm,
+    const igraph_vector_ptr_t *comms, igraph_vector_t *result,
+    igraph_community_comparison_t method) {
+  long int i, n = igraph_vector_size(comm);
+  long int no_of_comms = igraph_vector_ptr_size(comms);
+  igraph_i_contingency_t ct;
+
+  for (i = 0; i < no_of_comms; i++) {
+    if (igraph_vector_size(VECTOR(*comms)[i]) != n) {
+      IGRAPH_ERROR("community membership vectors have different lengths", IGRAPH_EINVAL);
+    }
+  }
+
+  IGRAPH_CHECK(igraph_vector_resize(result, no_of_comms));
+  IGRAPH_CHECK(igraph_i_contingency_init(&ct, n));
+  IGRAPH_FINALLY(igraph_i_contingency_destroy, &ct);
+
+  IGRAPH_CHECK(igraph_i_contingency_set_first(&ct, comm));
+  for (i = 0; i < no_of_comms; i++) {
+    IGRAPH_ALLOW_INTERRUPTION();
+    IGRAPH_CHECK(igraph_i_contingency_set_second(&ct, VECTOR(*comms)[i]));
+    IGRAPH_CHECK(igraph_i_compare_communities_ct(&ct, &VECTOR(*result)[i],
+						 method));
+  }
+
+  igraph_i_contingency_destroy(&ct);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
+}
+
+/**
+ * \ingroup communities
+ * \function igraph_split_join_distance
+ * \brief Calculates the split-join distance of two community structures
+ *
+ * The split-join distance between partitions A and B is the sum of the
+ * projection distance of A from B and the projection distance of B from
+ * A. The projection distance is an asymmetric measure and it is defined
+ * as follows:
+ *
+ * </para><para>
+ * First, each set in partition A is evaluated against all sets in partition
+ * B. For each set in partition A, the best matching set in partition B is
+ * found and the overlap size is calculated. (Matching is quantified by the
+ * size of the overlap between the two sets). Then, the maximal overlap sizes
+ * for each set in A are summed together and subtracted from the number of
+ * elements in A.
+ *
+ * </para><para>
+ * The split-join distance will be returned in two arguments, \c distance12
+ * will contain the projection distance of the first partition from the
+ * second, while \c distance21 will be the projection distance of the second
+ * partition from the first. This makes it easier to detect whether a
+ * partition is a subpartition of the other, since in this case, the
+ * corresponding distance will be zero.
+ *
+ * </para><para>
+ * Reference:
+ *
+ * </para><para>
+ * van Dongen S: Performance criteria for graph clustering and Markov cluster
+ * experiments. Technical Report INS-R0012, National Research Institute for
+ * Mathematics and Computer Science in the Netherlands, Amsterdam, May 2000.
+ * 
+ * \param  comm1       the membership vector of the first community structure
+ * \param  comm2       the membership vector of the second community structure
+ * \param  distance12  pointer to an \c igraph_integer_t, the projection distance
+ *                     of the first community structure from the second one will be
+ *                     returned here.
+ * \param  distance21  pointer to an \c igraph_integer_t, the projection distance
+ *                     of the second community structure from the first one will be
+ *                     returned here.
+ * \return  Error code.
+ *
+ * \see \ref igraph_compare_communities() with the \c IGRAPH_COMMCMP_SPLIT_JOIN
+ * method if you are not interested in the individual distances but only the sum
+ * of them.
+ *
+ * Time complexity: O(n), the number of elements, in the expected
+ * case.
+ */
+int igraph_split_join_distance(const igraph_vector_t *comm1,
+    const igraph_vector_t *comm2, igraph_integer_t *distance12,
+    igraph_integer_t *distance21) {
+  igraph_i_contingency_t ct;
+
+  if (igraph_vector_size(comm1) != igraph_vector_size(comm2)) {
+    IGRAPH_ERROR("community membership vectors have different lengths", IGRAPH_EINVAL);
+  }
+
+  IGRAPH_CHECK(igraph_i_contingency_init(&ct, igraph_vector_size(comm1)));
+  IGRAPH_FINALLY(igraph_i_contingency_destroy, &ct);
+
+  IGRAPH_CHECK(igraph_i_contingency_set_first(&ct, comm1));
+  IGRAPH_CHECK(igraph_i_contingency_set_second(&ct, comm2));
+  igraph_i_split_join_distance(&ct, distance12, distance21);
+
+  igraph_i_contingency_destroy(&ct);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
 }
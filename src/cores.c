@@ -24,6 +24,7 @@
 #include "igraph_community.h"
 #include "igraph_memory.h"
 #include "igraph_interface.h"
+#include "igraph_adjlist.h"
 #include "igraph_iterators.h"
 #include "config.h"
 
@@ -62,7 +63,7 @@ int igraph_coreness(const igraph_t *graph, igraph_vector_t *cores,
   long int *bin, *vert, *pos;
   long int maxdeg;
   long int i, j=0;
-  igraph_vector_t neis;
+  igraph_csr_t csr;
   igraph_neimode_t omode;
   
   if (mode != IGRAPH_ALL && mode != IGRAPH_OUT && mode != IGRAPH_IN) {
@@ -125,12 +126,14 @@ int igraph_coreness(const igraph_t *graph, igraph_vector_t *cores,
   bin[0]=0;
 
   /* this is the main algorithm */
-  IGRAPH_VECTOR_INIT_FINALLY(&neis, maxdeg);
+  IGRAPH_CHECK(igraph_csr_borrow(graph, &csr, omode));
+  IGRAPH_FINALLY(igraph_csr_return, &csr);
   for (i=0; i<no_of_nodes; i++) {
     long int v=vert[i];
-    IGRAPH_CHECK(igraph_neighbors(graph, &neis, (igraph_integer_t) v, omode));
-    for (j=0; j<igraph_vector_size(&neis); j++) {
-      long int u=(long int) VECTOR(neis)[j];
+    long int n=igraph_csr_size(&csr, v);
+    igraph_integer_t *neis=igraph_csr_adj(&csr, v);
+    for (j=0; j<n; j++) {
+      long int u=(long int) neis[j];
       if (VECTOR(*cores)[u] > VECTOR(*cores)[v]) {
 	long int du=(long int) VECTOR(*cores)[u];
 	long int pu=pos[u];
@@ -148,7 +151,7 @@ int igraph_coreness(const igraph_t *graph, igraph_vector_t *cores,
     }
   }
   
-  igraph_vector_destroy(&neis);
+  igraph_csr_return(&csr);
   IGRAPH_FINALLY_CLEAN(1);
 
   igraph_free(bin);
@@ -23,104 +23,456 @@
 */
 
 #include "igraph_datatype.h"
-#include "igraph_dqueue.h"
 #include "igraph_iterators.h"
 #include "igraph_interrupt_internal.h"
 #include "igraph_vector.h"
 #include "igraph_interface.h"
 #include "igraph_adjlist.h"
+#include "igraph_memory.h"
+#include "igraph_progress.h"
+#include "igraph_threading_internal.h"
+#include "igraph_types_internal.h"
+#include "structural_properties_internal.h"
 
-int igraph_i_eccentricity(const igraph_t *graph,
-			  igraph_vector_t *res,
-			  igraph_vs_t vids,
-			  igraph_neimode_t mode,
-			  const igraph_adjlist_t *adjlist) {
+#include <string.h>
 
-  int no_of_nodes=igraph_vcount(graph);
-  igraph_dqueue_long_t q;
-  igraph_vit_t vit;
-  igraph_vector_int_t counted;
-  int i, mark=1;
-  igraph_vector_t vneis;
-  igraph_vector_int_t *neis;
 
-  IGRAPH_CHECK(igraph_dqueue_long_init(&q, 100));
-  IGRAPH_FINALLY(igraph_dqueue_long_destroy, &q);
-  
-  IGRAPH_CHECK(igraph_vit_create(graph, vids, &vit));
-  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+/* 
+ * Shortest paths from many sources. The sources are processed in
+ * batches, and the sources of a batch are divided among 'nthreads'
+ * threads. Every thread has its own O(|V|) work buffers. No distance
+ * matrix is created, instead, after each source, the callback is
+ * called from the thread that did the search. It gets
+ * - the index of the source in 'sources' and the source itself,
+ * - the reached vertices in 'order', in the order they were reached,
+ *   so by non-decreasing distance, the source itself is the first,
+ * - the distances in 'dist', this is indexed by vertex ids, and 
+ *   only valid for the reached vertices.
+ * The buffers are reused for the next source, so the callback must
+ * not keep them. The callback cannot fail, it must not call igraph
+ * functions that might raise an error, or allocate memory, and it
+ * should write only to memory that belongs to its thread, or its
+ * source. Progress is reported (if 'message' is not a null pointer)
+ * and interruption is checked between the batches, by the main
+ * thread.
+ *
+ * The weights must be non-negative, this is not checked here. If
+ * 'weights' is a null pointer, then breadth-first search is used.
+ */
 
-  IGRAPH_CHECK(igraph_vector_int_init(&counted, no_of_nodes));
-  IGRAPH_FINALLY(igraph_vector_int_destroy, &counted);
+#define IGRAPH_I_SSSP_BATCH 64		/* sources per thread in a batch */
 
-  if (!adjlist) {
-    IGRAPH_VECTOR_INIT_FINALLY(&vneis, 0);
+typedef struct igraph_i_sssp_ws_t {
+  int nthreads;
+  igraph_real_t *dist;		/* nthreads * no_of_nodes */
+  long int *order;		/* nthreads * no_of_nodes */
+  igraph_2wheap_t *heaps;	/* weighted only */
+  int no_of_heaps;
+} igraph_i_sssp_ws_t;
+
+static void igraph_i_sssp_ws_destroy(igraph_i_sssp_ws_t *ws) {
+  int i;
+  for (i=0; i<ws->no_of_heaps; i++) {
+    igraph_2wheap_destroy(&ws->heaps[i]);
   }
+  if (ws->heaps) { igraph_Free(ws->heaps); }
+  if (ws->dist) { igraph_Free(ws->dist); }
+  if (ws->order) { igraph_Free(ws->order); }
+}
 
-  IGRAPH_CHECK(igraph_vector_resize(res, IGRAPH_VIT_SIZE(vit)));
-  igraph_vector_fill(res, -1);
+/* Breadth-first search, unreached vertices have negative distance,
+   and this is restored before returning. */
 
-  for (i=0, IGRAPH_VIT_RESET(vit); 
-       !IGRAPH_VIT_END(vit); 
-       IGRAPH_VIT_NEXT(vit), mark++, i++) {
+static long int igraph_i_sssp_bfs(const igraph_csr_t *csr, 
+				  long int source, igraph_real_t *dist, 
+				  long int *order) {
+  long int head=0, tail=0, j, n;
+  order[tail++]=source;
+  dist[source]=0;
+  while (head < tail) {
+    long int actnode=order[head++];
+    const igraph_integer_t *neis=igraph_csr_adj(csr, actnode);
+    n=igraph_csr_size(csr, actnode);
+    for (j=0; j<n; j++) {
+      long int neighbor=(long int) neis[j];
+      if (dist[neighbor] < 0) {
+	dist[neighbor]=dist[actnode]+1;
+	order[tail++]=neighbor;
+      }
+    }
+  }
+  return tail;
+}
 
-    long int source;
-    source=IGRAPH_VIT_GET(vit);
-    IGRAPH_CHECK(igraph_dqueue_long_push(&q, source));
-    IGRAPH_CHECK(igraph_dqueue_long_push(&q, 0));
-    VECTOR(counted)[source]=mark;
-    
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_long_empty(&q)) {
-      long int act=igraph_dqueue_long_pop(&q);
-      long int dist=igraph_dqueue_long_pop(&q);
-      int j, n;
-
-      if (dist > VECTOR(*res)[i]) {
-	VECTOR(*res)[i]=dist;
+/* Dijkstra's algorithm, the same as in
+   igraph_shortest_paths_dijkstra(), but the heap must be able to
+   hold all vertices without reallocation. For directed graphs in
+   'all' mode the out-edges are scanned first, then the in-edges, in
+   'csr2', this is the order of the incidence list. */
+
+static long int igraph_i_sssp_dijkstra(const igraph_csr_t *csr,
+				       const igraph_csr_t *csr2,
+				       const igraph_vector_t *weights,
+				       igraph_2wheap_t *Q, long int source, 
+				       igraph_real_t *dist, long int *order) {
+  long int count=0, j, nlen;
+  igraph_2wheap_clear(Q);
+  igraph_2wheap_push_with_index(Q, source, -1.0);
+  while (!igraph_2wheap_empty(Q)) {
+    long int minnei=igraph_2wheap_max_index(Q);
+    igraph_real_t mindist=-igraph_2wheap_deactivate_max(Q);
+    const igraph_csr_t *act;
+
+    dist[minnei]=mindist-1.0;
+    order[count++]=minnei;
+
+    for (act=csr; act; act= act == csr ? csr2 : 0) {
+      const igraph_integer_t *neis=igraph_csr_adj(act, minnei);
+      const igraph_integer_t *edges=igraph_csr_inc(act, minnei);
+      nlen=igraph_csr_size(act, minnei);
+      for (j=0; j<nlen; j++) {
+	long int edge=(long int) edges[j];
+	long int tto=(long int) neis[j];
+	igraph_real_t altdist=mindist + VECTOR(*weights)[edge];
+	igraph_bool_t active=igraph_2wheap_has_active(Q, tto);
+	igraph_bool_t has=igraph_2wheap_has_elem(Q, tto);
+	igraph_real_t curdist= active ? -igraph_2wheap_get(Q, tto) : 0.0;
+	if (!has) {
+	  /* This is the first non-infinite distance */
+	  igraph_2wheap_push_with_index(Q, tto, -altdist);
+	} else if (altdist < curdist) {
+	  /* This is a shorter path */
+	  igraph_2wheap_modify(Q, tto, -altdist);
+	}
       }
+    }
+  }
+  return count;
+}
+
+int igraph_i_sssp(const igraph_t *graph, const igraph_vs_t sources,
+		  igraph_neimode_t mode, const igraph_vector_t *weights,
+		  igraph_i_sssp_callback_t *callback, void *extra,
+		  int nthreads, const char *message) {
 
-      if (adjlist) {
-	neis=igraph_adjlist_get(adjlist, act);
-	n=(int) igraph_vector_int_size(neis);
-	for (j=0; j<n; j++) {
-	  int nei=(int) VECTOR(*neis)[j];
-	  if (VECTOR(counted)[nei] != mark) {
-	    VECTOR(counted)[nei]=mark;
-	    IGRAPH_CHECK(igraph_dqueue_long_push(&q, nei));
-	    IGRAPH_CHECK(igraph_dqueue_long_push(&q, dist+1));
-	  }
-	}  
-      } else {
-	IGRAPH_CHECK(igraph_neighbors(graph, &vneis,
-				      (igraph_integer_t) act, mode));
-	n=(int) igraph_vector_size(&vneis);
-	for (j=0; j<n; j++) {
-	  int nei=(int) VECTOR(vneis)[j];
-	  if (VECTOR(counted)[nei] != mark) {
-	    VECTOR(counted)[nei]=mark;
-	    IGRAPH_CHECK(igraph_dqueue_long_push(&q, nei));
-	    IGRAPH_CHECK(igraph_dqueue_long_push(&q, dist+1));
-	  }
-	}  
+  long int no_of_nodes=igraph_vcount(graph);
+  size_t nn=(size_t) nthreads * (size_t) no_of_nodes;
+  igraph_vit_t vit;
+  igraph_vector_long_t src;
+  igraph_csr_t csr, csr2;
+  igraph_i_sssp_ws_t ws;
+  igraph_bool_t both= weights && igraph_is_directed(graph) && 
+    mode == IGRAPH_ALL;
+  long int no_of_sources, from, i, batch;
+
+  IGRAPH_CHECK(igraph_vit_create(graph, sources, &vit));
+  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+  no_of_sources=IGRAPH_VIT_SIZE(vit);
+  IGRAPH_CHECK(igraph_vector_long_init(&src, no_of_sources));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &src);
+  for (i=0, IGRAPH_VIT_RESET(vit); !IGRAPH_VIT_END(vit); 
+       IGRAPH_VIT_NEXT(vit), i++) {
+    VECTOR(src)[i]=IGRAPH_VIT_GET(vit);
+  }
+  igraph_vit_destroy(&vit);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  memset(&ws, 0, sizeof(ws));
+  ws.nthreads=nthreads;
+  IGRAPH_FINALLY(igraph_i_sssp_ws_destroy, &ws);
+  ws.dist=igraph_Calloc(nn > 0 ? nn : 1, igraph_real_t);
+  if (!ws.dist) {
+    IGRAPH_ERROR("Shortest path calculation failed", IGRAPH_ENOMEM);
+  }
+  ws.order=igraph_Calloc(nn > 0 ? nn : 1, long int);
+  if (!ws.order) {
+    IGRAPH_ERROR("Shortest path calculation failed", IGRAPH_ENOMEM);
+  }
+
+  if (weights) {
+    ws.heaps=igraph_Calloc(nthreads, igraph_2wheap_t);
+    if (!ws.heaps) {
+      IGRAPH_ERROR("Shortest path calculation failed", IGRAPH_ENOMEM);
+    }
+    for (i=0; i<nthreads; i++) {
+      IGRAPH_CHECK(igraph_2wheap_init(&ws.heaps[i], no_of_nodes));
+      ws.no_of_heaps++;
+      IGRAPH_CHECK(igraph_2wheap_reserve(&ws.heaps[i], no_of_nodes));
+    }
+  } else {
+    for (i=0; i < (long int) nn; i++) { ws.dist[i]=-1; }
+  }
+  IGRAPH_CHECK(igraph_csr_borrow(graph, &csr, both ? IGRAPH_OUT : mode));
+  IGRAPH_FINALLY(igraph_csr_return, &csr);
+  if (both) {
+    IGRAPH_CHECK(igraph_csr_borrow(graph, &csr2, IGRAPH_IN));
+    IGRAPH_FINALLY(igraph_csr_return, &csr2);
+  }
+
+  batch=(long int) nthreads * IGRAPH_I_SSSP_BATCH;
+  for (from=0; from<no_of_sources; from += batch) {
+    long int to= from+batch < no_of_sources ? from+batch : no_of_sources;
+    if (message) {
+      IGRAPH_PROGRESS(message, 100.0*from/no_of_sources, 0);
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    IGRAPH_I_PARALLEL(nthreads)
+    {
+      int me=IGRAPH_I_THREAD_NUM;
+      igraph_real_t *dist=ws.dist + (size_t) me * (size_t) no_of_nodes;
+      long int *order=ws.order + (size_t) me * (size_t) no_of_nodes;
+      long int k, j, reached;
+      IGRAPH_I_SHARE(k, from, to) {
+	long int source=VECTOR(src)[k];
+	if (weights) {
+	  reached=igraph_i_sssp_dijkstra(&csr, both ? &csr2 : 0, weights, 
+					 &ws.heaps[me], source, dist, order);
+	  callback(me, k, source, order, dist, reached, extra);
+	} else {
+	  reached=igraph_i_sssp_bfs(&csr, source, dist, order);
+	  callback(me, k, source, order, dist, reached, extra);
+	  for (j=0; j<reached; j++) { dist[order[j]]=-1; }
+	}
       }
-    } /* while !igraph_dqueue_long_empty(dqueue) */
+    }
+  }
 
-  } /* for IGRAPH_VIT_NEXT(vit) */
+  if (message) {
+    IGRAPH_PROGRESS(message, 100.0, 0);
+  }
 
-  if (!adjlist) {
-    igraph_vector_destroy(&vneis);
+  if (both) {
+    igraph_csr_return(&csr2);
     IGRAPH_FINALLY_CLEAN(1);
   }
-  igraph_vector_int_destroy(&counted);
+  igraph_csr_return(&csr);
+  igraph_i_sssp_ws_destroy(&ws);
+  igraph_vector_long_destroy(&src);
+  IGRAPH_FINALLY_CLEAN(3);
+
+  return 0;
+}
+
+/* 
+ * Bit-parallel breadth-first search, after Then et al.: The More the
+ * Merrier: Efficient Multi-Source Graph Traversal, PVLDB 8(4), 2014.
+ *
+ * The sources are taken in groups of IGRAPH_I_MSBFS_BITS, and all
+ * searches of a group advance together, level by level. Every vertex
+ * has a bit set for the sources of the group that have already
+ * reached it ('seen') and for the ones that reached it on the current
+ * level ('visit'), so a vertex on the frontier of many searches
+ * scans its neighbors only once. The groups are divided among the
+ * threads, in batches, the same way as in igraph_i_sssp() above.
+ *
+ * The callback is called for every level, starting with level zero,
+ * the sources themselves. It gets the index of the first source of
+ * the group in 'sources' and the number of sources in the group, bit
+ * 'b' belongs to source 'first+b'. 'reached' contains the vertices
+ * that were reached on this level, by at least one source, and
+ * 'bits[v]' gives the sources that reached vertex 'v' on this
+ * level. 'bits' is only valid for the vertices in 'reached'. The
+ * same restrictions apply to the callback as in igraph_i_sssp(), but
+ * note that all sources of a group are handled by the same thread.
+ *
+ * If 'cutoff' is positive, then vertices farther than 'cutoff' are
+ * not searched from. 
+ */
+
+#define IGRAPH_I_MSBFS_BATCH 4		/* groups per thread in a batch */
+
+#ifndef __GNUC__
+int igraph_i_popcount(igraph_i_msbfs_word_t x) {
+  int c=0;
+  for (; x; x &= x-1) { c++; }
+  return c;
+}
+
+int igraph_i_ctz(igraph_i_msbfs_word_t x) {
+  int c=0;
+  for (; !(x & 1); x >>= 1) { c++; }
+  return c;
+}
+#endif
+
+typedef struct igraph_i_msbfs_ws_t {
+  igraph_i_msbfs_word_t *seen, *visit, *next; /* nthreads * no_of_nodes */
+  long int *frontier, *nextfrontier, *touched; /* nthreads * no_of_nodes */
+} igraph_i_msbfs_ws_t;
+
+static void igraph_i_msbfs_ws_destroy(igraph_i_msbfs_ws_t *ws) {
+  if (ws->seen) { igraph_Free(ws->seen); }
+  if (ws->visit) { igraph_Free(ws->visit); }
+  if (ws->next) { igraph_Free(ws->next); }
+  if (ws->frontier) { igraph_Free(ws->frontier); }
+  if (ws->nextfrontier) { igraph_Free(ws->nextfrontier); }
+  if (ws->touched) { igraph_Free(ws->touched); }
+}
+
+/* One group of sources. All bit vectors are zero on entry and are
+   restored to zero before returning. */
+
+static void igraph_i_msbfs_group(const igraph_csr_t *csr,
+				 const long int *src, long int first,
+				 int nsrc, igraph_real_t cutoff,
+				 igraph_i_msbfs_word_t *seen,
+				 igraph_i_msbfs_word_t *visit,
+				 igraph_i_msbfs_word_t *next,
+				 long int *frontier, long int *nextfrontier,
+				 long int *touched, int thread,
+				 igraph_i_msbfs_callback_t *callback,
+				 void *extra) {
+  long int nfront=0, nnext, ntouched=0, level=0, i, j, n;
+  int b;
+
+  for (b=0; b<nsrc; b++) {
+    long int s=src[first+b];
+    igraph_i_msbfs_word_t bit=((igraph_i_msbfs_word_t) 1) << b;
+    if (!seen[s]) {
+      touched[ntouched++]=s;
+      frontier[nfront++]=s;
+    }
+    seen[s] |= bit;
+    visit[s] |= bit;
+  }
+
+  while (nfront > 0) {
+    igraph_i_msbfs_word_t *tmpw;
+    long int *tmpl;
+
+    callback(thread, first, nsrc, level, frontier, nfront, visit, extra);
+    if (cutoff > 0 && level >= cutoff) { break; }
+
+    nnext=0;
+    for (i=0; i<nfront; i++) {
+      long int v=frontier[i];
+      igraph_i_msbfs_word_t w=visit[v];
+      const igraph_integer_t *neis=igraph_csr_adj(csr, v);
+      n=igraph_csr_size(csr, v);
+      for (j=0; j<n; j++) {
+	long int u=(long int) neis[j];
+	igraph_i_msbfs_word_t d=w & ~seen[u];
+	if (d) {
+	  if (!seen[u]) { touched[ntouched++]=u; }
+	  if (!next[u]) { nextfrontier[nnext++]=u; }
+	  seen[u] |= d;
+	  next[u] |= d;
+	}
+      }
+      visit[v]=0;
+    }
+
+    tmpw=visit; visit=next; next=tmpw;
+    tmpl=frontier; frontier=nextfrontier; nextfrontier=tmpl;
+    nfront=nnext;
+    level++;
+  }
+
+  for (i=0; i<nfront; i++) { visit[frontier[i]]=0; }
+  for (i=0; i<ntouched; i++) { seen[touched[i]]=0; }
+}
+
+int igraph_i_msbfs(const igraph_t *graph, const igraph_vs_t sources,
+		   igraph_neimode_t mode, igraph_real_t cutoff,
+		   igraph_i_msbfs_callback_t *callback, void *extra,
+		   int nthreads, const char *message) {
+
+  long int no_of_nodes=igraph_vcount(graph);
+  size_t nn=(size_t) nthreads * (size_t) no_of_nodes;
+  igraph_vit_t vit;
+  igraph_vector_long_t src;
+  igraph_csr_t csr;
+  igraph_i_msbfs_ws_t ws;
+  long int no_of_sources, no_of_groups, from, i, batch;
+
+  IGRAPH_CHECK(igraph_vit_create(graph, sources, &vit));
+  IGRAPH_FINALLY(igraph_vit_destroy, &vit);
+  no_of_sources=IGRAPH_VIT_SIZE(vit);
+  IGRAPH_CHECK(igraph_vector_long_init(&src, no_of_sources));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &src);
+  for (i=0, IGRAPH_VIT_RESET(vit); !IGRAPH_VIT_END(vit); 
+       IGRAPH_VIT_NEXT(vit), i++) {
+    VECTOR(src)[i]=IGRAPH_VIT_GET(vit);
+  }
   igraph_vit_destroy(&vit);
-  igraph_dqueue_long_destroy(&q);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  memset(&ws, 0, sizeof(ws));
+  IGRAPH_FINALLY(igraph_i_msbfs_ws_destroy, &ws);
+  if (nn == 0) { nn=1; }
+  ws.seen=igraph_Calloc(nn, igraph_i_msbfs_word_t);
+  ws.visit=igraph_Calloc(nn, igraph_i_msbfs_word_t);
+  ws.next=igraph_Calloc(nn, igraph_i_msbfs_word_t);
+  ws.frontier=igraph_Calloc(nn, long int);
+  ws.nextfrontier=igraph_Calloc(nn, long int);
+  ws.touched=igraph_Calloc(nn, long int);
+  if (!ws.seen || !ws.visit || !ws.next || !ws.frontier || 
+      !ws.nextfrontier || !ws.touched) {
+    IGRAPH_ERROR("Breadth-first search failed", IGRAPH_ENOMEM);
+  }
+
+  IGRAPH_CHECK(igraph_csr_borrow(graph, &csr, mode));
+  IGRAPH_FINALLY(igraph_csr_return, &csr);
+
+  no_of_groups=(no_of_sources + IGRAPH_I_MSBFS_BITS - 1) / 
+    IGRAPH_I_MSBFS_BITS;
+  batch=(long int) nthreads * IGRAPH_I_MSBFS_BATCH;
+  for (from=0; from<no_of_groups; from += batch) {
+    long int to= from+batch < no_of_groups ? from+batch : no_of_groups;
+    if (message) {
+      IGRAPH_PROGRESS(message, 100.0*from/no_of_groups, 0);
+    }
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    IGRAPH_I_PARALLEL(nthreads)
+    {
+      int me=IGRAPH_I_THREAD_NUM;
+      size_t off=(size_t) me * (size_t) no_of_nodes;
+      long int k;
+      IGRAPH_I_SHARE(k, from, to) {
+	long int first=k * IGRAPH_I_MSBFS_BITS;
+	int nsrc= no_of_sources-first < IGRAPH_I_MSBFS_BITS ? 
+	  (int) (no_of_sources-first) : IGRAPH_I_MSBFS_BITS;
+	igraph_i_msbfs_group(&csr, VECTOR(src), first, nsrc, cutoff,
+			     ws.seen+off, ws.visit+off, ws.next+off,
+			     ws.frontier+off, ws.nextfrontier+off, 
+			     ws.touched+off, me, callback, extra);
+      }
+    }
+  }
+
+  if (message) {
+    IGRAPH_PROGRESS(message, 100.0, 0);
+  }
+
+  igraph_csr_return(&csr);
+  igraph_i_msbfs_ws_destroy(&ws);
+  igraph_vector_long_destroy(&src);
   IGRAPH_FINALLY_CLEAN(3);
-  
+
   return 0;
 }
 
+static void igraph_i_eccentricity_cb(int thread, long int first, int nsrc,
+				     long int level, const long int *reached,
+				     long int no_reached, 
+				     const igraph_i_msbfs_word_t *bits,
+				     void *extra) {
+  igraph_vector_t *res=(igraph_vector_t *) extra;
+  igraph_i_msbfs_word_t any=0;
+  long int i;
+  IGRAPH_UNUSED(thread); IGRAPH_UNUSED(nsrc);
+  /* the sources that got farther are at least this far */
+  for (i=0; i<no_reached; i++) {
+    any |= bits[reached[i]];
+  }
+  while (any) {
+    VECTOR(*res)[first + IGRAPH_I_CTZ(any)]=level;
+    any &= any-1;
+  }
+}
+
 /**
  * \function igraph_eccentricity
  * Eccentricity of some vertices
@@ -144,6 +496,11 @@ int igraph_i_eccentricity(const igraph_t *graph,
  *    is ignored for undirected graphs.
  * \return Error code.
  * 
+ * </para><para>
+ * The breadth-first searches of 64 vertices are run together, with
+ * bit-parallel operations, and these groups are divided among the
+ * threads, see \ref igraph_set_num_threads().
+ * 
  * Time complexity: O(v*(|V|+|E|)), where |V| is the number of
  * vertices, |E| is the number of edges and v is the number of
  * vertices for which eccentricity is calculated.
@@ -158,7 +515,13 @@ int igraph_eccentricity(const igraph_t *graph,
 			igraph_vs_t vids,
 			igraph_neimode_t mode) {
 
-  return igraph_i_eccentricity(graph, res, vids, mode, /*adjlist=*/ 0);
+  igraph_integer_t size;
+  IGRAPH_CHECK(igraph_vs_size(graph, &vids, &size));
+  IGRAPH_CHECK(igraph_vector_resize(res, size));
+  IGRAPH_CHECK(igraph_i_msbfs(graph, vids, mode, /*cutoff=*/ -1,
+			      igraph_i_eccentricity_cb, res, 
+			      igraph_get_num_threads(), /*message=*/ 0));
+  return 0;
 }
 
 /**
@@ -194,17 +557,12 @@ int igraph_radius(const igraph_t *graph, igraph_real_t *radius,
   if (no_of_nodes==0) {
     *radius = IGRAPH_NAN;
   } else {
-    igraph_adjlist_t adjlist;
     igraph_vector_t ecc;
-    IGRAPH_CHECK(igraph_adjlist_init(graph, &adjlist, mode));
-    IGRAPH_FINALLY(igraph_adjlist_destroy, &adjlist);
     IGRAPH_VECTOR_INIT_FINALLY(&ecc, igraph_vcount(graph));
-    IGRAPH_CHECK(igraph_i_eccentricity(graph, &ecc, igraph_vss_all(), 
-				       mode, &adjlist));
+    IGRAPH_CHECK(igraph_eccentricity(graph, &ecc, igraph_vss_all(), mode));
     *radius = igraph_vector_min(&ecc);
     igraph_vector_destroy(&ecc);
-    igraph_adjlist_destroy(&adjlist);
-    IGRAPH_FINALLY_CLEAN(2);
+    IGRAPH_FINALLY_CLEAN(1);
   }
   
   return 0;
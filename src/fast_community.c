@@ -28,9 +28,11 @@
 #include "igraph_progress.h"
 #include "igraph_interrupt_internal.h"
 #include "igraph_structural.h"
-#include "igraph_vector_ptr.h"
+#include "igraph_qsort.h"
 #include "config.h"
 
+#include <string.h>
+
 /* #define IGRAPH_FASTCOMM_DEBUG */
 
 #ifdef _MSC_VER
@@ -65,487 +67,377 @@ void debug(const char* fmt, ...) {
  * K. Wakita, T. Tsurumi, "Finding community structure in mega-scale social
  * networks.". arXiv:cs/0702048v1.
  *
- * We maintain a vector of communities, each of which containing a list of
- * pointers to their neighboring communities along with the increase in the
- * modularity score that could be achieved by joining the two communities.
- * Each community has a pointer to one of its neighbors - the one which would
- * result in the highest increase in modularity after a join. The local
- * (community-level) maximums are also stored in an indexed max-heap. The
- * max-heap itself stores its elements in an array which satisfies the heap
- * property, but to allow us to access any of the elements in the array based
- * on the community index (and not based on the array index - which depends on
- * the element's actual position in the heap), we also maintain an index
- * vector in the heap: the ith element of the index vector contains the
- * position of community i in the array of the max-heap. When we perform
- * sifting operations on the heap to restore the heap property, we also maintain
- * the index vector.
+ * We maintain a vector of communities, each of which containing a sorted
+ * array of its neighboring communities along with the increase in the
+ * modularity score (dq) that could be achieved by joining the two
+ * communities. The ids and the dq values are stored in two parallel arrays,
+ * allocated as a single block, so a pair of neighboring communities only
+ * needs 2*(sizeof(igraph_integer_t)+sizeof(igraph_real_t)) bytes. When two
+ * communities are joined, their arrays are merged into a new one, like in
+ * merge sort, and the entries in the arrays of their neighbors are found
+ * with binary search.
+ *
+ * Each community also stores its maximal dq and the neighbor it belongs
+ * to. The (community-level) maximums are stored in an indexed 4-ary
+ * max-heap. The heap stores community indices, and to allow us to find any
+ * community in the heap we also maintain an index vector: the ith element
+ * of the index vector contains the position of community i in the heap.
+ * Ties are broken by preferring the smaller neighbor and the larger
+ * community index, so the result does not depend on the order of the
+ * operations on the heap.
  */
 
-/* Structure storing a pair of communities along with their dQ values */
-typedef struct s_igraph_i_fastgreedy_commpair {
-  long int first;       /* first member of the community pair */
-  long int second;      /* second member of the community pair */
-  igraph_real_t *dq;    /* pointer to a member of the dq vector storing the */
-                        /* increase in modularity achieved when joining */
-  struct s_igraph_i_fastgreedy_commpair *opposite;
-} igraph_i_fastgreedy_commpair;
+#define IGRAPH_I_FASTGREEDY_ARITY 4
 
 /* Structure storing a community */
 typedef struct {
   igraph_integer_t id;      /* Identifier of the community (for merges matrix) */
   igraph_integer_t size;    /* Size of the community */
-  igraph_vector_ptr_t neis; /* references to neighboring communities */
-  igraph_i_fastgreedy_commpair* maxdq; /* community pair with maximal dq */
+  long int n;               /* Number of neighboring communities */
+  long int alloc;           /* Allocated length of nei and dq */
+  igraph_integer_t *nei;    /* Neighboring communities, sorted */
+  igraph_real_t *dq;        /* dq values belonging to the neighbors */
+  igraph_integer_t maxnei;  /* Neighbor with maximal dq, -1 if none */
+  igraph_real_t maxdq;      /* The maximal dq */
 } igraph_i_fastgreedy_community;
 
 /* Global community list structure */
 typedef struct {
-  long int no_of_communities, n;  /* number of communities, number of vertices */
+  long int no_of_communities, n;  /* number of communities in the heap, number of vertices */
   igraph_i_fastgreedy_community* e;     /* list of communities */
-  igraph_i_fastgreedy_community** heap; /* heap of communities */
-  igraph_integer_t *heapindex; /* heap index to speed up lookup by community idx */
+  igraph_integer_t *heap;       /* heap of community indices */
+  igraph_integer_t *heapindex;  /* heap index to speed up lookup by community idx */
+  igraph_real_t memory;         /* bytes allocated currently */
+  igraph_real_t peak_memory;    /* maximum of memory */
 } igraph_i_fastgreedy_community_list;
 
-/* Scans the community neighborhood list for the new maximal dq value.
- * Returns 1 if the maximum is different from the previous one,
- * 0 otherwise. */
-int igraph_i_fastgreedy_community_rescan_max(
+/* Used for sorting the neighbors initially */
+typedef struct {
+  igraph_integer_t nei;
+  igraph_real_t dq;
+} igraph_i_fastgreedy_commpair;
+
+static void igraph_i_fastgreedy_add_memory(
+  igraph_i_fastgreedy_community_list* list, igraph_real_t bytes) {
+  list->memory += bytes;
+  if (list->memory > list->peak_memory) list->peak_memory = list->memory;
+}
+
+/* Allocates the neighbor arrays of a community, for n neighbors */
+static int igraph_i_fastgreedy_community_alloc(
+  igraph_i_fastgreedy_community_list* list,
+  igraph_i_fastgreedy_community* comm, long int n) {
+  comm->n = 0;
+  comm->alloc = n;
+  comm->nei = 0;
+  comm->dq = 0;
+  if (n > 0) {
+    comm->dq = (igraph_real_t*) igraph_Calloc(n * (sizeof(igraph_real_t) + sizeof(igraph_integer_t)), char);
+    if (comm->dq == 0) {
+      comm->alloc = 0;
+      IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
+    }
+    comm->nei = (igraph_integer_t*) (comm->dq + n);
+  }
+  igraph_i_fastgreedy_add_memory(list, n * (sizeof(igraph_real_t) + sizeof(igraph_integer_t)));
+  return 0;
+}
+
+static void igraph_i_fastgreedy_community_free(
+  igraph_i_fastgreedy_community_list* list,
+  igraph_i_fastgreedy_community* comm) {
+  if (comm->dq != 0) free(comm->dq);
+  list->memory -= comm->alloc * (sizeof(igraph_real_t) + sizeof(igraph_integer_t));
+  comm->n = comm->alloc = 0;
+  comm->nei = 0;
+  comm->dq = 0;
+}
+
+/* Is (dq1, nei1) preferred to (dq2, nei2) as the maximum of a community? */
+#define IGRAPH_I_FASTGREEDY_BETTER(dq1, nei1, dq2, nei2) \
+  ((dq1) > (dq2) || ((dq1) == (dq2) && (nei1) < (nei2)))
+
+/* Scans the community neighborhood list for the new maximal dq value. */
+static void igraph_i_fastgreedy_community_rescan_max(
   igraph_i_fastgreedy_community* comm) {
-  long int i, n;
-  igraph_i_fastgreedy_commpair *p, *best;
-  igraph_real_t bestdq, currdq;
-
-  n = igraph_vector_ptr_size(&comm->neis);
-  if (n == 0) {
-    comm->maxdq = 0;
-    return 1;
+  long int i, best;
+
+  if (comm->n == 0) {
+    comm->maxnei = -1;
+    return;
   }
 
-  best = (igraph_i_fastgreedy_commpair*)VECTOR(comm->neis)[0];
-  bestdq = *best->dq;
-  for (i = 1; i < n; i++) {
-	p = (igraph_i_fastgreedy_commpair*)VECTOR(comm->neis)[i];
-    currdq = *p->dq;
-	if (currdq > bestdq) {
-      best = p;
-      bestdq = currdq;
-    }
+  /* the array is sorted, so the first maximum has the smallest id */
+  best = 0;
+  for (i = 1; i < comm->n; i++) {
+    if (comm->dq[i] > comm->dq[best]) best = i;
   }
+  comm->maxnei = comm->nei[best];
+  comm->maxdq = comm->dq[best];
+}
 
-  if (best != comm->maxdq) {
-    comm->maxdq = best;
-    return 1;
-  } else {
-    return 0;
+/* Finds neighbor k in the neighbor list of a community, with binary search */
+static long int igraph_i_fastgreedy_community_find(
+  igraph_i_fastgreedy_community* comm, long int k) {
+  long int lo = 0, hi = comm->n - 1, mid;
+  while (lo <= hi) {
+    mid = lo + (hi - lo) / 2;
+    if (comm->nei[mid] < k) {
+      lo = mid + 1;
+    } else if (comm->nei[mid] > k) {
+      hi = mid - 1;
+    } else {
+      return mid;
+    }
   }
+  return -1;
 }
 
 /* Destroys the global community list object */
-void igraph_i_fastgreedy_community_list_destroy(
+static void igraph_i_fastgreedy_community_list_destroy(
   igraph_i_fastgreedy_community_list* list) {
   long int i;
   for (i=0; i<list->n; i++) {
-	igraph_vector_ptr_destroy(&list->e[i].neis);
+    if (list->e[i].dq != 0) free(list->e[i].dq);
   }
   free(list->e);
   if (list->heapindex != 0) free(list->heapindex);
   if (list->heap != 0) free(list->heap);
 }
 
+/* Is community c1 lower in the heap than community c2? */
+#define IGRAPH_I_FASTGREEDY_HEAP_LESS(list, c1, c2) \
+  ((list)->e[(c1)].maxdq < (list)->e[(c2)].maxdq || \
+   ((list)->e[(c1)].maxdq == (list)->e[(c2)].maxdq && (c1) < (c2)))
+
 /* Community list heap maintenance: sift down */
-void igraph_i_fastgreedy_community_list_sift_down(
+static void igraph_i_fastgreedy_community_list_sift_down(
   igraph_i_fastgreedy_community_list* list, long int idx) {
-  long int root, child, c1, c2;
-  igraph_i_fastgreedy_community* dummy;
-  igraph_integer_t dummy2;
-  igraph_i_fastgreedy_community** heap = list->heap;
+  igraph_integer_t* heap = list->heap;
   igraph_integer_t* heapindex = list->heapindex;
-
-  root = idx;
-  while (root*2+1 < list->no_of_communities) {
-    child = root*2+1;
-	if (child+1 < list->no_of_communities &&
-		*heap[child]->maxdq->dq < *heap[child+1]->maxdq->dq)
-	  child++;
-	if (*heap[root]->maxdq->dq < *heap[child]->maxdq->dq) {
-	  c1 = heap[root]->maxdq->first;
-	  c2 = heap[child]->maxdq->first;
-
-	  dummy = heap[root];
-	  heap[root] = heap[child];
-	  heap[child] = dummy;
-	  
-	  dummy2 = heapindex[c1];
-	  heapindex[c1] = heapindex[c2];
-	  heapindex[c2] = dummy2;
-
-	  root = child;
-	} else break;
+  long int child, last, best, i;
+  igraph_integer_t root = heap[idx];
+
+  while ((child = idx * IGRAPH_I_FASTGREEDY_ARITY + 1) < list->no_of_communities) {
+    last = child + IGRAPH_I_FASTGREEDY_ARITY;
+    if (last > list->no_of_communities) last = list->no_of_communities;
+    best = child;
+    for (i = child + 1; i < last; i++) {
+      if (IGRAPH_I_FASTGREEDY_HEAP_LESS(list, heap[best], heap[i])) best = i;
+    }
+    if (!IGRAPH_I_FASTGREEDY_HEAP_LESS(list, root, heap[best])) break;
+    heap[idx] = heap[best];
+    heapindex[heap[idx]] = (igraph_integer_t) idx;
+    idx = best;
   }
+  heap[idx] = root;
+  heapindex[root] = (igraph_integer_t) idx;
 }
 
 /* Community list heap maintenance: sift up */
-void igraph_i_fastgreedy_community_list_sift_up(
+static void igraph_i_fastgreedy_community_list_sift_up(
   igraph_i_fastgreedy_community_list* list, long int idx) {
-  long int root, parent, c1, c2;
-  igraph_i_fastgreedy_community* dummy;
-  igraph_integer_t dummy2;
-  igraph_i_fastgreedy_community** heap = list->heap;
+  igraph_integer_t* heap = list->heap;
   igraph_integer_t* heapindex = list->heapindex;
-
-  root = idx;
-  while (root>0) {
-    parent = (root-1)/2;
-	if (*heap[parent]->maxdq->dq < *heap[root]->maxdq->dq) {
-	  c1 = heap[root]->maxdq->first;
-	  c2 = heap[parent]->maxdq->first;
-	  
-	  dummy = heap[parent];
-	  heap[parent] = heap[root];
-	  heap[root] = dummy;
-	  
-	  dummy2 = heapindex[c1];
-	  heapindex[c1] = heapindex[c2];
-	  heapindex[c2] = dummy2;
-
-	  root = parent;
-	} else break;
-  }
+  long int parent;
+  igraph_integer_t root = heap[idx];
+
+  while (idx > 0) {
+    parent = (idx - 1) / IGRAPH_I_FASTGREEDY_ARITY;
+    if (!IGRAPH_I_FASTGREEDY_HEAP_LESS(list, heap[parent], root)) break;
+    heap[idx] = heap[parent];
+    heapindex[heap[idx]] = (igraph_integer_t) idx;
+    idx = parent;
+  }
+  heap[idx] = root;
+  heapindex[root] = (igraph_integer_t) idx;
 }
 
 /* Builds the community heap for the first time */
-void igraph_i_fastgreedy_community_list_build_heap(
+static void igraph_i_fastgreedy_community_list_build_heap(
   igraph_i_fastgreedy_community_list* list) {
   long int i;
-  for (i=list->no_of_communities/2-1; i>=0; i--)
+  if (list->no_of_communities < 2) return;
+  for (i=(list->no_of_communities-2)/IGRAPH_I_FASTGREEDY_ARITY; i>=0; i--)
 	igraph_i_fastgreedy_community_list_sift_down(list, i);
 }
 
-/* Finds the element belonging to a given community in the heap and return its
- * index in the heap array */
-#define igraph_i_fastgreedy_community_list_find_in_heap(list, idx) (list)->heapindex[idx]
+/* Removes a given community from the heap */
+static void igraph_i_fastgreedy_community_list_remove(
+  igraph_i_fastgreedy_community_list* list, long int c) {
+  long int idx = list->heapindex[c];
+  igraph_integer_t last;
 
-/* Dumps the heap - for debugging purposes */
-void igraph_i_fastgreedy_community_list_dump_heap(
-  igraph_i_fastgreedy_community_list* list) {
-  long int i;
-  debug("Heap:\n");
-  for (i=0; i<list->no_of_communities; i++) {
-	debug("(%ld, %p, %p)", i, list->heap[i],
-	  list->heap[i]->maxdq);
-	if (list->heap[i]->maxdq) {
-	  debug(" (%ld, %ld, %.7f)", list->heap[i]->maxdq->first,
-		list->heap[i]->maxdq->second, *list->heap[i]->maxdq->dq);
-	}
-	debug("\n");
-  }
-  debug("Heap index:\n");
-  for (i=0; i<list->no_of_communities; i++) debug("%ld ", (long)list->heapindex[i]);
-  debug("\nEND\n");
-}
-
-/* Checks if the community heap satisfies the heap property.
- * Only useful for debugging. */
-void igraph_i_fastgreedy_community_list_check_heap(
-  igraph_i_fastgreedy_community_list* list) {
-  long int i;
-  for (i=0; i<list->no_of_communities/2; i++) {
-	if ((2*i+1<list->no_of_communities && *list->heap[i]->maxdq->dq < *list->heap[2*i+1]->maxdq->dq) ||
-		(2*i+2<list->no_of_communities && *list->heap[i]->maxdq->dq < *list->heap[2*i+2]->maxdq->dq)) {
-	  IGRAPH_WARNING("Heap property violated");
-	  debug("Position: %ld, %ld and %ld\n", i, 2*i+1, 2*i+2);
-	  igraph_i_fastgreedy_community_list_dump_heap(list);
-	}
-  }
-}
-
-/* Removes a given element from the heap */
-void igraph_i_fastgreedy_community_list_remove(
-  igraph_i_fastgreedy_community_list* list, long int idx) {
-  igraph_real_t old;
-  long int commidx;
-  
-  /* First adjust the index */
-  commidx=list->heap[list->no_of_communities-1]->maxdq->first;
-  list->heapindex[commidx] = (igraph_integer_t) idx;
-  commidx=list->heap[idx]->maxdq->first;
-  list->heapindex[commidx] = -1;
-
-  /* Now remove the element */
-  old=*list->heap[idx]->maxdq->dq;
-  list->heap[idx] = list->heap[list->no_of_communities-1];
+  if (idx < 0) return;
+  list->heapindex[c] = -1;
   list->no_of_communities--;
-  
-  /* Recover heap property */
-  if (old > *list->heap[idx]->maxdq->dq)
-	igraph_i_fastgreedy_community_list_sift_down(list, idx);
-  else
-	igraph_i_fastgreedy_community_list_sift_up(list, idx);
-}
+  if (idx == list->no_of_communities) return;
 
-/* Removes a given element from the heap when there are no more neighbors
- * for it (comm->maxdq is NULL) */
-void igraph_i_fastgreedy_community_list_remove2(
-  igraph_i_fastgreedy_community_list* list, long int idx, long int comm) {
-  long int i;
- 
-  if (idx == list->no_of_communities-1) {
-    /* We removed the rightmost element on the bottom level, no problem,
-     * there's nothing to be done */
-    list->heapindex[comm] = -1;
-    list->no_of_communities--;
-    return;
-  }
-
-  /* First adjust the index */
-  i=list->heap[list->no_of_communities-1]->maxdq->first;
-  list->heapindex[i] = (igraph_integer_t) idx;
-  list->heapindex[comm] = -1;
-
-  /* Now remove the element */
-  list->heap[idx] = list->heap[list->no_of_communities-1];
-  list->no_of_communities--;
-  
-  /* Recover heap property */
-  for (i=list->no_of_communities/2-1; i>=0; i--)
-	igraph_i_fastgreedy_community_list_sift_down(list, i);
+  last = list->heap[list->no_of_communities];
+  list->heap[idx] = last;
+  list->heapindex[last] = (igraph_integer_t) idx;
+  igraph_i_fastgreedy_community_list_sift_up(list, idx);
+  igraph_i_fastgreedy_community_list_sift_down(list, list->heapindex[last]);
 }
 
-/* Removes the pair belonging to community k from the neighborhood list
- * of community c (that is, clist[c]) and recalculates maxdq */
-void igraph_i_fastgreedy_community_remove_nei(
-  igraph_i_fastgreedy_community_list* list, long int c, long int k) {
-  long int i, n;
-  igraph_bool_t rescan=0;
-  igraph_i_fastgreedy_commpair *p;
-  igraph_i_fastgreedy_community *comm;
-  igraph_real_t olddq;
-
-  comm=&list->e[c];
-  n=igraph_vector_ptr_size(&comm->neis);
-  for (i=0; i<n; i++) {
-	p=(igraph_i_fastgreedy_commpair*)VECTOR(comm->neis)[i];
-    if (p->second == k) {
-	  /* Check current maxdq */
-	  if (comm->maxdq == p) rescan=1;
-	  break;
-	}
-  }
-  if (i<n) {
-	olddq = *comm->maxdq->dq;
-	igraph_vector_ptr_remove(&comm->neis, i);
-	if (rescan) {
-	  igraph_i_fastgreedy_community_rescan_max(comm);
-      i=igraph_i_fastgreedy_community_list_find_in_heap(list, c);
-	  if (comm->maxdq) {
-        if (*comm->maxdq->dq > olddq)
-		  igraph_i_fastgreedy_community_list_sift_up(list, i);
-        else
-		  igraph_i_fastgreedy_community_list_sift_down(list, i);
-      } else {
-        /* no more neighbors for this community. we should remove this
-         * community from the heap and restore the heap property */
-        debug("REMOVING (NO MORE NEIS): %ld\n", i);
-        igraph_i_fastgreedy_community_list_remove2(list, i, c);
-      }
-	}
+/* Restores the heap property after the maximal dq of community c changed,
+ * or removes it from the heap if it has no more neighbors */
+static void igraph_i_fastgreedy_community_list_update(
+  igraph_i_fastgreedy_community_list* list, long int c) {
+  if (list->e[c].maxnei < 0) {
+    igraph_i_fastgreedy_community_list_remove(list, c);
+  } else {
+    igraph_i_fastgreedy_community_list_sift_up(list, list->heapindex[c]);
+    igraph_i_fastgreedy_community_list_sift_down(list, list->heapindex[c]);
   }
 }
 
-/* Auxiliary function to sort a community pair list with respect to the
- * `second` field */
-int igraph_i_fastgreedy_commpair_cmp(const void* p1, const void* p2) {
-  igraph_i_fastgreedy_commpair *cp1, *cp2;
-  cp1=*(igraph_i_fastgreedy_commpair**)p1;
-  cp2=*(igraph_i_fastgreedy_commpair**)p2;
-  return (int) (cp1->second - cp2->second);
-}
+/* Updates the neighbor list of community k after communities s and r
+ * were joined into s. k was a neighbor of s only (mode 0), r only (mode
+ * 1), or both (mode 2), newdq is the dq of joining k and s from now on. */
+static void igraph_i_fastgreedy_community_update_nei(
+  igraph_i_fastgreedy_community_list* list, long int k,
+  long int s, long int r, igraph_real_t newdq, int mode) {
+  igraph_i_fastgreedy_community *comm = &list->e[k];
+  long int i;
 
-/* Sorts the neighbor list of the community with the given index, optionally
- * optimizing the process if we know that the list is nearly sorted and only
- * a given pair is in the wrong place. */
-void igraph_i_fastgreedy_community_sort_neighbors_of(
-  igraph_i_fastgreedy_community_list* list, long int index,
-  igraph_i_fastgreedy_commpair* changed_pair) {
-  igraph_vector_ptr_t* vec;
-  long int i, n;
-  igraph_bool_t can_skip_sort = 0;
-  igraph_i_fastgreedy_commpair *other_pair;
-
-  vec = &list->e[index].neis;
-  if (changed_pair != 0) {
-    /* Optimized sorting */
-
-    /* First we look for changed_pair in vec */
-    n = igraph_vector_ptr_size(vec);
-    for (i = 0; i < n; i++) {
-      if (VECTOR(*vec)[i] == changed_pair) {
-        break;
-      }
+  if (mode == 0) {
+    i = igraph_i_fastgreedy_community_find(comm, s);
+  } else if (mode == 1) {
+    /* rename r to s, and move it to its sorted place */
+    i = igraph_i_fastgreedy_community_find(comm, r);
+    while (i + 1 < comm->n && comm->nei[i + 1] < s) {
+      comm->nei[i] = comm->nei[i + 1];
+      comm->dq[i] = comm->dq[i + 1];
+      i++;
     }
-
-    /* Did we find it? We should have -- otherwise it's a bug */
-    if (i >= n) {
-      IGRAPH_WARNING("changed_pair not found in neighbor vector while re-sorting "
-          "the neighbors of a community; this is probably a bug. Falling back to "
-          "full sort instead."
-      );
+    while (i > 0 && comm->nei[i - 1] > s) {
+      comm->nei[i] = comm->nei[i - 1];
+      comm->dq[i] = comm->dq[i - 1];
+      i--;
+    }
+    comm->nei[i] = (igraph_integer_t) s;
+  } else {
+    i = igraph_i_fastgreedy_community_find(comm, r);
+    memmove(comm->nei + i, comm->nei + i + 1,
+            (size_t) (comm->n - i - 1) * sizeof(igraph_integer_t));
+    memmove(comm->dq + i, comm->dq + i + 1,
+            (size_t) (comm->n - i - 1) * sizeof(igraph_real_t));
+    comm->n--;
+    i = igraph_i_fastgreedy_community_find(comm, s);
+  }
+  comm->dq[i] = newdq;
+
+  if (comm->maxnei == s || comm->maxnei == r) {
+    if (newdq > comm->maxdq) {
+      /* still the maximum */
+      comm->maxnei = (igraph_integer_t) s;
+      comm->maxdq = newdq;
     } else {
-      /* Okay, the pair that changed is at index i. We need to figure out where
-       * its new place should be. We can simply try moving the item all the way
-       * to the left as long as the comparison function tells so (since the
-       * rest of the vector is sorted), and then move all the way to the right
-       * as long as the comparison function tells so, and we will be okay. */
-
-      /* Shifting to the left */
-      while (i > 0) {
-        other_pair = VECTOR(*vec)[i-1];
-        if (other_pair->second > changed_pair->second) {
-          VECTOR(*vec)[i] = other_pair;
-          i--;
-        } else {
-          break;
-        }
-      }
-      VECTOR(*vec)[i] = changed_pair;
-
-      /* Shifting to the right */
-      while (i < n-1) {
-        other_pair = VECTOR(*vec)[i+1];
-        if (other_pair->second < changed_pair->second) {
-          VECTOR(*vec)[i] = other_pair;
-          i++;
-        } else {
-          break;
-        }
-      }
-      VECTOR(*vec)[i] = changed_pair;
-
-      /* Mark that we don't need a full sort */
-      can_skip_sort = 1;
+      igraph_i_fastgreedy_community_rescan_max(comm);
     }
+  } else if (IGRAPH_I_FASTGREEDY_BETTER(newdq, s, comm->maxdq, comm->maxnei)) {
+    comm->maxnei = (igraph_integer_t) s;
+    comm->maxdq = newdq;
+  } else {
+    return;
   }
-
-  if (!can_skip_sort) {
-    /* Fallback to full sorting */
-    igraph_vector_ptr_sort(vec, igraph_i_fastgreedy_commpair_cmp);
-  }
+  igraph_i_fastgreedy_community_list_update(list, k);
 }
 
-/* Updates the dq value of community pair p in the community with index p->first
- * of the community list clist to newdq and restores the heap property
- * in community c if necessary. Returns 1 if the maximum in the row had
- * to be updated, zero otherwise */
-int igraph_i_fastgreedy_community_update_dq(
-  igraph_i_fastgreedy_community_list* list,
-  igraph_i_fastgreedy_commpair* p, igraph_real_t newdq) {
-  long int i,j,to,from;
-  igraph_real_t olddq;
-  igraph_i_fastgreedy_community *comm_to, *comm_from;
-  to=p->first; from=p->second;
-  comm_to=&list->e[to];
-  comm_from=&list->e[from];
-  if (comm_to->maxdq == p && newdq >= *p->dq) {
-	/* If we are adjusting the current maximum and it is increased, we don't
-	 * have to re-scan for the new maximum */
-	*p->dq = newdq;
-	/* The maximum was increased, so perform a sift-up in the heap */
-	i = igraph_i_fastgreedy_community_list_find_in_heap(list, to);
-	igraph_i_fastgreedy_community_list_sift_up(list, i);
-	/* Let's check the opposite side. If the pair was not the maximal in
-	 * the opposite side (the other community list)... */
-	if (comm_from->maxdq != p->opposite) {
-	  if (*comm_from->maxdq->dq < newdq) {
-	    /* ...and it will become the maximal, we need to adjust and sift up */
-		comm_from->maxdq = p->opposite;
-	    j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	    igraph_i_fastgreedy_community_list_sift_up(list, j);
-	  } else {
-		/* The pair was not the maximal in the opposite side and it will
-		 * NOT become the maximal, there's nothing to do there */
-	  }
-	} else {
-	  /* The pair was maximal in the opposite side, so we need to sift it up
-	   * with the new value */
-	  j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	  igraph_i_fastgreedy_community_list_sift_up(list, j);
-	}
-	return 1;
-  } else if (comm_to->maxdq != p && (newdq <= *comm_to->maxdq->dq)) {
-	/* If we are modifying an item which is not the current maximum, and the
-	 * new value is less than the current maximum, we don't
-	 * have to re-scan for the new maximum */
-	olddq = *p->dq;
-	*p->dq = newdq;
-	/* However, if the item was the maximum on the opposite side, we'd better
-	 * re-scan it */
-	if (comm_from->maxdq == p->opposite) {
-	  if (olddq>newdq) {
-		/* Decreased the maximum on the other side, we have to re-scan for the
-		 * new maximum */
-		igraph_i_fastgreedy_community_rescan_max(comm_from);
-  	    j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	    igraph_i_fastgreedy_community_list_sift_down(list, j);
-	  } else {
-		/* Increased the maximum on the other side, we don't have to re-scan
-		 * but we might have to sift up */
-		j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-		igraph_i_fastgreedy_community_list_sift_up(list, j);
-	  }
-	}
-	return 0;
-  } else {
-	/* We got here in two cases:
-     (1) the pair we are modifying right now is the maximum in the given
-	     community and we are decreasing it
-	 (2) the pair we are modifying right now is NOT the maximum in the
-	     given community, but we increase it so much that it will become
-		 the new maximum
-     */
-    *p->dq = newdq;
-    if (comm_to->maxdq != p) {
-	  /* case (2) */
-	  comm_to->maxdq = p;
-	  /* The maximum was increased, so perform a sift-up in the heap */
-	  i = igraph_i_fastgreedy_community_list_find_in_heap(list, to);
-	  igraph_i_fastgreedy_community_list_sift_up(list, i);
-	  /* Opposite side. Chances are that the new value became the maximum
-	   * in the opposite side, but check it first */
-	  if (comm_from->maxdq != p->opposite) {
-		if (*comm_from->maxdq->dq < newdq) {
-		  /* Yes, it will become the new maximum */
-		  comm_from->maxdq = p->opposite;
-  	      j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	      igraph_i_fastgreedy_community_list_sift_up(list, j);
-		} else {
-		  /* No, nothing to do there */
-		}
-	  } else {
-	    /* Already increased the maximum on the opposite side, so sift it up */
-  	    j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	    igraph_i_fastgreedy_community_list_sift_up(list, j);
-	  }
+/* Joins community r into community s, a is the vector of the fraction of
+ * edge ends in the communities. */
+static int igraph_i_fastgreedy_community_join(
+  igraph_i_fastgreedy_community_list* list, igraph_vector_t* a,
+  long int s, long int r) {
+  igraph_i_fastgreedy_community *S = &list->e[s], *R = &list->e[r];
+  igraph_i_fastgreedy_community joined;
+  long int i = 0, j = 0, k, ks, kr;
+  igraph_real_t newdq;
+  int mode;
+
+  /* s and r are neighbors of each other, they are not kept */
+  IGRAPH_CHECK(igraph_i_fastgreedy_community_alloc(list, &joined,
+                                                   S->n + R->n - 2));
+  joined.maxnei = -1;
+  while (i < S->n || j < R->n) {
+    ks = i < S->n ? S->nei[i] : list->n;
+    kr = j < R->n ? R->nei[j] : list->n;
+    if (ks == r) { i++; continue; }
+    if (kr == s) { j++; continue; }
+    if (ks < kr) {
+      /* chain, case 1 */
+      k = ks; mode = 0;
+      newdq = S->dq[i++] - 2 * VECTOR(*a)[r] * VECTOR(*a)[k];
+    } else if (kr < ks) {
+      /* chain, case 2 */
+      k = kr; mode = 1;
+      newdq = R->dq[j++] - 2 * VECTOR(*a)[s] * VECTOR(*a)[k];
     } else {
-	  /* case (1) */
-	  /* This is the worst, we have to re-scan the whole community to find
-	   * the new maximum and update the global maximum as well if necessary */
-      igraph_i_fastgreedy_community_rescan_max(comm_to);
-	  /* The maximum was decreased, so perform a sift-down in the heap */
-	  i = igraph_i_fastgreedy_community_list_find_in_heap(list, to);
-	  igraph_i_fastgreedy_community_list_sift_down(list, i);
-  	  if (comm_from->maxdq != p->opposite) {
-		/* The one that we decreased on the opposite side is not the
-		 * maximal one. Nothing to do. */
-	  } else {
-		/* We decreased the maximal on the opposite side as well. Re-scan
-		 * and sift down */
-		igraph_i_fastgreedy_community_rescan_max(comm_from);
-	    j = igraph_i_fastgreedy_community_list_find_in_heap(list, from);
-	    igraph_i_fastgreedy_community_list_sift_down(list, j);
-      }
+      /* s, r and k form a triangle */
+      k = ks; mode = 2;
+      newdq = S->dq[i++] + R->dq[j++];
+    }
+    joined.nei[joined.n] = (igraph_integer_t) k;
+    joined.dq[joined.n] = newdq;
+    joined.n++;
+    if (joined.maxnei < 0 ||
+        IGRAPH_I_FASTGREEDY_BETTER(newdq, k, joined.maxdq, joined.maxnei)) {
+      joined.maxnei = (igraph_integer_t) k;
+      joined.maxdq = newdq;
     }
+    igraph_i_fastgreedy_community_update_nei(list, k, s, r, newdq, mode);
   }
-  return 1;
+
+  /* triangles were counted twice when allocating, give back the rest */
+  if (joined.n < joined.alloc) {
+    if (joined.n == 0) {
+      free(joined.dq);
+      joined.dq = 0;
+      joined.nei = 0;
+    } else {
+      igraph_real_t *tmp;
+      memmove(joined.dq + joined.n, joined.nei,
+              (size_t) joined.n * sizeof(igraph_integer_t));
+      tmp = (igraph_real_t*) realloc(joined.dq, (size_t) joined.n *
+                                     (sizeof(igraph_real_t) + sizeof(igraph_integer_t)));
+      /* if realloc fails, the old (larger) block is still valid */
+      if (tmp != 0) joined.dq = tmp;
+      joined.nei = (igraph_integer_t*) (joined.dq + joined.n);
+    }
+    list->memory -= (joined.alloc - joined.n) *
+      (sizeof(igraph_real_t) + sizeof(igraph_integer_t));
+    joined.alloc = joined.n;
+  }
+
+  /* r is removed from the heap while the heap still agrees with the old
+   * maximum of s */
+  igraph_i_fastgreedy_community_list_remove(list, r);
+  igraph_i_fastgreedy_community_free(list, S);
+  igraph_i_fastgreedy_community_free(list, R);
+  S->n = joined.n;
+  S->alloc = joined.alloc;
+  S->nei = joined.nei;
+  S->dq = joined.dq;
+  S->maxnei = joined.maxnei;
+  S->maxdq = joined.maxdq;
+  R->maxnei = -1;
+  igraph_i_fastgreedy_community_list_update(list, s);
+
+  VECTOR(*a)[s] += VECTOR(*a)[r];
+  VECTOR(*a)[r] = 0.0;
+  S->size += R->size;
+  R->size = 0;
+
+  return 0;
+}
+
+
+/* Auxiliary function to sort a community pair list with respect to the
+ * neighbor */
+static int igraph_i_fastgreedy_commpair_cmp(const void* p1, const void* p2) {
+  const igraph_i_fastgreedy_commpair *cp1 = p1, *cp2 = p2;
+  return cp1->nei < cp2->nei ? -1 : (cp1->nei > cp2->nei ? 1 : 0);
 }
 
 /**
@@ -563,6 +455,12 @@ int igraph_i_fastgreedy_community_update_dq(
  * structure in mega-scale social networks,
  * http://www.arxiv.org/abs/cs.CY/0702048v1 have also been implemented.
  *
+ * </para><para>
+ * The neighboring communities are stored in sorted arrays, so the
+ * algorithm needs about 24 bytes per edge, plus about 50 bytes per
+ * vertex. Ties between pairs of communities that give the same
+ * maximal increase in modularity are broken deterministically.
+ *
  * \param graph The input graph. It must be a graph without multiple edges.
  *    This is checked and an error message is given for graphs with multiple
  *    edges.
@@ -585,6 +483,10 @@ int igraph_i_fastgreedy_community_update_dq(
  * \param membership Pointer to a vector. If not a null pointer, then
  *    the membership vector corresponding to the best split (in terms
  *    of modularity) is stored here. 
+ * \param peak_memory Pointer to a real number or NULL. If not NULL,
+ *    then the peak memory used by the community and neighbor lists
+ *    and the heap is stored here, in bytes. The memory needed for
+ *    the results is not included.
  * \return Error code.
  *
  * \sa \ref igraph_community_walktrap(), \ref
@@ -602,21 +504,18 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 				const igraph_vector_t *weights,
 				igraph_matrix_t *merges, 
 				igraph_vector_t *modularity, 
-				igraph_vector_t *membership) {
+				igraph_vector_t *membership,
+				igraph_real_t *peak_memory) {
   long int no_of_edges, no_of_nodes, no_of_joins, total_joins;
-  long int i, j, k, n, m, from, to, dummy, best_no_of_joins;
-  igraph_integer_t ffrom, fto;
-  igraph_eit_t edgeit;
-  igraph_i_fastgreedy_commpair *pairs, *p1, *p2;
+  long int i, j, k, from, to, dummy, best_no_of_joins, maxdeg;
   igraph_i_fastgreedy_community_list communities;
+  igraph_i_fastgreedy_commpair *pairs;
   igraph_vector_t a;
-  igraph_real_t q, *dq, bestq, weight_sum, loop_weight_sum;
+  igraph_vector_long_t deg;
+  igraph_real_t q, d, bestq, weight_sum, loop_weight_sum;
   igraph_bool_t has_multiple;
   igraph_matrix_t merges_local;
 
-  /*long int join_order[] = { 16,5, 5,6, 6,0, 4,0, 10,0, 26,29, 29,33, 23,33, 27,33, 25,24, 24,31, 12,3, 21,1, 30,8, 8,32, 9,2, 17,1, 11,0, 7,3, 3,2, 13,2, 1,2, 28,31, 31,33, 22,32, 18,32, 20,32, 32,33, 15,33, 14,33, 0,19, 19,2, -1,-1 };*/
-  /*long int join_order[] = { 43,42, 42,41, 44,41, 41,36, 35,36, 37,36, 36,29, 38,29, 34,29, 39,29, 33,29, 40,29, 32,29, 14,29, 30,29, 31,29, 6,18, 18,4, 23,4, 21,4, 19,4, 27,4, 20,4, 22,4, 26,4, 25,4, 24,4, 17,4, 0,13, 13,2, 1,2, 11,2, 8,2, 5,2, 3,2, 10,2, 9,2, 7,2, 2,28, 28,15, 12,15, 29,16, 4,15, -1,-1 };*/
-
   no_of_nodes = igraph_vcount(graph);
   no_of_edges = igraph_ecount(graph);
   
@@ -624,7 +523,7 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 	IGRAPH_ERROR("fast greedy community detection works for undirected graphs only", IGRAPH_UNIMPLEMENTED);
   }
 
-  total_joins=no_of_nodes-1;
+  total_joins=no_of_nodes > 0 ? no_of_nodes-1 : 0;
 
   if (weights != 0) {
     if (igraph_vector_size(weights) < igraph_ecount(graph))
@@ -669,16 +568,29 @@ int igraph_community_fastgreedy(const igraph_t *graph,
     IGRAPH_CHECK(igraph_degree(graph, &a, igraph_vss_all(), IGRAPH_ALL, 1));
   }
 
+  /* Number of neighbors, loop edges are not counted */
+  IGRAPH_CHECK(igraph_vector_long_init(&deg, no_of_nodes));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &deg);
+  for (i=0; i < no_of_edges; i++) {
+    from = (long int) IGRAPH_FROM(graph, i);
+    to = (long int) IGRAPH_TO(graph, i);
+    if (from != to) {
+      VECTOR(deg)[from]++;
+      VECTOR(deg)[to]++;
+    }
+  }
+
   /* Create list of communities */
   debug("Creating community list\n");
   communities.n = no_of_nodes;
-  communities.no_of_communities = no_of_nodes;
+  communities.no_of_communities = 0;
+  communities.memory = communities.peak_memory = 0;
   communities.e = (igraph_i_fastgreedy_community*)calloc((size_t) no_of_nodes, sizeof(igraph_i_fastgreedy_community));
   if (communities.e == 0) {
 	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
   }
   IGRAPH_FINALLY(free, communities.e);
-  communities.heap = (igraph_i_fastgreedy_community**)calloc((size_t) no_of_nodes, sizeof(igraph_i_fastgreedy_community*));
+  communities.heap = (igraph_integer_t*)calloc((size_t) no_of_nodes, sizeof(igraph_integer_t));
   if (communities.heap == 0) {
 	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
   }
@@ -689,36 +601,29 @@ int igraph_community_fastgreedy(const igraph_t *graph,
   }
   IGRAPH_FINALLY_CLEAN(2);
   IGRAPH_FINALLY(igraph_i_fastgreedy_community_list_destroy, &communities);
+  igraph_i_fastgreedy_add_memory(&communities, no_of_nodes *
+    (sizeof(igraph_i_fastgreedy_community) + 2 * sizeof(igraph_integer_t) +
+     sizeof(igraph_real_t)));
+  maxdeg = 0;
   for (i=0; i<no_of_nodes; i++) {
-    igraph_vector_ptr_init(&communities.e[i].neis, 0);
+    IGRAPH_CHECK(igraph_i_fastgreedy_community_alloc(&communities, &communities.e[i],
+                                                     VECTOR(deg)[i]));
     communities.e[i].id = (igraph_integer_t) i;
     communities.e[i].size = 1;
+    communities.e[i].maxnei = -1;
+    if (VECTOR(deg)[i] > maxdeg) maxdeg = VECTOR(deg)[i];
   }
+  igraph_vector_long_destroy(&deg);
+  IGRAPH_FINALLY_CLEAN(1);
 
-  /* Create list of community pairs from edges */
-  debug("Allocating dq vector\n");
-  dq = (igraph_real_t*)calloc((size_t) no_of_edges, sizeof(igraph_real_t));
-  if (dq == 0) {
-	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, dq);
-  debug("Creating community pair list\n");
-  IGRAPH_CHECK(igraph_eit_create(graph, igraph_ess_all(0), &edgeit));
-  IGRAPH_FINALLY(igraph_eit_destroy, &edgeit);
-  pairs = (igraph_i_fastgreedy_commpair*)calloc(2*(size_t) no_of_edges, sizeof(igraph_i_fastgreedy_commpair));
-  if (pairs == 0) {
-	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, pairs);
+  /* Create the neighbor lists from the edges */
+  debug("Creating community neighbor lists\n");
   loop_weight_sum = 0;
-  for (i=0, j=0; !IGRAPH_EIT_END(edgeit); i+=2, j++, IGRAPH_EIT_NEXT(edgeit)) {
-    long int eidx = IGRAPH_EIT_GET(edgeit);
-    igraph_edge(graph, (igraph_integer_t) eidx, &ffrom, &fto);
-    
-	/* Create the pairs themselves */
-	from = (long int)ffrom; to = (long int)fto;
+  for (i=0; i<no_of_edges; i++) {
+	from = (long int) IGRAPH_FROM(graph, i);
+	to = (long int) IGRAPH_TO(graph, i);
 	if (from == to) {
-      loop_weight_sum += weights ? 2*VECTOR(*weights)[eidx] : 2;
+      loop_weight_sum += weights ? 2*VECTOR(*weights)[i] : 2;
       continue;
     }
 
@@ -726,45 +631,52 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 	  dummy=from; from=to; to=dummy;
 	}
     if (weights) {
-      dq[j]=2*(VECTOR(*weights)[eidx]/(weight_sum*2.0) - VECTOR(a)[from]*VECTOR(a)[to]/(4.0*weight_sum*weight_sum));
+      d=2*(VECTOR(*weights)[i]/(weight_sum*2.0) - VECTOR(a)[from]*VECTOR(a)[to]/(4.0*weight_sum*weight_sum));
     } else {
-	  dq[j]=2*(1.0/(no_of_edges*2.0) - VECTOR(a)[from]*VECTOR(a)[to]/(4.0*no_of_edges*no_of_edges));
+	  d=2*(1.0/(no_of_edges*2.0) - VECTOR(a)[from]*VECTOR(a)[to]/(4.0*no_of_edges*no_of_edges));
     }
-	pairs[i].first = from;
-	pairs[i].second = to;
-    pairs[i].dq = &dq[j];
-	pairs[i].opposite = &pairs[i+1];
-	pairs[i+1].first = to;
-	pairs[i+1].second = from;
-	pairs[i+1].dq = pairs[i].dq;
-	pairs[i+1].opposite = &pairs[i];
-	/* Link the pair to the communities */
-	igraph_vector_ptr_push_back(&communities.e[from].neis, &pairs[i]);
-	igraph_vector_ptr_push_back(&communities.e[to].neis, &pairs[i+1]);
-	/* Update maximums */
-	if (communities.e[from].maxdq==0 || *communities.e[from].maxdq->dq < *pairs[i].dq)
-	  communities.e[from].maxdq = &pairs[i];
-	if (communities.e[to].maxdq==0 || *communities.e[to].maxdq->dq < *pairs[i+1].dq)
-	  communities.e[to].maxdq = &pairs[i+1];
+    k = communities.e[from].n++;
+    communities.e[from].nei[k] = (igraph_integer_t) to;
+    communities.e[from].dq[k] = d;
+    k = communities.e[to].n++;
+    communities.e[to].nei[k] = (igraph_integer_t) from;
+    communities.e[to].dq[k] = d;
   }
-  igraph_eit_destroy(&edgeit);
-  IGRAPH_FINALLY_CLEAN(1);
 
   /* Sorting community neighbor lists by community IDs */
   debug("Sorting community neighbor lists\n");
-  for (i=0, j=0; i<no_of_nodes; i++) {
-    igraph_i_fastgreedy_community_sort_neighbors_of(&communities, i, 0);
+  pairs = igraph_Calloc(maxdeg > 0 ? maxdeg : 1, igraph_i_fastgreedy_commpair);
+  if (pairs == 0) {
+	IGRAPH_ERROR("can't run fast greedy community detection", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(free, pairs);
+  igraph_i_fastgreedy_add_memory(&communities, maxdeg * sizeof(igraph_i_fastgreedy_commpair));
+  for (i=0; i<no_of_nodes; i++) {
+    igraph_i_fastgreedy_community *comm = &communities.e[i];
+    for (j=0; j<comm->n; j++) {
+      pairs[j].nei = comm->nei[j];
+      pairs[j].dq = comm->dq[j];
+    }
+    igraph_qsort(pairs, (size_t) comm->n, sizeof(igraph_i_fastgreedy_commpair),
+                 igraph_i_fastgreedy_commpair_cmp);
+    for (j=0; j<comm->n; j++) {
+      comm->nei[j] = pairs[j].nei;
+      comm->dq[j] = pairs[j].dq;
+    }
+    igraph_i_fastgreedy_community_rescan_max(comm);
     /* Isolated vertices and vertices with loop edges only won't be stored in
-     * the heap (to avoid maxdq == 0) */
-    if (communities.e[i].maxdq != 0) {
-      communities.heap[j] = &communities.e[i];
-      communities.heapindex[i] = (igraph_integer_t) j;
-      j++;
+     * the heap */
+    if (comm->maxnei >= 0) {
+      communities.heap[communities.no_of_communities] = (igraph_integer_t) i;
+      communities.heapindex[i] = (igraph_integer_t) communities.no_of_communities;
+      communities.no_of_communities++;
     } else {
       communities.heapindex[i] = -1;
     }
   }
-  communities.no_of_communities = j;
+  free(pairs);
+  IGRAPH_FINALLY_CLEAN(1);
+  communities.memory -= maxdeg * sizeof(igraph_i_fastgreedy_commpair);
 
   /* Calculate proper vector a (see paper) and initial modularity */
   q = 2.0 * (weights ? weight_sum : no_of_edges);
@@ -803,180 +715,29 @@ int igraph_community_fastgreedy(const igraph_t *graph,
       best_no_of_joins = no_of_joins;
     }
 
-	/* Some debug info if needed */
-	/* igraph_i_fastgreedy_community_list_check_heap(&communities); */
-#ifdef DEBUG
-	debug("===========================================\n");
-	for (i=0; i<communities.n; i++) {
-	  if (communities.e[i].maxdq == 0) {
-	    debug("Community #%ld: PASSIVE\n", i);
-	    continue;
-	  }
-      debug("Community #%ld\n ", i);
-	  for (j=0; j<igraph_vector_ptr_size(&communities.e[i].neis); j++) {
-	    p1=(igraph_i_fastgreedy_commpair*)VECTOR(communities.e[i].neis)[j];
-	    debug(" (%ld,%ld,%.4f)", p1->first, p1->second, *p1->dq);
-	  }
-	  p1=communities.e[i].maxdq;
-	  debug("\n  Maxdq: (%ld,%ld,%.4f)\n", p1->first, p1->second, *p1->dq);
-    }
-	debug("Global maxdq is: (%ld,%ld,%.4f)\n", communities.heap[0]->maxdq->first,
-	    communities.heap[0]->maxdq->second, *communities.heap[0]->maxdq->dq);
-    for (i=0; i<communities.no_of_communities; i++)
-	  debug("(%ld,%ld,%.4f) ", communities.heap[i]->maxdq->first, communities.heap[i]->maxdq->second, *communities.heap[0]->maxdq->dq);
-	debug("\n");
-#endif
-	if (communities.heap[0] == 0) break; /* no more communities */
-	if (communities.heap[0]->maxdq == 0) break; /* there are only isolated comms */
-    to=communities.heap[0]->maxdq->second;
-	from=communities.heap[0]->maxdq->first;
+	if (communities.no_of_communities == 0) break; /* there are only isolated comms */
+	from=communities.heap[0];
+	to=communities.e[from].maxnei;
 
 	debug("Q[%ld] = %.7f\tdQ = %.7f\t |H| = %ld\n",
-	  no_of_joins, q, *communities.heap[0]->maxdq->dq, no_of_nodes-no_of_joins-1);
-
-	/* DEBUG */
-	/* from=join_order[no_of_joins*2]; to=join_order[no_of_joins*2+1];
-	if (to == -1) break;
-    for (i=0; i<igraph_vector_ptr_size(&communities.e[to].neis); i++) {
-      p1=(igraph_i_fastgreedy_commpair*)VECTOR(communities.e[to].neis)[i];
-	  if (p1->second == from) communities.maxdq = p1;
-	} */
-
-	n = igraph_vector_ptr_size(&communities.e[to].neis);
-	m = igraph_vector_ptr_size(&communities.e[from].neis);
-	/*if (n>m) {
-	  dummy=n; n=m; m=dummy;
-	  dummy=to; to=from; from=dummy;
-	}*/
+	  no_of_joins, q, communities.e[from].maxdq, no_of_nodes-no_of_joins-1);
 	debug("  joining: %ld <- %ld\n", to, from);
-    q += *communities.heap[0]->maxdq->dq; 
-	
-	/* Merge the second community into the first */
-	i = j = 0;
-	while (i<n && j<m) {
-	  p1 = (igraph_i_fastgreedy_commpair*)VECTOR(communities.e[to].neis)[i];
-	  p2 = (igraph_i_fastgreedy_commpair*)VECTOR(communities.e[from].neis)[j];
-	  debug("Pairs: %ld-%ld and %ld-%ld\n", p1->first, p1->second,
-		  p2->first, p2->second);
-	  if (p1->second < p2->second) {
-		/* Considering p1 from now on */
-		debug("    Considering: %ld-%ld\n", p1->first, p1->second);
-	    if (p1->second == from) {
-		  debug("    WILL REMOVE: %ld-%ld\n", to, from);
-	    } else {
-		  /* chain, case 1 */
-		  debug("    CHAIN(1): %ld-%ld %ld, now=%.7f, adding=%.7f, newdq(%ld,%ld)=%.7f\n",
-		    to, p1->second, from, *p1->dq, -2*VECTOR(a)[from]*VECTOR(a)[p1->second], p1->first, p1->second, *p1->dq-2*VECTOR(a)[from]*VECTOR(a)[p1->second]);
-		  igraph_i_fastgreedy_community_update_dq(&communities, p1, *p1->dq - 2*VECTOR(a)[from]*VECTOR(a)[p1->second]);
-		}
-		i++;
-	  } else if (p1->second == p2->second) {
-	    /* p1->first, p1->second and p2->first form a triangle */
-		debug("    Considering: %ld-%ld and %ld-%ld\n", p1->first, p1->second,
-		  p2->first, p2->second);
-		/* Update dq value */
-		debug("    TRIANGLE: %ld-%ld-%ld, now=%.7f, adding=%.7f, newdq(%ld,%ld)=%.7f\n",
-		  to, p1->second, from, *p1->dq, *p2->dq, p1->first, p1->second, *p1->dq+*p2->dq);
-		igraph_i_fastgreedy_community_update_dq(&communities, p1, *p1->dq + *p2->dq);
-        igraph_i_fastgreedy_community_remove_nei(&communities, p1->second, from);
-		i++;
-		j++;
-	  } else {
-		debug("    Considering: %ld-%ld\n", p2->first, p2->second);
-		if (p2->second == to) {
-		  debug("    WILL REMOVE: %ld-%ld\n", p2->second, p2->first);
-		} else {
-		  /* chain, case 2 */
-		  debug("    CHAIN(2): %ld %ld-%ld, newdq(%ld,%ld)=%.7f\n",
-		    to, p2->second, from, to, p2->second, *p2->dq-2*VECTOR(a)[to]*VECTOR(a)[p2->second]);
-		  p2->opposite->second=to;
-		  /* p2->opposite->second changed, so it means that
-		   * communities.e[p2->second].neis (which contains p2->opposite) is
-		   * not sorted any more. We have to find the index of p2->opposite in
-		   * this vector and move it to the correct place. Moving should be an
-		   * O(n) operation; re-sorting would be O(n*logn) or even worse,
-		   * depending on the pivoting strategy used by qsort() since the
-		   * vector is nearly sorted */
-		  igraph_i_fastgreedy_community_sort_neighbors_of(
-				  &communities, p2->second, p2->opposite);
-		  /* link from.neis[j] to the current place in to.neis if
-		   * from.neis[j] != to */
-		  p2->first=to;
-		  IGRAPH_CHECK(igraph_vector_ptr_insert(&communities.e[to].neis,i,p2));
-		  n++; i++;
-		  if (*p2->dq > *communities.e[to].maxdq->dq) {
-		    communities.e[to].maxdq = p2;
-            k=igraph_i_fastgreedy_community_list_find_in_heap(&communities, to);
-		    igraph_i_fastgreedy_community_list_sift_up(&communities, k);
-		  }
-		  igraph_i_fastgreedy_community_update_dq(&communities, p2, *p2->dq - 2*VECTOR(a)[to]*VECTOR(a)[p2->second]);
-		}
-		j++;
-	  }
-	}
-
-	while (i<n) {
-	  p1 = (igraph_i_fastgreedy_commpair*)VECTOR(communities.e[to].neis)[i];
-	  if (p1->second == from) {
-	    debug("    WILL REMOVE: %ld-%ld\n", p1->first, from);
-	  } else {
-	    /* chain, case 1 */
-	    debug("    CHAIN(1): %ld-%ld %ld, now=%.7f, adding=%.7f, newdq(%ld,%ld)=%.7f\n",
-	      to, p1->second, from, *p1->dq, -2*VECTOR(a)[from]*VECTOR(a)[p1->second], p1->first, p1->second, *p1->dq-2*VECTOR(a)[from]*VECTOR(a)[p1->second]);
-	    igraph_i_fastgreedy_community_update_dq(&communities, p1, *p1->dq - 2*VECTOR(a)[from]*VECTOR(a)[p1->second]);
-	  }
-	  i++;
-	}
-	while (j<m) {
-	  p2 = (igraph_i_fastgreedy_commpair*)VECTOR(communities.e[from].neis)[j];
-      if (to == p2->second) { j++; continue; }
-	  /* chain, case 2 */
-	  debug("    CHAIN(2): %ld %ld-%ld, newdq(%ld,%ld)=%.7f\n",
-	    to, p2->second, from, p1->first, p2->second, *p2->dq-2*VECTOR(a)[to]*VECTOR(a)[p2->second]);
-	  p2->opposite->second=to;
-	  /* need to re-sort community nei list `p2->second` */
-      igraph_i_fastgreedy_community_sort_neighbors_of(&communities, p2->second, p2->opposite);
-	  /* link from.neis[j] to the current place in to.neis if
-	   * from.neis[j] != to */
-	  p2->first=to;
-	  IGRAPH_CHECK(igraph_vector_ptr_push_back(&communities.e[to].neis,p2));
-	  if (*p2->dq > *communities.e[to].maxdq->dq) {
-	    communities.e[to].maxdq = p2;
-        k=igraph_i_fastgreedy_community_list_find_in_heap(&communities, to);
-		igraph_i_fastgreedy_community_list_sift_up(&communities, k);
-	  }
-	  igraph_i_fastgreedy_community_update_dq(&communities, p2, *p2->dq-2*VECTOR(a)[to]*VECTOR(a)[p2->second]);
-	  j++;
-	}
-
-	/* Now, remove community `from` from the neighbors of community `to` */
-	if (communities.no_of_communities > 2) {
-	  debug("    REMOVING: %ld-%ld\n", to, from);
-	  igraph_i_fastgreedy_community_remove_nei(&communities, to, from);
-	  i=igraph_i_fastgreedy_community_list_find_in_heap(&communities, from);
-	  igraph_i_fastgreedy_community_list_remove(&communities, i);
-    }
-	communities.e[from].maxdq=0;
-
-    /* Update community sizes */
-    communities.e[to].size += communities.e[from].size;
-    communities.e[from].size = 0;
+    q += communities.e[from].maxdq;
 
 	/* record what has been merged */
-	/* igraph_vector_ptr_clear is not enough here as it won't free
-	 * the memory consumed by communities.e[from].neis. Thanks
-	 * to Tom Gregorovic for pointing that out. */
-	igraph_vector_ptr_destroy(&communities.e[from].neis);
 	if (merges) {
 	  MATRIX(*merges, no_of_joins, 0) = communities.e[to].id;
 	  MATRIX(*merges, no_of_joins, 1) = communities.e[from].id;
-	  communities.e[to].id = (igraph_integer_t) (no_of_nodes+no_of_joins);
     }
 
-	/* Update vector a */
-	VECTOR(a)[to] += VECTOR(a)[from];
-	VECTOR(a)[from] = 0.0;
-	
+	/* Merge the community with fewer neighbors into the other one, this
+	 * needs fewer updates in the neighbor lists */
+	if (communities.e[from].n > communities.e[to].n) {
+	  dummy=from; from=to; to=dummy;
+	}
+	IGRAPH_CHECK(igraph_i_fastgreedy_community_join(&communities, &a, to, from));
+	communities.e[to].id = (igraph_integer_t) (no_of_nodes+no_of_joins);
+
 	no_of_joins++;
   }
   /* TODO: continue merging when some isolated communities remained. Always
@@ -1001,12 +762,14 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 	igraph_vector_resize(modularity, no_of_joins+1);
   }
 
+  if (peak_memory) {
+    *peak_memory = communities.peak_memory;
+  }
+
   debug("Freeing memory\n");
-  free(pairs);
-  free(dq);
   igraph_i_fastgreedy_community_list_destroy(&communities);
   igraph_vector_destroy(&a);
-  IGRAPH_FINALLY_CLEAN(4);
+  IGRAPH_FINALLY_CLEAN(2);
 
   if (membership) {
     IGRAPH_CHECK(igraph_community_to_membership(merges,
@@ -1028,4 +791,3 @@ int igraph_community_fastgreedy(const igraph_t *graph,
 #undef IGRAPH_FASTCOMM_DEBUG
 #endif
 
-
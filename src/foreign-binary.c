@@ -0,0 +1,830 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2018  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include "igraph_foreign.h"
+#include "config.h"
+#include "igraph_attributes.h"
+#include "igraph_interface.h"
+#include "igraph_interrupt_internal.h"
+#include "igraph_memory.h"
+#include "igraph_types_internal.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#if HAVE_SYS_MMAN_H == 1 && HAVE_UNISTD_H == 1
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define IGRAPH_I_BINARY_MMAP 1
+#endif
+
+/*
+ * The binary graph format, version 1. All numbers are in the byte
+ * order of the machine that wrote the file, the byte order mark in
+ * the header is used to detect files coming from a different
+ * architecture. Every section is padded with zeros to a multiple of
+ * eight bytes.
+ *
+ * The header, 56 bytes:
+ *   - char[8]  magic, "IGRAPHBN"
+ *   - uint32   version
+ *   - uint32   byte order mark, 0x01020304
+ *   - uint32   directed (0 or 1)
+ *   - uint32   reserved, zero
+ *   - int64    number of vertices, n
+ *   - int64    number of edges, m
+ *   - uint32   number of graph, vertex and edge attributes
+ *   - uint32   reserved, zero
+ *
+ * The graph structure, the from, to, oi, ii vectors (m int32 each) and
+ * the os, is vectors (n+1 int32 each) of igraph_t, in this order.
+ *
+ * The attributes, graph attributes first, then vertex, then edge
+ * attributes. For each of them:
+ *   - uint32   type, an igraph_attribute_type_t value
+ *   - uint32   length of the name
+ *   - char[]   the name, not zero terminated
+ *   - the values, one for graph attributes, n for vertex and m for
+ *     edge attributes. Numeric values are doubles, boolean ones
+ *     are bytes, strings are an uint32 length followed by the
+ *     characters.
+ */
+
+#define IGRAPH_I_BINARY_MAGIC "IGRAPHBN"
+#define IGRAPH_I_BINARY_VERSION 1
+#define IGRAPH_I_BINARY_BYTEORDER 0x01020304
+#define IGRAPH_I_BINARY_HEADER 56
+#define IGRAPH_I_BINARY_BLOCK 4096
+
+#define IGRAPH_I_BINARY_PADDING(bytes) ((8 - (size_t)(bytes) % 8) % 8)
+
+typedef struct igraph_i_binary_in_t {
+  FILE *stream;
+  const char *map;		/* the mapped file or NULL */
+  size_t mapsize;
+  size_t pos;			/* current position in the map */
+  size_t size;			/* size of a regular file, SIZE_MAX if unknown */
+} igraph_i_binary_in_t;
+
+static void igraph_i_binary_in_destroy(igraph_i_binary_in_t *in) {
+#ifdef IGRAPH_I_BINARY_MMAP
+  if (in->map) {
+    munmap((void*) in->map, in->mapsize);
+    in->map=0;
+  }
+#endif
+}
+
+/* Map the file if the stream belongs to a regular file, otherwise
+   (pipes, memory streams, no mmap() on the system) it is read with
+   fread(). The size of a regular file is kept even if it cannot be
+   mapped, to check the sizes in the header. */
+
+static void igraph_i_binary_in_init(igraph_i_binary_in_t *in,
+				    FILE *stream) {
+  in->stream=stream;
+  in->map=0;
+  in->mapsize=0;
+  in->pos=0;
+  in->size=SIZE_MAX;
+#ifdef IGRAPH_I_BINARY_MMAP
+  {
+    struct stat st;
+    long int offset=ftell(stream);
+    int fd=fileno(stream);
+    if (offset >= 0 && fd >= 0 && fstat(fd, &st) == 0 &&
+	S_ISREG(st.st_mode) && st.st_size >= offset &&
+	(uintmax_t) st.st_size < (uintmax_t) SIZE_MAX) {
+      in->size=(size_t) st.st_size;
+    }
+    if (in->size != SIZE_MAX && in->size > (size_t) offset) {
+      void *map=mmap(0, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+	madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+	in->map=map;
+	in->mapsize=(size_t) st.st_size;
+	in->pos=(size_t) offset;
+      }
+    }
+  }
+#endif
+}
+
+/* Leave the stream right after the graph, as the text readers do */
+
+static int igraph_i_binary_in_finish(igraph_i_binary_in_t *in) {
+  if (in->map && fseek(in->stream, (long int) in->pos, SEEK_SET) != 0) {
+    IGRAPH_ERROR("Cannot seek in binary graph file", IGRAPH_EFILE);
+  }
+  return 0;
+}
+
+static int igraph_i_binary_read(igraph_i_binary_in_t *in, void *dest,
+				size_t bytes) {
+  if (in->map) {
+    if (in->mapsize - in->pos < bytes) {
+      IGRAPH_ERROR("Unexpected end of binary graph file", IGRAPH_PARSEERROR);
+    }
+    memcpy(dest, in->map + in->pos, bytes);
+    in->pos += bytes;
+  } else if (fread(dest, 1, bytes, in->stream) != bytes) {
+    IGRAPH_ERROR("Unexpected end of binary graph file", IGRAPH_PARSEERROR);
+  }
+  return 0;
+}
+
+static int igraph_i_binary_read_padding(igraph_i_binary_in_t *in,
+					size_t bytes) {
+  char pad[8];
+  return igraph_i_binary_read(in, pad, IGRAPH_I_BINARY_PADDING(bytes));
+}
+
+/* The number of bytes left in a regular file, SIZE_MAX if it is not
+   known. Sizes from the file are checked against it before the
+   memory is allocated for them, so a corrupt file is a parse error,
+   and not an out of memory error. */
+
+static size_t igraph_i_binary_left(const igraph_i_binary_in_t *in) {
+  long int offset;
+  if (in->map) {
+    return in->mapsize - in->pos;
+  }
+  if (in->size == SIZE_MAX || (offset=ftell(in->stream)) < 0) {
+    return SIZE_MAX;
+  }
+  return (size_t) offset < in->size ? in->size - (size_t) offset : 0;
+}
+
+static int igraph_i_binary_check_left(const igraph_i_binary_in_t *in,
+				      size_t bytes) {
+  if (igraph_i_binary_left(in) < bytes) {
+    IGRAPH_ERROR("Unexpected end of binary graph file", IGRAPH_PARSEERROR);
+  }
+  return 0;
+}
+
+/* Read 'len' characters into 'buf' and terminate them with a zero.
+   Pipes have no size, so 'buf' grows with the data that was actually
+   read, see also igraph_i_binary_read_ids(). */
+
+static int igraph_i_binary_read_chars(igraph_i_binary_in_t *in,
+				      igraph_vector_char_t *buf,
+				      size_t len) {
+  size_t i, chunk;
+
+  IGRAPH_CHECK(igraph_i_binary_check_left(in, len));
+  igraph_vector_char_clear(buf);
+  for (i=0; i<len; i+=chunk) {
+    long int cap=igraph_vector_char_capacity(buf);
+    chunk = len-i < IGRAPH_I_BINARY_BLOCK ? len-i : IGRAPH_I_BINARY_BLOCK;
+    if ((size_t) cap < i+chunk+1) {
+      size_t newcap = 2*(size_t) cap < len+1 ? 2*(size_t) cap : len+1;
+      IGRAPH_CHECK(igraph_vector_char_reserve(buf, (long int)
+	(newcap > i+chunk+1 ? newcap : i+chunk+1)));
+    }
+    IGRAPH_CHECK(igraph_vector_char_resize(buf, (long int) (i+chunk)));
+    IGRAPH_CHECK(igraph_i_binary_read(in, VECTOR(*buf)+i, chunk));
+  }
+  IGRAPH_CHECK(igraph_vector_char_push_back(buf, '\0'));
+  return 0;
+}
+
+/* Read 'len' ids into 'v', all of them must be in [0, limit]. 'v'
+   grows with the data read, the length in the header is not trusted
+   for the allocation, if the size of the input is not known. */
+
+static int igraph_i_binary_read_ids(igraph_i_binary_in_t *in,
+				    igraph_i_graph_vector_t *v,
+				    long int len, long int limit) {
+  int32_t buf[IGRAPH_I_BINARY_BLOCK];
+  long int i, j, chunk;
+
+  IGRAPH_I_GRAPH_VECTOR(clear)(v);
+  for (i=0; i<len; i+=chunk) {
+    long int cap=IGRAPH_I_GRAPH_VECTOR(capacity)(v);
+    IGRAPH_ALLOW_INTERRUPTION();
+    chunk = len-i < IGRAPH_I_BINARY_BLOCK ? len-i : IGRAPH_I_BINARY_BLOCK;
+    if (cap < i+chunk) {
+      long int newcap = 2*cap < len ? 2*cap : len;
+      IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(reserve)(v, newcap > i+chunk ?
+						  newcap : i+chunk));
+    }
+    IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(resize)(v, i+chunk));
+    IGRAPH_CHECK(igraph_i_binary_read(in, buf, sizeof(int32_t) *
+				      (size_t) chunk));
+    for (j=0; j<chunk; j++) {
+      if (buf[j] < 0 || buf[j] > limit) {
+	IGRAPH_ERROR("Invalid id in binary graph file", IGRAPH_PARSEERROR);
+      }
+      VECTOR(*v)[i+j] = buf[j];
+    }
+  }
+  IGRAPH_CHECK(igraph_i_binary_read_padding(in, sizeof(int32_t) *
+					    (size_t) len));
+  return 0;
+}
+
+/* The index 'idx' (oi or ii) must be a permutation of the edges that
+   sorts them by 'key' (from or to), and then by 'key2', and 'start'
+   (os or is) must point to the first edge of every vertex in this
+   order. The ranges of the ids are already checked when they are
+   read. The graph functions rely on all this, e.g. they look up
+   edges with binary search, so a file that was not written by
+   igraph_write_graph_binary() cannot give an invalid graph. */
+
+static int igraph_i_binary_check_index(const igraph_i_graph_vector_t *idx,
+				       const igraph_i_graph_vector_t *start,
+				       const igraph_i_graph_vector_t *key,
+				       const igraph_i_graph_vector_t *key2,
+				       long int no_of_nodes,
+				       long int no_of_edges) {
+  igraph_vector_bool_t seen;
+  long int i, v;
+
+  if (VECTOR(*start)[0] != 0 || VECTOR(*start)[no_of_nodes] != no_of_edges) {
+    IGRAPH_ERROR("Invalid index in binary graph file", IGRAPH_PARSEERROR);
+  }
+  for (v=0; v<no_of_nodes; v++) {
+    if (VECTOR(*start)[v+1] < VECTOR(*start)[v]) {
+      IGRAPH_ERROR("Invalid index in binary graph file", IGRAPH_PARSEERROR);
+    }
+  }
+
+  IGRAPH_CHECK(igraph_vector_bool_init(&seen, no_of_edges));
+  IGRAPH_FINALLY(igraph_vector_bool_destroy, &seen);
+  for (v=0; v<no_of_nodes; v++) {
+    for (i=(long int) VECTOR(*start)[v];
+	 i<(long int) VECTOR(*start)[v+1]; i++) {
+      long int e=(long int) VECTOR(*idx)[i];
+      if (VECTOR(seen)[e] || VECTOR(*key)[e] != v ||
+	  (i > VECTOR(*start)[v] &&
+	   VECTOR(*key2)[e] < VECTOR(*key2)[(long int) VECTOR(*idx)[i-1]])) {
+	IGRAPH_ERROR("Invalid index in binary graph file", IGRAPH_PARSEERROR);
+      }
+      VECTOR(seen)[e]=1;
+    }
+  }
+  igraph_vector_bool_destroy(&seen);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
+}
+
+static void igraph_i_binary_attribute_destroy(igraph_attribute_record_t *rec) {
+  if (rec->value) {
+    if (rec->type == IGRAPH_ATTRIBUTE_NUMERIC) {
+      igraph_vector_destroy((igraph_vector_t*) rec->value);
+    } else if (rec->type == IGRAPH_ATTRIBUTE_STRING) {
+      igraph_strvector_destroy((igraph_strvector_t*) rec->value);
+    } else if (rec->type == IGRAPH_ATTRIBUTE_BOOLEAN) {
+      igraph_vector_bool_destroy((igraph_vector_bool_t*) rec->value);
+    }
+    igraph_Free(rec->value);
+  }
+  if (rec->name) {
+    igraph_Free(rec->name);
+  }
+}
+
+static int igraph_i_binary_read_attribute(igraph_i_binary_in_t *in,
+					  igraph_vector_ptr_t *attrs,
+					  long int count) {
+  uint32_t head[2];
+  igraph_attribute_record_t *rec;
+  igraph_vector_char_t str;
+  char *name;
+  long int i, j, chunk;
+  int ret;
+
+  IGRAPH_CHECK(igraph_i_binary_read(in, head, sizeof(head)));
+  if (head[0] != IGRAPH_ATTRIBUTE_NUMERIC &&
+      head[0] != IGRAPH_ATTRIBUTE_STRING &&
+      head[0] != IGRAPH_ATTRIBUTE_BOOLEAN) {
+    IGRAPH_ERROR("Unknown attribute type in binary graph file",
+		 IGRAPH_PARSEERROR);
+  }
+
+  /* the record is owned by 'attrs' from now on, its value is only
+     set once it is fully allocated */
+  rec=igraph_Calloc(1, igraph_attribute_record_t);
+  if (!rec) {
+    IGRAPH_ERROR("Cannot read binary graph file", IGRAPH_ENOMEM);
+  }
+  ret=igraph_vector_ptr_push_back(attrs, rec);
+  if (ret) {
+    igraph_Free(rec);
+    IGRAPH_ERROR("Cannot read binary graph file", ret);
+  }
+  rec->type=(igraph_attribute_type_t) head[0];
+
+  IGRAPH_CHECK(igraph_vector_char_init(&str, 0));
+  IGRAPH_FINALLY(igraph_vector_char_destroy, &str);
+  IGRAPH_CHECK(igraph_i_binary_read_chars(in, &str, head[1]));
+  name=igraph_Calloc((size_t) head[1]+1, char);
+  if (!name) {
+    IGRAPH_ERROR("Cannot read binary graph file", IGRAPH_ENOMEM);
+  }
+  memcpy(name, VECTOR(str), (size_t) head[1]+1);
+  rec->name=name;
+  IGRAPH_CHECK(igraph_i_binary_read_padding(in, head[1]));
+
+  if (rec->type == IGRAPH_ATTRIBUTE_NUMERIC) {
+    igraph_vector_t *v=igraph_Calloc(1, igraph_vector_t);
+    if (!v) {
+      IGRAPH_ERROR("Cannot read binary graph file", IGRAPH_ENOMEM);
+    }
+    ret=igraph_vector_init(v, count);
+    if (ret) {
+      igraph_Free(v);
+      IGRAPH_ERROR("Cannot read binary graph file", ret);
+    }
+    rec->value=v;
+    IGRAPH_CHECK(igraph_i_binary_read(in, VECTOR(*v),
+				      sizeof(double) * (size_t) count));
+
+  } else if (rec->type == IGRAPH_ATTRIBUTE_BOOLEAN) {
+    unsigned char buf[IGRAPH_I_BINARY_BLOCK];
+    igraph_vector_bool_t *v=igraph_Calloc(1, igraph_vector_bool_t);
+    if (!v) {
+      IGRAPH_ERROR("Cannot read binary graph file", IGRAPH_ENOMEM);
+    }
+    ret=igraph_vector_bool_init(v, count);
+    if (ret) {
+      igraph_Free(v);
+      IGRAPH_ERROR("Cannot read binary graph file", ret);
+    }
+    rec->value=v;
+    for (i=0; i<count; i+=chunk) {
+      chunk = count-i < IGRAPH_I_BINARY_BLOCK ? count-i : IGRAPH_I_BINARY_BLOCK;
+      IGRAPH_CHECK(igraph_i_binary_read(in, buf, (size_t) chunk));
+      for (j=0; j<chunk; j++) {
+	VECTOR(*v)[i+j] = buf[j] ? 1 : 0;
+      }
+    }
+    IGRAPH_CHECK(igraph_i_binary_read_padding(in, (size_t) count));
+
+  } else {
+    igraph_strvector_t *v=igraph_Calloc(1, igraph_strvector_t);
+    size_t bytes=0;
+    uint32_t len;
+    if (!v) {
+      IGRAPH_ERROR("Cannot read binary graph file", IGRAPH_ENOMEM);
+    }
+    ret=igraph_strvector_init(v, count);
+    if (ret) {
+      igraph_Free(v);
+      IGRAPH_ERROR("Cannot read binary graph file", ret);
+    }
+    rec->value=v;
+    for (i=0; i<count; i++) {
+      IGRAPH_CHECK(igraph_i_binary_read(in, &len, sizeof(len)));
+      IGRAPH_CHECK(igraph_i_binary_read_chars(in, &str, len));
+      IGRAPH_CHECK(igraph_strvector_set2(v, i, VECTOR(str), len));
+      bytes += sizeof(len) + len;
+    }
+    IGRAPH_CHECK(igraph_i_binary_read_padding(in, bytes));
+  }
+
+  igraph_vector_char_destroy(&str);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
+}
+
+/**
+ * \function igraph_read_graph_binary
+ * \brief Reads a graph from a binary file.
+ *
+ * </para><para>
+ * The binary format contains the internal representation of the
+ * graph, i.e. the edge list together with its indices, and the
+ * numeric, string and boolean graph, vertex and edge
+ * attributes. Reading it involves no parsing and no sorting, the
+ * data is copied into the graph as it is. If the stream belongs to
+ * a regular file and the system supports it, then the file is
+ * memory mapped, otherwise it is read with the usual stream
+ * functions.
+ *
+ * </para><para>
+ * The file must be written by \ref igraph_write_graph_binary() on
+ * a machine with the same byte order. The ranges of the ids in the
+ * file are checked, and so is whether the indices really sort the
+ * edge list, this takes linear time.
+ *
+ * \param graph Pointer to an uninitialized graph object.
+ * \param instream The stream to read the graph from. It is left at
+ *        the end of the graph.
+ * \return Error code:
+ *         \c IGRAPH_PARSEERROR if the file is not a binary graph
+ *         file, it has an unsupported version, or it is invalid.
+ *         \c IGRAPH_EFILE if there is an error reading the file.
+ *
+ * Time complexity: O(|V|+|E|), the number of vertices plus the
+ * number of edges, and the size of the attributes.
+ */
+
+int igraph_read_graph_binary(igraph_t *graph, FILE *instream) {
+
+  igraph_i_binary_in_t in;
+  char header[IGRAPH_I_BINARY_HEADER];
+  uint32_t version, byteorder, directed, nattrs[3];
+  int64_t n64, m64;
+  long int no_of_nodes, no_of_edges, i, k;
+  igraph_i_graph_vector_t from, to, oi, ii, os, is;
+  igraph_vector_ptr_t gattrs, vattrs, eattrs;
+  igraph_vector_ptr_t *attrs[3];
+
+  igraph_i_binary_in_init(&in, instream);
+  IGRAPH_FINALLY(igraph_i_binary_in_destroy, &in);
+
+  IGRAPH_CHECK(igraph_i_binary_read(&in, header, IGRAPH_I_BINARY_HEADER));
+  if (memcmp(header, IGRAPH_I_BINARY_MAGIC, 8) != 0) {
+    IGRAPH_ERROR("Not a binary graph file", IGRAPH_PARSEERROR);
+  }
+  memcpy(&version, header+8, sizeof(uint32_t));
+  memcpy(&byteorder, header+12, sizeof(uint32_t));
+  memcpy(&directed, header+16, sizeof(uint32_t));
+  memcpy(&n64, header+24, sizeof(int64_t));
+  memcpy(&m64, header+32, sizeof(int64_t));
+  memcpy(nattrs, header+40, 3*sizeof(uint32_t));
+  if (byteorder != IGRAPH_I_BINARY_BYTEORDER) {
+    IGRAPH_ERROR("Binary graph file was written on a machine with a "
+		 "different byte order", IGRAPH_PARSEERROR);
+  }
+  if (version != IGRAPH_I_BINARY_VERSION) {
+    IGRAPH_ERROR("Unsupported binary graph file version",
+		 IGRAPH_PARSEERROR);
+  }
+  if (n64 < 0 || m64 < 0 || n64 >= INT_MAX || m64 >= INT_MAX) {
+    IGRAPH_ERROR("Invalid graph size in binary graph file",
+		 IGRAPH_PARSEERROR);
+  }
+  no_of_nodes=(long int) n64;
+  no_of_edges=(long int) m64;
+  if (igraph_i_binary_left(&in) / sizeof(int32_t) <
+      4 * (size_t) no_of_edges + 2 * (size_t) no_of_nodes + 2) {
+    IGRAPH_ERROR("Unexpected end of binary graph file", IGRAPH_PARSEERROR);
+  }
+
+  /* The structure */
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(&from, 0));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &from);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(&to, 0));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &to);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(&oi, 0));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &oi);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(&ii, 0));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &ii);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(&os, 0));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &os);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(&is, 0));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &is);
+
+  IGRAPH_CHECK(igraph_i_binary_read_ids(&in, &from, no_of_edges,
+					no_of_nodes-1));
+  IGRAPH_CHECK(igraph_i_binary_read_ids(&in, &to, no_of_edges,
+					no_of_nodes-1));
+  IGRAPH_CHECK(igraph_i_binary_read_ids(&in, &oi, no_of_edges,
+					no_of_edges-1));
+  IGRAPH_CHECK(igraph_i_binary_read_ids(&in, &ii, no_of_edges,
+					no_of_edges-1));
+  IGRAPH_CHECK(igraph_i_binary_read_ids(&in, &os, no_of_nodes+1,
+					no_of_edges));
+  IGRAPH_CHECK(igraph_i_binary_read_ids(&in, &is, no_of_nodes+1,
+					no_of_edges));
+  IGRAPH_CHECK(igraph_i_binary_check_index(&oi, &os, &from, &to,
+					   no_of_nodes, no_of_edges));
+  IGRAPH_CHECK(igraph_i_binary_check_index(&ii, &is, &to, &from,
+					   no_of_nodes, no_of_edges));
+  if (!directed) {
+    for (i=0; i<no_of_edges; i++) {
+      if (VECTOR(from)[i] < VECTOR(to)[i]) {
+	IGRAPH_ERROR("Invalid undirected edge in binary graph file",
+		     IGRAPH_PARSEERROR);
+      }
+    }
+  }
+
+  /* The attributes */
+  IGRAPH_CHECK(igraph_vector_ptr_init(&gattrs, 0));
+  IGRAPH_VECTOR_PTR_SET_ITEM_DESTRUCTOR(&gattrs,
+					igraph_i_binary_attribute_destroy);
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy_all, &gattrs);
+  IGRAPH_CHECK(igraph_vector_ptr_init(&vattrs, 0));
+  IGRAPH_VECTOR_PTR_SET_ITEM_DESTRUCTOR(&vattrs,
+					igraph_i_binary_attribute_destroy);
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy_all, &vattrs);
+  IGRAPH_CHECK(igraph_vector_ptr_init(&eattrs, 0));
+  IGRAPH_VECTOR_PTR_SET_ITEM_DESTRUCTOR(&eattrs,
+					igraph_i_binary_attribute_destroy);
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy_all, &eattrs);
+
+  attrs[0]=&gattrs; attrs[1]=&vattrs; attrs[2]=&eattrs;
+  for (k=0; k<3; k++) {
+    long int count = k==0 ? 1 : (k==1 ? no_of_nodes : no_of_edges);
+    for (i=0; i<nattrs[k]; i++) {
+      IGRAPH_CHECK(igraph_i_binary_read_attribute(&in, attrs[k], count));
+    }
+  }
+  IGRAPH_CHECK(igraph_i_binary_in_finish(&in));
+
+  /* Create the graph and move the structure into it */
+  IGRAPH_CHECK(igraph_empty_attrs(graph, 0, directed ? 1 : 0, &gattrs));
+  IGRAPH_FINALLY(igraph_destroy, graph);
+  IGRAPH_CHECK(igraph_add_vertices(graph, (igraph_integer_t) no_of_nodes,
+				   &vattrs));
+
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->from);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->to);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->oi);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->ii);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->os);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->is);
+  graph->from=from; graph->to=to;
+  graph->oi=oi; graph->ii=ii;
+  graph->os=os; graph->is=is;
+  from.stor_begin=to.stor_begin=oi.stor_begin=0;
+  ii.stor_begin=os.stor_begin=is.stor_begin=0;
+
+  /* The attribute handler needs the edges themselves */
+  if (graph->attr) {
+    igraph_vector_t edges;
+    IGRAPH_VECTOR_INIT_FINALLY(&edges, no_of_edges*2);
+    for (i=0; i<no_of_edges; i++) {
+      VECTOR(edges)[2*i]   = VECTOR(graph->from)[i];
+      VECTOR(edges)[2*i+1] = VECTOR(graph->to)[i];
+    }
+    IGRAPH_CHECK(igraph_i_attribute_add_edges(graph, &edges, &eattrs));
+    igraph_vector_destroy(&edges);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  IGRAPH_FINALLY_CLEAN(1);	/* graph */
+  igraph_vector_ptr_destroy_all(&eattrs);
+  igraph_vector_ptr_destroy_all(&vattrs);
+  igraph_vector_ptr_destroy_all(&gattrs);
+  IGRAPH_FINALLY_CLEAN(9);	/* the attributes and the moved vectors */
+  igraph_i_binary_in_destroy(&in);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  return 0;
+}
+
+static int igraph_i_binary_write(FILE *outstream, const void *data,
+				 size_t bytes) {
+  if (bytes > 0 && fwrite(data, 1, bytes, outstream) != bytes) {
+    IGRAPH_ERROR("Write failed", IGRAPH_EFILE);
+  }
+  return 0;
+}
+
+static int igraph_i_binary_write_padding(FILE *outstream, size_t bytes) {
+  static const char pad[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  return igraph_i_binary_write(outstream, pad,
+			       IGRAPH_I_BINARY_PADDING(bytes));
+}
+
+static int igraph_i_binary_write_ids(FILE *outstream,
+				     const igraph_i_graph_vector_t *v) {
+  long int len=IGRAPH_I_GRAPH_VECTOR(size)(v);
+#ifdef IGRAPH_COMPACT_GRAPH
+  IGRAPH_CHECK(igraph_i_binary_write(outstream, VECTOR(*v),
+				     sizeof(int32_t) * (size_t) len));
+#else
+  int32_t buf[IGRAPH_I_BINARY_BLOCK];
+  long int i, j, chunk;
+  for (i=0; i<len; i+=chunk) {
+    chunk = len-i < IGRAPH_I_BINARY_BLOCK ? len-i : IGRAPH_I_BINARY_BLOCK;
+    for (j=0; j<chunk; j++) {
+      buf[j] = (int32_t) VECTOR(*v)[i+j];
+    }
+    IGRAPH_CHECK(igraph_i_binary_write(outstream, buf, sizeof(int32_t) *
+				       (size_t) chunk));
+  }
+#endif
+  IGRAPH_CHECK(igraph_i_binary_write_padding(outstream, sizeof(int32_t) *
+					     (size_t) len));
+  return 0;
+}
+
+static igraph_bool_t igraph_i_binary_supported(igraph_real_t type) {
+  return type == IGRAPH_ATTRIBUTE_NUMERIC ||
+    type == IGRAPH_ATTRIBUTE_STRING ||
+    type == IGRAPH_ATTRIBUTE_BOOLEAN;
+}
+
+static int igraph_i_binary_write_attribute(const igraph_t *graph,
+					   FILE *outstream,
+					   igraph_attribute_elemtype_t elemtype,
+					   const char *name,
+					   igraph_attribute_type_t type) {
+  uint32_t head[2];
+  long int i, j, chunk, count;
+  size_t namelen=strlen(name);
+
+  head[0]=(uint32_t) type;
+  head[1]=(uint32_t) namelen;
+  IGRAPH_CHECK(igraph_i_binary_write(outstream, head, sizeof(head)));
+  IGRAPH_CHECK(igraph_i_binary_write(outstream, name, namelen));
+  IGRAPH_CHECK(igraph_i_binary_write_padding(outstream, namelen));
+
+  if (type == IGRAPH_ATTRIBUTE_NUMERIC) {
+    igraph_vector_t v;
+    IGRAPH_VECTOR_INIT_FINALLY(&v, 0);
+    if (elemtype == IGRAPH_ATTRIBUTE_GRAPH) {
+      IGRAPH_CHECK(igraph_i_attribute_get_numeric_graph_attr(graph, name, &v));
+    } else if (elemtype == IGRAPH_ATTRIBUTE_VERTEX) {
+      IGRAPH_CHECK(igraph_i_attribute_get_numeric_vertex_attr(graph, name,
+							     igraph_vss_all(),
+							     &v));
+    } else {
+      IGRAPH_CHECK(igraph_i_attribute_get_numeric_edge_attr(graph, name,
+			       igraph_ess_all(IGRAPH_EDGEORDER_ID), &v));
+    }
+    IGRAPH_CHECK(igraph_i_binary_write(outstream, VECTOR(v), sizeof(double) *
+				       (size_t) igraph_vector_size(&v)));
+    igraph_vector_destroy(&v);
+    IGRAPH_FINALLY_CLEAN(1);
+
+  } else if (type == IGRAPH_ATTRIBUTE_BOOLEAN) {
+    unsigned char buf[IGRAPH_I_BINARY_BLOCK];
+    igraph_vector_bool_t v;
+    IGRAPH_VECTOR_BOOL_INIT_FINALLY(&v, 0);
+    if (elemtype == IGRAPH_ATTRIBUTE_GRAPH) {
+      IGRAPH_CHECK(igraph_i_attribute_get_bool_graph_attr(graph, name, &v));
+    } else if (elemtype == IGRAPH_ATTRIBUTE_VERTEX) {
+      IGRAPH_CHECK(igraph_i_attribute_get_bool_vertex_attr(graph, name,
+							   igraph_vss_all(),
+							   &v));
+    } else {
+      IGRAPH_CHECK(igraph_i_attribute_get_bool_edge_attr(graph, name,
+			       igraph_ess_all(IGRAPH_EDGEORDER_ID), &v));
+    }
+    count=igraph_vector_bool_size(&v);
+    for (i=0; i<count; i+=chunk) {
+      chunk = count-i < IGRAPH_I_BINARY_BLOCK ? count-i : IGRAPH_I_BINARY_BLOCK;
+      for (j=0; j<chunk; j++) {
+	buf[j] = VECTOR(v)[i+j] ? 1 : 0;
+      }
+      IGRAPH_CHECK(igraph_i_binary_write(outstream, buf, (size_t) chunk));
+    }
+    IGRAPH_CHECK(igraph_i_binary_write_padding(outstream, (size_t) count));
+    igraph_vector_bool_destroy(&v);
+    IGRAPH_FINALLY_CLEAN(1);
+
+  } else {
+    igraph_strvector_t v;
+    size_t bytes=0;
+    IGRAPH_STRVECTOR_INIT_FINALLY(&v, 0);
+    if (elemtype == IGRAPH_ATTRIBUTE_GRAPH) {
+      IGRAPH_CHECK(igraph_i_attribute_get_string_graph_attr(graph, name, &v));
+    } else if (elemtype == IGRAPH_ATTRIBUTE_VERTEX) {
+      IGRAPH_CHECK(igraph_i_attribute_get_string_vertex_attr(graph, name,
+							     igraph_vss_all(),
+							     &v));
+    } else {
+      IGRAPH_CHECK(igraph_i_attribute_get_string_edge_attr(graph, name,
+			       igraph_ess_all(IGRAPH_EDGEORDER_ID), &v));
+    }
+    count=igraph_strvector_size(&v);
+    for (i=0; i<count; i++) {
+      char *s;
+      uint32_t len;
+      igraph_strvector_get(&v, i, &s);
+      len=(uint32_t) strlen(s);
+      IGRAPH_CHECK(igraph_i_binary_write(outstream, &len, sizeof(len)));
+      IGRAPH_CHECK(igraph_i_binary_write(outstream, s, len));
+      bytes += sizeof(len) + len;
+    }
+    IGRAPH_CHECK(igraph_i_binary_write_padding(outstream, bytes));
+    igraph_strvector_destroy(&v);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  return 0;
+}
+
+/**
+ * \function igraph_write_graph_binary
+ * \brief Writes the graph to a binary file.
+ *
+ * </para><para>
+ * The file contains the edge list of the graph together with its
+ * indices, and the numeric, string and boolean attributes, in the
+ * byte order of the machine. It can be read back with \ref
+ * igraph_read_graph_binary() much faster than the text formats, as
+ * no parsing and no sorting is needed. Attributes of other types
+ * are skipped with a warning.
+ *
+ * \param graph The graph to write.
+ * \param outstream The stream to write to, it should be writable
+ *        and it should be opened in binary mode on systems that
+ *        distinguish text and binary streams.
+ * \return Error code:
+ *         \c IGRAPH_EFILE if there is an error writing the file.
+ *
+ * Time complexity: O(|V|+|E|), the number of vertices plus the
+ * number of edges, and the size of the attributes.
+ */
+
+int igraph_write_graph_binary(const igraph_t *graph, FILE *outstream) {
+
+  char header[IGRAPH_I_BINARY_HEADER];
+  uint32_t version=IGRAPH_I_BINARY_VERSION;
+  uint32_t byteorder=IGRAPH_I_BINARY_BYTEORDER;
+  uint32_t directed=igraph_is_directed(graph) ? 1 : 0;
+  uint32_t nattrs[3]={ 0, 0, 0 };
+  int64_t n64=igraph_vcount(graph), m64=igraph_ecount(graph);
+  igraph_strvector_t gnames, vnames, enames;
+  igraph_vector_t gtypes, vtypes, etypes;
+  igraph_strvector_t *names[3];
+  igraph_vector_t *types[3];
+  long int i, k;
+
+  IGRAPH_STRVECTOR_INIT_FINALLY(&gnames, 0);
+  IGRAPH_STRVECTOR_INIT_FINALLY(&vnames, 0);
+  IGRAPH_STRVECTOR_INIT_FINALLY(&enames, 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&gtypes, 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&vtypes, 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&etypes, 0);
+  IGRAPH_CHECK(igraph_i_attribute_get_info(graph,
+					   &gnames, &gtypes,
+					   &vnames, &vtypes,
+					   &enames, &etypes));
+  names[0]=&gnames; names[1]=&vnames; names[2]=&enames;
+  types[0]=&gtypes; types[1]=&vtypes; types[2]=&etypes;
+  for (k=0; k<3; k++) {
+    for (i=0; i<igraph_vector_size(types[k]); i++) {
+      if (igraph_i_binary_supported(VECTOR(*types[k])[i])) {
+	nattrs[k]++;
+      } else {
+	IGRAPH_WARNING("Only numeric, string and boolean attributes are "
+		       "written to binary graph files");
+      }
+    }
+  }
+
+  memset(header, 0, IGRAPH_I_BINARY_HEADER);
+  memcpy(header, IGRAPH_I_BINARY_MAGIC, 8);
+  memcpy(header+8, &version, sizeof(uint32_t));
+  memcpy(header+12, &byteorder, sizeof(uint32_t));
+  memcpy(header+16, &directed, sizeof(uint32_t));
+  memcpy(header+24, &n64, sizeof(int64_t));
+  memcpy(header+32, &m64, sizeof(int64_t));
+  memcpy(header+40, nattrs, 3*sizeof(uint32_t));
+  IGRAPH_CHECK(igraph_i_binary_write(outstream, header,
+				     IGRAPH_I_BINARY_HEADER));
+
+  IGRAPH_CHECK(igraph_i_binary_write_ids(outstream, &graph->from));
+  IGRAPH_CHECK(igraph_i_binary_write_ids(outstream, &graph->to));
+  IGRAPH_CHECK(igraph_i_binary_write_ids(outstream, &graph->oi));
+  IGRAPH_CHECK(igraph_i_binary_write_ids(outstream, &graph->ii));
+  IGRAPH_CHECK(igraph_i_binary_write_ids(outstream, &graph->os));
+  IGRAPH_CHECK(igraph_i_binary_write_ids(outstream, &graph->is));
+
+  for (k=0; k<3; k++) {
+    for (i=0; i<igraph_vector_size(types[k]); i++) {
+      char *name;
+      if (!igraph_i_binary_supported(VECTOR(*types[k])[i])) { continue; }
+      igraph_strvector_get(names[k], i, &name);
+      IGRAPH_CHECK(igraph_i_binary_write_attribute(graph, outstream,
+				   (igraph_attribute_elemtype_t) k, name,
+				   (igraph_attribute_type_t) VECTOR(*types[k])[i]));
+    }
+  }
+
+  igraph_strvector_destroy(&gnames);
+  igraph_strvector_destroy(&vnames);
+  igraph_strvector_destroy(&enames);
+  igraph_vector_destroy(&gtypes);
+  igraph_vector_destroy(&vtypes);
+  igraph_vector_destroy(&etypes);
+  IGRAPH_FINALLY_CLEAN(6);
+
+  return 0;
+}
@@ -0,0 +1,400 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2018  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include "config.h"
+#include "foreign-compress.h"
+#include "igraph_error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if HAVE_ZLIB == 1
+#include <zlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* The readers and writers of the foreign formats all work on a FILE
+   stream. A gzip compressed file is handed to them as the read (or
+   write) end of a pipe, the other end is served by a thread that
+   (de)compresses the data. This way the parser and the decompression
+   run at the same time, and the file is never decompressed to a
+   temporary file. zlib is not used from the calling thread at all, the
+   thread owns the gzFile until it finishes.
+
+   Other files are opened with fopen(), so the readers can still map
+   regular files into memory. Compressed input is recognized from the
+   magic bytes at the beginning of the file, output is compressed if the
+   file name ends with '.gz'. Regular files are rewound after looking
+   at their first bytes. Pipes and terminals cannot be rewound, only
+   their first byte is peeked at and pushed back with ungetc(), this is
+   enough to recognize gzip, but not Zstandard input. */
+
+#define IGRAPH_I_ZFILE_BUFFER (1 << 17)
+
+static const unsigned char igraph_i_zfile_gzip_magic[] = { 0x1f, 0x8b };
+static const unsigned char igraph_i_zfile_zstd_magic[] =
+  { 0x28, 0xb5, 0x2f, 0xfd };
+
+static int igraph_i_zfile_has_suffix(const char *filename,
+				     const char *suffix) {
+  size_t len=strlen(filename), slen=strlen(suffix);
+  return len > slen && !strcmp(filename + len - slen, suffix);
+}
+
+#if HAVE_ZLIB == 1
+
+/* write() and read() that restart after signals */
+
+static int igraph_i_zfile_write_all(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n=write(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      return -1;
+    }
+    buf += n;
+    len -= (size_t) n;
+  }
+  return 0;
+}
+
+static ssize_t igraph_i_zfile_read(int fd, char *buf, size_t len) {
+  ssize_t n;
+  do {
+    n=read(fd, buf, len);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+/* Decompress to the pipe until the end of the file, or until the
+   reader closes its end. In the latter case write() fails with EPIPE,
+   SIGPIPE is blocked in this thread. The input is read with stdio and
+   inflated here, instead of gzdopen() on its file descriptor, because
+   the first byte of a pipe is already in the buffer of the stream.
+   Concatenated gzip members are read as one file, and data after the
+   last member is ignored, like gzip does. */
+
+static void *igraph_i_zfile_inflate_thread(void *arg) {
+  igraph_i_zfile_t *zf=arg;
+  unsigned char *in=(unsigned char *) zf->buffer + IGRAPH_I_ZFILE_BUFFER;
+  z_stream z;
+  int ret=Z_OK, member=0, full=0;
+
+  memset(&z, 0, sizeof(z));
+  if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) {
+    zf->error="Cannot decompress gzip file";
+    fclose(zf->input);
+    close(zf->fd);
+    return 0;
+  }
+
+  while (1) {
+    /* inflate() may have more output even if the input is used up */
+    if (z.avail_in == 0 && !full) {
+      z.next_in=in;
+      z.avail_in=(uInt) fread(in, 1, IGRAPH_I_ZFILE_BUFFER, zf->input);
+      if (z.avail_in == 0) { break; }
+    }
+    if (!member) {
+      if (z.avail_in > 0 && z.next_in[0] != igraph_i_zfile_gzip_magic[0]) {
+	break;
+      }
+      member=1;
+    }
+    z.next_out=(Bytef *) zf->buffer;
+    z.avail_out=IGRAPH_I_ZFILE_BUFFER;
+    ret=inflate(&z, Z_NO_FLUSH);
+    if (ret == Z_BUF_ERROR && z.avail_in == 0) { ret=Z_OK; }
+    if (ret != Z_OK && ret != Z_STREAM_END) { break; }
+    full= z.avail_out == 0;
+    if (igraph_i_zfile_write_all(zf->fd, zf->buffer,
+				 IGRAPH_I_ZFILE_BUFFER - z.avail_out) != 0) {
+      member=0;
+      break;
+    }
+    if (ret == Z_STREAM_END) {
+      inflateReset(&z);
+      member=0;
+      full=0;
+    }
+  }
+
+  /* A truncated file ends within a member */
+  if (member || ferror(zf->input)) {
+    zf->error="Cannot decompress gzip file, it is corrupt or truncated";
+  }
+  inflateEnd(&z);
+  fclose(zf->input);
+  close(zf->fd);
+  return 0;
+}
+
+/* Compress everything that comes from the pipe. After an error the
+   pipe is still drained, so that the writer does not block. */
+
+static void *igraph_i_zfile_deflate_thread(void *arg) {
+  igraph_i_zfile_t *zf=arg;
+  gzFile gz=zf->gz;
+  ssize_t n;
+
+  while ((n=igraph_i_zfile_read(zf->fd, zf->buffer,
+				IGRAPH_I_ZFILE_BUFFER)) > 0) {
+    if (!zf->error && gzwrite(gz, zf->buffer, (unsigned int) n) != n) {
+      zf->error="Cannot write gzip compressed file";
+    }
+  }
+  if (n < 0 && !zf->error) {
+    zf->error="Cannot read from compression pipe";
+  }
+  if (gzclose_w(gz) != Z_OK && !zf->error) {
+    zf->error="Cannot write gzip compressed file";
+  }
+  close(zf->fd);
+  return 0;
+}
+
+/* Closes the compressed file, if the thread could not be started */
+
+static void igraph_i_zfile_release(igraph_i_zfile_t *zf) {
+  if (zf->gz) {
+    gzclose(zf->gz);
+    zf->gz=0;
+  }
+  if (zf->input) {
+    fclose(zf->input);
+    zf->input=0;
+  }
+}
+
+/* Start the thread with all signals blocked, they are handled by the
+   calling thread only. The compressed file is in 'zf->gz' for
+   writing, and in 'zf->input' for reading, the thread owns it from
+   now on. The reading thread needs an input buffer as well. */
+
+static int igraph_i_zfile_start(igraph_i_zfile_t *zf, int writing) {
+  int fds[2];
+  sigset_t all, old;
+  int ret;
+
+  zf->buffer=malloc(writing ? IGRAPH_I_ZFILE_BUFFER :
+		    2 * IGRAPH_I_ZFILE_BUFFER);
+  if (!zf->buffer) {
+    igraph_i_zfile_release(zf);
+    IGRAPH_ERROR("Cannot open compressed file", IGRAPH_ENOMEM);
+  }
+  if (pipe(fds) != 0) {
+    igraph_i_zfile_release(zf);
+    free(zf->buffer);
+    zf->buffer=0;
+    IGRAPH_ERROR("Cannot create pipe for compressed file", IGRAPH_EFILE);
+  }
+#ifdef F_SETPIPE_SZ
+  /* A larger pipe lets the two sides run ahead of each other,
+     failure is harmless */
+  fcntl(fds[0], F_SETPIPE_SZ, IGRAPH_I_ZFILE_BUFFER * 8);
+#endif
+
+  zf->writing=writing;
+  zf->error=0;
+  zf->fd= writing ? fds[0] : fds[1];
+  zf->stream= writing ? fdopen(fds[1], "w") : fdopen(fds[0], "r");
+  if (!zf->stream) {
+    igraph_i_zfile_release(zf);
+    close(fds[0]);
+    close(fds[1]);
+    free(zf->buffer);
+    zf->buffer=0;
+    IGRAPH_ERROR("Cannot open compressed file", IGRAPH_EFILE);
+  }
+  setvbuf(zf->stream, 0, _IOFBF, IGRAPH_I_ZFILE_BUFFER);
+
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  ret=pthread_create(&zf->thread, 0, writing ?
+		     igraph_i_zfile_deflate_thread :
+		     igraph_i_zfile_inflate_thread, zf);
+  pthread_sigmask(SIG_SETMASK, &old, 0);
+  if (ret != 0) {
+    igraph_i_zfile_release(zf);
+    fclose(zf->stream);
+    zf->stream=0;
+    close(zf->fd);
+    free(zf->buffer);
+    zf->buffer=0;
+    IGRAPH_ERROR("Cannot start thread for compressed file", IGRAPH_EFILE);
+  }
+  zf->threaded=1;
+
+  return 0;
+}
+
+#endif
+
+/**
+ * Opens a file for one of the foreign format readers or writers.
+ *
+ * \param zf The object to initialize, the stream to use is in
+ *    <code>zf->stream</code>. It is a null pointer if the file could
+ *    not be opened, this is not an error, so the caller can report it
+ *    with a message that names the format.
+ * \param filename The name of the file.
+ * \param mode The mode for fopen(), reading or writing.
+ * \return Error code, if the file is compressed and cannot be
+ *    (de)compressed.
+ */
+
+int igraph_i_zfile_open(igraph_i_zfile_t *zf, const char *filename,
+			const char *mode) {
+  int writing= mode[0] != 'r';
+
+  zf->stream=0;
+#if HAVE_ZLIB == 1
+  zf->threaded=0;
+  zf->buffer=0;
+  zf->gz=0;
+  zf->input=0;
+  zf->error=0;
+#endif
+
+  if (writing) {
+    if (igraph_i_zfile_has_suffix(filename, ".zst")) {
+      IGRAPH_ERROR("Zstandard compressed files are not supported",
+		   IGRAPH_UNIMPLEMENTED);
+    }
+    if (igraph_i_zfile_has_suffix(filename, ".gz")) {
+#if HAVE_ZLIB == 1
+      zf->gz=gzopen(filename, "wb");
+      if (zf->gz) {
+	IGRAPH_CHECK(igraph_i_zfile_start(zf, /*writing=*/ 1));
+      }
+#else
+      IGRAPH_ERROR("Cannot write gzip compressed file, igraph was "
+		   "compiled without zlib", IGRAPH_UNIMPLEMENTED);
+#endif
+    } else {
+      zf->stream=fopen(filename, mode);
+    }
+
+  } else {
+    unsigned char magic[4];
+    size_t n=0;
+    struct stat st;
+    int c;
+    zf->stream=fopen(filename, mode);
+    if (!zf->stream) { return 0; }
+    if (fstat(fileno(zf->stream), &st) == 0 && S_ISREG(st.st_mode)) {
+      n=fread(magic, 1, sizeof(magic), zf->stream);
+      if (fseek(zf->stream, 0, SEEK_SET) != 0) {
+	fclose(zf->stream);
+	zf->stream=0;
+	IGRAPH_ERROR("Cannot rewind file", IGRAPH_EFILE);
+      }
+    } else if ((c=getc(zf->stream)) != EOF) {
+      magic[0]=(unsigned char) c;
+      n=1;
+      ungetc(c, zf->stream);
+    }
+    if (n >= sizeof(igraph_i_zfile_zstd_magic) &&
+	!memcmp(magic, igraph_i_zfile_zstd_magic,
+		sizeof(igraph_i_zfile_zstd_magic))) {
+      fclose(zf->stream);
+      zf->stream=0;
+      IGRAPH_ERROR("Zstandard compressed files are not supported",
+		   IGRAPH_UNIMPLEMENTED);
+    } else if (n > 0 &&
+	       !memcmp(magic, igraph_i_zfile_gzip_magic,
+		       n < sizeof(igraph_i_zfile_gzip_magic) ? n :
+		       sizeof(igraph_i_zfile_gzip_magic))) {
+#if HAVE_ZLIB == 1
+      /* the stream is at the beginning, the thread reads it */
+      zf->input=zf->stream;
+      zf->stream=0;
+      IGRAPH_CHECK(igraph_i_zfile_start(zf, /*writing=*/ 0));
+#else
+      fclose(zf->stream);
+      zf->stream=0;
+      IGRAPH_ERROR("Cannot read gzip compressed file, igraph was "
+		   "compiled without zlib", IGRAPH_UNIMPLEMENTED);
+#endif
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Closes the file and waits for the compression thread. The object
+ * is destroyed even if there was an error, an error of the thread
+ * (corrupt input, full disk) is reported here.
+ */
+
+int igraph_i_zfile_close(igraph_i_zfile_t *zf) {
+  int ret=0;
+  if (zf->stream) {
+    ret=fclose(zf->stream);
+    zf->stream=0;
+  }
+#if HAVE_ZLIB == 1
+  if (zf->threaded) {
+    const char *error;
+    pthread_join(zf->thread, 0);
+    zf->threaded=0;
+    free(zf->buffer);
+    zf->buffer=0;
+    error=zf->error;
+    zf->error=0;
+    if (error) {
+      IGRAPH_ERROR(error, zf->writing ? IGRAPH_EFILE : IGRAPH_PARSEERROR);
+    }
+  }
+#endif
+  if (ret != 0) {
+    IGRAPH_ERROR("Cannot close file", IGRAPH_EFILE);
+  }
+  return 0;
+}
+
+/* Closing the pipe stops the thread as well: the reading thread gets
+   an error from write(), the writing thread gets the end of file. */
+
+void igraph_i_zfile_destroy(igraph_i_zfile_t *zf) {
+  if (zf->stream) {
+    fclose(zf->stream);
+    zf->stream=0;
+  }
+#if HAVE_ZLIB == 1
+  if (zf->threaded) {
+    pthread_join(zf->thread, 0);
+    zf->threaded=0;
+    free(zf->buffer);
+    zf->buffer=0;
+  }
+#endif
+}
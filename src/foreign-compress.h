@@ -0,0 +1,63 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2018  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#ifndef FOREIGN_COMPRESS_H
+#define FOREIGN_COMPRESS_H
+
+#include "igraph_decls.h"
+#include "config.h"
+
+#include <stdio.h>
+
+#if HAVE_ZLIB == 1
+#include <pthread.h>
+#endif
+
+__BEGIN_DECLS
+
+/* A file opened for the foreign format readers and writers,
+   gzip compressed files are (de)compressed on the fly, by a separate
+   thread, see foreign-compress.c. */
+
+typedef struct igraph_i_zfile_t {
+  FILE *stream;			/* what the reader or writer uses */
+#if HAVE_ZLIB == 1
+  int threaded;			/* is there a thread to join? */
+  int writing;
+  pthread_t thread;
+  void *gz;			/* gzFile, owned by the thread */
+  FILE *input;			/* compressed input, owned by the thread */
+  int fd;			/* the other end of the pipe */
+  char *buffer;
+  const char *error;		/* set by the thread */
+#endif
+} igraph_i_zfile_t;
+
+int igraph_i_zfile_open(igraph_i_zfile_t *zf, const char *filename,
+			const char *mode);
+int igraph_i_zfile_close(igraph_i_zfile_t *zf);
+void igraph_i_zfile_destroy(igraph_i_zfile_t *zf);
+
+__END_DECLS
+
+#endif
@@ -28,8 +28,10 @@
 #include "igraph_attributes.h"
 #include "igraph_interface.h"
 #include "igraph_types_internal.h"
+#include "foreign-ncol.h"
 
 #include <ctype.h>		/* isspace */
+#include <stdlib.h>
 #include <string.h>
 #include "igraph_memory.h"
 #include <stdarg.h> 		/* va_start & co */
@@ -66,6 +68,13 @@ xmlEntity blankEntityStruct = {
 
 xmlEntityPtr blankEntity = &blankEntityStruct;
 
+/* The size of the blocks given to the parser */
+#define IGRAPH_I_GRAPHML_BLOCK (1 << 16)
+/* The vertices and edges are given to the attribute handler in at
+   most this many batches, of at least this size */
+#define IGRAPH_I_GRAPHML_BATCHES 8
+#define IGRAPH_I_GRAPHML_MIN_BATCH (1 << 20)
+
 #define GRAPHML_PARSE_ERROR_WITH_CODE(state, msg, code) do {  \
   if (state->successful) {                                    \
     igraph_error(msg, __FILE__, __LINE__, code);              \
@@ -85,6 +94,20 @@ xmlEntityPtr blankEntity = &blankEntityStruct;
 
 /* TODO: proper error handling */
 
+/* The values of a string attribute (or of the edge ids) while
+   parsing: the zero terminated strings one after the other in
+   'data', and the position of the value of each vertex or edge in
+   'offsets', -1 for the default value. The size of 'data' is its
+   allocated size, it is grown geometrically, and 'used' bytes of it
+   are in use. The string vector for the attribute handler is only
+   created at the end, one element type at a time. */
+
+typedef struct igraph_i_graphml_strings_t {
+  igraph_vector_char_t data;
+  long int used;
+  igraph_vector_long_t offsets;
+} igraph_i_graphml_strings_t;
+
 typedef struct igraph_i_graphml_attribute_record_t {
   const char *id;         	/* GraphML id */
   enum { I_GRAPHML_BOOLEAN, I_GRAPHML_INTEGER, I_GRAPHML_LONG,
@@ -95,6 +118,8 @@ typedef struct igraph_i_graphml_attribute_record_t {
     igraph_bool_t as_boolean;
     char* as_string;
   } default_value;   /* Default value of the attribute, if any */
+  igraph_bool_t skip;		/* the values are not read */
+  igraph_i_graphml_strings_t *strings; /* values of string attributes */
   igraph_attribute_record_t record;
 } igraph_i_graphml_attribute_record_t;
 
@@ -102,13 +127,14 @@ struct igraph_i_graphml_parser_state {
   enum { START, INSIDE_GRAPHML, INSIDE_GRAPH, INSIDE_NODE, INSIDE_EDGE,
       INSIDE_KEY, INSIDE_DEFAULT, INSIDE_DATA, FINISH, UNKNOWN, ERROR } st;
   igraph_t *g;
-  igraph_trie_t node_trie;
-  igraph_strvector_t edgeids;
-  igraph_vector_t edgelist;
+  igraph_i_ncol_names_t node_names;
+  igraph_i_graphml_strings_t edgeids;
+  igraph_i_graph_vector_t from, to;	/* the endpoints of the edges */
   igraph_vector_int_t prev_state_stack;
   unsigned int unknown_depth;
   int index;
   igraph_bool_t successful, edges_directed, destroyed;
+  const igraph_strvector_t *skip;
   igraph_trie_t v_names;
   igraph_vector_ptr_t v_attrs;
   igraph_trie_t e_names;
@@ -116,10 +142,11 @@ struct igraph_i_graphml_parser_state {
   igraph_trie_t g_names;
   igraph_vector_ptr_t g_attrs;
   igraph_i_graphml_attribute_record_t* current_attr_record;
-  xmlChar *data_key;
-  igraph_attribute_elemtype_t data_type;
+  igraph_i_graphml_attribute_record_t* data_record; /* null if ignored */
+  long int data_id;
   char *error_message;
   char *data_char;
+  long int data_char_len, data_char_cap;
   long int act_node;
 };
 
@@ -132,11 +159,13 @@ static void igraph_i_report_unhandled_attribute_target(const char* target,
 igraph_real_t igraph_i_graphml_parse_numeric(const char* char_data,
     igraph_real_t default_value) {
   double result;
+  char *end;
 
   if (char_data == 0)
     return default_value;
 
-  if (sscanf(char_data, "%lf", &result) == 0)
+  result=strtod(char_data, &end);
+  if (end == char_data)
     return default_value;
 
   return result;
@@ -144,7 +173,8 @@ igraph_real_t igraph_i_graphml_parse_numeric(const char* char_data,
 
 igraph_bool_t igraph_i_graphml_parse_boolean(const char* char_data,
     igraph_bool_t default_value) {
-  int value;
+  long int value;
+  char *end;
   if (char_data == 0)
     return default_value;
   if (!strcasecmp("true", char_data))
@@ -155,12 +185,78 @@ igraph_bool_t igraph_i_graphml_parse_boolean(const char* char_data,
     return 0;
   if (!strcasecmp("no", char_data))
     return 0;
-  if (sscanf(char_data, "%d", &value) == 0)
+  value=strtol(char_data, &end, 10);
+  if (end == char_data)
     return default_value;
   return value != 0;
 }
 
-void igraph_i_graphml_attribute_record_destroy(igraph_i_graphml_attribute_record_t* rec) {
+static int igraph_i_graphml_strings_init(igraph_i_graphml_strings_t *strings) {
+  IGRAPH_CHECK(igraph_vector_char_init(&strings->data, 0));
+  IGRAPH_FINALLY(igraph_vector_char_destroy, &strings->data);
+  IGRAPH_CHECK(igraph_vector_long_init(&strings->offsets, 0));
+  strings->used=0;
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+static void igraph_i_graphml_strings_destroy(igraph_i_graphml_strings_t *strings) {
+  igraph_vector_char_destroy(&strings->data);
+  igraph_vector_long_destroy(&strings->offsets);
+}
+
+/* Sets the value of element 'id' to the first 'len' characters of
+   'str', or to the default value if 'str' is null. The elements
+   before it that have no value yet get the default value. */
+
+static int igraph_i_graphml_strings_set(igraph_i_graphml_strings_t *strings,
+					long int id, const char *str,
+					long int len) {
+  long int size=igraph_vector_char_size(&strings->data);
+
+  while (igraph_vector_long_size(&strings->offsets) <= id) {
+    IGRAPH_CHECK(igraph_vector_long_push_back(&strings->offsets, -1));
+  }
+  if (str == 0) {
+    VECTOR(strings->offsets)[id]=-1;
+    return 0;
+  }
+
+  if (strings->used+len+1 > size) {
+    size = 2*size > strings->used+len+1 ? 2*size : strings->used+len+1;
+    IGRAPH_CHECK(igraph_vector_char_resize(&strings->data, size));
+  }
+  memcpy(VECTOR(strings->data)+strings->used, str, (size_t) len);
+  VECTOR(strings->data)[strings->used+len]='\0';
+  VECTOR(strings->offsets)[id]=strings->used;
+  strings->used += len+1;
+  return 0;
+}
+
+/* Stores the values of elements 'from' to 'to'-1 in 'res', it must
+   be initialized. */
+
+static int igraph_i_graphml_strings_get(const igraph_i_graphml_strings_t *strings,
+					long int from, long int to,
+					const char *def,
+					igraph_strvector_t *res) {
+  long int i, size=igraph_vector_long_size(&strings->offsets);
+  igraph_strvector_clear(res);
+  IGRAPH_CHECK(igraph_strvector_resize(res, to-from));
+  for (i=from; i<to; i++) {
+    long int offset= i < size ? VECTOR(strings->offsets)[i] : -1;
+    const char *str= offset < 0 ? def : VECTOR(strings->data)+offset;
+    if (str[0] != '\0') {
+      IGRAPH_CHECK(igraph_strvector_set(res, i-from, str));
+    }
+  }
+  return 0;
+}
+
+/* Frees the values of an attribute, but not its key. */
+
+static void igraph_i_graphml_attribute_record_free_values(
+    igraph_i_graphml_attribute_record_t* rec) {
   if (rec->record.type==IGRAPH_ATTRIBUTE_NUMERIC) {
     if (rec->record.value != 0) {
       igraph_vector_destroy((igraph_vector_t*)rec->record.value);
@@ -169,17 +265,26 @@ void igraph_i_graphml_attribute_record_destroy(igraph_i_graphml_attribute_record
   } else if (rec->record.type==IGRAPH_ATTRIBUTE_STRING) {
     if (rec->record.value != 0) {
       igraph_strvector_destroy((igraph_strvector_t*)rec->record.value);
-      if (rec->default_value.as_string != 0) {
-	igraph_Free(rec->default_value.as_string);
-      }
       igraph_Free(rec->record.value);
     }
+    if (rec->strings != 0) {
+      igraph_i_graphml_strings_destroy(rec->strings);
+      igraph_Free(rec->strings);
+    }
   } else if (rec->record.type==IGRAPH_ATTRIBUTE_BOOLEAN) {
     if (rec->record.value != 0) {
       igraph_vector_bool_destroy((igraph_vector_bool_t*)rec->record.value);
       igraph_Free(rec->record.value);
     }
   }
+}
+
+void igraph_i_graphml_attribute_record_destroy(igraph_i_graphml_attribute_record_t* rec) {
+  igraph_i_graphml_attribute_record_free_values(rec);
+  if (rec->record.type==IGRAPH_ATTRIBUTE_STRING &&
+      rec->default_value.as_string != 0) {
+    igraph_Free(rec->default_value.as_string);
+  }
   if (rec->id != 0) {
     igraph_Free(rec->id);
   }
@@ -193,16 +298,16 @@ void igraph_i_graphml_destroy_state(struct igraph_i_graphml_parser_state* state)
     return;
   state->destroyed=1;
 
-  igraph_trie_destroy(&state->node_trie);
-  igraph_strvector_destroy(&state->edgeids);
+  igraph_i_ncol_names_destroy(&state->node_names);
+  igraph_i_graphml_strings_destroy(&state->edgeids);
   igraph_trie_destroy(&state->v_names);
   igraph_trie_destroy(&state->e_names);
   igraph_trie_destroy(&state->g_names);
-  igraph_vector_destroy(&state->edgelist);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&state->from);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&state->to);
   igraph_vector_int_destroy(&state->prev_state_stack);
    
   if (state->error_message) { free(state->error_message); }
-  if (state->data_key) { free(state->data_key); }
   if (state->data_char) { free(state->data_char); }
 
   igraph_vector_ptr_destroy_all(&state->v_attrs);
@@ -257,9 +362,10 @@ void igraph_i_graphml_sax_handler_start_document(void *state0) {
   state->successful=1;
   state->edges_directed=0;
   state->destroyed=0;
-  state->data_key=0;
   state->error_message=0;
+  state->data_record=0;
   state->data_char=0;
+  state->data_char_len=state->data_char_cap=0;
   state->unknown_depth=0;
 
   ret=igraph_vector_int_init(&state->prev_state_stack, 0);
@@ -296,23 +402,29 @@ void igraph_i_graphml_sax_handler_start_document(void *state0) {
       igraph_i_graphml_attribute_record_destroy);
   IGRAPH_FINALLY(igraph_vector_ptr_destroy, &state->g_attrs);
 
-  ret=igraph_vector_init(&state->edgelist, 0);
+  ret=IGRAPH_I_GRAPH_VECTOR(init)(&state->from, 0);
+  if (ret) {
+    RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
+  }
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &state->from);
+
+  ret=IGRAPH_I_GRAPH_VECTOR(init)(&state->to, 0);
   if (ret) {
     RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
   }
-  IGRAPH_FINALLY(igraph_vector_destroy, &state->edgelist);
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &state->to);
 
-  ret=igraph_trie_init(&state->node_trie, 1);
+  ret=igraph_i_ncol_names_init(&state->node_names);
   if (ret) {
     RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
   }
-  IGRAPH_FINALLY(igraph_trie_destroy, &state->node_trie);
+  IGRAPH_FINALLY(igraph_i_ncol_names_destroy, &state->node_names);
 
-  ret=igraph_strvector_init(&state->edgeids, 0);
+  ret=igraph_i_graphml_strings_init(&state->edgeids);
   if (ret) {
     RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
   }
-  IGRAPH_FINALLY(igraph_strvector_destroy, &state->edgeids);
+  IGRAPH_FINALLY(igraph_i_graphml_strings_destroy, &state->edgeids);
 
   ret=igraph_trie_init(&state->v_names, 0);
   if (ret) {
@@ -332,193 +444,251 @@ void igraph_i_graphml_sax_handler_start_document(void *state0) {
   }
   IGRAPH_FINALLY(igraph_trie_destroy, &state->g_names);
   
-  IGRAPH_FINALLY_CLEAN(10);
+  IGRAPH_FINALLY_CLEAN(11);
   IGRAPH_FINALLY(igraph_i_graphml_destroy_state, state);
 }
 
-void igraph_i_graphml_sax_handler_end_document(void *state0) {
-  struct igraph_i_graphml_parser_state *state=
-    (struct igraph_i_graphml_parser_state*)state0;
-  long i, l;
-  int r;
-  igraph_attribute_record_t idrec, eidrec;
-  const char *idstr="id";
-  igraph_bool_t already_has_vertex_id=0, already_has_edge_id=0;
+/* Fills in the missing values of a numeric or boolean attribute with
+   its default value. */
 
-  if (!state->successful) return;
-
-  if (state->index<0) {
+static int igraph_i_graphml_attribute_record_fill(
+    igraph_i_graphml_attribute_record_t *graphmlrec, long int n) {
+  igraph_attribute_record_t *rec=&graphmlrec->record;
+  long int l, origsize;
 
-    igraph_vector_ptr_t vattr, eattr, gattr;
-    long int esize=igraph_vector_ptr_size(&state->e_attrs);
-    const void **tmp;
-    r=igraph_vector_ptr_init(&vattr, 
-			     igraph_vector_ptr_size(&state->v_attrs)+1);
-    if (r) {
-      igraph_error("Cannot parse GraphML file", __FILE__, __LINE__, r);
-      igraph_i_graphml_sax_handler_error(state, "Cannot parse GraphML file");
-      return;
-    }
-    IGRAPH_FINALLY(igraph_vector_ptr_destroy, &vattr);
-    if (igraph_strvector_size(&state->edgeids) != 0) {
-      esize++;      
+  if (rec->type == IGRAPH_ATTRIBUTE_NUMERIC) {
+    igraph_vector_t *vec=(igraph_vector_t*)rec->value;
+    origsize=igraph_vector_size(vec);
+    IGRAPH_CHECK(igraph_vector_resize(vec, n));
+    for (l=origsize; l<n; l++) {
+      VECTOR(*vec)[l] = graphmlrec->default_value.as_numeric;
     }
-    r=igraph_vector_ptr_init(&eattr, esize);
-    if (r) {
-      igraph_error("Cannot parse GraphML file", __FILE__, __LINE__, r);
-      igraph_i_graphml_sax_handler_error(state, "Cannot parse GraphML file");
-      return;
+  } else if (rec->type == IGRAPH_ATTRIBUTE_BOOLEAN) {
+    igraph_vector_bool_t *boolvec=(igraph_vector_bool_t*)rec->value;
+    origsize=igraph_vector_bool_size(boolvec);
+    IGRAPH_CHECK(igraph_vector_bool_resize(boolvec, n));
+    for (l=origsize; l<n; l++) {
+      VECTOR(*boolvec)[l] = graphmlrec->default_value.as_boolean;
     }
-    IGRAPH_FINALLY(igraph_vector_ptr_destroy, &eattr);
-    r=igraph_vector_ptr_init(&gattr, igraph_vector_ptr_size(&state->g_attrs));
-    if (r) {
-      igraph_error("Cannot parse GraphML file", __FILE__, __LINE__, r);
-      igraph_i_graphml_sax_handler_error(state, "Cannot parse GraphML file");
-      return;
-    }
-    IGRAPH_FINALLY(igraph_vector_ptr_destroy, &gattr);
+  }
+
+  return 0;
+}
 
-    for (i=0; i<igraph_vector_ptr_size(&state->v_attrs); i++) {
-      igraph_i_graphml_attribute_record_t *graphmlrec=
-	VECTOR(state->v_attrs)[i];
-      igraph_attribute_record_t *rec=&graphmlrec->record;
+/* The values of an attribute for one batch of vertices or edges, as
+   the attribute handler needs them. Numeric and boolean values are
+   views into the columns, string values are copied. */
 
-      /* Check that the name of the vertex attribute is not 'id'.
-	 If it is then we cannot the complimentary 'id' attribute. */
-      if (! strcmp(rec->name, idstr)) {
-	already_has_vertex_id=1;
-      }
+typedef struct igraph_i_graphml_batch_t {
+  igraph_attribute_record_t record;
+  igraph_vector_t numeric;
+  igraph_vector_bool_t boolean;
+  igraph_strvector_t string;
+} igraph_i_graphml_batch_t;
+
+static void igraph_i_graphml_batch_destroy(igraph_i_graphml_batch_t *batch) {
+  if (batch->record.type == IGRAPH_ATTRIBUTE_STRING) {
+    igraph_strvector_destroy(&batch->string);
+  }
+}
 
-      if (rec->type == IGRAPH_ATTRIBUTE_NUMERIC) {
-	igraph_vector_t *vec=(igraph_vector_t*)rec->value;
-	long int origsize=igraph_vector_size(vec);
-	long int nodes=igraph_trie_size(&state->node_trie);
-	igraph_vector_resize(vec, nodes);
-	for (l=origsize; l<nodes; l++) {
-	  VECTOR(*vec)[l] = graphmlrec->default_value.as_numeric;
-	}
-      } else if (rec->type == IGRAPH_ATTRIBUTE_STRING) {
-	igraph_strvector_t *strvec=(igraph_strvector_t*)rec->value;
-	long int origsize=igraph_strvector_size(strvec);
-	long int nodes=igraph_trie_size(&state->node_trie);
-	igraph_strvector_resize(strvec, nodes);
-	for (l=origsize; l<nodes; l++) {
-	  igraph_strvector_set(strvec, l, graphmlrec->default_value.as_string);
-	}
-      } else if (rec->type == IGRAPH_ATTRIBUTE_BOOLEAN) {
-	igraph_vector_bool_t *boolvec=(igraph_vector_bool_t*)rec->value;
-	long int origsize=igraph_vector_bool_size(boolvec);
-	long int nodes=igraph_trie_size(&state->node_trie);
-	igraph_vector_bool_resize(boolvec, nodes);
-	for (l=origsize; l<nodes; l++) {
-	  VECTOR(*boolvec)[l] = graphmlrec->default_value.as_boolean;
-	}
-      }
-      VECTOR(vattr)[i]=rec;
+static int igraph_i_graphml_batch_add(igraph_vector_ptr_t *batches,
+				      const char *name,
+				      igraph_attribute_type_t type) {
+  igraph_i_graphml_batch_t *batch=igraph_Calloc(1, igraph_i_graphml_batch_t);
+  if (batch == 0) {
+    IGRAPH_ERROR("Cannot parse GraphML file", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_free, batch);
+  batch->record.name=name;
+  batch->record.type=type;
+  if (type == IGRAPH_ATTRIBUTE_STRING) {
+    IGRAPH_CHECK(igraph_strvector_init(&batch->string, 0));
+    IGRAPH_FINALLY(igraph_strvector_destroy, &batch->string);
+  }
+  IGRAPH_CHECK(igraph_vector_ptr_push_back(batches, batch));
+  IGRAPH_FINALLY_CLEAN(type == IGRAPH_ATTRIBUTE_STRING ? 2 : 1);
+  return 0;
+}
+
+/* Creates the graph, or adds the vertices or the edges to it, with
+   their attributes. They are added in a few large batches, so that
+   only one batch of the string values is converted to string vectors
+   at a time. The vertex and edge ids are added as the 'id' attribute,
+   unless there is such an attribute already. */
+
+static int igraph_i_graphml_add_elements(struct igraph_i_graphml_parser_state *state,
+					 igraph_vector_ptr_t *attrs,
+					 igraph_attribute_elemtype_t type) {
+  long int n, step, from, to, i, j, k;
+  long int size=igraph_vector_ptr_size(attrs);
+  igraph_vector_ptr_t batches, recs;
+  igraph_i_graphml_attribute_record_t *graphmlrec;
+  igraph_i_graphml_batch_t *batch;
+  igraph_bool_t has_id=0, add_ids=0;
+  igraph_vector_t edges;
+
+  switch (type) {
+  case IGRAPH_ATTRIBUTE_GRAPH:
+    n=1;
+    break;
+  case IGRAPH_ATTRIBUTE_VERTEX:
+    n=igraph_vector_ptr_size(&state->node_names.keys);
+    break;
+  default:
+    n=IGRAPH_I_GRAPH_VECTOR(size)(&state->from);
+    break;
+  }
+  step=n/IGRAPH_I_GRAPHML_BATCHES+1;
+  if (step < IGRAPH_I_GRAPHML_MIN_BATCH) {
+    step=IGRAPH_I_GRAPHML_MIN_BATCH;
+  }
+
+  IGRAPH_CHECK(igraph_vector_ptr_init(&batches, 0));
+  IGRAPH_VECTOR_PTR_SET_ITEM_DESTRUCTOR(&batches,
+					igraph_i_graphml_batch_destroy);
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy_all, &batches);
+  for (i=0; i<size; i++) {
+    graphmlrec=VECTOR(*attrs)[i];
+    if (graphmlrec->skip) {
+      continue;
+    }
+    if (!strcmp(graphmlrec->record.name, "id")) {
+      has_id=1;
     }
-    if (!already_has_vertex_id) {
-      idrec.name=idstr;
-      idrec.type=IGRAPH_ATTRIBUTE_STRING;
-      tmp=&idrec.value;
-      igraph_trie_getkeys(&state->node_trie, (const igraph_strvector_t **)tmp);
-      VECTOR(vattr)[i]=&idrec;
+    IGRAPH_CHECK(igraph_i_graphml_attribute_record_fill(graphmlrec, n));
+    IGRAPH_CHECK(igraph_i_graphml_batch_add(&batches, graphmlrec->record.name,
+					    graphmlrec->record.type));
+  }
+  if (type == IGRAPH_ATTRIBUTE_VERTEX) {
+    add_ids=igraph_has_attribute_table() && !has_id;
+  } else if (type == IGRAPH_ATTRIBUTE_EDGE &&
+	     igraph_vector_long_size(&state->edgeids.offsets) != 0) {
+    if (!has_id) {
+      add_ids=1;
     } else {
-      igraph_vector_ptr_pop_back(&vattr);
+      IGRAPH_WARNING("Could not add edge ids, "
+		     "there is already an 'id' edge attribute");
     }
-
-    for (i=0; i<igraph_vector_ptr_size(&state->e_attrs); i++) {
-      igraph_i_graphml_attribute_record_t *graphmlrec=
-	VECTOR(state->e_attrs)[i];
-      igraph_attribute_record_t *rec=&graphmlrec->record;
-
-      if (! strcmp(rec->name, idstr)) {
-	already_has_edge_id=1;
+  }
+  if (add_ids) {
+    IGRAPH_CHECK(igraph_i_graphml_batch_add(&batches, "id",
+					    IGRAPH_ATTRIBUTE_STRING));
+  }
+  IGRAPH_CHECK(igraph_vector_ptr_init(&recs, igraph_vector_ptr_size(&batches)));
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy, &recs);
+  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
+
+  from=0;
+  do {
+    to= n-from > step ? from+step : n;
+    for (i=0, j=0; i<size; i++) {
+      graphmlrec=VECTOR(*attrs)[i];
+      if (graphmlrec->skip) {
+	continue;
       }
-
-      if (rec->type == IGRAPH_ATTRIBUTE_NUMERIC) {
-	igraph_vector_t *vec=(igraph_vector_t*)rec->value;
-	long int origsize=igraph_vector_size(vec);
-	long int edges=igraph_vector_size(&state->edgelist)/2;
-	igraph_vector_resize(vec, edges);
-	for (l=origsize; l<edges; l++) {
-	  VECTOR(*vec)[l] = graphmlrec->default_value.as_numeric;
-	}
-      } else if (rec->type == IGRAPH_ATTRIBUTE_STRING) {
-	igraph_strvector_t *strvec=(igraph_strvector_t*)rec->value;
-	long int origsize=igraph_strvector_size(strvec);
-	long int edges=igraph_vector_size(&state->edgelist)/2;
-	igraph_strvector_resize(strvec, edges);
-	for (l=origsize; l<edges; l++) {
-	  igraph_strvector_set(strvec, l, graphmlrec->default_value.as_string);
-	}
-      } else if (rec->type == IGRAPH_ATTRIBUTE_BOOLEAN) {
-	igraph_vector_bool_t *boolvec=(igraph_vector_bool_t*)rec->value;
-	long int origsize=igraph_vector_bool_size(boolvec);
-	long int edges=igraph_vector_size(&state->edgelist)/2;
-	igraph_vector_bool_resize(boolvec, edges);
-	for (l=origsize; l<edges; l++) {
-	  VECTOR(*boolvec)[l] = graphmlrec->default_value.as_boolean;
-	}
+      batch=VECTOR(batches)[j];
+      VECTOR(recs)[j++]=&batch->record;
+      switch (graphmlrec->record.type) {
+      case IGRAPH_ATTRIBUTE_NUMERIC:
+	igraph_vector_view(&batch->numeric,
+	  VECTOR(*(igraph_vector_t*)graphmlrec->record.value)+from, to-from);
+	batch->record.value=&batch->numeric;
+	break;
+      case IGRAPH_ATTRIBUTE_BOOLEAN:
+	igraph_vector_bool_view(&batch->boolean,
+	  VECTOR(*(igraph_vector_bool_t*)graphmlrec->record.value)+from,
+	  to-from);
+	batch->record.value=&batch->boolean;
+	break;
+      case IGRAPH_ATTRIBUTE_STRING:
+	IGRAPH_CHECK(igraph_i_graphml_strings_get(graphmlrec->strings, from, to,
+		       graphmlrec->default_value.as_string, &batch->string));
+	batch->record.value=&batch->string;
+	break;
+      default:
+	break;
       }
-      VECTOR(eattr)[i]=rec;
     }
-    if (igraph_strvector_size(&state->edgeids) != 0) {
-      if (!already_has_edge_id) {
-	long int origsize=igraph_strvector_size(&state->edgeids);
-	eidrec.name=idstr;
-	eidrec.type=IGRAPH_ATTRIBUTE_STRING;
-	igraph_strvector_resize(&state->edgeids, 
-				igraph_vector_size(&state->edgelist)/2);
-	for (; origsize < igraph_strvector_size(&state->edgeids); origsize++) {
-	  igraph_strvector_set(&state->edgeids, origsize, "");
+    if (add_ids) {
+      batch=VECTOR(batches)[j];
+      VECTOR(recs)[j]=&batch->record;
+      batch->record.value=&batch->string;
+      if (type == IGRAPH_ATTRIBUTE_VERTEX) {
+	IGRAPH_CHECK(igraph_strvector_resize(&batch->string, to-from));
+	for (k=from; k<to; k++) {
+	  IGRAPH_CHECK(igraph_strvector_set(&batch->string, k-from,
+					    VECTOR(state->node_names.keys)[k]));
 	}
-	eidrec.value=&state->edgeids;
-	VECTOR(eattr)[(long int)igraph_vector_ptr_size(&eattr)-1]=&eidrec;
       } else {
-	igraph_vector_ptr_pop_back(&eattr);
-	IGRAPH_WARNING("Could not add edge ids, "
-		       "there is already an 'id' edge attribute");
+	IGRAPH_CHECK(igraph_i_graphml_strings_get(&state->edgeids, from, to, "",
+						  &batch->string));
       }
     }
 
-    for (i=0; i<igraph_vector_ptr_size(&state->g_attrs); i++) {
-      igraph_i_graphml_attribute_record_t *graphmlrec=
-	VECTOR(state->g_attrs)[i];
-      igraph_attribute_record_t *rec=&graphmlrec->record;
-      if (rec->type == IGRAPH_ATTRIBUTE_NUMERIC) {
-	igraph_vector_t *vec=(igraph_vector_t*)rec->value;
-	long int origsize=igraph_vector_size(vec);
-	igraph_vector_resize(vec, 1);
-	for (l=origsize; l<1; l++) {
-	  VECTOR(*vec)[l] = graphmlrec->default_value.as_numeric;
-	}
-      } else if (rec->type == IGRAPH_ATTRIBUTE_STRING) {
-	igraph_strvector_t *strvec=(igraph_strvector_t*)rec->value;
-	long int origsize=igraph_strvector_size(strvec);
-	igraph_strvector_resize(strvec, 1);
-	for (l=origsize; l<1; l++) {
-	  igraph_strvector_set(strvec, l, graphmlrec->default_value.as_string);
-	}
-      } else if (rec->type == IGRAPH_ATTRIBUTE_BOOLEAN) {
-	igraph_vector_bool_t *boolvec=(igraph_vector_bool_t*)rec->value;
-	long int origsize=igraph_vector_bool_size(boolvec);
-	igraph_vector_bool_resize(boolvec, 1);
-	for (l=origsize; l<1; l++) {
-	  VECTOR(*boolvec)[l] = graphmlrec->default_value.as_boolean;
-	}
+    switch (type) {
+    case IGRAPH_ATTRIBUTE_GRAPH:
+      IGRAPH_CHECK(igraph_empty_attrs(state->g, 0, state->edges_directed,
+				      &recs));
+      break;
+    case IGRAPH_ATTRIBUTE_VERTEX:
+      IGRAPH_CHECK(igraph_add_vertices(state->g, (igraph_integer_t) (to-from),
+				       &recs));
+      break;
+    default:
+      IGRAPH_CHECK(igraph_vector_resize(&edges, 2*(to-from)));
+      for (k=from; k<to; k++) {
+	VECTOR(edges)[2*(k-from)]   = VECTOR(state->from)[k];
+	VECTOR(edges)[2*(k-from)+1] = VECTOR(state->to)[k];
       }
-      VECTOR(gattr)[i]=rec;
+      IGRAPH_CHECK(igraph_add_edges(state->g, &edges, &recs));
+      break;
     }
-    
-    igraph_empty_attrs(state->g, 0, state->edges_directed, &gattr);
-    igraph_add_vertices(state->g, (igraph_integer_t) 
-			igraph_trie_size(&state->node_trie), &vattr);
-    igraph_add_edges(state->g, &state->edgelist, &eattr);
+    from=to;
+  } while (from < n);
 
-    igraph_vector_ptr_destroy(&vattr);
-    igraph_vector_ptr_destroy(&eattr);
-    igraph_vector_ptr_destroy(&gattr);
-    IGRAPH_FINALLY_CLEAN(3);     
+  igraph_vector_destroy(&edges);
+  igraph_vector_ptr_destroy(&recs);
+  igraph_vector_ptr_destroy_all(&batches);
+  IGRAPH_FINALLY_CLEAN(3);
+
+  /* give back the memory of the values */
+  for (i=0; i<size; i++) {
+    igraph_i_graphml_attribute_record_free_values(VECTOR(*attrs)[i]);
+  }
+
+  return 0;
+}
+
+static int igraph_i_graphml_build_graph(struct igraph_i_graphml_parser_state *state) {
+  IGRAPH_CHECK(igraph_i_graphml_add_elements(state, &state->g_attrs,
+					     IGRAPH_ATTRIBUTE_GRAPH));
+  IGRAPH_FINALLY(igraph_destroy, state->g);
+  IGRAPH_CHECK(igraph_i_graphml_add_elements(state, &state->v_attrs,
+					     IGRAPH_ATTRIBUTE_VERTEX));
+  if (igraph_has_attribute_table()) {
+    IGRAPH_CHECK(igraph_i_graphml_add_elements(state, &state->e_attrs,
+					       IGRAPH_ATTRIBUTE_EDGE));
+  } else {
+    /* no edge attributes, the endpoints become the edge list */
+    IGRAPH_CHECK(igraph_i_add_edges_take(state->g, &state->from,
+					 &state->to));
+  }
+  IGRAPH_FINALLY_CLEAN(1);
+  return 0;
+}
+
+void igraph_i_graphml_sax_handler_end_document(void *state0) {
+  struct igraph_i_graphml_parser_state *state=
+    (struct igraph_i_graphml_parser_state*)state0;
+
+  if (!state->successful) return;
+
+  if (state->index<0) {
+    if (igraph_i_graphml_build_graph(state)) {
+      state->successful=0;
+      state->st=ERROR;
+    }
   }
 
   igraph_i_graphml_destroy_state(state);
@@ -534,6 +704,27 @@ void igraph_i_graphml_sax_handler_end_document(void *state0) {
 #define XML_ATTR_VALUE_END(it) (*(it+4))
 #define XML_ATTR_VALUE(it) *(it+3), (*(it+4))-(*(it+3))
 
+/* Whether the values of a key are not needed, 'skip' contains key
+   ids and attribute names. */
+
+static igraph_bool_t igraph_i_graphml_skip_key(const igraph_strvector_t *skip,
+					       const char *id,
+					       const char *name) {
+  long int i, n;
+  char *str;
+  if (skip == 0) {
+    return 0;
+  }
+  n=igraph_strvector_size(skip);
+  for (i=0; i<n; i++) {
+    igraph_strvector_get(skip, i, &str);
+    if (!strcmp(str, id) || !strcmp(str, name)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 igraph_i_graphml_attribute_record_t* igraph_i_graphml_add_attribute_key(
     const xmlChar** attrs, int nb_attrs,
     struct igraph_i_graphml_parser_state *state) {
@@ -662,6 +853,7 @@ igraph_i_graphml_attribute_record_t* igraph_i_graphml_add_attribute_key(
   /* if the code above requested skipping the attribute, free everything and
    * return */
   if (skip) {
+    igraph_i_graphml_attribute_record_destroy(rec);
     igraph_free(rec);
     IGRAPH_FINALLY_CLEAN(1);
     return 0;
@@ -684,19 +876,33 @@ igraph_i_graphml_attribute_record_t* igraph_i_graphml_add_attribute_key(
    * finally stack */
   IGRAPH_FINALLY_CLEAN(1);	/* rec */
 
+  /* Unwanted keys stay in the trie, so that their <data> tags can be
+   * recognized and ignored without warnings. Without an attribute
+   * handler no values are needed at all. */
+  rec->skip=!igraph_has_attribute_table() ||
+    igraph_i_graphml_skip_key(state->skip, rec->id, rec->record.name);
+  if (rec->skip) {
+    return rec;
+  }
+
   /* create the attribute values */
   switch (rec->record.type) {
     igraph_vector_t *vec;
     igraph_vector_bool_t *boolvec;
-    igraph_strvector_t *strvec;
+    igraph_i_graphml_strings_t *strings;
   case IGRAPH_ATTRIBUTE_BOOLEAN:
     boolvec=igraph_Calloc(1, igraph_vector_bool_t);
     if (boolvec==0) {
       GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", IGRAPH_ENOMEM);
       return 0;
     }
+    ret=igraph_vector_bool_init(boolvec, 0);
+    if (ret) {
+      igraph_Free(boolvec);
+      GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
+      return 0;
+    }
     rec->record.value=boolvec;
-    igraph_vector_bool_init(boolvec, 0);    
     break;
   case IGRAPH_ATTRIBUTE_NUMERIC:
     vec=igraph_Calloc(1, igraph_vector_t);
@@ -704,17 +910,27 @@ igraph_i_graphml_attribute_record_t* igraph_i_graphml_add_attribute_key(
       GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", IGRAPH_ENOMEM);
       return 0;
     }
+    ret=igraph_vector_init(vec, 0);
+    if (ret) {
+      igraph_Free(vec);
+      GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
+      return 0;
+    }
     rec->record.value=vec;
-    igraph_vector_init(vec, 0);    
     break;
   case IGRAPH_ATTRIBUTE_STRING:
-    strvec=igraph_Calloc(1, igraph_strvector_t);
-    if (strvec==0) {
+    strings=igraph_Calloc(1, igraph_i_graphml_strings_t);
+    if (strings==0) {
       GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", IGRAPH_ENOMEM);
       return 0;
     }
-    rec->record.value=strvec;
-    igraph_strvector_init(strvec, 0);
+    ret=igraph_i_graphml_strings_init(strings);
+    if (ret) {
+      igraph_Free(strings);
+      GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
+      return 0;
+    }
+    rec->strings=strings;
     break;
   default: break;
   }
@@ -722,31 +938,84 @@ igraph_i_graphml_attribute_record_t* igraph_i_graphml_add_attribute_key(
   return rec;
 }
 
+/* Looks up the key of a <data> tag. The values of unknown and
+   skipped keys are not collected at all. */
+
 void igraph_i_graphml_attribute_data_setup(struct igraph_i_graphml_parser_state *state,
 					   const xmlChar **attrs,
 					   int nb_attrs,
 					   igraph_attribute_elemtype_t type) {
   xmlChar **it;
   int i;
+  igraph_trie_t *trie=0;
+  igraph_vector_ptr_t *ptrvector=0;
+  long int recid, id=0;
+  char buf[64], *key;
+  size_t len;
+
+  state->data_record=0;
+  state->data_char_len=0;
 
   if (!state->successful)
     return;
 
+  switch (type) {
+  case IGRAPH_ATTRIBUTE_GRAPH:
+    trie=&state->g_names;
+    ptrvector=&state->g_attrs;
+    id=0;
+    break;
+  case IGRAPH_ATTRIBUTE_VERTEX:
+    trie=&state->v_names;
+    ptrvector=&state->v_attrs;
+    id=state->act_node;
+    break;
+  case IGRAPH_ATTRIBUTE_EDGE:
+    trie=&state->e_names;
+    ptrvector=&state->e_attrs;
+    id=IGRAPH_I_GRAPH_VECTOR(size)(&state->from)-1; /* hack */
+    break;
+  default:
+    /* impossible */
+    return;
+  }
+
   for (i=0, it=(xmlChar**)attrs; i < nb_attrs; i++, it+=5) {
     if (XML_ATTR_URI(it) != 0 &&
 	!xmlStrEqual(toXmlChar(GRAPHML_NAMESPACE_URI), XML_ATTR_URI(it)))
       continue;
 
     if (xmlStrEqual(*it, toXmlChar("key"))) {
-      if (state->data_key) {
-	free(state->data_key);
+      len=(size_t) (XML_ATTR_VALUE_END(it)-XML_ATTR_VALUE_START(it));
+      if (len < sizeof(buf)) {
+	key=buf;
+	memcpy(key, XML_ATTR_VALUE_START(it), len);
+	key[len]='\0';
+      } else {
+	key=fromXmlChar(xmlStrndup(XML_ATTR_VALUE(it)));
+	if (key == 0) {
+	  RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", IGRAPH_ENOMEM);
+	}
+      }
+      igraph_trie_check(trie, key, &recid);
+      if (recid < 0) {
+	/* no such attribute key, issue a warning */
+	igraph_warningf(
+            "unknown attribute key '%s' in a <data> tag, ignoring attribute",
+	    __FILE__, __LINE__, 0,
+	    key
+	);
+	state->data_record=0;
+      } else if (((igraph_i_graphml_attribute_record_t*)
+		  VECTOR(*ptrvector)[recid])->skip) {
+	state->data_record=0;
+      } else {
+	state->data_record=VECTOR(*ptrvector)[recid];
+	state->data_id=id;
       }
-      state->data_key=xmlStrndup(XML_ATTR_VALUE(it));
-      if (state->data_char) {
-        free(state->data_char);
+      if (key != buf) {
+	free(key);
       }
-      state->data_char=0;
-      state->data_type=type;
     } else {
       /* ignore */
     }
@@ -755,126 +1024,72 @@ void igraph_i_graphml_attribute_data_setup(struct igraph_i_graphml_parser_state
 
 void igraph_i_graphml_append_to_data_char(struct igraph_i_graphml_parser_state *state,
 					  const xmlChar *data, int len) {
-  long int data_char_new_start=0;
+  long int size=state->data_char_len+len+1;
 
   if (!state->successful) return;
 
-  if (state->data_char) {
-    data_char_new_start=(long int) strlen(state->data_char);
-    state->data_char=igraph_Realloc(state->data_char, 
-				    (size_t)(data_char_new_start+len+1), char);
-  } else {
-    state->data_char=igraph_Calloc((size_t) len+1, char);
-  }
-  if (state->data_char==0) {
-    RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", IGRAPH_ENOMEM);
+  if (size > state->data_char_cap) {
+    long int cap=2*state->data_char_cap > size ? 2*state->data_char_cap : size;
+    char *tmp=igraph_Realloc(state->data_char, (size_t) cap, char);
+    if (tmp==0) {
+      RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", IGRAPH_ENOMEM);
+    }
+    state->data_char=tmp;
+    state->data_char_cap=cap;
   }
-  memcpy(state->data_char+data_char_new_start, data, 
+  memcpy(state->data_char+state->data_char_len, data, 
 	 (size_t) len*sizeof(xmlChar));
-  state->data_char[data_char_new_start+len]='\0';
+  state->data_char_len += len;
+  state->data_char[state->data_char_len]='\0';
 }
 
+/* The values are written right into the columns of the attributes,
+   these are grown geometrically. */
+
 void igraph_i_graphml_attribute_data_finish(struct igraph_i_graphml_parser_state *state) {
-  const char *key=fromXmlChar(state->data_key);
-  igraph_attribute_elemtype_t type=state->data_type;
-  igraph_trie_t *trie=0;
-  igraph_vector_ptr_t *ptrvector=0;
-  igraph_i_graphml_attribute_record_t *graphmlrec;
+  igraph_i_graphml_attribute_record_t *graphmlrec=state->data_record;
   igraph_attribute_record_t *rec;
-  long int recid, id=0;
-  int ret;
-  
-  switch (type) {
-  case IGRAPH_ATTRIBUTE_GRAPH:
-    trie=&state->g_names;
-    ptrvector=&state->g_attrs;
-    id=0;
-    break;
-  case IGRAPH_ATTRIBUTE_VERTEX:
-    trie=&state->v_names;
-    ptrvector=&state->v_attrs;
-    id=state->act_node;
-    break;
-  case IGRAPH_ATTRIBUTE_EDGE:
-    trie=&state->e_names;
-    ptrvector=&state->e_attrs;
-    id=igraph_vector_size(&state->edgelist)/2-1; /* hack */
-    break;
-  default:
-    /* impossible */
-    break;
-  }
-  
-  igraph_trie_check(trie, key, &recid);
-  if (recid < 0) {
-    /* no such attribute key, issue a warning */
-    igraph_warningf(
-        "unknown attribute key '%s' in a <data> tag, ignoring attribute",
-        __FILE__, __LINE__, 0,
-        key
-    );
-    igraph_Free(state->data_char);
+  const char *data= state->data_char_len > 0 ? state->data_char : 0;
+  long int id=state->data_id, len=state->data_char_len;
+  int ret=0;
+
+  state->data_record=0;
+  state->data_char_len=0;
+
+  if (graphmlrec == 0) {
     return;
   }
-   
-  graphmlrec=VECTOR(*ptrvector)[recid];
   rec=&graphmlrec->record;
 
   switch (rec->type) {
     igraph_vector_bool_t *boolvec;
     igraph_vector_t *vec;
-    igraph_strvector_t *strvec;
-    long int s, i;
-    const char* strvalue;
+    long int s;
   case IGRAPH_ATTRIBUTE_BOOLEAN:
     boolvec=(igraph_vector_bool_t *)rec->value;
-    s=igraph_vector_bool_size(boolvec);
-    if (id >= s) {
-      ret=igraph_vector_bool_resize(boolvec, id+1);
-      if (ret) {
-        RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
-      }
-      for (i=s; i<id; i++) {
-	VECTOR(*boolvec)[i] = graphmlrec->default_value.as_boolean;
-      }
+    for (s=igraph_vector_bool_size(boolvec); s<=id && !ret; s++) {
+      ret=igraph_vector_bool_push_back(boolvec,
+				       graphmlrec->default_value.as_boolean);
     }
-    VECTOR(*boolvec)[id] = igraph_i_graphml_parse_boolean(state->data_char,
+    if (ret) {
+      RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
+    }
+    VECTOR(*boolvec)[id] = igraph_i_graphml_parse_boolean(data,
 	graphmlrec->default_value.as_boolean);
     break;
   case IGRAPH_ATTRIBUTE_NUMERIC:
     vec=(igraph_vector_t *)rec->value;
-    s=igraph_vector_size(vec);
-    if (id >= s) {
-      ret=igraph_vector_resize(vec, id+1);
-      if (ret) {
-        RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
-      }
-      for (i=s; i<id; i++) {
-	VECTOR(*vec)[i] = graphmlrec->default_value.as_numeric;
-      }
+    for (s=igraph_vector_size(vec); s<=id && !ret; s++) {
+      ret=igraph_vector_push_back(vec, graphmlrec->default_value.as_numeric);
     }
-    VECTOR(*vec)[id] = igraph_i_graphml_parse_numeric(state->data_char,
+    if (ret) {
+      RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
+    }
+    VECTOR(*vec)[id] = igraph_i_graphml_parse_numeric(data,
 	graphmlrec->default_value.as_numeric);
     break;
   case IGRAPH_ATTRIBUTE_STRING:
-    strvec=(igraph_strvector_t *)rec->value;
-    s=igraph_strvector_size(strvec);
-    if (id >= s) {
-      ret=igraph_strvector_resize(strvec, id+1);
-      if (ret) {
-        RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
-      }
-      strvalue = graphmlrec->default_value.as_string;
-      for (i=s;i<id;i++) {
-	igraph_strvector_set(strvec, i, strvalue);
-      }
-    }
-    if (state->data_char) {
-      strvalue = state->data_char;
-    } else {
-      strvalue = graphmlrec->default_value.as_string;
-    }
-    ret=igraph_strvector_set(strvec, id, strvalue);
+    ret=igraph_i_graphml_strings_set(graphmlrec->strings, id, data, len);
     if (ret) {
       RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
     }
@@ -882,15 +1097,14 @@ void igraph_i_graphml_attribute_data_finish(struct igraph_i_graphml_parser_state
   default:
     break;
   }
-
-  if (state->data_char) {
-    igraph_Free(state->data_char);
-  }
 }
 
 void igraph_i_graphml_attribute_default_value_finish(
     struct igraph_i_graphml_parser_state *state) {
   igraph_i_graphml_attribute_record_t *graphmlrec=state->current_attr_record;
+  const char *data= state->data_char_len > 0 ? state->data_char : 0;
+
+  state->data_char_len=0;
 
   if (graphmlrec == 0) {
     igraph_warning("state->current_attr_record was null where it should have been "
@@ -899,33 +1113,40 @@ void igraph_i_graphml_attribute_default_value_finish(
     return;
   }
 
-  if (state->data_char == 0)
+  if (data == 0)
     return;
 
   switch (graphmlrec->record.type) {
   case IGRAPH_ATTRIBUTE_BOOLEAN:
     graphmlrec->default_value.as_boolean = igraph_i_graphml_parse_boolean(
-	state->data_char, 0);
+	data, 0);
     break;
   case IGRAPH_ATTRIBUTE_NUMERIC:
     graphmlrec->default_value.as_numeric = igraph_i_graphml_parse_numeric(
-	state->data_char, IGRAPH_NAN);
+	data, IGRAPH_NAN);
     break;
   case IGRAPH_ATTRIBUTE_STRING:
-    if (state->data_char) {
-      if (graphmlrec->default_value.as_string != 0) {
-	free(graphmlrec->default_value.as_string);
-      }
-      graphmlrec->default_value.as_string = strdup(state->data_char);
+    if (graphmlrec->default_value.as_string != 0) {
+      free(graphmlrec->default_value.as_string);
     }
+    graphmlrec->default_value.as_string = strdup(data);
     break;
   default:
     break;
   }
+}
 
-  if (state->data_char) {
-    igraph_Free(state->data_char);
-  }
+/* The id of a vertex name, a new one if the name was not seen yet. */
+
+static int igraph_i_graphml_node_id(struct igraph_i_graphml_parser_state *state,
+				    const xmlChar *start, const xmlChar *end,
+				    long int *id) {
+  const char *str=fromXmlChar(start);
+  size_t len=(size_t) (end-start);
+  IGRAPH_CHECK(igraph_i_ncol_names_reserve(&state->node_names, 1, len+1));
+  *id=igraph_i_ncol_names_get(&state->node_names, str, len,
+			      igraph_i_ncol_hash(str, len));
+  return 0;
 }
 
 void igraph_i_graphml_sax_handler_start_element_ns(
@@ -935,9 +1156,8 @@ void igraph_i_graphml_sax_handler_start_element_ns(
   struct igraph_i_graphml_parser_state *state=
     (struct igraph_i_graphml_parser_state*)state0;
   xmlChar** it;
-  char* attr_value;
   long int id1, id2;
-  int i;
+  int i, ret;
 
   if (!state->successful)
     return;
@@ -995,8 +1215,12 @@ void igraph_i_graphml_sax_handler_start_element_ns(
 
   case INSIDE_KEY:
     /* If we are in the INSIDE_KEY state, check for default tag */
-    if (xmlStrEqual(localname, toXmlChar("default"))) state->st=INSIDE_DEFAULT;
-    else igraph_i_graphml_handle_unknown_start_tag(state);
+    if (xmlStrEqual(localname, toXmlChar("default"))) {
+      state->data_char_len=0;
+      state->st=INSIDE_DEFAULT;
+    } else {
+      igraph_i_graphml_handle_unknown_start_tag(state);
+    }
     break;
 
   case INSIDE_DEFAULT:
@@ -1015,28 +1239,32 @@ void igraph_i_graphml_sax_handler_start_element_ns(
 	  continue;
 	}
 	if (xmlStrEqual(*it, toXmlChar("source"))) {
-	  attr_value = fromXmlChar(xmlStrndup(XML_ATTR_VALUE(it)));
-	  igraph_trie_get(&state->node_trie, attr_value, &id1);
-	  free(attr_value);
+	  ret=igraph_i_graphml_node_id(state, XML_ATTR_VALUE_START(it),
+				       XML_ATTR_VALUE_END(it), &id1);
 	} else if (xmlStrEqual(*it, toXmlChar("target"))) {
-	  attr_value = fromXmlChar(xmlStrndup(XML_ATTR_VALUE(it)));
-	  igraph_trie_get(&state->node_trie, attr_value, &id2);
-	  free(attr_value);
-	} else if (xmlStrEqual(*it, toXmlChar("id"))) {
-	  long int edges=igraph_vector_size(&state->edgelist)/2+1;
-	  long int origsize=igraph_strvector_size(&state->edgeids);
-	  attr_value = fromXmlChar(xmlStrndup(XML_ATTR_VALUE(it)));
-	  igraph_strvector_resize(&state->edgeids, edges);
-	  for (;origsize < edges-1; origsize++) {
-	    igraph_strvector_set(&state->edgeids, origsize, "");
-	  }
-	  igraph_strvector_set(&state->edgeids, edges-1, attr_value);
-	  free(attr_value);
+	  ret=igraph_i_graphml_node_id(state, XML_ATTR_VALUE_START(it),
+				       XML_ATTR_VALUE_END(it), &id2);
+	} else if (xmlStrEqual(*it, toXmlChar("id")) &&
+		   igraph_has_attribute_table()) {
+	  ret=igraph_i_graphml_strings_set(&state->edgeids,
+	      IGRAPH_I_GRAPH_VECTOR(size)(&state->from),
+	      fromXmlChar(XML_ATTR_VALUE_START(it)),
+	      XML_ATTR_VALUE_END(it)-XML_ATTR_VALUE_START(it));
+	} else {
+	  ret=0;
+	}
+	if (ret) {
+	  RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
 	}
       }
       if (id1>=0 && id2>=0) {
-	igraph_vector_push_back(&state->edgelist, id1);
-	igraph_vector_push_back(&state->edgelist, id2);
+	ret=IGRAPH_I_GRAPH_VECTOR(push_back)(&state->from, id1);
+	if (!ret) {
+	  ret=IGRAPH_I_GRAPH_VECTOR(push_back)(&state->to, id2);
+	}
+	if (ret) {
+	  RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
+	}
       } else {
 	igraph_i_graphml_sax_handler_error(state, "Edge with missing source or target encountered");
 	return;
@@ -1051,9 +1279,11 @@ void igraph_i_graphml_sax_handler_start_element_ns(
 	  continue;
 	}
 	if (xmlStrEqual(XML_ATTR_LOCALNAME(it), toXmlChar("id"))) {
-	  attr_value = fromXmlChar(xmlStrndup(XML_ATTR_VALUE(it)));
-	  igraph_trie_get(&state->node_trie, attr_value, &id1);
-	  free(attr_value);
+	  ret=igraph_i_graphml_node_id(state, XML_ATTR_VALUE_START(it),
+				       XML_ATTR_VALUE_END(it), &id1);
+	  if (ret) {
+	    RETURN_GRAPHML_PARSE_ERROR_WITH_CODE(state, "Cannot parse GraphML file", ret);
+	  }
 	  break;
 	}
       }
@@ -1175,6 +1405,11 @@ void igraph_i_graphml_sax_handler_chars(void* state0, const xmlChar* ch, int len
     break;
     
   case INSIDE_DATA:
+    if (state->data_record != 0) {
+      igraph_i_graphml_append_to_data_char(state, ch, len);
+    }
+    break;
+
   case INSIDE_DEFAULT:
     igraph_i_graphml_append_to_data_char(state, ch, len);
     break;
@@ -1284,6 +1519,12 @@ int igraph_i_xml_escape(char* src, char** dest) {
  * igraph will fall back to the \c id attribute of the \c key tag if
  * \c attr.name is missing.
  *
+ * </para><para>
+ * The file is read in a single pass, the attribute values are stored
+ * in typed arrays while parsing, and converted for the attribute
+ * handler one element type at a time. Use \ref
+ * igraph_read_graph_graphml_skip() to leave out some attributes.
+ *
  * \param graph Pointer to an uninitialized graph object.
  * \param instream A stream, it should be readable.
  * \param index If the GraphML file contains more than one graph, the one
@@ -1302,12 +1543,42 @@ int igraph_i_xml_escape(char* src, char** dest) {
  */
 int igraph_read_graph_graphml(igraph_t *graph, FILE *instream,
 			      int index) {
+  return igraph_read_graph_graphml_skip(graph, instream, index, 0);
+}
+
+/**
+ * \ingroup loadsave
+ * \function igraph_read_graph_graphml_skip
+ * \brief Reads a graph from a GraphML file, without some attributes.
+ *
+ * </para><para>
+ * This is the same as \ref igraph_read_graph_graphml(), but the
+ * values of the given keys are ignored while parsing, so they take
+ * no memory at all. This is useful for large files with many
+ * attributes, when only some of them are needed.
+ *
+ * \param graph Pointer to an uninitialized graph object.
+ * \param instream A stream, it should be readable.
+ * \param index The index of the graph in the file, starting from
+ *              zero, see \ref igraph_read_graph_graphml().
+ * \param skip The keys to ignore, either their \c id or their \c
+ *        attr.name attribute can be given. If a null pointer, then
+ *        all attributes are read.
+ *
+ * \return Error code, see \ref igraph_read_graph_graphml().
+ *
+ * Time complexity: O(n+k), the size of the file, plus k, the number
+ * of keys to skip times the number of keys in the file.
+ */
+int igraph_read_graph_graphml_skip(igraph_t *graph, FILE *instream,
+				   int index, const igraph_strvector_t *skip) {
 
 #if HAVE_LIBXML == 1
   xmlParserCtxtPtr ctxt;
   struct igraph_i_graphml_parser_state state;
   int res;
-  char buffer[4096];
+  char buffer[IGRAPH_I_GRAPHML_BLOCK];
+  char errmsg[4096];
 
   if (index<0)
     IGRAPH_ERROR("Graph index must be non-negative", IGRAPH_EINVAL);
@@ -1317,6 +1588,7 @@ int igraph_read_graph_graphml(igraph_t *graph, FILE *instream,
   /* Create a progressive parser context */
   state.g=graph;
   state.index=index<0?0:index;
+  state.skip=skip;
   res=(int) fread(buffer, 1, 4096, instream);
   ctxt=xmlCreatePushParserCtxt(&igraph_i_graphml_sax_handler,
 			       &state,
@@ -1339,7 +1611,7 @@ int igraph_read_graph_graphml(igraph_t *graph, FILE *instream,
     IGRAPH_ERROR("Cannot set options for the parser context", IGRAPH_EINVAL);
 
   /* Parse the file */
-  while ((res=(int) fread(buffer, 1, 4096, instream))>0) {
+  while ((res=(int) fread(buffer, 1, sizeof(buffer), instream))>0) {
     xmlParseChunk(ctxt, buffer, res, 0);
     if (!state.successful) break;
   }
@@ -1348,9 +1620,12 @@ int igraph_read_graph_graphml(igraph_t *graph, FILE *instream,
   /* Free the context */
   xmlFreeParserCtxt(ctxt);
   if (!state.successful) {
-    if (state.error_message != 0)
-      IGRAPH_ERROR(state.error_message, IGRAPH_PARSEERROR);
-    else
+    if (state.error_message != 0) {
+      /* the error handler frees the state, with the message */
+      strncpy(errmsg, state.error_message, sizeof(errmsg)-1);
+      errmsg[sizeof(errmsg)-1]='\0';
+      IGRAPH_ERROR(errmsg, IGRAPH_PARSEERROR);
+    } else
       IGRAPH_ERROR("Malformed GraphML file", IGRAPH_PARSEERROR);
   }
   if (state.index>=0)
@@ -0,0 +1,866 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2018  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#include "igraph_foreign.h"
+#include "config.h"
+#include "foreign-ncol.h"
+#include "igraph_attributes.h"
+#include "igraph_interface.h"
+#include "igraph_interrupt_internal.h"
+#include "igraph_memory.h"
+#include "igraph_threading_internal.h"
+#include "igraph_types_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Reader for the NCOL and LGL formats of the Large Graph Layout
+ * program.
+ *
+ * The file is read in large blocks, and every block is cut into
+ * pieces at line boundaries, one piece for each thread. The vertex
+ * names are stored in open addressing hash tables, the keys
+ * themselves in large chunks of memory. The first thread adds the
+ * names of its piece to the hash table of the whole file, the others
+ * to a table of their own. After the threads are done, these are
+ * merged into the table of the file, in the order of the pieces, so
+ * the vertex ids are assigned in the order of the first appearance
+ * of the names, just like with a single thread.
+ *
+ * A piece of L bytes contains at most L/2+1 names, L+1 bytes of keys
+ * and L/2+1 edges, all tables and buffers are made large enough for
+ * this before the threads start, so the parser never allocates
+ * memory and cannot fail, it only reports syntax errors.
+ *
+ * In an LGL file the first vertex of an edge is given on an earlier
+ * line, maybe in an earlier piece. The threads, except the first one,
+ * write -1 for these vertices, and they are filled in when merging.
+ */
+
+#define IGRAPH_I_NCOL_BLOCK (1 << 20)
+#define IGRAPH_I_NCOL_CHUNK (1 << 24)
+
+/* character classes */
+#define IGRAPH_I_NCOL_BLANK   1	/* space and tab */
+#define IGRAPH_I_NCOL_NEWLINE 2	/* \n and \r */
+#define IGRAPH_I_NCOL_HASH    4	/* #, only in LGL files */
+#define IGRAPH_I_NCOL_ZERO    8	/* zero bytes end the names */
+#define IGRAPH_I_NCOL_STOP \
+  (IGRAPH_I_NCOL_BLANK | IGRAPH_I_NCOL_NEWLINE | IGRAPH_I_NCOL_HASH)
+
+/* the current vertex in an LGL file */
+#define IGRAPH_I_NCOL_NONE    (-1)	/* none, after an empty line */
+#define IGRAPH_I_NCOL_INHERIT (-2)	/* the one of the previous piece */
+
+/* FNV-1a hash, the high bits are mixed into the slot number */
+#define IGRAPH_I_NCOL_HASH_INIT  2166136261U
+#define IGRAPH_I_NCOL_HASH_PRIME 16777619U
+#define IGRAPH_I_NCOL_SLOT(h, mask) ((long int) (((h) ^ ((h) >> 16)) & (mask)))
+
+typedef struct {
+  igraph_i_ncol_names_t names;
+  igraph_vector_t edges, weights;
+} igraph_i_ncol_local_t;
+
+typedef struct {
+  char *begin, *end;
+  igraph_i_ncol_names_t *names;
+  igraph_real_t *edges, *weights;
+  long int actvertex;		/* LGL, the current vertex */
+  long int no_of_edges, no_of_lines;
+  long int errline;		/* line of the first error, or zero */
+  const char *errmsg;
+  igraph_bool_t has_weights;
+  igraph_bool_t inherited;	/* LGL, edges of the previous vertex */
+} igraph_i_ncol_piece_t;
+
+int igraph_i_ncol_names_init(igraph_i_ncol_names_t *names) {
+  IGRAPH_CHECK(igraph_vector_ptr_init(&names->chunks, 0));
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy, &names->chunks);
+  IGRAPH_CHECK(igraph_vector_ptr_init(&names->keys, 0));
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy, &names->keys);
+  IGRAPH_CHECK(igraph_vector_int_init(&names->slots, 2*16));
+  names->free=0;
+  names->left=names->chunksize=names->bytes=0;
+  names->capacity=0;
+  IGRAPH_FINALLY_CLEAN(2);
+  return 0;
+}
+
+void igraph_i_ncol_names_destroy(igraph_i_ncol_names_t *names) {
+  igraph_vector_ptr_destroy_all(&names->chunks);
+  igraph_vector_ptr_destroy(&names->keys);
+  igraph_vector_int_destroy(&names->slots);
+}
+
+unsigned int igraph_i_ncol_hash(const char *str, size_t len) {
+  unsigned int hash=IGRAPH_I_NCOL_HASH_INIT;
+  size_t i;
+  for (i=0; i<len; i++) {
+    hash=(hash ^ (unsigned char) str[i]) * IGRAPH_I_NCOL_HASH_PRIME;
+  }
+  return hash;
+}
+
+/* Removes all names, but keeps the memory, only the last chunk is
+   kept from the keys. */
+
+static void igraph_i_ncol_names_clear(igraph_i_ncol_names_t *names) {
+  long int i, j, size=igraph_vector_ptr_size(&names->keys);
+  long int mask=igraph_vector_int_size(&names->slots)/2-1;
+  long int nchunks=igraph_vector_ptr_size(&names->chunks);
+
+  /* this is faster than zeroing the whole table if it is sparse */
+  for (i=0; i<size; i++) {
+    const char *key=VECTOR(names->keys)[i];
+    j=IGRAPH_I_NCOL_SLOT(igraph_i_ncol_hash(key, strlen(key)), mask);
+    while (VECTOR(names->slots)[2*j] != i+1) { j=(j+1) & mask; }
+    VECTOR(names->slots)[2*j]=0;
+  }
+  igraph_vector_ptr_clear(&names->keys);
+
+  if (nchunks > 0) {
+    char *last=VECTOR(names->chunks)[nchunks-1];
+    for (i=0; i<nchunks-1; i++) {
+      igraph_Free(VECTOR(names->chunks)[i]);
+    }
+    VECTOR(names->chunks)[0]=last;
+    igraph_vector_ptr_resize(&names->chunks, 1);
+    names->free=last;
+    names->left=names->chunksize;
+  }
+  names->bytes=0;
+}
+
+/* Makes room for 'no' new names, 'bytes' bytes in total, including
+   the terminating zeros. */
+
+int igraph_i_ncol_names_reserve(igraph_i_ncol_names_t *names,
+				long int no, size_t bytes) {
+  long int size=igraph_vector_ptr_size(&names->keys);
+  long int nslots=igraph_vector_int_size(&names->slots)/2;
+
+  if (names->left < bytes) {
+    size_t chunksize= bytes > IGRAPH_I_NCOL_CHUNK ? bytes : IGRAPH_I_NCOL_CHUNK;
+    char *chunk=igraph_Calloc(chunksize, char);
+    if (!chunk) {
+      IGRAPH_ERROR("Cannot store vertex names", IGRAPH_ENOMEM);
+    }
+    IGRAPH_FINALLY(igraph_free, chunk);
+    IGRAPH_CHECK(igraph_vector_ptr_push_back(&names->chunks, chunk));
+    IGRAPH_FINALLY_CLEAN(1);
+    names->free=chunk;
+    names->left=names->chunksize=chunksize;
+  }
+
+  if (names->capacity < size+no) {
+    long int cap=2*names->capacity;
+    if (cap < size+no) { cap=size+no; }
+    IGRAPH_CHECK(igraph_vector_ptr_reserve(&names->keys, cap));
+    names->capacity=cap;
+  }
+
+  if (nslots < 2*(size+no)) {
+    igraph_vector_int_t newslots;
+    long int i, j, mask, oldslots=nslots;
+    while (nslots < 2*(size+no)) { nslots *= 2; }
+    mask=nslots-1;
+    IGRAPH_CHECK(igraph_vector_int_init(&newslots, 2*nslots));
+    for (i=0; i<oldslots; i++) {
+      int id=VECTOR(names->slots)[2*i], hash=VECTOR(names->slots)[2*i+1];
+      if (id == 0) { continue; }
+      j=IGRAPH_I_NCOL_SLOT((unsigned int) hash, mask);
+      while (VECTOR(newslots)[2*j] != 0) { j=(j+1) & mask; }
+      VECTOR(newslots)[2*j]=id;
+      VECTOR(newslots)[2*j+1]=hash;
+    }
+    igraph_vector_int_destroy(&names->slots);
+    names->slots=newslots;
+  }
+
+  return 0;
+}
+
+/* The id of a name, a new one if it is not in the table yet. 'str'
+   has no zero bytes. There must be room for the new name, see
+   igraph_i_ncol_names_reserve(). */
+
+long int igraph_i_ncol_names_get(igraph_i_ncol_names_t *names,
+				 const char *str, size_t len,
+				 unsigned int hash) {
+  int *slots=VECTOR(names->slots);
+  long int mask=igraph_vector_int_size(&names->slots)/2-1;
+  long int i=IGRAPH_I_NCOL_SLOT(hash, mask), id;
+  char *key;
+
+  while (slots[2*i] != 0) {
+    if ((unsigned int) slots[2*i+1] == hash) {
+      id=slots[2*i]-1;
+      key=VECTOR(names->keys)[id];
+      if (strncmp(key, str, len) == 0 && key[len] == '\0') {
+	return id;
+      }
+    }
+    i=(i+1) & mask;
+  }
+
+  id=igraph_vector_ptr_size(&names->keys);
+  key=names->free;
+  memcpy(key, str, len);
+  key[len]='\0';
+  names->free += len+1;
+  names->left -= len+1;
+  names->bytes += len+1;
+  igraph_vector_ptr_push_back(&names->keys, key);
+  slots[2*i]=(int) id+1;
+  slots[2*i+1]=(int) hash;
+
+  return id;
+}
+
+static int igraph_i_ncol_local_init(igraph_i_ncol_local_t *local) {
+  IGRAPH_CHECK(igraph_i_ncol_names_init(&local->names));
+  IGRAPH_FINALLY(igraph_i_ncol_names_destroy, &local->names);
+  IGRAPH_VECTOR_INIT_FINALLY(&local->edges, 0);
+  IGRAPH_CHECK(igraph_vector_init(&local->weights, 0));
+  IGRAPH_FINALLY_CLEAN(2);
+  return 0;
+}
+
+static void igraph_i_ncol_local_destroy(igraph_i_ncol_local_t *local) {
+  igraph_i_ncol_names_destroy(&local->names);
+  igraph_vector_destroy(&local->edges);
+  igraph_vector_destroy(&local->weights);
+}
+
+/* Parses a piece of the file. It starts at the beginning of a line,
+   and it ends after a newline, or at the end of the file. */
+
+static void igraph_i_ncol_parse(igraph_i_ncol_piece_t *piece,
+				const unsigned char *cls,
+				igraph_bool_t lgl) {
+  char *p=piece->begin, *end=piece->end;
+  long int act=piece->actvertex, ne=0, lines=0;
+  int maxtok= lgl ? 2 : 3;
+
+  piece->has_weights=0;
+  piece->inherited=0;
+  piece->errline=0;
+
+  while (p < end) {
+    char *tok[3];
+    size_t len[3];
+    unsigned int hash[3];
+    int ntok=0;
+    igraph_bool_t hashmark=0;
+
+    /* split the line into names */
+    while (1) {
+      char *s;
+      unsigned int h=IGRAPH_I_NCOL_HASH_INIT;
+      while (p < end && (cls[(unsigned char) *p] & IGRAPH_I_NCOL_BLANK)) {
+	p++;
+      }
+      if (p == end || (cls[(unsigned char) *p] & IGRAPH_I_NCOL_NEWLINE)) {
+	break;
+      }
+      if (cls[(unsigned char) *p] & IGRAPH_I_NCOL_HASH) {
+	if (ntok > 0 || hashmark) {
+	  piece->errmsg="unexpected '#'";
+	  goto error;
+	}
+	hashmark=1;
+	p++;
+	continue;
+      }
+      if (ntok == maxtok) {
+	piece->errmsg="too many fields";
+	goto error;
+      }
+      s=p;
+      while (p < end && !(cls[(unsigned char) *p] &
+			  (IGRAPH_I_NCOL_STOP | IGRAPH_I_NCOL_ZERO))) {
+	h=(h ^ (unsigned char) *p) * IGRAPH_I_NCOL_HASH_PRIME;
+	p++;
+      }
+      tok[ntok]=s;
+      len[ntok]=(size_t) (p-s);
+      hash[ntok]=h;
+      ntok++;
+      /* the rest of the name after a zero byte is ignored */
+      while (p < end && !(cls[(unsigned char) *p] & IGRAPH_I_NCOL_STOP)) {
+	p++;
+      }
+    }
+
+    if (!lgl && ntok > 0) {
+      if (ntok < 2) {
+	piece->errmsg="missing vertex name";
+	goto error;
+      }
+      piece->edges[2*ne]=
+	igraph_i_ncol_names_get(piece->names, tok[0], len[0], hash[0]);
+      piece->edges[2*ne+1]=
+	igraph_i_ncol_names_get(piece->names, tok[1], len[1], hash[1]);
+    } else if (lgl && hashmark) {
+      if (ntok != 1) {
+	piece->errmsg="there must be one vertex name after '#'";
+	goto error;
+      }
+      act=igraph_i_ncol_names_get(piece->names, tok[0], len[0], hash[0]);
+    } else if (lgl && ntok == 0) {
+      act=IGRAPH_I_NCOL_NONE;
+    } else if (lgl) {
+      if (act == IGRAPH_I_NCOL_NONE) {
+	piece->errmsg="edge without a '#' line";
+	goto error;
+      } else if (act == IGRAPH_I_NCOL_INHERIT) {
+	piece->inherited=1;
+      }
+      piece->edges[2*ne]= act == IGRAPH_I_NCOL_INHERIT ? -1 : act;
+      piece->edges[2*ne+1]=
+	igraph_i_ncol_names_get(piece->names, tok[0], len[0], hash[0]);
+    }
+
+    /* an edge, with an optional weight as the last field */
+    if (ntok > 0 && !hashmark) {
+      if (ntok == maxtok) {
+	/* strtod() needs a terminating zero, the byte after the
+	   weight is a newline, a space, or the spare byte at the end
+	   of the block */
+	char *w=tok[ntok-1], c=w[len[ntok-1]];
+	w[len[ntok-1]]='\0';
+	piece->weights[ne]=strtod(w, 0);
+	w[len[ntok-1]]=c;
+	piece->has_weights=1;
+      } else {
+	piece->weights[ne]=0;
+      }
+      ne++;
+    }
+
+    /* newline, \n\r and \r\n count as one */
+    if (p < end) {
+      char c=*p++;
+      if (p < end && (*p == '\n' || *p == '\r') && *p != c) { p++; }
+      lines++;
+    }
+  }
+
+  piece->actvertex=act;
+  piece->no_of_edges=ne;
+  piece->no_of_lines=lines;
+  return;
+
+ error:
+  piece->errline=lines+1;
+  piece->no_of_edges=ne;
+  piece->no_of_lines=lines;
+}
+
+#define IGRAPH_I_NCOL_LINESTART(buf, c) \
+  (((buf)[(c)-1] == '\n' || (buf)[(c)-1] == '\r') && \
+   (buf)[(c)] != '\n' && (buf)[(c)] != '\r')
+
+static int igraph_i_read_graph_ncol_lgl(igraph_t *graph, FILE *instream,
+					igraph_strvector_t *predefnames,
+					igraph_bool_t names,
+					igraph_add_weights_t weights,
+					igraph_bool_t directed,
+					igraph_bool_t lgl) {
+
+  const char *format= lgl ? "LGL" : "NCOL";
+  igraph_vector_t edges, ws;
+  igraph_strvector_t namevec;
+  igraph_i_ncol_names_t table;
+  igraph_vector_char_t block;
+  igraph_vector_ptr_t locals;
+  igraph_vector_long_t map;
+  igraph_i_ncol_piece_t *pieces;
+  igraph_vector_ptr_t name, weight;
+  igraph_vector_ptr_t *pname=0, *pweight=0;
+  igraph_attribute_record_t namerec, weightrec;
+  const char *namestr="name", *weightstr="weight";
+  unsigned char cls[256];
+  char errmsg[300];
+  long int size=0, nw=0, lines=0, no_predefined=0;
+  long int act=IGRAPH_I_NCOL_NONE;
+  igraph_integer_t no_of_nodes;
+  igraph_bool_t eof=0, has_weights=0;
+  size_t len=0;
+  int t, nthreads=igraph_get_num_threads();
+
+  memset(cls, 0, sizeof(cls));
+  cls[(unsigned char) ' ']=cls[(unsigned char) '\t']=IGRAPH_I_NCOL_BLANK;
+  cls[(unsigned char) '\n']=cls[(unsigned char) '\r']=IGRAPH_I_NCOL_NEWLINE;
+  cls[0]=IGRAPH_I_NCOL_ZERO;
+  if (lgl) {
+    cls[(unsigned char) '#']=IGRAPH_I_NCOL_HASH;
+  }
+
+  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
+  IGRAPH_VECTOR_INIT_FINALLY(&ws, 0);
+  IGRAPH_CHECK(igraph_strvector_init(&namevec, 0));
+  IGRAPH_FINALLY(igraph_strvector_destroy, &namevec);
+  IGRAPH_CHECK(igraph_i_ncol_names_init(&table));
+  IGRAPH_FINALLY(igraph_i_ncol_names_destroy, &table);
+
+  /* Add the predefined names, if any */
+  if (predefnames != 0) {
+    long int i, id, n;
+    size_t bytes=0;
+    char *key;
+    n=no_predefined=igraph_strvector_size(predefnames);
+    for (i=0; i<n; i++) {
+      igraph_strvector_get(predefnames, i, &key);
+      bytes += strlen(key)+1;
+    }
+    IGRAPH_CHECK(igraph_i_ncol_names_reserve(&table, n, bytes));
+    for (i=0; i<n; i++) {
+      size_t keylen;
+      igraph_strvector_get(predefnames, i, &key);
+      keylen=strlen(key);
+      id=igraph_i_ncol_names_get(&table, key, keylen,
+				 igraph_i_ncol_hash(key, keylen));
+      if (id != i) {
+        IGRAPH_WARNING("reading NCOL file, duplicate entry in predefnames");
+        no_predefined--;
+      }
+    }
+  }
+
+  /* one spare byte at the end, see igraph_i_ncol_parse() */
+  IGRAPH_CHECK(igraph_vector_char_init(&block, nthreads *
+				       IGRAPH_I_NCOL_BLOCK + 1));
+  IGRAPH_FINALLY(igraph_vector_char_destroy, &block);
+
+  /* the names and buffers of the threads, except the first one */
+  IGRAPH_CHECK(igraph_vector_ptr_init(&locals, nthreads));
+  IGRAPH_VECTOR_PTR_SET_ITEM_DESTRUCTOR(&locals, igraph_i_ncol_local_destroy);
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy_all, &locals);
+  for (t=1; t<nthreads; t++) {
+    igraph_i_ncol_local_t *local=igraph_Calloc(1, igraph_i_ncol_local_t);
+    if (!local) {
+      IGRAPH_ERROR("Cannot read NCOL/LGL file", IGRAPH_ENOMEM);
+    }
+    IGRAPH_FINALLY(igraph_free, local);
+    IGRAPH_CHECK(igraph_i_ncol_local_init(local));
+    VECTOR(locals)[t]=local;
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+
+  IGRAPH_CHECK(igraph_vector_long_init(&map, 0));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &map);
+  pieces=igraph_Calloc(nthreads, igraph_i_ncol_piece_t);
+  if (!pieces) {
+    IGRAPH_ERROR("Cannot read NCOL/LGL file", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_free, pieces);
+
+  while (!eof) {
+    size_t blocksize=(size_t) igraph_vector_char_size(&block)-1;
+    char *buf=VECTOR(block);
+    size_t got, end;
+    long int newsize, newnw, cap;
+
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    got=fread(buf+len, 1, blocksize-len, instream);
+    if (got < blocksize-len) {
+      if (ferror(instream)) {
+	IGRAPH_ERROR("Cannot read NCOL/LGL file", IGRAPH_EFILE);
+      }
+      eof=1;
+    }
+    len += got;
+
+    /* only parse complete lines, keep the rest for the next round */
+    end=len;
+    if (!eof) {
+      end--;
+      while (end > 0 && !IGRAPH_I_NCOL_LINESTART(buf, end)) { end--; }
+      if (end == 0) {
+	/* a single line fills the whole block, make it larger */
+	IGRAPH_CHECK(igraph_vector_char_resize(&block, (long int) blocksize*2+1));
+	continue;
+      }
+    }
+
+    /* cut the block into pieces at line boundaries */
+    for (t=0; t<nthreads; t++) {
+      size_t c= t == 0 ? 0 : (size_t) ((double) end * t / nthreads);
+      if (t > 0 && c < (size_t) (pieces[t-1].begin - buf)) {
+	c=(size_t) (pieces[t-1].begin - buf);
+      }
+      while (c > 0 && c < end && !IGRAPH_I_NCOL_LINESTART(buf, c)) { c++; }
+      pieces[t].begin=buf+c;
+      if (t > 0) { pieces[t-1].end=buf+c; }
+    }
+    pieces[nthreads-1].end=buf+end;
+
+    /* make room for the names and edges of each piece, 'edges' and
+       'ws' are only resized at the end, as igraph_vector_resize()
+       would give up the reserved space */
+    for (t=0; t<nthreads; t++) {
+      long int plen=pieces[t].end - pieces[t].begin;
+      if (t == 0) {
+	IGRAPH_CHECK(igraph_i_ncol_names_reserve(&table, plen/2+1,
+						 (size_t) plen+1));
+	if (igraph_vector_capacity(&edges) < size+plen+2) {
+	  cap=2*igraph_vector_capacity(&edges);
+	  IGRAPH_CHECK(igraph_vector_reserve(&edges, cap > size+plen+2 ?
+					     cap : size+plen+2));
+	}
+	if (igraph_vector_capacity(&ws) < nw+plen/2+1) {
+	  cap=2*igraph_vector_capacity(&ws);
+	  IGRAPH_CHECK(igraph_vector_reserve(&ws, cap > nw+plen/2+1 ?
+					     cap : nw+plen/2+1));
+	}
+	pieces[t].names=&table;
+	pieces[t].edges=VECTOR(edges)+size;
+	pieces[t].weights=VECTOR(ws)+nw;
+	pieces[t].actvertex=act;
+      } else {
+	igraph_i_ncol_local_t *local=VECTOR(locals)[t];
+	igraph_i_ncol_names_clear(&local->names);
+	IGRAPH_CHECK(igraph_i_ncol_names_reserve(&local->names, plen/2+1,
+						 (size_t) plen+1));
+	IGRAPH_CHECK(igraph_vector_resize(&local->edges, plen+2));
+	IGRAPH_CHECK(igraph_vector_resize(&local->weights, plen/2+1));
+	pieces[t].names=&local->names;
+	pieces[t].edges=VECTOR(local->edges);
+	pieces[t].weights=VECTOR(local->weights);
+	pieces[t].actvertex=IGRAPH_I_NCOL_INHERIT;
+      }
+    }
+
+    IGRAPH_I_PARALLEL(nthreads)
+    {
+      int p;
+      IGRAPH_I_SHARE(p, 0, nthreads) {
+	igraph_i_ncol_parse(&pieces[p], cls, lgl);
+      }
+    }
+
+    /* the first piece is in place, the others are merged in order */
+    newsize=size; newnw=nw;
+    for (t=0; t<nthreads; t++) {
+      newsize += 2*pieces[t].no_of_edges;
+      newnw += pieces[t].no_of_edges;
+    }
+    if (igraph_vector_capacity(&edges) < newsize) {
+      cap=2*igraph_vector_capacity(&edges);
+      IGRAPH_CHECK(igraph_vector_reserve(&edges, cap > newsize ? cap : newsize));
+    }
+    if (igraph_vector_capacity(&ws) < newnw) {
+      cap=2*igraph_vector_capacity(&ws);
+      IGRAPH_CHECK(igraph_vector_reserve(&ws, cap > newnw ? cap : newnw));
+    }
+
+    for (t=0; t<nthreads; t++) {
+      igraph_i_ncol_piece_t *piece=&pieces[t];
+      long int i, ne=piece->no_of_edges;
+
+      if (t == 0) {
+	act=piece->actvertex;
+      } else {
+	igraph_i_ncol_local_t *local=VECTOR(locals)[t];
+	igraph_i_ncol_names_t *lnames=&local->names;
+	long int nonames=igraph_vector_ptr_size(&lnames->keys);
+
+	IGRAPH_CHECK(igraph_i_ncol_names_reserve(&table, nonames,
+						 lnames->bytes));
+	IGRAPH_CHECK(igraph_vector_long_resize(&map, nonames));
+	for (i=0; i<nonames; i++) {
+	  const char *key=VECTOR(lnames->keys)[i];
+	  size_t keylen=strlen(key);
+	  VECTOR(map)[i]=igraph_i_ncol_names_get(&table, key, keylen,
+						 igraph_i_ncol_hash(key, keylen));
+	}
+
+	if (piece->inherited && act == IGRAPH_I_NCOL_NONE) {
+	  piece->errline=1;
+	  piece->errmsg="edge without a '#' line";
+	}
+	for (i=0; i<2*ne; i++) {
+	  long int v=(long int) piece->edges[i];
+	  piece->edges[i]= v < 0 ? act : VECTOR(map)[v];
+	}
+	memcpy(VECTOR(edges)+size, piece->edges,
+	       sizeof(igraph_real_t) * (size_t) (2*ne));
+	memcpy(VECTOR(ws)+nw, piece->weights,
+	       sizeof(igraph_real_t) * (size_t) ne);
+
+	if (piece->actvertex >= 0) {
+	  act=VECTOR(map)[piece->actvertex];
+	} else if (piece->actvertex == IGRAPH_I_NCOL_NONE) {
+	  act=IGRAPH_I_NCOL_NONE;
+	}
+      }
+
+      if (piece->errline != 0) {
+	snprintf(errmsg, sizeof(errmsg)/sizeof(char),
+		 "Parse error in %s file, line %li (%s)", format,
+		 lines+piece->errline, piece->errmsg);
+	IGRAPH_ERROR(errmsg, IGRAPH_PARSEERROR);
+      }
+
+      size += 2*ne;
+      nw += ne;
+      lines += piece->no_of_lines;
+      has_weights = has_weights || piece->has_weights;
+    }
+
+    len -= end;
+    memmove(buf, buf+end, len);
+  }
+
+  igraph_free(pieces);
+  igraph_vector_long_destroy(&map);
+  igraph_vector_ptr_destroy_all(&locals);
+  igraph_vector_char_destroy(&block);
+  IGRAPH_FINALLY_CLEAN(4);
+
+  /* the reserved part is filled, this does not fail */
+  igraph_vector_resize(&edges, size);
+  igraph_vector_resize(&ws, nw);
+
+  if (lgl) {
+    no_of_nodes=(igraph_integer_t) igraph_vector_ptr_size(&table.keys);
+  } else {
+    if (predefnames != 0 &&
+	igraph_vector_ptr_size(&table.keys) != no_predefined) {
+      IGRAPH_WARNING("unknown vertex/vertices found, predefnames extended");
+    }
+    if (igraph_vector_empty(&edges)) {
+      no_of_nodes = 0;
+    } else {
+      no_of_nodes = (igraph_integer_t) igraph_vector_max(&edges)+1;
+    }
+  }
+
+  if (names) {
+    long int i, n=igraph_vector_ptr_size(&table.keys);
+    IGRAPH_CHECK(igraph_strvector_resize(&namevec, n));
+    for (i=0; i<n; i++) {
+      const char *key=VECTOR(table.keys)[i];
+      IGRAPH_CHECK(igraph_strvector_set2(&namevec, i, key,
+					 (int) strlen(key)));
+    }
+  }
+  igraph_i_ncol_names_destroy(&table);
+  IGRAPH_FINALLY_CLEAN(1);
+
+  IGRAPH_CHECK(igraph_empty(graph, 0, directed));
+  IGRAPH_FINALLY(igraph_destroy, graph);
+
+  if (names) {
+    IGRAPH_CHECK(igraph_vector_ptr_init(&name, 1));
+    IGRAPH_FINALLY(igraph_vector_ptr_destroy, &name);
+    pname=&name;
+    namerec.name=namestr;
+    namerec.type=IGRAPH_ATTRIBUTE_STRING;
+    namerec.value=&namevec;
+    VECTOR(name)[0]=&namerec;
+  }
+
+  if (weights == IGRAPH_ADD_WEIGHTS_YES ||
+      (weights == IGRAPH_ADD_WEIGHTS_IF_PRESENT && has_weights)) {
+    IGRAPH_CHECK(igraph_vector_ptr_init(&weight, 1));
+    IGRAPH_FINALLY(igraph_vector_ptr_destroy, &weight);
+    pweight=&weight;
+    weightrec.name=weightstr;
+    weightrec.type=IGRAPH_ATTRIBUTE_NUMERIC;
+    weightrec.value=&ws;
+    VECTOR(weight)[0]=&weightrec;
+  }
+
+  IGRAPH_CHECK(igraph_add_vertices(graph, no_of_nodes, pname));
+  IGRAPH_CHECK(igraph_add_edges(graph, &edges, pweight));
+
+  if (pweight) {
+    igraph_vector_ptr_destroy(pweight);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+  if (pname) {
+    igraph_vector_ptr_destroy(pname);
+    IGRAPH_FINALLY_CLEAN(1);
+  }
+  igraph_strvector_destroy(&namevec);
+  igraph_vector_destroy(&ws);
+  igraph_vector_destroy(&edges);
+  IGRAPH_FINALLY_CLEAN(4);
+
+  return 0;
+}
+
+/**
+ * \ingroup loadsave
+ * \function igraph_read_graph_ncol
+ * \brief Reads a <code>.ncol</code> file used by LGL.
+ *
+ * Also useful for creating graphs from \quote named\endquote (and
+ * optionally weighted) edge lists. 
+ * 
+ * </para><para>
+ * This format is used by the Large Graph Layout program
+ * (http://lgl.sourceforge.net), and it is simply a
+ * symbolic weighted edge list. It is a simple text file with one edge
+ * per line. An edge is defined by two symbolic vertex names separated
+ * by whitespace. (The symbolic vertex names themselves cannot contain 
+ * whitespace. They might follow by an optional number, this will be
+ * the weight of the edge; the number can be negative and can be in
+ * scientific notation. If there is no weight specified to an edge it
+ * is assumed to be zero.
+ *
+ * </para><para>
+ * The resulting graph is always undirected.
+ * LGL cannot deal with files which contain multiple or loop edges, 
+ * this is however not checked here, as \a igraph is happy with
+ * these.
+ * </para><para>
+ * The file is read in large blocks. If igraph was compiled with
+ * OpenMP support, then the blocks are parsed in parallel, using at
+ * most the number of threads set by \ref igraph_set_num_threads().
+ * \param graph Pointer to an uninitialized graph object.
+ * \param instream Pointer to a stream, it should be readable.
+ * \param predefnames Pointer to the symbolic names of the vertices in
+ *        the file. If \c NULL is given here then vertex ids will be
+ *        assigned to vertex names in the order of their appearance in
+ *        the \c .ncol file. If it is not \c NULL and some unknown
+ *        vertex names are found in the \c .ncol file then new vertex
+ *        ids will be assigned to them. 
+ * \param names Logical value, if TRUE the symbolic names of the
+ *        vertices will be added to the graph as a vertex attribute
+ *        called \quote name\endquote.
+ * \param weights Whether to add the weights of the edges to the
+ *        graph as an edge attribute called \quote weight\endquote.
+ *        \c IGRAPH_ADD_WEIGHTS_YES adds the weights (even if they
+ *        are not present in the file, in this case they are assumed
+ *        to be zero). \c IGRAPH_ADD_WEIGHTS_NO does not add any
+ *        edge attribute. \c IGRAPH_ADD_WEIGHTS_IF_PRESENT adds the
+ *        attribute if and only if there is at least one explicit
+ *        edge weight in the input file.
+ * \param directed Whether to create a directed graph. As this format
+ *        was originally used only for undirected graphs there is no
+ *        information in the file about the directedness of the graph.
+ *        Set this parameter to \c IGRAPH_DIRECTED or \c
+ *        IGRAPH_UNDIRECTED to create a directed or undirected graph.
+ * \return Error code:
+ *         \c IGRAPH_PARSEERROR: if there is a
+ *          problem reading 
+ *         the file, or the file is syntactically incorrect.
+ *
+ * Time complexity:
+ * O(|V|+|E|log(|V|)) if we neglect
+ * the time required by the parsing. As usual
+ * |V| is the number of vertices,
+ * while |E| is the number of edges. 
+ * 
+ * \sa \ref igraph_read_graph_lgl(), \ref igraph_write_graph_ncol()
+ */
+
+int igraph_read_graph_ncol(igraph_t *graph, FILE *instream, 
+			   igraph_strvector_t *predefnames,
+			   igraph_bool_t names, 
+			   igraph_add_weights_t weights,
+			   igraph_bool_t directed) {
+  return igraph_i_read_graph_ncol_lgl(graph, instream, predefnames, names,
+				      weights, directed, /*lgl=*/ 0);
+}
+
+/**
+ * \ingroup loadsave
+ * \function igraph_read_graph_lgl
+ * \brief Reads a graph from an <code>.lgl</code> file
+ * 
+ * </para><para>
+ * The <code>.lgl</code> format is used by the Large Graph
+ * Layout visualization software
+ * (http://lgl.sourceforge.net), it can 
+ * describe undirected optionally weighted graphs. From the LGL
+ * manual: 
+ * 
+ * \blockquote <para>The second format is the LGL file format
+ * (<code>.lgl</code> file 
+ * suffix). This is yet another graph file format that tries to be as
+ * stingy as possible with space, yet keeping the edge file in a human
+ * readable (not binary) format. The format itself is like the
+ * following:
+ * \verbatim # vertex1name
+vertex2name [optionalWeight]
+vertex3name [optionalWeight] \endverbatim
+ * Here, the first vertex of an edge is preceded with a pound sign
+ * '#'.  Then each vertex that shares an edge with that vertex is
+ * listed one per line on subsequent lines.</para> \endblockquote
+ * 
+ * </para><para>
+ * LGL cannot handle loop and multiple edges or directed graphs, but
+ * in \a igraph it is not an error to have multiple and loop edges.
+ * </para><para>
+ * The file is read in large blocks. If igraph was compiled with
+ * OpenMP support, then the blocks are parsed in parallel, using at
+ * most the number of threads set by \ref igraph_set_num_threads().
+ * \param graph Pointer to an uninitialized graph object.
+ * \param instream A stream, it should be readable.
+ * \param names Logical value, if TRUE the symbolic names of the
+ *        vertices will be added to the graph as a vertex attribute
+ *        called \quote name\endquote.
+ * \param weights Whether to add the weights of the edges to the
+ *        graph as an edge attribute called \quote weight\endquote.
+ *        \c IGRAPH_ADD_WEIGHTS_YES adds the weights (even if they
+ *        are not present in the file, in this case they are assumed
+ *        to be zero). \c IGRAPH_ADD_WEIGHTS_NO does not add any
+ *        edge attribute. \c IGRAPH_ADD_WEIGHTS_IF_PRESENT adds the
+ *        attribute if and only if there is at least one explicit
+ *        edge weight in the input file.
+ * \param directed Whether to create a directed graph. As this format
+ *        was originally used only for undirected graphs there is no
+ *        information in the file about the directedness of the graph.
+ *        Set this parameter to \c IGRAPH_DIRECTED or \c
+ *        IGRAPH_UNDIRECTED to create a directed or undirected graph.
+ * \return Error code:
+ *         \c IGRAPH_PARSEERROR: if there is a
+ *         problem reading the file, or the file is syntactically
+ *         incorrect. 
+ *
+ * Time complexity:
+ * O(|V|+|E|log(|V|)) if we neglect
+ * the time required by the parsing. As usual
+ * |V| is the number of vertices,
+ * while |E| is the number of edges. 
+ * 
+ * \sa \ref igraph_read_graph_ncol(), \ref igraph_write_graph_lgl()
+ * 
+ * \example examples/simple/igraph_read_graph_lgl.c
+ */
+
+int igraph_read_graph_lgl(igraph_t *graph, FILE *instream,
+			  igraph_bool_t names, 
+			  igraph_add_weights_t weights,
+			  igraph_bool_t directed) {
+  return igraph_i_read_graph_ncol_lgl(graph, instream, /*predefnames=*/ 0,
+				      names, weights, directed, /*lgl=*/ 1);
+}
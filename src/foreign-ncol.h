@@ -0,0 +1,60 @@
+/* -*- mode: C -*-  */
+/*
+   IGraph library.
+   Copyright (C) 2018  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+   02110-1301 USA
+
+*/
+
+#ifndef FOREIGN_NCOL_H
+#define FOREIGN_NCOL_H
+
+#include "igraph_decls.h"
+#include "igraph_vector.h"
+#include "igraph_vector_ptr.h"
+
+#include <stddef.h>
+
+__BEGIN_DECLS
+
+/* Hash table of vertex names, used by the NCOL, LGL and GraphML
+   readers, see foreign-ncol.c. */
+
+typedef struct {
+  igraph_vector_ptr_t chunks;	/* memory for the keys */
+  char *free;			/* the unused part of the last chunk */
+  size_t left, chunksize;
+  size_t bytes;			/* total size of the keys */
+  igraph_vector_ptr_t keys;	/* zero terminated key of each id */
+  long int capacity;		/* of 'keys' */
+  igraph_vector_int_t slots;	/* pairs of id+1 (zero for free
+				   slots) and hash value */
+} igraph_i_ncol_names_t;
+
+int igraph_i_ncol_names_init(igraph_i_ncol_names_t *names);
+void igraph_i_ncol_names_destroy(igraph_i_ncol_names_t *names);
+unsigned int igraph_i_ncol_hash(const char *str, size_t len);
+int igraph_i_ncol_names_reserve(igraph_i_ncol_names_t *names,
+				long int no, size_t bytes);
+long int igraph_i_ncol_names_get(igraph_i_ncol_names_t *names,
+				 const char *str, size_t len,
+				 unsigned int hash);
+
+__END_DECLS
+
+#endif
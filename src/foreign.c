@@ -31,8 +31,10 @@
 #include "igraph_interrupt_internal.h"
 #include "igraph_constructors.h"
 #include "igraph_types_internal.h"
+#include "igraph_threading_internal.h"
 
 #include <ctype.h>		/* isspace */
+#include <limits.h>
 #include <string.h>
 #include <time.h>
 
@@ -47,6 +49,75 @@
  * operating systems supporting \quote non-standard\endquote streams.</para>
  */
 
+/*
+ * The edge list is read in large blocks and the numbers are parsed
+ * by hand, this is much faster than fscanf(). Numbers are accepted
+ * exactly as fscanf("%li") does: an optional sign, then decimal
+ * digits, octal digits after a leading zero, or hexadecimal digits
+ * after 0x. They need not be separated by whitespace, e.g. "1-2" is
+ * the edge from 1 to -2, an invalid vertex id.
+ *
+ * With more than one thread (see igraph_set_num_threads()) every
+ * block is cut into pieces at whitespace, the threads parse the
+ * pieces into separate buffers and these are concatenated in order,
+ * so the result does not depend on the number of threads. All
+ * buffers are allocated before the threads start and the parser
+ * cannot fail, it only reports syntax errors.
+ */
+
+#define IGRAPH_I_EDGELIST_BLOCK (1 << 20)
+
+#define IGRAPH_I_EDGELIST_SPACE(c) \
+  ((c) == ' ' || (c) == '\n' || (c) == '\t' || (c) == '\r' || \
+   (c) == '\v' || (c) == '\f')
+
+/* Parse the numbers in [p,end) into 'res', which has room for end-p
+   numbers. Returns the number of numbers, or -1 for a syntax error
+   or a number that does not fit into a long int. */
+
+static long int igraph_i_edgelist_parse(const char *p, const char *end,
+					igraph_real_t *res) {
+  long int no=0;
+  while (1) {
+    unsigned long int value=0, base=10, digit;
+    igraph_bool_t neg=0;
+
+    while (p < end && IGRAPH_I_EDGELIST_SPACE(*p)) { p++; }
+    if (p == end) { break; }
+
+    if (*p == '+' || *p == '-') {
+      neg = *p == '-';
+      p++;
+    }
+    if (p == end || *p < '0' || *p > '9') { return -1; }
+    if (*p == '0') {
+      p++;
+      base=8;
+      if (p < end && (*p == 'x' || *p == 'X')) {
+	/* a lone 0x is zero, as for fscanf() */
+	base=16;
+	p++;
+      }
+    }
+    for (; p < end; p++) {
+      if (*p >= '0' && *p <= '9') {
+	digit=(unsigned long int) (*p - '0');
+      } else if (base == 16 && *p >= 'a' && *p <= 'f') {
+	digit=(unsigned long int) (*p - 'a' + 10);
+      } else if (base == 16 && *p >= 'A' && *p <= 'F') {
+	digit=(unsigned long int) (*p - 'A' + 10);
+      } else {
+	break;
+      }
+      if (digit >= base) { break; }
+      if (value > (LONG_MAX - digit) / base) { return -1; }
+      value = value * base + digit;
+    }
+    res[no++] = neg ? -(igraph_real_t) value : (igraph_real_t) value;
+  }
+  return no;
+}
+
 /**
  * \ingroup loadsave
  * \function igraph_read_graph_edgelist
@@ -57,6 +128,11 @@
  * whitespace. The one edge (ie. two integers) per line format is thus
  * not required (but recommended for readability). Edges of directed
  * graphs are assumed to be in from, to order.
+ * 
+ * </para><para>
+ * The file is read in large blocks. If igraph was compiled with
+ * OpenMP support, then the blocks are parsed in parallel, using at
+ * most the number of threads set by \ref igraph_set_num_threads().
  * \param graph Pointer to an uninitialized graph object.
  * \param instream Pointer to a stream, it should be readable.
  * \param n The number of vertices in the graph. If smaller than the
@@ -79,374 +155,132 @@ int igraph_read_graph_edgelist(igraph_t *graph, FILE *instream,
 			       igraph_integer_t n, igraph_bool_t directed) {
 
   igraph_vector_t edges=IGRAPH_VECTOR_NULL;
-  long int from, to;
-  int c;
-  
+  igraph_vector_ptr_t bufs;
+  igraph_vector_long_t cuts, counts;
+  igraph_vector_char_t block;
+  size_t len=0;
+  long int size=0;
+  int t, nthreads=igraph_get_num_threads();
+  igraph_bool_t eof=0, error=0;
+
   IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
   IGRAPH_CHECK(igraph_vector_reserve(&edges, 100));
 
-  /* skip all whitespace */
-  do {
-    c = getc (instream);
-  } while (isspace (c));
-  ungetc (c, instream);
-  
-  while (!feof(instream)) {
-    int read;
+  IGRAPH_CHECK(igraph_vector_char_init(&block, nthreads *
+				       IGRAPH_I_EDGELIST_BLOCK));
+  IGRAPH_FINALLY(igraph_vector_char_destroy, &block);
+
+  /* one result buffer for every thread, except the first one, that
+     one parses directly into 'edges' */
+  IGRAPH_CHECK(igraph_vector_ptr_init(&bufs, nthreads));
+  IGRAPH_VECTOR_PTR_SET_ITEM_DESTRUCTOR(&bufs, igraph_vector_destroy);
+  IGRAPH_FINALLY(igraph_vector_ptr_destroy_all, &bufs);
+  for (t=1; t<nthreads; t++) {
+    igraph_vector_t *v=igraph_Calloc(1, igraph_vector_t);
+    if (!v) {
+      IGRAPH_ERROR("reading edgelist file failed", IGRAPH_ENOMEM);
+    }
+    VECTOR(bufs)[t]=v;
+    IGRAPH_CHECK(igraph_vector_init(v, 0));
+  }
+  IGRAPH_CHECK(igraph_vector_long_init(&cuts, nthreads+1));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &cuts);
+  IGRAPH_CHECK(igraph_vector_long_init(&counts, nthreads));
+  IGRAPH_FINALLY(igraph_vector_long_destroy, &counts);
+
+  while (!eof) {
+    size_t blocksize=(size_t) igraph_vector_char_size(&block);
+    char *buf=VECTOR(block);
+    size_t got, end;
 
     IGRAPH_ALLOW_INTERRUPTION();
-    
-    read=fscanf(instream, "%li", &from);
-    if (read != 1) { 
-      IGRAPH_ERROR("parsing edgelist file failed", IGRAPH_PARSEERROR); 
-    }
-    read=fscanf(instream, "%li", &to);
-    if (read != 1) { 
-      IGRAPH_ERROR("parsing edgelist file failed", IGRAPH_PARSEERROR); 
-    }
-    IGRAPH_CHECK(igraph_vector_push_back(&edges, from));
-    IGRAPH_CHECK(igraph_vector_push_back(&edges, to));
-    
-    /* skip all whitespace */
-    do {
-      c = getc (instream);
-    } while (isspace (c));
-    ungetc (c, instream);    
-  }
-  
-  IGRAPH_CHECK(igraph_create(graph, &edges, n, directed));
-  igraph_vector_destroy(&edges);
-  IGRAPH_FINALLY_CLEAN(1);
-  return 0;
-}
-
-#include "foreign-ncol-header.h"
-
-int igraph_ncol_yylex_init_extra (igraph_i_ncol_parsedata_t* user_defined,
-				void* scanner);
-int igraph_ncol_yylex_destroy (void *scanner );
-int igraph_ncol_yyparse (igraph_i_ncol_parsedata_t* context);
-void igraph_ncol_yyset_in  (FILE * in_str, void* yyscanner );
-
-/**
- * \ingroup loadsave
- * \function igraph_read_graph_ncol
- * \brief Reads a <code>.ncol</code> file used by LGL.
- *
- * Also useful for creating graphs from \quote named\endquote (and
- * optionally weighted) edge lists. 
- * 
- * </para><para>
- * This format is used by the Large Graph Layout program
- * (http://lgl.sourceforge.net), and it is simply a
- * symbolic weighted edge list. It is a simple text file with one edge
- * per line. An edge is defined by two symbolic vertex names separated
- * by whitespace. (The symbolic vertex names themselves cannot contain 
- * whitespace. They might follow by an optional number, this will be
- * the weight of the edge; the number can be negative and can be in
- * scientific notation. If there is no weight specified to an edge it
- * is assumed to be zero.
- *
- * </para><para>
- * The resulting graph is always undirected.
- * LGL cannot deal with files which contain multiple or loop edges, 
- * this is however not checked here, as \a igraph is happy with
- * these.
- * \param graph Pointer to an uninitialized graph object.
- * \param instream Pointer to a stream, it should be readable.
- * \param predefnames Pointer to the symbolic names of the vertices in
- *        the file. If \c NULL is given here then vertex ids will be
- *        assigned to vertex names in the order of their appearance in
- *        the \c .ncol file. If it is not \c NULL and some unknown
- *        vertex names are found in the \c .ncol file then new vertex
- *        ids will be assigned to them. 
- * \param names Logical value, if TRUE the symbolic names of the
- *        vertices will be added to the graph as a vertex attribute
- *        called \quote name\endquote.
- * \param weights Whether to add the weights of the edges to the
- *        graph as an edge attribute called \quote weight\endquote.
- *        \c IGRAPH_ADD_WEIGHTS_YES adds the weights (even if they
- *        are not present in the file, in this case they are assumed
- *        to be zero). \c IGRAPH_ADD_WEIGHTS_NO does not add any
- *        edge attribute. \c IGRAPH_ADD_WEIGHTS_IF_PRESENT adds the
- *        attribute if and only if there is at least one explicit
- *        edge weight in the input file.
- * \param directed Whether to create a directed graph. As this format
- *        was originally used only for undirected graphs there is no
- *        information in the file about the directedness of the graph.
- *        Set this parameter to \c IGRAPH_DIRECTED or \c
- *        IGRAPH_UNDIRECTED to create a directed or undirected graph.
- * \return Error code:
- *         \c IGRAPH_PARSEERROR: if there is a
- *          problem reading 
- *         the file, or the file is syntactically incorrect.
- *
- * Time complexity:
- * O(|V|+|E|log(|V|)) if we neglect
- * the time required by the parsing. As usual
- * |V| is the number of vertices,
- * while |E| is the number of edges. 
- * 
- * \sa \ref igraph_read_graph_lgl(), \ref igraph_write_graph_ncol()
- */
-
-int igraph_read_graph_ncol(igraph_t *graph, FILE *instream, 
-			   igraph_strvector_t *predefnames,
-			   igraph_bool_t names, 
-			   igraph_add_weights_t weights,
-			   igraph_bool_t directed) {
-  
-  igraph_vector_t edges, ws;
-  igraph_trie_t trie=IGRAPH_TRIE_NULL;
-  igraph_integer_t no_of_nodes;
-  long int no_predefined=0;
-  igraph_vector_ptr_t name, weight;
-  igraph_vector_ptr_t *pname=0, *pweight=0;
-  igraph_attribute_record_t namerec, weightrec;
-  const char *namestr="name", *weightstr="weight";
-  igraph_i_ncol_parsedata_t context;
 
-  IGRAPH_CHECK(igraph_empty(graph, 0, directed));
-  IGRAPH_FINALLY(igraph_destroy, graph);
-  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
-
-  IGRAPH_TRIE_INIT_FINALLY(&trie, names);
-  IGRAPH_VECTOR_INIT_FINALLY(&ws, 0);
-
-  /* Add the predefined names, if any */
-  if (predefnames != 0) {
-    long int i, id, n;
-    char *key;
-    n=no_predefined=igraph_strvector_size(predefnames);
-    for (i=0; i<n; i++) {
-      igraph_strvector_get(predefnames, i, &key);
-      igraph_trie_get(&trie, key, &id);
-      if (id != i) {
-        IGRAPH_WARNING("reading NCOL file, duplicate entry in predefnames");
-        no_predefined--;
+    got=fread(buf+len, 1, blocksize-len, instream);
+    if (got < blocksize-len) {
+      if (ferror(instream)) {
+	IGRAPH_ERROR("reading edgelist file failed", IGRAPH_EFILE);
+      }
+      eof=1;
+    }
+    len += got;
+
+    /* only parse complete numbers, keep the rest for the next round */
+    end=len;
+    if (!eof) {
+      while (end > 0 && !IGRAPH_I_EDGELIST_SPACE(buf[end-1])) { end--; }
+      if (end == 0) {
+	/* a single token fills the whole block, make it larger */
+	IGRAPH_CHECK(igraph_vector_char_resize(&block, (long int) blocksize*2));
+	continue;
       }
     }
-  }
-  
-  context.has_weights=0;
-  context.vector=&edges;
-  context.weights=&ws;
-  context.trie=&trie;
-  context.eof=0;
-
-  igraph_ncol_yylex_init_extra(&context, &context.scanner);
-  IGRAPH_FINALLY(igraph_ncol_yylex_destroy, context.scanner);
-
-  igraph_ncol_yyset_in(instream, context.scanner);  
 
-  if (igraph_ncol_yyparse(&context)) {
-    if (context.errmsg) {
-      IGRAPH_ERROR(context.errmsg, IGRAPH_PARSEERROR);
-    } else {
-      IGRAPH_ERROR("Cannot read NCOL file", IGRAPH_PARSEERROR);
+    /* cut the block into pieces at whitespace, one for each thread,
+       and make room for the results, every number takes at least one
+       character */
+    VECTOR(cuts)[0]=0;
+    for (t=1; t<nthreads; t++) {
+      long int c=(long int) ((double) end * t / nthreads);
+      if (c < VECTOR(cuts)[t-1]) { c=VECTOR(cuts)[t-1]; }
+      while (c < (long int) end && !IGRAPH_I_EDGELIST_SPACE(buf[c])) { c++; }
+      VECTOR(cuts)[t]=c;
+    }
+    VECTOR(cuts)[nthreads]=(long int) end;
+    if (igraph_vector_capacity(&edges) < size + (long int) end) {
+      long int cap=igraph_vector_capacity(&edges) * 2;
+      IGRAPH_CHECK(igraph_vector_reserve(&edges, cap > size + (long int) end ?
+					 cap : size + (long int) end));
+    }
+    for (t=1; t<nthreads; t++) {
+      IGRAPH_CHECK(igraph_vector_resize(VECTOR(bufs)[t], VECTOR(cuts)[t+1] -
+					VECTOR(cuts)[t]));
+    }
+
+    IGRAPH_I_PARALLEL(nthreads)
+    {
+      int p;
+      IGRAPH_I_SHARE(p, 0, nthreads) {
+	igraph_real_t *res= p==0 ? VECTOR(edges) + size :
+	  VECTOR(*(igraph_vector_t*)VECTOR(bufs)[p]);
+	VECTOR(counts)[p] =
+	  igraph_i_edgelist_parse(buf + VECTOR(cuts)[p],
+				  buf + VECTOR(cuts)[p+1], res);
+      }
     }
-  }
-
-  if (predefnames != 0 && 
-      igraph_trie_size(&trie) != no_predefined) {
-    IGRAPH_WARNING("unknown vertex/vertices found, predefnames extended");    
-  }
-
-  if (names) {
-    const igraph_strvector_t *namevec;
-    IGRAPH_CHECK(igraph_vector_ptr_init(&name, 1)); 
-    pname=&name;
-    igraph_trie_getkeys(&trie, &namevec); /* dirty */
-    namerec.name=namestr;
-    namerec.type=IGRAPH_ATTRIBUTE_STRING;
-    namerec.value=namevec;
-    VECTOR(name)[0]=&namerec;
-  }
-
-  if (weights == IGRAPH_ADD_WEIGHTS_YES ||
-      (weights == IGRAPH_ADD_WEIGHTS_IF_PRESENT && context.has_weights)) {
-    IGRAPH_CHECK(igraph_vector_ptr_init(&weight, 1)); 
-    pweight=&weight;
-    weightrec.name=weightstr;
-    weightrec.type=IGRAPH_ATTRIBUTE_NUMERIC;
-    weightrec.value=&ws;
-    VECTOR(weight)[0]=&weightrec;
-  }
 
-  if (igraph_vector_empty(&edges)) {
-    no_of_nodes = 0;
-  } else {
-    no_of_nodes = igraph_vector_max(&edges)+1;
-  }
-
-  IGRAPH_CHECK(igraph_add_vertices(graph, no_of_nodes, pname));
-  IGRAPH_CHECK(igraph_add_edges(graph, &edges, pweight));
-
-  if (pname) {
-    igraph_vector_ptr_destroy(pname);
-  }
-  if (pweight) {
-    igraph_vector_ptr_destroy(pweight);
-  }
-  igraph_vector_destroy(&ws); 
-  igraph_trie_destroy(&trie);
-  igraph_vector_destroy(&edges);
-  igraph_ncol_yylex_destroy(context.scanner);
-  IGRAPH_FINALLY_CLEAN(5);
-
-  return 0;
-}
-
-#include "foreign-lgl-header.h"
-
-int igraph_lgl_yylex_init_extra (igraph_i_lgl_parsedata_t* user_defined,
-				void* scanner);
-int igraph_lgl_yylex_destroy (void *scanner );
-int igraph_lgl_yyparse (igraph_i_lgl_parsedata_t* context);
-void igraph_lgl_yyset_in  (FILE * in_str, void* yyscanner );
-
-/**
- * \ingroup loadsave
- * \function igraph_read_graph_lgl
- * \brief Reads a graph from an <code>.lgl</code> file
- * 
- * </para><para>
- * The <code>.lgl</code> format is used by the Large Graph
- * Layout visualization software
- * (http://lgl.sourceforge.net), it can 
- * describe undirected optionally weighted graphs. From the LGL
- * manual: 
- * 
- * \blockquote <para>The second format is the LGL file format
- * (<code>.lgl</code> file 
- * suffix). This is yet another graph file format that tries to be as
- * stingy as possible with space, yet keeping the edge file in a human
- * readable (not binary) format. The format itself is like the
- * following:
- * \verbatim # vertex1name
-vertex2name [optionalWeight]
-vertex3name [optionalWeight] \endverbatim
- * Here, the first vertex of an edge is preceded with a pound sign
- * '#'.  Then each vertex that shares an edge with that vertex is
- * listed one per line on subsequent lines.</para> \endblockquote
- * 
- * </para><para>
- * LGL cannot handle loop and multiple edges or directed graphs, but
- * in \a igraph it is not an error to have multiple and loop edges.
- * \param graph Pointer to an uninitialized graph object.
- * \param instream A stream, it should be readable.
- * \param names Logical value, if TRUE the symbolic names of the
- *        vertices will be added to the graph as a vertex attribute
- *        called \quote name\endquote.
- * \param weights Whether to add the weights of the edges to the
- *        graph as an edge attribute called \quote weight\endquote.
- *        \c IGRAPH_ADD_WEIGHTS_YES adds the weights (even if they
- *        are not present in the file, in this case they are assumed
- *        to be zero). \c IGRAPH_ADD_WEIGHTS_NO does not add any
- *        edge attribute. \c IGRAPH_ADD_WEIGHTS_IF_PRESENT adds the
- *        attribute if and only if there is at least one explicit
- *        edge weight in the input file.
- * \param directed Whether to create a directed graph. As this format
- *        was originally used only for undirected graphs there is no
- *        information in the file about the directedness of the graph.
- *        Set this parameter to \c IGRAPH_DIRECTED or \c
- *        IGRAPH_UNDIRECTED to create a directed or undirected graph.
- * \return Error code:
- *         \c IGRAPH_PARSEERROR: if there is a
- *         problem reading the file, or the file is syntactically
- *         incorrect. 
- *
- * Time complexity:
- * O(|V|+|E|log(|V|)) if we neglect
- * the time required by the parsing. As usual
- * |V| is the number of vertices,
- * while |E| is the number of edges. 
- * 
- * \sa \ref igraph_read_graph_ncol(), \ref igraph_write_graph_lgl()
- * 
- * \example examples/simple/igraph_read_graph_lgl.c
- */
-
-int igraph_read_graph_lgl(igraph_t *graph, FILE *instream,
-			  igraph_bool_t names, 
-			  igraph_add_weights_t weights,
-			  igraph_bool_t directed) {
-
-  igraph_vector_t edges=IGRAPH_VECTOR_NULL, ws=IGRAPH_VECTOR_NULL;
-  igraph_trie_t trie=IGRAPH_TRIE_NULL;
-  igraph_vector_ptr_t name, weight;
-  igraph_vector_ptr_t *pname=0, *pweight=0;
-  igraph_attribute_record_t namerec, weightrec;
-  const char *namestr="name", *weightstr="weight";
-  igraph_i_lgl_parsedata_t context;
-
-  IGRAPH_VECTOR_INIT_FINALLY(&ws, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&edges, 0);
-  IGRAPH_TRIE_INIT_FINALLY(&trie, names);
-  
-  context.has_weights=0;
-  context.vector=&edges;
-  context.weights=&ws;
-  context.trie=&trie;
-  context.eof=0;
-
-  igraph_lgl_yylex_init_extra(&context, &context.scanner);
-  IGRAPH_FINALLY(igraph_lgl_yylex_destroy, context.scanner);
-
-  igraph_lgl_yyset_in(instream, context.scanner);  
-
-  if (igraph_lgl_yyparse(&context)) {
-    if (context.errmsg) {
-      IGRAPH_ERROR(context.errmsg, IGRAPH_PARSEERROR);
-    } else {
-      IGRAPH_ERROR("Cannot read LGL file", IGRAPH_PARSEERROR);
+    /* concatenate the results in order */
+    for (t=0; t<nthreads; t++) {
+      if (VECTOR(counts)[t] < 0) { error=1; break; }
+      if (t > 0) {
+	memcpy(VECTOR(edges) + size,
+	       VECTOR(*(igraph_vector_t*)VECTOR(bufs)[t]),
+	       sizeof(igraph_real_t) * (size_t) VECTOR(counts)[t]);
+      }
+      size += VECTOR(counts)[t];
     }
-  }
-
-  IGRAPH_CHECK(igraph_empty(graph, 0, directed));
-  IGRAPH_FINALLY(igraph_destroy, graph);
+    if (error) {
+      IGRAPH_ERROR("parsing edgelist file failed", IGRAPH_PARSEERROR);
+    }
+    /* the reserved part is filled, this does not fail */
+    igraph_vector_resize(&edges, size);
 
-  if (names) {
-    const igraph_strvector_t *namevec;
-    IGRAPH_CHECK(igraph_vector_ptr_init(&name, 1)); 
-    IGRAPH_FINALLY(igraph_vector_ptr_destroy, &name);
-    pname=&name;
-    igraph_trie_getkeys(&trie, &namevec); /* dirty */
-    namerec.name=namestr;
-    namerec.type=IGRAPH_ATTRIBUTE_STRING;
-    namerec.value=namevec;
-    VECTOR(name)[0]=&namerec;
+    len -= end;
+    memmove(buf, buf+end, len);
   }
 
-  if (weights == IGRAPH_ADD_WEIGHTS_YES ||
-      (weights == IGRAPH_ADD_WEIGHTS_IF_PRESENT && context.has_weights)) {
-    IGRAPH_CHECK(igraph_vector_ptr_init(&weight, 1)); 
-    IGRAPH_FINALLY(igraph_vector_ptr_destroy, &weight);
-    pweight=&weight;
-    weightrec.name=weightstr;
-    weightrec.type=IGRAPH_ATTRIBUTE_NUMERIC;
-    weightrec.value=&ws;
-    VECTOR(weight)[0]=&weightrec;
+  if (size % 2 != 0) {
+    IGRAPH_ERROR("parsing edgelist file failed", IGRAPH_PARSEERROR);
   }
 
-  IGRAPH_CHECK(igraph_add_vertices(graph, (igraph_integer_t) 
-				   igraph_trie_size(&trie), pname));
-  IGRAPH_CHECK(igraph_add_edges(graph, &edges, pweight));
-  
-  if (pweight) {
-    igraph_vector_ptr_destroy(pweight);
-    IGRAPH_FINALLY_CLEAN(1);
-  }
-  if (pname) {
-    igraph_vector_ptr_destroy(pname);
-    IGRAPH_FINALLY_CLEAN(1);
-  }
-  igraph_trie_destroy(&trie);
+  igraph_vector_long_destroy(&counts);
+  igraph_vector_long_destroy(&cuts);
+  igraph_vector_ptr_destroy_all(&bufs);
+  igraph_vector_char_destroy(&block);
+  IGRAPH_FINALLY_CLEAN(4);
+
+  IGRAPH_CHECK(igraph_create(graph, &edges, n, directed));
   igraph_vector_destroy(&edges);
-  igraph_vector_destroy(&ws);
-  igraph_lgl_yylex_destroy(context.scanner);
-  IGRAPH_FINALLY_CLEAN(5);
-  
+  IGRAPH_FINALLY_CLEAN(1);
   return 0;
 }
 
@@ -924,6 +924,15 @@ void igraph_2wheap_destroy(igraph_2wheap_t *h) {
   igraph_vector_long_destroy(&h->index2);
 }
 
+/* Makes sure that the heap can hold 'size' elements without
+   reallocating its storage */
+
+int igraph_2wheap_reserve(igraph_2wheap_t *h, long int size) {
+  IGRAPH_CHECK(igraph_vector_reserve(&h->data, size));
+  IGRAPH_CHECK(igraph_vector_long_reserve(&h->index, size));
+  return 0;
+}
+
 int igraph_2wheap_clear(igraph_2wheap_t *h) {
   igraph_vector_clear(&h->data);
   igraph_vector_long_clear(&h->index);
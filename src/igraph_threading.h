@@ -32,11 +32,18 @@ __BEGIN_DECLS
  * \define IGRAPH_THREAD_SAFE
  * 
  * Macro that is defined to be 1 if the current build of the 
- * igraph library is thread-safe, and 0 if it is not.
+ * igraph library is thread-safe, and 0 if it is not. In a
+ * thread-safe build the global state of igraph, e.g. the error
+ * handlers, the stack of temporary objects and the default random
+ * number generator, is thread-local. Use the
+ * \c --enable-thread-safe configure option to create such a build.
  */
 
 #define IGRAPH_THREAD_SAFE 0
 
+DECLDIR int igraph_set_num_threads(int num_threads);
+DECLDIR int igraph_get_num_threads(void);
+
 __END_DECLS
 
 #endif
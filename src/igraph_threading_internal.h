@@ -0,0 +1,93 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2003-2012  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#ifndef IGRAPH_THREADING_INTERNAL_H
+#define IGRAPH_THREADING_INTERNAL_H
+
+#include "config.h"
+#include "igraph_threading.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#undef __BEGIN_DECLS
+#undef __END_DECLS
+#ifdef __cplusplus
+# define __BEGIN_DECLS extern "C" {
+# define __END_DECLS }
+#else
+# define __BEGIN_DECLS /* empty */
+# define __END_DECLS /* empty */
+#endif
+
+__BEGIN_DECLS
+
+/*
+ * Parallel regions.
+ *
+ * IGRAPH_I_PARALLEL(n) starts the following block on at most 'n'
+ * threads, or runs it on the calling thread if 'n' is one, or if
+ * igraph was compiled without OpenMP. OpenMP may start fewer threads
+ * than requested, so the work must be divided according to
+ * IGRAPH_I_NUM_THREADS, never according to 'n'. IGRAPH_I_SHARE(i,
+ * from, to) does this, it is a loop in which every thread takes
+ * every IGRAPH_I_NUM_THREADS-th value of 'i' from [from,to), starting
+ * at from+IGRAPH_I_THREAD_NUM.
+ *
+ * Code in a parallel region must not raise igraph errors, use the
+ * finally stack or the default random number generator.
+ */
+
+#ifdef _OPENMP
+#define IGRAPH_I_PRAGMA(x) _Pragma(#x)
+#define IGRAPH_I_PARALLEL(n) \
+  IGRAPH_I_PRAGMA(omp parallel num_threads(n) if((n) > 1))
+#define IGRAPH_I_THREAD_NUM omp_get_thread_num()
+#define IGRAPH_I_NUM_THREADS omp_get_num_threads()
+#define IGRAPH_I_BARRIER _Pragma("omp barrier")
+#define IGRAPH_I_SINGLE _Pragma("omp single")
+#else
+#define IGRAPH_I_PARALLEL(n)
+#define IGRAPH_I_THREAD_NUM 0
+#define IGRAPH_I_NUM_THREADS 1
+#define IGRAPH_I_BARRIER
+#define IGRAPH_I_SINGLE
+#endif
+
+#define IGRAPH_I_SHARE(i, from, to) \
+  for ((i)=(from)+IGRAPH_I_THREAD_NUM; (i)<(to); (i)+=IGRAPH_I_NUM_THREADS)
+
+/* Records the size of the team in a parallel region, so that the
+   tests can check that the work is really shared. See
+   igraph_i_last_team_size(). */
+#define IGRAPH_I_RECORD_TEAM \
+  do { if (IGRAPH_I_THREAD_NUM == 0) { \
+      igraph_i_record_team_size(IGRAPH_I_NUM_THREADS); } } while (0)
+
+void igraph_i_record_team_size(int size);
+int igraph_i_last_team_size(void);
+
+__END_DECLS
+
+#endif
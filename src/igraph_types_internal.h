@@ -35,6 +35,7 @@
 #endif
 
 #include "igraph_types.h"
+#include "igraph_datatype.h"
 #include "igraph_matrix.h"
 #include "igraph_stack.h"
 #include "igraph_strvector.h"
@@ -141,6 +142,7 @@ typedef struct igraph_2wheap_t {
 
 int igraph_2wheap_init(igraph_2wheap_t *h, long int size);
 void igraph_2wheap_destroy(igraph_2wheap_t *h);
+int igraph_2wheap_reserve(igraph_2wheap_t *h, long int size);
 int igraph_2wheap_clear(igraph_2wheap_t *h);
 int igraph_2wheap_push_with_index(igraph_2wheap_t *h, 
 				  long int idx, igraph_real_t elem);
@@ -390,6 +392,13 @@ int igraph_fixed_vectorlist_convert(igraph_fixed_vectorlist_t *l,
 				    const igraph_vector_t *from,
 				    long int size);
 
+/* -------------------------------------------------- */
+/* Graph type                                         */
+/* -------------------------------------------------- */
+
+int igraph_i_add_edges_take(igraph_t *graph, igraph_i_graph_vector_t *from,
+			    igraph_i_graph_vector_t *to);
+
 __END_DECLS
 
 #endif
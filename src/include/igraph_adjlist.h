@@ -106,6 +106,61 @@ DECLDIR int igraph_inclist_fprint(const igraph_inclist_t *il, FILE *outfile);
  */
 #define igraph_inclist_get(il,no) (&(il)->incs[(long int)(no)])
 
+typedef struct igraph_csr_t {
+  igraph_integer_t length;
+  long int *start;
+  igraph_integer_t *adj;
+  igraph_integer_t *inc;
+  igraph_bool_t owned;
+} igraph_csr_t;
+
+DECLDIR int igraph_csr_borrow(const igraph_t *graph, igraph_csr_t *csr,
+                igraph_neimode_t mode);
+DECLDIR void igraph_csr_return(igraph_csr_t *csr);
+
+/**
+ * \define igraph_csr_size
+ * The number of neighbors in a compressed adjacency list
+ *
+ * \param csr Pointer to the compressed adjacency list.
+ * \param no The vertex id.
+ * \return The number of adjacent vertices (and incident edges) of the
+ *   vertex, loop and multiple edges are counted as many times as they
+ *   appear in the result of \ref igraph_neighbors().
+ *
+ * Time complexity: O(1).
+ */
+#define igraph_csr_size(csr,no) \
+  ((csr)->start[(long int)(no)+1] - (csr)->start[(long int)(no)])
+
+/**
+ * \define igraph_csr_adj
+ * Neighbors in a compressed adjacency list
+ *
+ * \param csr Pointer to the compressed adjacency list.
+ * \param no The vertex id.
+ * \return Pointer to the first neighbor of the vertex, the neighbors
+ *   are in the same order as in \ref igraph_neighbors(). They must
+ *   not be modified.
+ *
+ * Time complexity: O(1).
+ */
+#define igraph_csr_adj(csr,no) ((csr)->adj + (csr)->start[(long int)(no)])
+
+/**
+ * \define igraph_csr_inc
+ * Incident edges in a compressed adjacency list
+ *
+ * \param csr Pointer to the compressed adjacency list.
+ * \param no The vertex id.
+ * \return Pointer to the first incident edge of the vertex, the edge
+ *   that leads to the first neighbor given by \ref igraph_csr_adj(),
+ *   etc. They must not be modified.
+ *
+ * Time complexity: O(1).
+ */
+#define igraph_csr_inc(csr,no) ((csr)->inc + (csr)->start[(long int)(no)])
+
 typedef struct igraph_lazy_adjlist_t {
   const igraph_t *graph;
   igraph_integer_t length;
@@ -30,6 +30,7 @@
 #include "igraph_datatype.h"
 #include "igraph_iterators.h"
 #include "igraph_arpack.h"
+#include "igraph_random.h"
 
 __BEGIN_DECLS
 
@@ -54,6 +55,12 @@ DECLDIR int igraph_betweenness_estimate(const igraph_t *graph, igraph_vector_t *
                 igraph_real_t cutoff, 
                 const igraph_vector_t *weights, 
                 igraph_bool_t nobigint);
+DECLDIR int igraph_betweenness_approx(const igraph_t *graph, igraph_vector_t *res,
+                igraph_vector_t *error,
+                const igraph_vs_t vids, igraph_bool_t directed,
+                const igraph_vector_t *weights,
+                igraph_real_t epsilon, igraph_real_t delta,
+                igraph_rng_t *rng, igraph_integer_t *samples);
 DECLDIR int igraph_edge_betweenness(const igraph_t *graph, igraph_vector_t *result,
                 igraph_bool_t directed, 
                 const igraph_vector_t *weigths);
@@ -71,7 +71,8 @@ DECLDIR int igraph_community_spinglass(const igraph_t *graph,
 /* 			          igraph_matrix_t *adhesion, */
 /* 			          igraph_matrix_t *normalised_adhesion, */
 /* 			          igraph_real_t *polarization, */
-                igraph_real_t lambda);
+                igraph_real_t lambda,
+                igraph_integer_t replicas);
 
 DECLDIR int igraph_community_spinglass_single(const igraph_t *graph,
                 const igraph_vector_t *weights,
@@ -90,7 +91,9 @@ DECLDIR int igraph_community_walktrap(const igraph_t *graph,
                 int steps,
                 igraph_matrix_t *merges,
                 igraph_vector_t *modularity, 
-                igraph_vector_t *membership);
+                igraph_vector_t *membership,
+                igraph_real_t max_memory,
+                igraph_integer_t *recomputations);
 
 DECLDIR int igraph_community_infomap(const igraph_t * graph,
                 const igraph_vector_t *e_weights,
@@ -120,7 +123,8 @@ DECLDIR int igraph_community_fastgreedy(const igraph_t *graph,
                 const igraph_vector_t *weights,
                 igraph_matrix_t *merges,
                 igraph_vector_t *modularity, 
-                igraph_vector_t *membership);
+                igraph_vector_t *membership,
+                igraph_real_t *peak_memory);
 
 DECLDIR int igraph_community_to_membership(const igraph_matrix_t *merges,
                 igraph_integer_t nodes,
@@ -200,18 +204,27 @@ DECLDIR int igraph_community_leading_eigenvector(const igraph_t *graph,
                 igraph_vector_ptr_t *eigenvectors,
                 igraph_vector_t *history, 
                 igraph_community_leading_eigenvector_callback_t *callback,
-                void *callback_extra);
+                void *callback_extra,
+                igraph_bool_t warm_start);
 
 DECLDIR int igraph_community_label_propagation(const igraph_t *graph,
                 igraph_vector_t *membership,
                 const igraph_vector_t *weights,
                 const igraph_vector_t *initial,
                 igraph_vector_bool_t *fixed,
-                igraph_real_t *modularity);
+                igraph_real_t *modularity,
+                igraph_lpa_mode_t mode);
 DECLDIR int igraph_community_multilevel(const igraph_t *graph,
                 const igraph_vector_t *weights,
                 igraph_vector_t *membership,
                 igraph_matrix_t *memberships,
+                igraph_vector_t *modularity,
+                igraph_bool_t parallel);
+DECLDIR int igraph_community_leiden(const igraph_t *graph,
+                const igraph_vector_t *weights,
+                igraph_real_t resolution,
+                igraph_vector_t *membership,
+                igraph_matrix_t *memberships,
                 igraph_vector_t *modularity);
 
 /* -------------------------------------------------- */
@@ -222,6 +235,10 @@ DECLDIR int igraph_compare_communities(const igraph_vector_t *comm1,
                 const igraph_vector_t *comm2,
                 igraph_real_t* result,
                 igraph_community_comparison_t method);
+DECLDIR int igraph_compare_communities_batch(const igraph_vector_t *comm,
+                const igraph_vector_ptr_t *comms,
+                igraph_vector_t *result,
+                igraph_community_comparison_t method);
 DECLDIR int igraph_split_join_distance(const igraph_vector_t *comm1,
                 const igraph_vector_t *comm2,
                 igraph_integer_t* distance12,
@@ -118,6 +118,9 @@ typedef enum { IGRAPH_COMMCMP_VI = 0,
                IGRAPH_COMMCMP_RAND,
                IGRAPH_COMMCMP_ADJUSTED_RAND } igraph_community_comparison_t;
 
+typedef enum { IGRAPH_LPA_SWEEP = 0,
+               IGRAPH_LPA_FRONTIER } igraph_lpa_mode_t;
+
 typedef enum { IGRAPH_ADD_WEIGHTS_NO = 0,
                IGRAPH_ADD_WEIGHTS_YES,
                IGRAPH_ADD_WEIGHTS_IF_PRESENT } igraph_add_weights_t;
@@ -65,17 +65,63 @@ __BEGIN_DECLS
  *
  * The storage requirements for a graph with \c |V| vertices
  * and \c |E| edges is \c O(|E|+|V|).
+ *
+ * The six vectors are of type \type igraph_i_graph_vector_t, see
+ * below. Use the \ref IGRAPH_FROM, \ref IGRAPH_TO, \ref IGRAPH_OI,
+ * \ref IGRAPH_II, \ref IGRAPH_OS and \ref IGRAPH_IS macros to
+ * read them, these work with both storage types.
+ *
+ * - <b>attr</b> The attributes, handled by the attribute handler.
+ * - <b>cache</b> Compressed adjacency lists, built on demand by
+ *   \ref igraph_csr_borrow() and dropped when the graph is
+ *   modified. It can be a null pointer, then nothing is cached.
+ */
+
+/**
+ * \ingroup internal
+ * \typedef igraph_i_graph_vector_t
+ * \brief Storage type of the edge list and its indices.
+ *
+ * By default the edge list and the indices of \type igraph_t are
+ * stored in \type igraph_vector_t objects, i.e. as doubles. If igraph
+ * is compiled with \c IGRAPH_COMPACT_GRAPH defined, then they are
+ * stored in \type igraph_vector_int_t objects instead. Vertex and
+ * edge ids are \type igraph_integer_t values anyway, so this loses
+ * nothing, but it halves the memory needed for the graph structure
+ * and makes the neighborhood queries more cache friendly.
+ *
+ * </para><para>
+ * Note that \c IGRAPH_COMPACT_GRAPH changes the layout of \type
+ * igraph_t, so the library and the code using it must be compiled
+ * with the same setting.
+ *
+ * </para><para>
+ * \c IGRAPH_I_GRAPH_VECTOR(fun) gives the name of the vector function
+ * \c fun for the chosen storage type, e.g.
+ * <code>IGRAPH_I_GRAPH_VECTOR(init)</code> is either \c
+ * igraph_vector_init or \c igraph_vector_int_init.
  */
+#ifdef IGRAPH_COMPACT_GRAPH
+typedef igraph_vector_int_t igraph_i_graph_vector_t;
+#define IGRAPH_I_GRAPH_VECTOR(fun) igraph_vector_int_##fun
+#else
+typedef igraph_vector_t igraph_i_graph_vector_t;
+#define IGRAPH_I_GRAPH_VECTOR(fun) igraph_vector_##fun
+#endif
+
+struct igraph_i_adjcache_t;
+
 typedef struct igraph_s {
   igraph_integer_t n;
   igraph_bool_t directed;
-  igraph_vector_t from;
-  igraph_vector_t to;
-  igraph_vector_t oi;
-  igraph_vector_t ii;
-  igraph_vector_t os;
-  igraph_vector_t is;
+  igraph_i_graph_vector_t from;
+  igraph_i_graph_vector_t to;
+  igraph_i_graph_vector_t oi;
+  igraph_i_graph_vector_t ii;
+  igraph_i_graph_vector_t os;
+  igraph_i_graph_vector_t is;
   void *attr;
+  struct igraph_i_adjcache_t *cache;
 } igraph_t;
 
 __END_DECLS
@@ -49,6 +49,8 @@ DECLDIR int igraph_read_graph_lgl(igraph_t *graph, FILE *instream,
 DECLDIR int igraph_read_graph_pajek(igraph_t *graph, FILE *instream);
 DECLDIR int igraph_read_graph_graphml(igraph_t *graph, FILE *instream,
                 int index);
+DECLDIR int igraph_read_graph_graphml_skip(igraph_t *graph, FILE *instream,
+                int index, const igraph_strvector_t *skip);
 DECLDIR int igraph_read_graph_dimacs(igraph_t *graph, FILE *instream,
                 igraph_strvector_t *problem,
                 igraph_vector_t *label,
@@ -61,6 +63,7 @@ DECLDIR int igraph_read_graph_graphdb(igraph_t *graph, FILE *instream,
 DECLDIR int igraph_read_graph_gml(igraph_t *graph, FILE *instream);
 DECLDIR int igraph_read_graph_dl(igraph_t *graph, FILE *instream, 
                 igraph_bool_t directed);
+DECLDIR int igraph_read_graph_binary(igraph_t *graph, FILE *instream);
 
 DECLDIR int igraph_write_graph_edgelist(const igraph_t *graph, FILE *outstream);
 DECLDIR int igraph_write_graph_ncol(const igraph_t *graph, FILE *outstream,
@@ -79,6 +82,7 @@ DECLDIR int igraph_write_graph_gml(const igraph_t *graph, FILE *outstream,
 DECLDIR int igraph_write_graph_dot(const igraph_t *graph, FILE *outstream);
 DECLDIR int igraph_write_graph_leda(const igraph_t *graph, FILE *outstream,
                 const char* vertex_attr_name, const char* edge_attr_name);
+DECLDIR int igraph_write_graph_binary(const igraph_t *graph, FILE *outstream);
 
 __END_DECLS
 
@@ -81,6 +81,13 @@ DECLDIR int igraph_incident(const igraph_t *graph, igraph_vector_t *eids, igraph
 #define IGRAPH_OTHER(g,e,v) \
     ((igraph_integer_t)(IGRAPH_TO(g,(e))==(v) ? IGRAPH_FROM((g),(e)) : IGRAPH_TO((g),(e))))
 
+/* Accessors for the indices of the edge list, see igraph_t. These
+   work with both the default and the compact storage. */
+#define IGRAPH_OI(g,i)   ((long int)(VECTOR((g)->oi)[(long int)(i)]))
+#define IGRAPH_II(g,i)   ((long int)(VECTOR((g)->ii)[(long int)(i)]))
+#define IGRAPH_OS(g,v)   ((long int)(VECTOR((g)->os)[(long int)(v)]))
+#define IGRAPH_IS(g,v)   ((long int)(VECTOR((g)->is)[(long int)(v)]))
+
 __END_DECLS
 
 #endif
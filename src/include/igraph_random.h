@@ -65,6 +65,8 @@ DECLDIR int igraph_rng_init(igraph_rng_t *rng, const igraph_rng_type_t *type);
 DECLDIR void igraph_rng_destroy(igraph_rng_t *rng);
 
 DECLDIR int igraph_rng_seed(igraph_rng_t *rng, unsigned long int seed);
+DECLDIR int igraph_rng_split(igraph_rng_t *rng, igraph_rng_t *streams,
+			     int no_of_streams);
 DECLDIR unsigned long int igraph_rng_max(igraph_rng_t *rng);
 DECLDIR unsigned long int igraph_rng_min(igraph_rng_t *rng);
 DECLDIR const char *igraph_rng_name(igraph_rng_t *rng);
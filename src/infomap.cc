@@ -30,29 +30,32 @@
 */
 
 #include <cmath>
+#include <new>
 #include "igraph_interface.h"
 #include "igraph_community.h"
 #include "igraph_interrupt_internal.h"
-
+#include "igraph_threading_internal.h"
+#include "config.h"
 
 #include "infomap_Node.h"
 #include "infomap_Greedy.h"
 
 /****************************************************************************/
-int infomap_partition(FlowGraph * fgraph, bool rcall) {
-  Greedy * greedy;
+/* A single trial. This runs in the worker threads, so it does not use
+   the finally stack and it cannot be interrupted, all memory is owned
+   by local objects. */
+static void infomap_partition(FlowGraph * fgraph, igraph_rng_t * rng) {
 
   // save the original graph
-  FlowGraph * cpy_fgraph = new FlowGraph(fgraph);
-  IGRAPH_FINALLY(delete_FlowGraph, cpy_fgraph);
+  FlowGraph cpy_fgraph(fgraph);
   
-  int Nnode = cpy_fgraph->Nnode; 
+  int Nnode = cpy_fgraph.Nnode; 
   // "real" number of vertex, ie. number of vertex of the graph	
 
   int iteration = 0;
   double outer_oldCodeLength, newCodeLength;
   
-  int *initial_move = NULL;
+  vector<int> initial_move;
   bool initial_move_done = true;
   
   do { // Main loop
@@ -64,59 +67,45 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
       // ===========================================
       
       // intial_move indicate current clustering
-      initial_move = new int[Nnode];    
+      vector<int>(Nnode).swap(initial_move);
       // new_cluster_id --> old_cluster_id (save curent clustering state)
       
-      IGRAPH_FINALLY(operator delete [], initial_move);
       initial_move_done = false;
       
-      int *subMoveTo = NULL; // enventual new partitionment of original graph
+      vector<int> subMoveTo; // enventual new partitionment of original graph
 			
       if ((iteration % 2 == 0) && (fgraph->Nnode > 1)) { 
 	// 0/ Submodule movements : partition each module of the 
 	// current partition (rec. call)
 	
-	subMoveTo = new int[Nnode];       
+	vector<int>(Nnode).swap(subMoveTo);
 	// vid_cpy_fgraph  --> new_cluster_id (new partition)
 
-	IGRAPH_FINALLY(operator delete [], subMoveTo);
-				
 	int subModIndex = 0;
 
 	for (int i=0 ; i < fgraph->Nnode ; i++) {
 	  // partition each non trivial module
 	  int sub_Nnode = fgraph->node[i]->members.size();
 	  if (sub_Nnode > 1) { // If the module is not trivial
-	    int *sub_members  = new int[sub_Nnode];      // id_sub --> id
-	    IGRAPH_FINALLY(operator delete [], sub_members); 
-	    
-	    for (int j=0 ; j < sub_Nnode ; j++)
-	      sub_members[j] = fgraph->node[i]->members[j];
+	    vector<int> sub_members(fgraph->node[i]->members); // id_sub --> id
 	    
 	    // extraction of the subgraph
-	    FlowGraph *sub_fgraph = new FlowGraph(cpy_fgraph, sub_Nnode, 
-						  sub_members);
-	    IGRAPH_FINALLY(delete_FlowGraph, sub_fgraph);
-	    sub_fgraph->initiate();
+	    FlowGraph sub_fgraph(&cpy_fgraph, sub_Nnode, &sub_members[0]);
+	    sub_fgraph.initiate();
 	    
 	    // recursif call of partitionment on the subgraph
-	    infomap_partition(sub_fgraph, true);
+	    infomap_partition(&sub_fgraph, rng);
 	    
 	    // Record membership changes
-	    for (int j=0; j < sub_fgraph->Nnode; j++) {
-	      int Nmembers = sub_fgraph->node[j]->members.size();
+	    for (int j=0; j < sub_fgraph.Nnode; j++) {
+	      int Nmembers = sub_fgraph.node[j]->members.size();
 	      for (int k=0; k<Nmembers; k++) {
-		subMoveTo[sub_members[sub_fgraph->node[j]->members[k]]] = 
+		subMoveTo[sub_members[sub_fgraph.node[j]->members[k]]] = 
 		  subModIndex;
 	      }
 	      initial_move[subModIndex] = i;
 	      subModIndex++;
 	    }
-	    
-	    delete sub_fgraph;
-	    IGRAPH_FINALLY_CLEAN(1);
-	    delete [] sub_members;
-	    IGRAPH_FINALLY_CLEAN(1);
 	  } else{
 	    subMoveTo[fgraph->node[i]->members[0]] = subModIndex;
 	    initial_move[subModIndex] = i;
@@ -134,18 +123,12 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
 	}
       }
       
-      fgraph->back_to(cpy_fgraph);
-      if (subMoveTo) {
-	Greedy *cpy_greedy = new Greedy(fgraph);
-	IGRAPH_FINALLY(delete_Greedy, cpy_greedy);
-	
-	cpy_greedy->setMove(subMoveTo);
-	cpy_greedy->apply(false);
+      fgraph->back_to(&cpy_fgraph);
+      if (!subMoveTo.empty()) {
+	Greedy cpy_greedy(fgraph, rng);
 	
-	delete_Greedy(cpy_greedy);
-	IGRAPH_FINALLY_CLEAN(1);
-	delete [] subMoveTo;
-	IGRAPH_FINALLY_CLEAN(1);
+	cpy_greedy.setMove(&subMoveTo[0]);
+	cpy_greedy.apply(false);
       }
     }
     /**********************************************************************/
@@ -155,29 +138,28 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
     
     do {
       // greedy optimizing object creation
-      greedy = new Greedy(fgraph);
-      IGRAPH_FINALLY(delete_Greedy, greedy);
+      Greedy greedy(fgraph, rng);
       
       // Initial move to apply ?
-      if (!initial_move_done && initial_move) {
+      if (!initial_move_done && !initial_move.empty()) {
 	initial_move_done = true;
-	greedy->setMove(initial_move);
+	greedy.setMove(&initial_move[0]);
       }
       
-      oldCodeLength = greedy->codeLength;
+      oldCodeLength = greedy.codeLength;
       bool moved = true;
       int Nloops = 0;
       //int count = 0;
       double inner_oldCodeLength = 1000;
       
       while (moved) { // main greedy optimizing loop
-	inner_oldCodeLength = greedy->codeLength;
-	moved = greedy->optimize();
+	inner_oldCodeLength = greedy.codeLength;
+	moved = greedy.optimize();
 
 	Nloops++;
 	//count++;
 	
-	if (fabs(greedy->codeLength - inner_oldCodeLength) < 1.0e-10) 
+	if (fabs(greedy.codeLength - inner_oldCodeLength) < 1.0e-10) 
 	  // if the move does'n reduce the codelenght -> exit !
 	  moved = false;
 	
@@ -188,28 +170,78 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
       }
       
       // transform the network to network of modules:
-      greedy->apply(true);
-      newCodeLength = greedy->codeLength;
-      
-      // destroy greedy object
-      delete greedy;
-      IGRAPH_FINALLY_CLEAN(1);
+      greedy.apply(true);
+      newCodeLength = greedy.codeLength;
       
     } while (oldCodeLength - newCodeLength >  1.0e-10); 
     // while there is some improvement
 		
-    if (iteration > 0) {
-      delete [] initial_move;
-      IGRAPH_FINALLY_CLEAN(1);
-    }
-    
     iteration++;
-    if (!rcall) IGRAPH_ALLOW_INTERRUPTION();
   } while (outer_oldCodeLength - newCodeLength > 1.0e-10);
-  
-  delete cpy_fgraph;
-  IGRAPH_FINALLY_CLEAN(1);
-  return IGRAPH_SUCCESS;
+}
+
+/* The trials are independent, they are divided among the threads.
+   Each trial has its own random number generator, seeded from a
+   single number drawn from the default one and the number of the
+   trial, and the best trial is the one with the shortest code length,
+   or the smallest number, if there are ties. So neither the result
+   nor the state of the default generator depends on the number of
+   threads. */
+
+class InfomapTrials {
+ public:
+  InfomapTrials(int nthreads, int Nnode) :
+    nthreads(nthreads), Nnode(Nnode), rngs(0), no_of_rngs(0),
+    codeLength(nthreads), trial(nthreads, -1),
+    membership((size_t) nthreads * Nnode), failed(nthreads, 0) { }
+  ~InfomapTrials() {
+    for (int i=0; i<no_of_rngs; i++) { igraph_rng_destroy(&rngs[i]); }
+    delete [] rngs;
+  }
+
+  void run(FlowGraph * fgraph, int t, int trial_no);
+
+  int nthreads, Nnode;
+  unsigned long int seed;
+  igraph_rng_t *rngs;		// one per thread
+  int no_of_rngs;
+  // the best trial of each thread
+  vector<double> codeLength;
+  vector<int> trial;
+  vector<int> membership;	// Nnode for each thread
+  vector<char> failed;
+};
+
+static void delete_InfomapTrials(InfomapTrials *ws) {
+  delete ws;
+}
+
+void InfomapTrials::run(FlowGraph * fgraph, int t, int trial_no) {
+  try {
+    igraph_rng_seed(&rngs[t], seed + (unsigned long int) trial_no);
+
+    FlowGraph cpy_fgraph(fgraph);
+
+    //partition the network
+    infomap_partition(&cpy_fgraph, &rngs[t]);
+
+    // if better than the better...
+    if (trial[t] < 0 || cpy_fgraph.codeLength < codeLength[t] ||
+	(cpy_fgraph.codeLength == codeLength[t] && trial_no < trial[t])) {
+      codeLength[t] = cpy_fgraph.codeLength;
+      trial[t] = trial_no;
+      // ... store the partition
+      int *memb = &membership[(size_t) t * Nnode];
+      for (int i=0 ; i < cpy_fgraph.Nnode ; i++) {
+	int Nmembers = cpy_fgraph.node[i]->members.size();
+	for (int k=0; k < Nmembers; k++) {
+	  memb[cpy_fgraph.node[i]->members[k]] = i;
+	}
+      }
+    }
+  } catch (std::bad_alloc &) {
+    failed[t] = 1;
+  }
 }
 
 
@@ -245,6 +277,16 @@ int infomap_partition(FlowGraph * fgraph, bool rcall) {
  * If you want to specify a random seed (as in original
  * implementation) you can use \ref igraph_rng_seed().
  * 
+ * </para><para>
+ * The trials are independent, they are divided among the threads,
+ * see \ref igraph_set_num_threads(). The flow of the random walker is
+ * calculated only once, and it is shared by all trials. Each trial
+ * uses its own random number generator, seeded from the default one,
+ * and the first of the trials with the shortest code length is kept,
+ * so the result does not depend on the number of threads. A single
+ * number is taken from the default generator in each call, whatever
+ * the number of threads and trials is.
+ * 
  * \param graph The input graph.
  * \param e_weights Numeric vector giving the weights of the edges. 
  *     If it is a NULL pointer then all edges will have equal
@@ -275,41 +317,72 @@ int igraph_community_infomap(const igraph_t * graph,
   FlowGraph * fgraph = new FlowGraph(graph, e_weights, v_weights);
   IGRAPH_FINALLY(delete_FlowGraph, fgraph);
 	
-  // compute stationary distribution
+  // compute stationary distribution, this is shared by the trials
   fgraph->initiate();
 	
-  FlowGraph * cpy_fgraph ;
   double shortestCodeLength = 1000.0;
   
   // create membership vector
   int Nnode = fgraph->Nnode;
   IGRAPH_CHECK(igraph_vector_resize(membership, Nnode));
+
+  int nthreads = igraph_get_num_threads();
+  if (nthreads > nb_trials) { nthreads = nb_trials; }
+  if (nthreads < 1) { nthreads = 1; }
+
+  InfomapTrials * ws = new InfomapTrials(nthreads, Nnode);
+  IGRAPH_FINALLY(delete_InfomapTrials, ws);
+  ws->rngs = new igraph_rng_t[nthreads];
+  RNG_BEGIN();
+  ws->seed = (unsigned long int) RNG_INTEGER(0, 0x7FFFFFFFL);
+  RNG_END();
+  for (int t = 0; t < nthreads; t++) {
+    IGRAPH_CHECK(igraph_rng_init(&ws->rngs[t], &igraph_rngtype_mt19937));
+    ws->no_of_rngs = t + 1;
+  }
   
-  for (int trial = 0; trial < nb_trials; trial++) {
-    cpy_fgraph = new FlowGraph(fgraph);
-    IGRAPH_FINALLY(delete_FlowGraph, cpy_fgraph);
-    
-    //partition the network
-    IGRAPH_CHECK(infomap_partition(cpy_fgraph, false));
-    
-    // if better than the better...
-    if (cpy_fgraph->codeLength < shortestCodeLength) {
-      shortestCodeLength = cpy_fgraph->codeLength;
-      // ... store the partition
-      for (int i=0 ; i < cpy_fgraph->Nnode ; i++) {
-	int Nmembers = cpy_fgraph->node[i]->members.size();
-	for (int k=0; k < Nmembers; k++) {
-	  //cluster[ cpy_fgraph->node[i]->members[k] ] = i;
-	  VECTOR(*membership)[cpy_fgraph->node[i]->members[k]] = i;
-	}
+  for (int from = 0; from < nb_trials; from += nthreads) {
+    int to = from + nthreads < nb_trials ? from + nthreads : nb_trials;
+    IGRAPH_ALLOW_INTERRUPTION();
+
+    IGRAPH_I_PARALLEL(ws->nthreads)
+    {
+      int me = IGRAPH_I_THREAD_NUM, trial;
+      IGRAPH_I_RECORD_TEAM;
+      IGRAPH_I_SHARE(trial, from, to) {
+	ws->run(fgraph, me, trial);
       }
     }
-    
-    delete_FlowGraph(cpy_fgraph);
-    IGRAPH_FINALLY_CLEAN(1);
+
+    for (int t = 0; t < nthreads; t++) {
+      if (ws->failed[t]) {
+	IGRAPH_ERROR("Infomap community detection failed", IGRAPH_ENOMEM);
+      }
+    }
+  }
+
+  int best = -1;
+  for (int t = 0; t < nthreads; t++) {
+    if (ws->trial[t] >= 0 && 
+	(best < 0 || ws->codeLength[t] < ws->codeLength[best] ||
+	 (ws->codeLength[t] == ws->codeLength[best] &&
+	  ws->trial[t] < ws->trial[best]))) {
+      best = t;
+    }
+  }
+  if (best >= 0) {
+    shortestCodeLength = ws->codeLength[best];
+    for (int i = 0; i < Nnode; i++) {
+      VECTOR(*membership)[i] = ws->membership[(size_t) best * Nnode + i];
+    }
   }
+
+  delete ws;
+  IGRAPH_FINALLY_CLEAN(1);
   
-  *codelength = (igraph_real_t) shortestCodeLength/log(2.0);
+  if (codelength) {
+    *codelength = (igraph_real_t) shortestCodeLength/log(2.0);
+  }
   
   delete fgraph;
   IGRAPH_FINALLY_CLEAN(1);
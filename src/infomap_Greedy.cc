@@ -26,8 +26,9 @@
 #include <iterator>
 #define plogp( x ) ( (x) > 0.0 ? (x)*log(x) : 0.0 )
 
-Greedy::Greedy(FlowGraph * fgraph){
+Greedy::Greedy(FlowGraph * fgraph, igraph_rng_t * rng){
   graph = fgraph;
+  this->rng = rng;
   Nnode = graph->Nnode;
 	
   alpha = graph->alpha;// teleportation probability
@@ -80,15 +81,13 @@ bool Greedy::optimize() {
   bool moved = false;
   Node ** node = graph->node;
 	
-  RNG_BEGIN();
-	
   // Generate random enumeration of nodes
   vector<int> randomOrder(Nnode);
   for (int i=0; i<Nnode; i++) { randomOrder[i] = i; }
   
   for (int i=0; i<Nnode-1; i++) {
     //int randPos = i ; //XXX
-    int randPos = RNG_INTEGER(i, Nnode-1);
+    int randPos = igraph_rng_get_integer(rng, i, Nnode-1);
     // swap i & randPos
     int tmp              = randomOrder[i];
     randomOrder[i]       = randomOrder[randPos];
@@ -203,7 +202,7 @@ bool Greedy::optimize() {
     // Randomize link order for optimized search
     for (int j=0;j<NmodLinks-1;j++) {
       //int randPos = j ; // XXX
-      int randPos = RNG_INTEGER(j, NmodLinks-1);
+      int randPos = igraph_rng_get_integer(rng, j, NmodLinks-1);
       int tmp_M = flowNtoM[j].first;
       double tmp_outFlow = flowNtoM[j].second.first;
       double tmp_inFlow = flowNtoM[j].second.second;
@@ -308,8 +307,6 @@ bool Greedy::optimize() {
     offset += Nnode;
   }
 
-  RNG_END();
-
   return moved;
 }
 
@@ -343,10 +340,11 @@ void Greedy::apply(bool sort) {
   }
   //modSnode[id_when_no_empty_node] = id_in_mod_tbl
 
-  // Create the new graph
-  FlowGraph * tmp_fgraph = new FlowGraph(Nmod);
-  IGRAPH_FINALLY(delete_FlowGraph, tmp_fgraph);
-  Node ** node_tmp = tmp_fgraph->node ;
+  // Create the new graph. This runs in the trial threads, so the
+  // finally stack is not used, the local object is freed on return
+  // and on exceptions as well.
+  FlowGraph tmp_fgraph(Nmod);
+  Node ** node_tmp = tmp_fgraph.node ;
   
   Node ** node = graph->node;
   
@@ -434,12 +432,9 @@ void Greedy::apply(bool sort) {
   vector<int>().swap(mod_empty);
   Nempty = 0;
 
-  //swap node between tmp_graph and graph, then destroy tmp_fgraph
-  graph->swap(tmp_fgraph);
+  //swap node between tmp_graph and graph, tmp_fgraph is destroyed
+  graph->swap(&tmp_fgraph);
   Nnode = Nmod;
-  
-  delete tmp_fgraph;
-  IGRAPH_FINALLY_CLEAN(1);
 }
 
 
@@ -53,6 +53,7 @@ using namespace std;
 
 #include "igraph_random.h"
 #include "igraph_interrupt_internal.h"
+#include "igraph_threading_internal.h"
 #include "config.h"
 
 //#################################################################################################
@@ -1585,6 +1586,303 @@ double PottsModel::GammaSweepZeroTemp(double gamma_start, double gamma_stop, dou
 // }
 //##############################################################################
 
+//#################################################################################################
+// Replica exchange Monte Carlo. The replicas run the heat bath sweeps
+// of PottsModel::HeatBathLookup at different temperatures, in parallel,
+// and neighbouring temperatures swap their configurations after every
+// round. Each replica has its own random number generator, so the
+// result does not depend on the number of threads.
+//#################################################################################################
+
+PottsReplicas::PottsReplicas(network *n, unsigned int qvalue, int m,
+			     unsigned int replicas, int threads)
+{
+  DLList_Iter<NNode*> iter;
+  DLList_Iter<NLink*> l_iter;
+  NNode *node, *n_cur;
+  NLink *l_cur;
+  long i, k;
+  net=n;
+  q=qvalue;
+  operation_mode=m;
+  num_replicas=replicas;
+  nthreads=threads;
+  num_of_nodes=net->node_list->Size();
+
+  // copy the network into arrays, the linked lists of the network
+  // cannot be read from several threads at the same time
+  first_link=new long[num_of_nodes+1];
+  link_end=new long[2*net->link_list->Size()];
+  link_weight=new double[2*net->link_list->Size()];
+  node_weight=new double[num_of_nodes];
+  total_degree_sum=0.0;
+  k=0;
+  node=iter.First(net->node_list);
+  while (!iter.End())
+  {
+    i=node->Get_Index();
+    first_link[i]=k;
+    node_weight[i]=0.0;
+    l_cur=l_iter.First(node->Get_Links());
+    while (!l_iter.End())
+    {
+      if (node==l_cur->Get_Start()) {
+	n_cur=l_cur->Get_End();
+      } else {
+	n_cur=l_cur->Get_Start();
+      }
+      link_end[k]=n_cur->Get_Index();
+      link_weight[k]=l_cur->Get_Weight();
+      node_weight[i]+=l_cur->Get_Weight();
+      k++;
+      l_cur=l_iter.Next();
+    }
+    total_degree_sum+=node_weight[i];
+    node=iter.Next();
+  }
+  first_link[num_of_nodes]=k;
+
+  spins=new unsigned int[num_replicas*num_of_nodes];
+  best_spins=new unsigned int[num_of_nodes];
+  color_field=new double[num_replicas*(q+1)];
+  neighbours=new double[num_replicas*(q+1)];
+  weights=new double[num_replicas*(q+1)];
+  energy=new double[num_replicas];
+  acceptance=new double[num_replicas];
+  kT=new double[num_replicas];
+  ladder=new unsigned int[num_replicas];
+  for (unsigned int r=0; r<num_replicas; r++) ladder[r]=r;
+  rngs=new igraph_rng_t[num_replicas];
+  no_of_rngs=0;
+  best_energy=0.0;
+  has_best=false;
+}
+
+PottsReplicas::~PottsReplicas()
+{
+  for (unsigned int r=0; r<no_of_rngs; r++) igraph_rng_destroy(&rngs[r]);
+  delete [] rngs;
+  delete [] ladder;
+  delete [] kT;
+  delete [] acceptance;
+  delete [] energy;
+  delete [] weights;
+  delete [] neighbours;
+  delete [] color_field;
+  delete [] best_spins;
+  delete [] spins;
+  delete [] node_weight;
+  delete [] link_weight;
+  delete [] link_end;
+  delete [] first_link;
+}
+
+//#####################################################
+// Random initial configuration for every replica. The random number
+// generators of the replicas are created here, from the default one.
+//#####################################################
+int PottsReplicas::assign_initial_conf(void)
+{
+  IGRAPH_CHECK(igraph_rng_split(igraph_rng_default(), rngs, num_replicas));
+  no_of_rngs=num_replicas;
+  for (unsigned int r=0; r<num_replicas; r++)
+  {
+    unsigned int *spin=spins+r*num_of_nodes;
+    double *cf=color_field+r*(q+1);
+    for (unsigned int s=0; s<=q; s++) cf[s]=0.0;
+    for (long i=0; i<num_of_nodes; i++)
+    {
+      spin[i]=(unsigned int) igraph_rng_get_integer(&rngs[r], 1, q);
+      if (operation_mode==0) {
+	cf[spin[i]]++;
+      } else {
+	cf[spin[i]]+=node_weight[i];
+      }
+    }
+  }
+  return 0;
+}
+
+//#####################################################
+// The energy whose differences are used in the heat bath, the
+// weight of the links inside the communities, minus the
+// expected weight.
+//#####################################################
+double PottsReplicas::calculate_energy(unsigned int r, double gamma, double prob)
+{
+  unsigned int *spin=spins+r*num_of_nodes;
+  double *cf=color_field+r*(q+1);
+  double inner=0.0, expected=0.0;
+  for (long i=0; i<num_of_nodes; i++)
+    for (long k=first_link[i]; k<first_link[i+1]; k++)
+      if (spin[link_end[k]]==spin[i]) inner+=link_weight[k];
+  for (unsigned int s=1; s<=q; s++) expected+=cf[s]*cf[s];
+  if (operation_mode==0) {
+    expected*=prob;
+  } else {
+    expected/=total_degree_sum;
+  }
+  return -inner/2.0+gamma*expected/2.0;
+}
+
+//#####################################################
+// The same as PottsModel::HeatBathLookup, for replica r, at
+// temperature kT[r].
+//#####################################################
+double PottsReplicas::HeatBathLookup(unsigned int r, double gamma, double prob,
+				     unsigned int max_sweeps)
+{
+  unsigned int *spin=spins+r*num_of_nodes;
+  double *cf=color_field+r*(q+1);
+  double *nb=neighbours+r*(q+1);
+  double *w=weights+r*(q+1);
+  igraph_rng_t *rng=&rngs[r];
+  unsigned int new_spin, spin_opt, old_spin;
+  unsigned long changes=0;
+  double delta=1.0, h, p=prob, norm, rn, beta, minweight;
+  long node;
+
+  beta=1.0/kT[r];
+  for (unsigned int sweep=0; sweep<max_sweeps; sweep++)
+  {
+    for (long n=0; n<num_of_nodes; n++)
+    {
+      node=igraph_rng_get_integer(rng, 0, num_of_nodes-1);
+      for (unsigned int i=0; i<=q; i++) {
+	nb[i]=0.0;
+	w[i]=0.0;
+      }
+      for (long k=first_link[node]; k<first_link[node+1]; k++)
+	nb[spin[link_end[k]]]+=link_weight[k];
+
+      old_spin=spin[node];
+      if (operation_mode==1) {
+	p=node_weight[node]/total_degree_sum;
+	delta=node_weight[node];
+      }
+      spin_opt=old_spin;
+      minweight=0.0;
+      for (unsigned int s=1; s<=q; s++)
+      {
+	if (s!=old_spin)
+	{
+	  h=cf[s]-(cf[old_spin]-delta);
+	  w[s]=nb[old_spin]-nb[s]+gamma*p*h;
+	  if (w[s]<minweight) minweight=w[s];
+	}
+      }
+      norm=0.0;
+      for (unsigned int s=1; s<=q; s++)
+      {
+	w[s]-=minweight;
+	w[s]=exp(-beta*w[s]);
+	norm+=w[s];
+      }
+
+      rn=igraph_rng_get_unif(rng, 0, norm);
+      for (new_spin=1; new_spin<=q; new_spin++) {
+	if (rn<=w[new_spin]) {
+	  spin_opt=new_spin;
+	  break;
+	} else rn-=w[new_spin];
+      }
+      if (spin_opt!=old_spin)
+      {
+	changes++;
+	spin[node]=spin_opt;
+	cf[old_spin]-=delta;
+	cf[spin_opt]+=delta;
+      }
+    }
+  }
+  return double(changes)/double(num_of_nodes)/double(max_sweeps);
+}
+
+//#####################################################
+// One round of sweeps for all replicas, the coldest one is at
+// temperature t, and the others at t*ratio, t*ratio^2, etc.
+// The best configuration seen so far is kept. Returns the acceptance
+// ratio of the coldest replica.
+//#####################################################
+double PottsReplicas::HeatBathSweeps(double gamma, double prob, double t,
+				     double ratio, unsigned int max_sweeps)
+{
+  unsigned int best=0;
+  for (unsigned int i=0; i<num_replicas; i++)
+  {
+    kT[ladder[i]]=t;
+    t*=ratio;
+  }
+
+  IGRAPH_I_PARALLEL(nthreads)
+  {
+    unsigned int r;
+    IGRAPH_I_RECORD_TEAM;
+    IGRAPH_I_SHARE(r, 0, num_replicas)
+    {
+      acceptance[r]=HeatBathLookup(r, gamma, prob, max_sweeps);
+      energy[r]=calculate_energy(r, gamma, prob);
+    }
+  }
+
+  for (unsigned int r=1; r<num_replicas; r++)
+    if (energy[r]<energy[best]) best=r;
+  if (!has_best || energy[best]<best_energy)
+  {
+    has_best=true;
+    best_energy=energy[best];
+    memcpy(best_spins, spins+best*num_of_nodes,
+	   sizeof(unsigned int)*num_of_nodes);
+  }
+  return acceptance[ladder[0]];
+}
+
+//#####################################################
+// Swap the configurations of neighbouring temperatures, with the
+// usual Metropolis probability. The pairs start at the coldest
+// temperature if parity is zero, and at the second coldest
+// otherwise. Returns the number of swaps. This uses the default
+// random number generator.
+//#####################################################
+unsigned long PottsReplicas::Exchange(double t, double ratio, int parity)
+{
+  unsigned long swaps=0;
+  unsigned int tmp;
+  double beta1, beta2, d;
+  t*=pow(ratio, parity);
+  for (unsigned int i=parity; i+1<num_replicas; i+=2)
+  {
+    beta1=1.0/t;
+    beta2=1.0/(t*ratio);
+    d=(beta1-beta2)*(energy[ladder[i]]-energy[ladder[i+1]]);
+    if (d>=0 || RNG_UNIF01()<exp(d))
+    {
+      tmp=ladder[i];
+      ladder[i]=ladder[i+1];
+      ladder[i+1]=tmp;
+      swaps++;
+    }
+    t*=ratio*ratio;
+  }
+  return swaps;
+}
+
+//#####################################################
+// Write the best configuration into the cluster indices of the
+// network, for PottsModel::WriteClusters.
+//#####################################################
+void PottsReplicas::Set_Best_Conf(void)
+{
+  DLList_Iter<NNode*> iter;
+  NNode *node;
+  node=iter.First(net->node_list);
+  while (!iter.End())
+  {
+    node->Set_ClusterIndex(best_spins[node->Get_Index()]);
+    node=iter.Next();
+  }
+}
+
 //#################################################################################################
 PottsModelN::PottsModelN(network *n, unsigned int num_communities, bool directed)
 {
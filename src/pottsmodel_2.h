@@ -50,6 +50,7 @@
 #include "igraph_types.h"
 #include "igraph_vector.h"
 #include "igraph_matrix.h"
+#include "igraph_random.h"
 
 #define qmax 500
 
@@ -107,6 +108,55 @@ class PottsModel {
 };
 
 
+// Replica exchange (parallel tempering) version of the HeatBathLookup
+// sweeps of PottsModel. The replicas share a read-only copy of the
+// network, each has its own spins and random number generator.
+class PottsReplicas {
+  private:
+    network *net;
+    unsigned int q;
+    unsigned int operation_mode;
+    unsigned int num_replicas;
+    int nthreads;
+    long num_of_nodes;
+    // the network, the links of node i are first_link[i] ...
+    // first_link[i+1]-1, this is not modified by the replicas
+    long *first_link;
+    long *link_end;
+    double *link_weight;
+    double *node_weight;
+    double total_degree_sum;
+    // the state of the replicas, num_of_nodes spins and
+    // q+1 doubles for each replica
+    unsigned int *spins;
+    double *color_field;
+    double *neighbours;
+    double *weights;
+    double *energy;
+    double *acceptance;
+    double *kT;
+    // the replica at each temperature, the coldest first
+    unsigned int *ladder;
+    igraph_rng_t *rngs;
+    unsigned int no_of_rngs;
+    unsigned int *best_spins;
+    double best_energy;
+    bool has_best;
+    double HeatBathLookup(unsigned int r, double gamma, double prob,
+			  unsigned int max_sweeps);
+    double calculate_energy(unsigned int r, double gamma, double prob);
+  public:
+    PottsReplicas(network *net, unsigned int q, int norm_by_degree,
+		  unsigned int replicas, int nthreads);
+    ~PottsReplicas();
+    int assign_initial_conf(void);
+    double HeatBathSweeps(double gamma, double prob, double kT,
+			  double ratio, unsigned int max_sweeps);
+    unsigned long Exchange(double kT, double ratio, int parity);
+    void Set_Best_Conf(void);
+};
+
+
 class PottsModelN {
   private:
   //  HugeArray<double> neg_gammalookup;
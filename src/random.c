@@ -685,6 +685,52 @@ int igraph_rng_seed(igraph_rng_t *rng, unsigned long int seed) {
   return 0;
 }
 
+/**
+ * \function igraph_rng_split
+ * Create independent random number generators for parallel code
+ * 
+ * The default random number generator of igraph cannot be used from
+ * multiple threads at the same time. (In the R interface it is the
+ * random number generator of R.) Parallel code should call this
+ * function before starting the threads, and use a separate generator
+ * in each thread, or for each independent piece of work.
+ * 
+ * </para><para>
+ * The new generators are Mersenne Twister generators, seeded from
+ * \p rng, so the results are reproducible if the seed of \p rng is
+ * set, independently of the number of threads used.
+ * 
+ * \param rng The RNG to take the seeds from, usually
+ *    \ref igraph_rng_default().
+ * \param streams Pointer to an array of uninitialized RNGs, of
+ *    length at least \p no_of_streams. They must be destroyed with
+ *    \ref igraph_rng_destroy() after use.
+ * \param no_of_streams The number of generators to create.
+ * \return Error code.
+ * 
+ * Time complexity: O(no_of_streams).
+ */
+
+int igraph_rng_split(igraph_rng_t *rng, igraph_rng_t *streams,
+		     int no_of_streams) {
+  int i, ret=0;
+  for (i=0; i<no_of_streams; i++) {
+    unsigned long int seed=(unsigned long int) 
+      igraph_rng_get_integer(rng, 0, 0x7FFFFFFFL);
+    ret=igraph_rng_init(&streams[i], &igraph_rngtype_mt19937);
+    if (ret != 0) { break; }
+    ret=igraph_rng_seed(&streams[i], seed);
+    if (ret != 0) { igraph_rng_destroy(&streams[i]); break; }
+  }
+  if (ret != 0) {
+    while (--i >= 0) {
+      igraph_rng_destroy(&streams[i]);
+    }
+    IGRAPH_ERROR("Cannot create random number generators", ret);
+  }
+  return 0;
+}
+
 /** 
  * \function igraph_rng_max 
  * Query the maximum possible integer for a random number generator
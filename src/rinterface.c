@@ -29,7 +29,17 @@
 #include <R.h>
 #include <Rinternals.h>
 #include <Rdefines.h>
+#include <Rversion.h>
 #include "rinterface.h"
+#include "foreign-compress.h"
+#include "igraph_threading_internal.h"
+#include "igraph_adjlist_internal.h"
+
+#if defined(R_VERSION) && R_VERSION >= R_Version(3, 5, 0)
+#define IGRAPH_R_ALTREP 1
+#include <R_ext/Rdynload.h>
+#include <R_ext/Altrep.h>
+#endif
 
 #include "init.c"		/* registration table */
 
@@ -51,7 +61,7 @@ SEXP R_igraph_matrix_to_SEXP(const igraph_matrix_t *m);
 SEXP R_igraph_matrix_complex_to_SEXP(const igraph_matrix_complex_t *m);
 SEXP R_igraph_0ormatrix_complex_to_SEXP(const igraph_matrix_complex_t *m);
 SEXP R_igraph_strvector_to_SEXP(const igraph_strvector_t *m);
-SEXP R_igraph_to_SEXP(const igraph_t *graph);
+SEXP R_igraph_to_SEXP(igraph_t *graph);
 SEXP R_igraph_vectorlist_to_SEXP(const igraph_vector_ptr_t *ptr);
 SEXP R_igraph_vectorlist_int_to_SEXP(const igraph_vector_ptr_t *ptr);
 void R_igraph_vectorlist_int_destroy(igraph_vector_ptr_t *ptr);
@@ -78,6 +88,10 @@ int R_SEXP_to_matrix_complex(SEXP pakl, igraph_matrix_complex_t *akl);
 int R_SEXP_to_igraph_matrix_copy(SEXP pakl, igraph_matrix_t *akl);
 int R_SEXP_to_igraph(SEXP graph, igraph_t *res);
 int R_SEXP_to_igraph_copy(SEXP graph, igraph_t *res);
+int R_SEXP_to_igraph_graph_vector(SEXP sv, igraph_i_graph_vector_t *v);
+int R_SEXP_to_igraph_graph_vector_copy(SEXP sv, igraph_i_graph_vector_t *v);
+SEXP R_igraph_graph_vector_to_SEXP(igraph_i_graph_vector_t *v);
+void R_igraph_altrep_init(DllInfo *dll);
 int R_SEXP_to_igraph_vs(SEXP rit, igraph_t *graph, igraph_vs_t *it);
 int R_SEXP_to_igraph_es(SEXP rit, igraph_t *graph, igraph_es_t *it);
 int R_SEXP_to_igraph_adjlist(SEXP vectorlist, igraph_adjlist_t *ptr);
@@ -2129,6 +2143,7 @@ void R_init_igraph(DllInfo *dll) {
   R_registerRoutines(dll, CEntries, CallEntries, NULL, NULL);
   R_useDynamicSymbols(dll, FALSE);
   R_forceSymbols(dll, TRUE);
+  R_igraph_altrep_init(dll);
 
   igraph_set_error_handler(R_igraph_myhandler);
   igraph_set_warning_handler(R_igraph_warning_handler);
@@ -2147,6 +2162,24 @@ SEXP R_igraph_set_verbose(SEXP verbose) {
   return R_NilValue;
 }
 
+SEXP R_igraph_set_num_threads(SEXP nthreads) {
+  igraph_set_num_threads(INTEGER(nthreads)[0]);
+  return R_NilValue;
+}
+
+/* For the tests: the finally stack must be empty between calls */
+
+SEXP R_igraph_finally_stack_size() {
+  return ScalarInteger(IGRAPH_FINALLY_STACK_SIZE());
+}
+
+/* For the tests: the number of threads in the last parallel region
+   that recorded its team, or -1 without OpenMP */
+
+SEXP R_igraph_last_team_size() {
+  return ScalarInteger(igraph_i_last_team_size());
+}
+
 SEXP R_igraph_finalizer() {
   SEXP rho;
   PROTECT(rho = EVAL(lang2(install("getNamespace"), 
@@ -2428,36 +2461,190 @@ SEXP R_igraph_strvector_to_SEXP(const igraph_strvector_t *m) {
   return result;
 }
 
-SEXP R_igraph_to_SEXP(const igraph_t *graph) {
+/* 
+ * The edge list and the indices of the graph are stored in numeric R
+ * vectors by default and in integer R vectors if igraph is compiled
+ * with IGRAPH_COMPACT_GRAPH. Both builds can read both kinds of
+ * objects, a graph of the other kind is converted on the fly.
+ */
+
+#ifdef IGRAPH_R_ALTREP
+
+/* 
+ * With R 3.5.0 and above, the vectors of a graph returned by a C
+ * function are not copied, R_igraph_graph_vector_to_SEXP() moves
+ * them into an ALTREP vector instead. The storage is owned by an
+ * external pointer, and it is freed by its finalizer. Duplicating or
+ * serializing these vectors creates ordinary R vectors, and reading
+ * them back via R_SEXP_to_igraph() does not copy them at all.
+ */
+
+static R_altrep_class_t R_igraph_graph_vector_class;
+
+static void R_igraph_graph_vector_finalizer(SEXP ptr) {
+  igraph_i_graph_vector_t *v=R_ExternalPtrAddr(ptr);
+  if (v) {
+    IGRAPH_I_GRAPH_VECTOR(destroy)(v);
+    igraph_Free(v);
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+static igraph_i_graph_vector_t *R_igraph_graph_vector_altrep(SEXP x) {
+  return R_ExternalPtrAddr(R_altrep_data1(x));
+}
+
+static R_xlen_t R_igraph_graph_vector_Length(SEXP x) {
+  return IGRAPH_I_GRAPH_VECTOR(size)(R_igraph_graph_vector_altrep(x));
+}
+
+static void *R_igraph_graph_vector_Dataptr(SEXP x, Rboolean writeable) {
+  return R_igraph_graph_vector_altrep(x)->stor_begin;
+}
+
+static const void *R_igraph_graph_vector_Dataptr_or_null(SEXP x) {
+  return R_igraph_graph_vector_altrep(x)->stor_begin;
+}
+
+static Rboolean R_igraph_graph_vector_Inspect(SEXP x, int pre, int deep,
+					      int pvec, 
+					      void (*inspect_subtree)(SEXP, int, int, int)) {
+  Rprintf(" igraph graph vector, length %ld\n",
+	  (long int) R_igraph_graph_vector_Length(x));
+  return TRUE;
+}
+
+#ifdef IGRAPH_COMPACT_GRAPH
+static int R_igraph_graph_vector_Elt(SEXP x, R_xlen_t i) {
+  return VECTOR(*R_igraph_graph_vector_altrep(x))[i];
+}
+#else
+static double R_igraph_graph_vector_Elt(SEXP x, R_xlen_t i) {
+  return VECTOR(*R_igraph_graph_vector_altrep(x))[i];
+}
+#endif
+
+void R_igraph_altrep_init(DllInfo *dll) {
+#ifdef IGRAPH_COMPACT_GRAPH
+  R_altrep_class_t cls=R_make_altinteger_class("igraph_graph_vector",
+					       "igraph", dll);
+  R_set_altinteger_Elt_method(cls, R_igraph_graph_vector_Elt);
+#else
+  R_altrep_class_t cls=R_make_altreal_class("igraph_graph_vector",
+					    "igraph", dll);
+  R_set_altreal_Elt_method(cls, R_igraph_graph_vector_Elt);
+#endif
+  R_set_altrep_Length_method(cls, R_igraph_graph_vector_Length);
+  R_set_altrep_Inspect_method(cls, R_igraph_graph_vector_Inspect);
+  R_set_altvec_Dataptr_method(cls, R_igraph_graph_vector_Dataptr);
+  R_set_altvec_Dataptr_or_null_method(cls, 
+				      R_igraph_graph_vector_Dataptr_or_null);
+  R_igraph_graph_vector_class=cls;
+}
+
+#else
+
+void R_igraph_altrep_init(DllInfo *dll) { }
+
+#endif
+
+/* 
+ * Convert a vector of the graph to an R vector. With ALTREP, the
+ * storage of 'v' is moved into the result, and 'v' is left empty, it
+ * can only be destroyed afterwards. Otherwise it is copied.
+ */
+
+SEXP R_igraph_graph_vector_to_SEXP(igraph_i_graph_vector_t *v) {
+  SEXP result;
+  long int n=IGRAPH_I_GRAPH_VECTOR(size)(v);
+#ifdef IGRAPH_R_ALTREP
+  igraph_i_graph_vector_t *stolen=igraph_Calloc(1, igraph_i_graph_vector_t);
+  if (stolen) {
+    SEXP ptr;
+    PROTECT(ptr=R_MakeExternalPtr(stolen, R_NilValue, R_NilValue));
+    R_RegisterCFinalizerEx(ptr, R_igraph_graph_vector_finalizer, TRUE);
+    *stolen=*v;
+    v->stor_begin=v->stor_end=v->end=0;
+    result=R_new_altrep(R_igraph_graph_vector_class, ptr, R_NilValue);
+    UNPROTECT(1);
+    return result;
+  }
+#endif
+#ifdef IGRAPH_COMPACT_GRAPH
+  PROTECT(result=NEW_INTEGER(n));
+  memcpy(INTEGER(result), v->stor_begin, sizeof(int)*(size_t) n);
+#else
+  PROTECT(result=NEW_NUMERIC(n));
+  memcpy(REAL(result), v->stor_begin, sizeof(igraph_real_t)*(size_t) n);
+#endif
+  UNPROTECT(1);
+  return result;
+}
+
+int R_SEXP_to_igraph_graph_vector(SEXP sv, igraph_i_graph_vector_t *v) {
+  long int i, n=GET_LENGTH(sv);
+#ifdef IGRAPH_COMPACT_GRAPH
+  if (TYPEOF(sv) == INTSXP) {
+    v->stor_begin=INTEGER(sv);
+  } else {
+    v->stor_begin=(int*) R_alloc((size_t) n, sizeof(int));
+    for (i=0; i<n; i++) { v->stor_begin[i] = (int) REAL(sv)[i]; }
+  }
+#else
+  if (TYPEOF(sv) == REALSXP) {
+    v->stor_begin=REAL(sv);
+  } else {
+    v->stor_begin=(igraph_real_t*) R_alloc((size_t) n, sizeof(igraph_real_t));
+    for (i=0; i<n; i++) { v->stor_begin[i] = INTEGER(sv)[i]; }
+  }
+#endif
+  v->stor_end=v->stor_begin+n;
+  v->end=v->stor_end;
+  return 0;
+}
+
+int R_SEXP_to_igraph_graph_vector_copy(SEXP sv, igraph_i_graph_vector_t *v) {
+  long int i, n=GET_LENGTH(sv);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(v, n));
+#ifdef IGRAPH_COMPACT_GRAPH
+  if (TYPEOF(sv) == INTSXP) {
+    memcpy(v->stor_begin, INTEGER(sv), sizeof(int)*(size_t) n);
+  } else {
+    for (i=0; i<n; i++) { VECTOR(*v)[i] = (int) REAL(sv)[i]; }
+  }
+#else
+  if (TYPEOF(sv) == REALSXP) {
+    memcpy(v->stor_begin, REAL(sv), sizeof(igraph_real_t)*(size_t) n);
+  } else {
+    for (i=0; i<n; i++) { VECTOR(*v)[i] = INTEGER(sv)[i]; }
+  }
+#endif
+  return 0;
+}
+
+/* 
+ * The edge list and the indices of 'graph' are moved into the result
+ * if possible, see R_igraph_graph_vector_to_SEXP(). The graph must
+ * be destroyed afterwards, but it cannot be used for anything else.
+ */
+
+SEXP R_igraph_to_SEXP(igraph_t *graph) {
   
   SEXP result;
   long int no_of_nodes=igraph_vcount(graph);
-  long int no_of_edges=igraph_ecount(graph);
   
   PROTECT(result=NEW_LIST(10));
   SET_VECTOR_ELT(result, 0, NEW_NUMERIC(1));
   SET_VECTOR_ELT(result, 1, NEW_LOGICAL(1));
-  SET_VECTOR_ELT(result, 2, NEW_NUMERIC(no_of_edges));
-  SET_VECTOR_ELT(result, 3, NEW_NUMERIC(no_of_edges));
-  SET_VECTOR_ELT(result, 4, NEW_NUMERIC(no_of_edges));
-  SET_VECTOR_ELT(result, 5, NEW_NUMERIC(no_of_edges));
-  SET_VECTOR_ELT(result, 6, NEW_NUMERIC(no_of_nodes+1));
-  SET_VECTOR_ELT(result, 7, NEW_NUMERIC(no_of_nodes+1));
+  SET_VECTOR_ELT(result, 2, R_igraph_graph_vector_to_SEXP(&graph->from));
+  SET_VECTOR_ELT(result, 3, R_igraph_graph_vector_to_SEXP(&graph->to));
+  SET_VECTOR_ELT(result, 4, R_igraph_graph_vector_to_SEXP(&graph->oi));
+  SET_VECTOR_ELT(result, 5, R_igraph_graph_vector_to_SEXP(&graph->ii));
+  SET_VECTOR_ELT(result, 6, R_igraph_graph_vector_to_SEXP(&graph->os));
+  SET_VECTOR_ELT(result, 7, R_igraph_graph_vector_to_SEXP(&graph->is));
 
   REAL(VECTOR_ELT(result, 0))[0]=no_of_nodes;
   LOGICAL(VECTOR_ELT(result, 1))[0]=graph->directed;
-  memcpy(REAL(VECTOR_ELT(result, 2)), graph->from.stor_begin, 
-	 sizeof(igraph_real_t)*(size_t) no_of_edges);
-  memcpy(REAL(VECTOR_ELT(result, 3)), graph->to.stor_begin, 
-	 sizeof(igraph_real_t)*(size_t) no_of_edges);
-  memcpy(REAL(VECTOR_ELT(result, 4)), graph->oi.stor_begin, 
-	 sizeof(igraph_real_t)*(size_t) no_of_edges);
-  memcpy(REAL(VECTOR_ELT(result, 5)), graph->ii.stor_begin, 
-	 sizeof(igraph_real_t)*(size_t) no_of_edges);
-  memcpy(REAL(VECTOR_ELT(result, 6)), graph->os.stor_begin, 
-	 sizeof(igraph_real_t)*(size_t) (no_of_nodes+1));
-  memcpy(REAL(VECTOR_ELT(result, 7)), graph->is.stor_begin, 
-	 sizeof(igraph_real_t)*(size_t) (no_of_nodes+1));
   
   SET_CLASS(result, ScalarString(CREATE_STRING_VECTOR("igraph")));
 
@@ -3074,21 +3261,60 @@ int R_igraph_SEXP_to_array3_copy(SEXP rval, igraph_array3_t *a) {
   return 0;
 }
 
+/* 
+ * The adjacency list cache of the graph lives in its environment, so
+ * it is kept between calls. Old graphs without an environment do not
+ * have a cache.
+ */
+
+static void R_igraph_graph_cache_finalizer(SEXP ptr) {
+  struct igraph_i_adjcache_t *cache=R_ExternalPtrAddr(ptr);
+  if (cache) {
+    igraph_i_adjcache_destroy(cache);
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+static struct igraph_i_adjcache_t *R_igraph_graph_cache(SEXP graph) {
+  SEXP env, ptr;
+  struct igraph_i_adjcache_t *cache;
+
+  if (GET_LENGTH(graph) != 10 || !isEnvironment(VECTOR_ELT(graph, 9))) {
+    return 0;
+  }
+  env=VECTOR_ELT(graph, 9);
+  ptr=findVarInFrame(env, install(R_IGRAPH_CACHE_VAR));
+  if (ptr != R_UnboundValue && TYPEOF(ptr) == EXTPTRSXP && 
+      R_ExternalPtrAddr(ptr)) {
+    return R_ExternalPtrAddr(ptr);
+  }
+
+  cache=igraph_i_adjcache_create(/*external=*/ 1);
+  if (!cache) { return 0; }
+  PROTECT(ptr=R_MakeExternalPtr(cache, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, R_igraph_graph_cache_finalizer, TRUE);
+  defineVar(install(R_IGRAPH_CACHE_VAR), ptr, env);
+  UNPROTECT(1);
+  return cache;
+}
+
 int R_SEXP_to_igraph(SEXP graph, igraph_t *res) {
   
   res->n=(igraph_integer_t) REAL(VECTOR_ELT(graph, 0))[0];
   res->directed=LOGICAL(VECTOR_ELT(graph, 1))[0];
-  R_SEXP_to_vector(VECTOR_ELT(graph, 2), &res->from);
-  R_SEXP_to_vector(VECTOR_ELT(graph, 3), &res->to);
-  R_SEXP_to_vector(VECTOR_ELT(graph, 4), &res->oi);
-  R_SEXP_to_vector(VECTOR_ELT(graph, 5), &res->ii);
-  R_SEXP_to_vector(VECTOR_ELT(graph, 6), &res->os);
-  R_SEXP_to_vector(VECTOR_ELT(graph, 7), &res->is);
+  R_SEXP_to_igraph_graph_vector(VECTOR_ELT(graph, 2), &res->from);
+  R_SEXP_to_igraph_graph_vector(VECTOR_ELT(graph, 3), &res->to);
+  R_SEXP_to_igraph_graph_vector(VECTOR_ELT(graph, 4), &res->oi);
+  R_SEXP_to_igraph_graph_vector(VECTOR_ELT(graph, 5), &res->ii);
+  R_SEXP_to_igraph_graph_vector(VECTOR_ELT(graph, 6), &res->os);
+  R_SEXP_to_igraph_graph_vector(VECTOR_ELT(graph, 7), &res->is);
   
   /* attributes */
   REAL(VECTOR_ELT(VECTOR_ELT(graph, 8), 0))[0] = 1; /* R objects refcount */
   REAL(VECTOR_ELT(VECTOR_ELT(graph, 8), 0))[1] = 0; /* igraph_t objects */
   res->attr=VECTOR_ELT(graph, 8);
+
+  res->cache=R_igraph_graph_cache(graph);
   
   return 0;
 }
@@ -3097,24 +3323,21 @@ int R_SEXP_to_igraph_copy(SEXP graph, igraph_t *res) {
   
   res->n=(igraph_integer_t) REAL(VECTOR_ELT(graph, 0))[0];
   res->directed=LOGICAL(VECTOR_ELT(graph, 1))[0];
-  igraph_vector_init_copy(&res->from, REAL(VECTOR_ELT(graph, 2)), 
-		   GET_LENGTH(VECTOR_ELT(graph, 2)));
-  igraph_vector_init_copy(&res->to, REAL(VECTOR_ELT(graph, 3)), 
-		   GET_LENGTH(VECTOR_ELT(graph, 3)));
-  igraph_vector_init_copy(&res->oi, REAL(VECTOR_ELT(graph, 4)), 
-		   GET_LENGTH(VECTOR_ELT(graph, 4)));
-  igraph_vector_init_copy(&res->ii, REAL(VECTOR_ELT(graph, 5)), 
-		   GET_LENGTH(VECTOR_ELT(graph, 5)));
-  igraph_vector_init_copy(&res->os, REAL(VECTOR_ELT(graph, 6)), 
-		   GET_LENGTH(VECTOR_ELT(graph, 6)));
-  igraph_vector_init_copy(&res->is, REAL(VECTOR_ELT(graph, 7)),
-		   GET_LENGTH(VECTOR_ELT(graph, 7)));
+  R_SEXP_to_igraph_graph_vector_copy(VECTOR_ELT(graph, 2), &res->from);
+  R_SEXP_to_igraph_graph_vector_copy(VECTOR_ELT(graph, 3), &res->to);
+  R_SEXP_to_igraph_graph_vector_copy(VECTOR_ELT(graph, 4), &res->oi);
+  R_SEXP_to_igraph_graph_vector_copy(VECTOR_ELT(graph, 5), &res->ii);
+  R_SEXP_to_igraph_graph_vector_copy(VECTOR_ELT(graph, 6), &res->os);
+  R_SEXP_to_igraph_graph_vector_copy(VECTOR_ELT(graph, 7), &res->is);
 
   /* attributes */
   REAL(VECTOR_ELT(VECTOR_ELT(graph, 8), 0))[0] = 1; /* R objects */
   REAL(VECTOR_ELT(VECTOR_ELT(graph, 8), 0))[1] = 1; /* igraph_t objects */
   PROTECT(res->attr=VECTOR_ELT(graph, 8));  
 
+  /* modified in place, gets its own cache */
+  res->cache=igraph_i_adjcache_create(/*external=*/ 0);
+
   return 0;
 }
 
@@ -3752,6 +3975,46 @@ SEXP R_igraph_betweenness(SEXP graph, SEXP pvids, SEXP pdirected,
   return result;
 }
 
+SEXP R_igraph_betweenness_approx(SEXP graph, SEXP pvids, SEXP pdirected,
+				 SEXP weights, SEXP pepsilon, SEXP pdelta) {
+  
+  igraph_t g;
+  igraph_vs_t vs;
+  igraph_bool_t directed=LOGICAL(pdirected)[0];
+  igraph_real_t epsilon=REAL(pepsilon)[0];
+  igraph_real_t delta=REAL(pdelta)[0];
+  igraph_vector_t res, error;
+  igraph_vector_t v_weights, *pweights=0;
+  igraph_integer_t samples;
+  SEXP result, names;
+  
+  R_SEXP_to_igraph(graph, &g);
+  R_SEXP_to_igraph_vs(pvids, &g, &vs);
+  igraph_vector_init(&res, 0);
+  igraph_vector_init(&error, 0);
+  if (!isNull(weights)) { 
+    pweights=&v_weights; R_SEXP_to_vector(weights, &v_weights);
+  }
+  igraph_betweenness_approx(&g, &res, &error, vs, directed, pweights,
+			    epsilon, delta, /*rng=*/ 0, &samples);
+  
+  PROTECT(result=NEW_LIST(3));
+  SET_VECTOR_ELT(result, 0, R_igraph_vector_to_SEXP(&res));
+  SET_VECTOR_ELT(result, 1, R_igraph_vector_to_SEXP(&error));
+  SET_VECTOR_ELT(result, 2, ScalarInteger(samples));
+  PROTECT(names=NEW_CHARACTER(3));
+  SET_STRING_ELT(names, 0, mkChar("betweenness"));
+  SET_STRING_ELT(names, 1, mkChar("error"));
+  SET_STRING_ELT(names, 2, mkChar("samples"));
+  SET_NAMES(result, names);
+  igraph_vector_destroy(&res);
+  igraph_vector_destroy(&error);
+  igraph_vs_destroy(&vs);
+
+  UNPROTECT(2);
+  return result;
+}
+
 SEXP R_igraph_running_mean(SEXP pdata, SEXP pbinwidth) {
   
   igraph_vector_t data;
@@ -4787,17 +5050,18 @@ SEXP R_igraph_read_graph_edgelist(SEXP pvfile, SEXP pn, SEXP pdirected) {
   igraph_integer_t n=(igraph_integer_t) REAL(pn)[0];
   igraph_bool_t directed=LOGICAL(pdirected)[0];
   FILE *file;
+  igraph_i_zfile_t zf;
   SEXP result;
   
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "r");
-#else
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "r");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "r");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot read edgelist", __FILE__, __LINE__,
 			      IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_read_graph_edgelist(&g, file, n, directed);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   PROTECT(result=R_igraph_to_SEXP(&g));
   igraph_destroy(&g);
   
@@ -4809,17 +5073,18 @@ SEXP R_igraph_read_graph_gml(SEXP pvfile) {
 
   igraph_t g;
   FILE *file;
+  igraph_i_zfile_t zf;
   SEXP result;
   
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "r");
-#else
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "r");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "r");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot read GML file", __FILE__, __LINE__,
 			      IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_read_graph_gml(&g, file);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   PROTECT(result=R_igraph_to_SEXP(&g));
   igraph_destroy(&g);
   
@@ -4831,18 +5096,19 @@ SEXP R_igraph_read_graph_dl(SEXP pvfile, SEXP pdirected) {
 
   igraph_t g;
   FILE *file;
+  igraph_i_zfile_t zf;
   SEXP result;
   igraph_bool_t directed=LOGICAL(pdirected)[0];
   
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "r");
-#else
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "r");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "r");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot read DL file", __FILE__, __LINE__,
 			      IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_read_graph_dl(&g, file, directed);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   PROTECT(result=R_igraph_to_SEXP(&g));
   igraph_destroy(&g);
   
@@ -4854,17 +5120,18 @@ SEXP R_igraph_read_graph_graphdb(SEXP pvfile, SEXP pdirected) {
   igraph_t g;
   igraph_bool_t directed=LOGICAL(pdirected)[0];
   FILE *file;
+  igraph_i_zfile_t zf;
   SEXP result;
   
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "rb");
-#else
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "rb");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "rb");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot read graphdb file", __FILE__, __LINE__,
 			      IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_read_graph_graphdb(&g, file, directed);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   PROTECT(result=R_igraph_to_SEXP(&g));
   igraph_destroy(&g);
   
@@ -4875,29 +5142,19 @@ SEXP R_igraph_read_graph_graphdb(SEXP pvfile, SEXP pdirected) {
 SEXP R_igraph_write_graph_edgelist(SEXP graph, SEXP file) {
   igraph_t g;
   FILE *stream;
-#if HAVE_OPEN_MEMSTREAM == 1
-  char *bp;
-  size_t size;
-#endif
+  igraph_i_zfile_t zf;
   SEXP result;
   
   R_SEXP_to_igraph(graph, &g);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else
-  stream=fopen(CHAR(STRING_ELT(file, 0)), "w");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "w");
+  stream=zf.stream;
   if (stream==0) { igraph_error("Cannot write edgelist", __FILE__, __LINE__,
 				IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_edgelist(&g, stream);
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
   
   UNPROTECT(1);
   return result;
@@ -4906,10 +5163,7 @@ SEXP R_igraph_write_graph_edgelist(SEXP graph, SEXP file) {
 SEXP R_igraph_write_graph_gml(SEXP graph, SEXP file, SEXP pid, SEXP pcreator) {
   igraph_t g;
   FILE *stream;
-#if HAVE_OPEN_MEMSTREAM == 1
-  char *bp;
-  size_t size;
-#endif
+  igraph_i_zfile_t zf;
   igraph_vector_t id, *ppid=0;
   const char *creator=0;
   SEXP result;
@@ -4917,22 +5171,15 @@ SEXP R_igraph_write_graph_gml(SEXP graph, SEXP file, SEXP pid, SEXP pcreator) {
   if (!isNull(pid)) { R_SEXP_to_vector(pid, &id); ppid=&id; }
   if (!isNull(pcreator)) { creator=CHAR(STRING_ELT(pcreator, 0)); }
   R_SEXP_to_igraph(graph, &g);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else
-  stream=fopen(CHAR(STRING_ELT(file, 0)), "w");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "w");
+  stream=zf.stream;
   if (stream==0) { igraph_error("Cannot write edgelist", __FILE__, __LINE__,
 				IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_gml(&g, stream, ppid, creator);
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
   
   UNPROTECT(1);
   return result;
@@ -4941,29 +5188,19 @@ SEXP R_igraph_write_graph_gml(SEXP graph, SEXP file, SEXP pid, SEXP pcreator) {
 SEXP R_igraph_write_graph_dot(SEXP graph, SEXP file) {
   igraph_t g;
   FILE *stream;
-#if HAVE_OPEN_MEMSTREAM == 1
-  char *bp;
-  size_t size;
-#endif
+  igraph_i_zfile_t zf;
   SEXP result;
   
   R_SEXP_to_igraph(graph, &g);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else
-  stream=fopen(CHAR(STRING_ELT(file, 0)), "w");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "w");
+  stream=zf.stream;
   if (stream==0) { igraph_error("Cannot write edgelist", __FILE__, __LINE__,
 				IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_dot(&g, stream);
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
   
   UNPROTECT(1);
   return result;
@@ -4972,31 +5209,21 @@ SEXP R_igraph_write_graph_dot(SEXP graph, SEXP file) {
 SEXP R_igraph_write_graph_leda(SEXP graph, SEXP file, SEXP va, SEXP ea) {
   igraph_t g;
   FILE *stream;
-#if HAVE_OPEN_MEMSTREAM == 1 
-  char *bp;
-  size_t size;
-#endif
+  igraph_i_zfile_t zf;
   SEXP result;
   
   R_SEXP_to_igraph(graph, &g);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else
-  stream=fopen(CHAR(STRING_ELT(file, 0)), "w");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "w");
+  stream=zf.stream;
   if (stream==0) { igraph_error("Cannot write edgelist", __FILE__, __LINE__,
 				IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_leda(&g, stream,
 			  isNull(va) ? 0 : CHAR(STRING_ELT(va, 0)),
 			  isNull(ea) ? 0 : CHAR(STRING_ELT(ea, 0)));
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
   
   UNPROTECT(1);
   return result;
@@ -5006,29 +5233,19 @@ SEXP R_igraph_write_graph_pajek(SEXP graph, SEXP file) {
   
   igraph_t g;
   FILE *stream;
-#if HAVE_OPEN_MEMSTREAM == 1
-  char *bp;
-  size_t size;
-#endif
+  igraph_i_zfile_t zf;
   SEXP result;
   
   R_SEXP_to_igraph(graph, &g);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else
-  stream=fopen(CHAR(STRING_ELT(file, 0)), "wb");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "wb");
+  stream=zf.stream;
   if (stream==0) { igraph_error("Cannot write oajek file", __FILE__, __LINE__,
 				IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_pajek(&g, stream);
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
   
   UNPROTECT(1);
   return result;
@@ -5042,22 +5259,23 @@ SEXP R_igraph_read_graph_ncol(SEXP pvfile, SEXP ppredef,
   igraph_add_weights_t weights=REAL(pweights)[0];
   igraph_bool_t directed=LOGICAL(pdirected)[0];
   FILE *file;
+  igraph_i_zfile_t zf;
   igraph_strvector_t predef, *predefptr=0;  
   SEXP result;
   
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "r");
-#else 
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "r");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "r");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot read edgelist", __FILE__, __LINE__,
 			      IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   if (GET_LENGTH(ppredef)>0) {
     R_igraph_SEXP_to_strvector(ppredef, &predef);
     predefptr=&predef;
   } 
   igraph_read_graph_ncol(&g, file, predefptr, names, weights, directed);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   PROTECT(result=R_igraph_to_SEXP(&g));
   igraph_destroy(&g);
   
@@ -5069,10 +5287,7 @@ SEXP R_igraph_write_graph_ncol(SEXP graph, SEXP file, SEXP pnames,
 			       SEXP pweights) {
   igraph_t g;
   FILE *stream;
-#if HAVE_OPEN_MEMSTREAM == 1
-  char *bp;
-  size_t size;
-#endif
+  igraph_i_zfile_t zf;
   const char *names, *weights;
   SEXP result;
 
@@ -5088,22 +5303,15 @@ SEXP R_igraph_write_graph_ncol(SEXP graph, SEXP file, SEXP pnames,
   }   
 
   R_SEXP_to_igraph(graph, &g);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else 
-  stream=fopen(CHAR(STRING_ELT(file,0)), "w");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "w");
+  stream=zf.stream;
   if (stream==0) { igraph_error("Cannot write .ncol file", __FILE__, __LINE__,
 				IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_ncol(&g, stream, names, weights);
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
   
   UNPROTECT(1);
   return result;
@@ -5115,17 +5323,18 @@ SEXP R_igraph_read_graph_lgl(SEXP pvfile, SEXP pnames, SEXP pweights, SEXP pdire
   igraph_add_weights_t weights=REAL(pweights)[0];
   igraph_bool_t directed=LOGICAL(pdirected)[0];
   FILE *file;
+  igraph_i_zfile_t zf;
   SEXP result;
   
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "r");
-#else 
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "r");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "r");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot read edgelist", __FILE__, __LINE__,
 			      IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_read_graph_lgl(&g, file, names, weights, directed);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   PROTECT(result=R_igraph_to_SEXP(&g));
   igraph_destroy(&g);
   
@@ -5137,10 +5346,7 @@ SEXP R_igraph_write_graph_lgl(SEXP graph, SEXP file, SEXP pnames,
 			      SEXP pweights, SEXP pisolates) {
   igraph_t g;
   FILE *stream;
-#if HAVE_OPEN_MEMSTREAM == 1
-  char *bp;
-  size_t size;
-#endif
+  igraph_i_zfile_t zf;
   const char *names, *weights;
   igraph_bool_t isolates=LOGICAL(pisolates)[0];
   SEXP result;
@@ -5157,20 +5363,15 @@ SEXP R_igraph_write_graph_lgl(SEXP graph, SEXP file, SEXP pnames,
   }   
 
   R_SEXP_to_igraph(graph, &g);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else
-  stream=fopen(CHAR(STRING_ELT(file, 0)), "w");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "w");
+  stream=zf.stream;
+  if (stream==0) { igraph_error("Cannot write LGL file", __FILE__, __LINE__,
+				IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_lgl(&g, stream, names, weights, isolates);
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
   
   UNPROTECT(1);
   return result;
@@ -5179,17 +5380,18 @@ SEXP R_igraph_write_graph_lgl(SEXP graph, SEXP file, SEXP pnames,
 SEXP R_igraph_read_graph_pajek(SEXP pvfile) {
   igraph_t g;
   FILE *file;  
+  igraph_i_zfile_t zf;
   SEXP result;
   
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "r");
-#else
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "r");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "r");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot read Pajek file", __FILE__, __LINE__,
 			      IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_read_graph_pajek(&g, file);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   PROTECT(result=R_igraph_to_SEXP(&g));
   igraph_destroy(&g);
   
@@ -5856,21 +6058,27 @@ SEXP R_igraph_to_directed(SEXP graph, SEXP pmode) {
   return result;
 }
 
-SEXP R_igraph_read_graph_graphml(SEXP pvfile, SEXP pindex) {
+SEXP R_igraph_read_graph_graphml(SEXP pvfile, SEXP pindex, SEXP pskip) {
   igraph_t g;
   int index=(int) REAL(pindex)[0];
   FILE *file;
+  igraph_i_zfile_t zf;
+  igraph_strvector_t skip, *skipptr=0;
   SEXP result;
 
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "r");
-#else
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "r");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "r");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot open GraphML file", __FILE__, __LINE__,
 			      IGRAPH_EFILE); }
-  igraph_read_graph_graphml(&g, file, index);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
+  if (GET_LENGTH(pskip)>0) {
+    R_igraph_SEXP_to_strvector(pskip, &skip);
+    skipptr=&skip;
+  }
+  igraph_read_graph_graphml_skip(&g, file, index, skipptr);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   PROTECT(result=R_igraph_to_SEXP(&g));
   igraph_destroy(&g);
   
@@ -5882,30 +6090,63 @@ SEXP R_igraph_write_graph_graphml(SEXP graph, SEXP file, SEXP pprefixattr) {
   
   igraph_t g;
   FILE *stream;
+  igraph_i_zfile_t zf;
   igraph_bool_t prefixattr=LOGICAL(pprefixattr)[0];
-#if HAVE_OPEN_MEMSTREAM == 1
-  char *bp;
-  size_t size;
-#endif
   SEXP result;
   
   R_SEXP_to_igraph(graph, &g);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else
-  stream=fopen(CHAR(STRING_ELT(file, 0)), "w");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "w");
+  stream=zf.stream;
   if (stream==0) { igraph_error("Cannot write GraphML file", __FILE__, 
 				__LINE__, IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_graphml(&g, stream, prefixattr);
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
+  PROTECT(result=NEW_NUMERIC(0));
+
+  UNPROTECT(1);
+  return result;
+}
+
+SEXP R_igraph_read_graph_binary(SEXP pvfile) {
+  igraph_t g;
+  FILE *file;
+  igraph_i_zfile_t zf;
+  SEXP result;
+
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "rb");
+  file=zf.stream;
+  if (file==0) { igraph_error("Cannot open binary graph file", __FILE__,
+			      __LINE__, IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
+  igraph_read_graph_binary(&g, file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
+  PROTECT(result=R_igraph_to_SEXP(&g));
+  igraph_destroy(&g);
+
+  UNPROTECT(1);
+  return result;
+}
+
+SEXP R_igraph_write_graph_binary(SEXP graph, SEXP file) {
+  igraph_t g;
+  FILE *stream;
+  igraph_i_zfile_t zf;
+  SEXP result;
+
+  R_SEXP_to_igraph(graph, &g);
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "wb");
+  stream=zf.stream;
+  if (stream==0) { igraph_error("Cannot write binary graph file", __FILE__,
+				__LINE__, IGRAPH_EFILE); }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
+  igraph_write_graph_binary(&g, stream);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
 
   UNPROTECT(1);
   return result;
@@ -6071,26 +6312,27 @@ SEXP R_igraph_read_graph_dimacs(SEXP pvfile, SEXP pdirected) {
   igraph_t g;
   igraph_bool_t directed=LOGICAL(pdirected)[0];
   FILE *file;
+  igraph_i_zfile_t zf;
   igraph_vector_t label;
   igraph_strvector_t problem;
   igraph_integer_t source, target;
   igraph_vector_t cap;
   SEXP result=R_NilValue;
   
-#if HAVE_FMEMOPEN == 1
-  file=fmemopen(RAW(pvfile), GET_LENGTH(pvfile), "r");
-#else
-  file=fopen(CHAR(STRING_ELT(pvfile, 0)), "r");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(pvfile, 0)), "r");
+  file=zf.stream;
   if (file==0) { igraph_error("Cannot read edgelist", __FILE__, __LINE__,
 			      IGRAPH_EFILE); 
   }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_vector_init(&label, 0);
   igraph_strvector_init(&problem, 0);
   igraph_vector_init(&cap, 0);
   igraph_read_graph_dimacs(&g, file, &problem, &label, 
 			   &source, &target, &cap, directed);
-  fclose(file);
+  IGRAPH_FINALLY(igraph_destroy, &g);
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(2);
   if (!strcmp(STR(problem, 0), "max")) {
     PROTECT(result=NEW_LIST(5));
     SET_VECTOR_ELT(result, 0, R_igraph_strvector_to_SEXP(&problem));
@@ -6128,10 +6370,7 @@ SEXP R_igraph_write_graph_dimacs(SEXP graph, SEXP file,
   
   igraph_t g;
   FILE *stream;
-#if HAVE_OPEN_MEMSTREAM == 1
-  char *bp;
-  size_t size;
-#endif
+  igraph_i_zfile_t zf;
   igraph_integer_t source=(igraph_integer_t) REAL(psource)[0];
   igraph_integer_t target=(igraph_integer_t) REAL(ptarget)[0];
   igraph_vector_t cap;
@@ -6139,23 +6378,16 @@ SEXP R_igraph_write_graph_dimacs(SEXP graph, SEXP file,
   
   R_SEXP_to_igraph(graph, &g);
   R_SEXP_to_vector(pcap, &cap);
-#if HAVE_OPEN_MEMSTREAM == 1
-  stream=open_memstream(&bp, &size);
-#else
-  stream=fopen(CHAR(STRING_ELT(file, 0)), "w");
-#endif
+  igraph_i_zfile_open(&zf, CHAR(STRING_ELT(file, 0)), "w");
+  stream=zf.stream;
   if (stream==0) { igraph_error("Cannot write edgelist", __FILE__, __LINE__,
 				IGRAPH_EFILE); 
   }
+  IGRAPH_FINALLY(igraph_i_zfile_destroy, &zf);
   igraph_write_graph_dimacs(&g, stream, source, target, &cap);
-  fclose(stream);
-#if HAVE_OPEN_MEMSTREAM == 1
-  PROTECT(result=allocVector(RAWSXP, size));
-  memcpy(RAW(result), bp, sizeof(char)*size);
-  free(bp);
-#else
+  igraph_i_zfile_close(&zf);
+  IGRAPH_FINALLY_CLEAN(1);
   PROTECT(result=NEW_NUMERIC(0));
-#endif
   
   UNPROTECT(1);
   return result;
@@ -6390,7 +6622,7 @@ SEXP R_igraph_spinglass_community(SEXP graph, SEXP weights,
 				  SEXP pstarttemp, SEXP pstoptemp,
 				  SEXP pcoolfact, SEXP pupdate_rule,
 				  SEXP pgamma, SEXP pimplementation, 
-				  SEXP plambda) {
+				  SEXP plambda, SEXP preplicas) {
   igraph_t g;
   igraph_vector_t v_weights, *pweights=0;
   igraph_integer_t spins=(igraph_integer_t) REAL(pspins)[0];
@@ -6402,6 +6634,7 @@ SEXP R_igraph_spinglass_community(SEXP graph, SEXP weights,
   igraph_real_t gamma=REAL(pgamma)[0];
   igraph_real_t implementation=REAL(pimplementation)[0];
   igraph_real_t lambda=REAL(plambda)[0];
+  igraph_integer_t replicas=(igraph_integer_t) REAL(preplicas)[0];
   igraph_real_t modularity;
   igraph_real_t temperature;
   igraph_vector_t membership;
@@ -6419,7 +6652,7 @@ SEXP R_igraph_spinglass_community(SEXP graph, SEXP weights,
 			     &membership, &csize,
 			     spins, parupdate, starttemp, stoptemp,
 			     coolfact, update_rule, gamma,
-			     implementation, lambda);
+			     implementation, lambda, replicas);
   
   PROTECT(result=NEW_LIST(4));
   PROTECT(names=NEW_CHARACTER(4));
@@ -7064,13 +7297,16 @@ SEXP R_igraph_citing_cited_type_game(SEXP pnodes, SEXP ptypes, SEXP ppref,
 
 SEXP R_igraph_walktrap_community(SEXP graph, SEXP pweights,
 				 SEXP psteps, SEXP pmerges, 
-				 SEXP pmodularity, SEXP pmembership) {
+				 SEXP pmodularity, SEXP pmembership,
+				 SEXP pmax_memory) {
   igraph_t g;
   igraph_vector_t weights, *ppweights=0;
   igraph_integer_t steps=(igraph_integer_t) REAL(psteps)[0];
   igraph_matrix_t merges, *ppmerges=0;
   igraph_vector_t modularity, *ppmodularity=0;
   igraph_vector_t membership, *ppmembership=0;
+  igraph_real_t max_memory=REAL(pmax_memory)[0];
+  igraph_integer_t recomputations=0;
   SEXP result, names;
   
   R_SEXP_to_igraph(graph, &g);
@@ -7092,19 +7328,22 @@ SEXP R_igraph_walktrap_community(SEXP graph, SEXP pweights,
   }
 
   igraph_community_walktrap(&g, ppweights, steps, ppmerges, ppmodularity,
-			    ppmembership);
+			    ppmembership, max_memory, &recomputations);
 
-  PROTECT(result=NEW_LIST(3));
+  PROTECT(result=NEW_LIST(4));
   SET_VECTOR_ELT(result, 0, R_igraph_0ormatrix_to_SEXP(ppmerges));
   if (ppmerges) { igraph_matrix_destroy(ppmerges); }
   SET_VECTOR_ELT(result, 1, R_igraph_0orvector_to_SEXP(ppmodularity));
   if (ppmodularity) { igraph_vector_destroy(ppmodularity); }
   SET_VECTOR_ELT(result, 2, R_igraph_0orvector_to_SEXP(ppmembership));
   if (ppmembership) { igraph_vector_destroy(ppmembership); }
-  PROTECT(names=NEW_CHARACTER(3));
+  SET_VECTOR_ELT(result, 3, NEW_NUMERIC(1));
+  REAL(VECTOR_ELT(result, 3))[0]=recomputations;
+  PROTECT(names=NEW_CHARACTER(4));
   SET_STRING_ELT(names, 0, CREATE_STRING_VECTOR("merges"));
   SET_STRING_ELT(names, 1, CREATE_STRING_VECTOR("modularity"));
   SET_STRING_ELT(names, 2, CREATE_STRING_VECTOR("membership"));
+  SET_STRING_ELT(names, 3, CREATE_STRING_VECTOR("recomputations"));
   SET_NAMES(result, names);
   
   UNPROTECT(2);
@@ -7241,6 +7480,7 @@ SEXP R_igraph_community_fastgreedy(SEXP graph, SEXP pmerges, SEXP pmodularity,
   igraph_vector_t modularity, *ppmodularity=0;
   igraph_vector_t membership, *ppmembership=0;
   igraph_vector_t weights, *ppweights=0;
+  igraph_real_t peak_memory;
   SEXP result, names;
   
   if (!isNull(pweights)) {
@@ -7261,18 +7501,21 @@ SEXP R_igraph_community_fastgreedy(SEXP graph, SEXP pmerges, SEXP pmodularity,
     igraph_vector_init(&membership, 0);
   }
   igraph_community_fastgreedy(&g, ppweights, ppmerges, ppmodularity, 
-			      ppmembership);
-  PROTECT(result=NEW_LIST(3));
+			      ppmembership, &peak_memory);
+  PROTECT(result=NEW_LIST(4));
   SET_VECTOR_ELT(result, 0, R_igraph_0ormatrix_to_SEXP(ppmerges));
   if (ppmerges) { igraph_matrix_destroy(ppmerges); }
   SET_VECTOR_ELT(result, 1, R_igraph_0orvector_to_SEXP(ppmodularity));
   if (ppmodularity) { igraph_vector_destroy(ppmodularity); }
   SET_VECTOR_ELT(result, 2, R_igraph_0orvector_to_SEXP(ppmembership));
   if (ppmembership) { igraph_vector_destroy(ppmembership); }
-  PROTECT(names=NEW_CHARACTER(3));
+  SET_VECTOR_ELT(result, 3, NEW_NUMERIC(1));
+  REAL(VECTOR_ELT(result, 3))[0]=peak_memory;
+  PROTECT(names=NEW_CHARACTER(4));
   SET_STRING_ELT(names, 0, CREATE_STRING_VECTOR("merges"));
   SET_STRING_ELT(names, 1, CREATE_STRING_VECTOR("modularity"));
   SET_STRING_ELT(names, 2, CREATE_STRING_VECTOR("membership"));
+  SET_STRING_ELT(names, 3, CREATE_STRING_VECTOR("memory"));
   SET_NAMES(result, names);
   
   UNPROTECT(2);
@@ -8064,7 +8307,8 @@ SEXP R_igraph_community_leading_eigenvector(SEXP graph, SEXP steps,
 					    SEXP callback, 
 					    SEXP callback_extra,
 					    SEXP callback_env,
-					    SEXP callback_env2) {
+					    SEXP callback_env2,
+					    SEXP pwarm_start) {
                                         /* Declarations */
   igraph_t c_graph;
   igraph_matrix_t c_merges;
@@ -8127,7 +8371,8 @@ SEXP R_igraph_community_leading_eigenvector(SEXP graph, SEXP steps,
 						&c_history, 
 						isNull(callback) ? 0 : 
 						R_igraph_i_levc_callback,
-						&callback_data);
+						&callback_data, 
+						LOGICAL(pwarm_start)[0]);
 
                                         /* Convert output */
   PROTECT(result=NEW_LIST(7));
@@ -12881,6 +13126,39 @@ SEXP R_igraph_compare_communities(SEXP comm1, SEXP comm2, SEXP method) {
   return(result);
 }
 
+/*-------------------------------------------/
+/ igraph_compare_communities_batch           /
+/-------------------------------------------*/
+SEXP R_igraph_compare_communities_batch(SEXP comm, SEXP comms, SEXP method) {
+                                        /* Declarations */
+  igraph_vector_t c_comm;
+  igraph_vector_ptr_t c_comms;
+  igraph_vector_t c_res;
+  igraph_community_comparison_t c_method;
+  SEXP res;
+
+  SEXP result;
+                                        /* Convert input */
+  R_SEXP_to_vector(comm, &c_comm);
+  R_igraph_SEXP_to_vectorlist(comms, &c_comms);
+  c_method=(igraph_community_comparison_t) REAL(method)[0];
+  if (0 != igraph_vector_init(&c_res, 0)) { 
+  igraph_error("", __FILE__, __LINE__, IGRAPH_ENOMEM); 
+  } 
+  IGRAPH_FINALLY(igraph_vector_destroy, &c_res);
+                                        /* Call igraph */
+  igraph_compare_communities_batch(&c_comm, &c_comms, &c_res, c_method);
+
+                                        /* Convert output */
+  PROTECT(res=R_igraph_vector_to_SEXP(&c_res)); 
+  igraph_vector_destroy(&c_res); 
+  IGRAPH_FINALLY_CLEAN(1);
+  result=res;
+
+  UNPROTECT(1);
+  return(result);
+}
+
 /*-------------------------------------------/
 / igraph_modularity                          /
 /-------------------------------------------*/
@@ -12945,7 +13223,7 @@ SEXP R_igraph_modularity_matrix(SEXP graph, SEXP membership, SEXP weights) {
 /*-------------------------------------------/
 / igraph_community_label_propagation         /
 /-------------------------------------------*/
-SEXP R_igraph_community_label_propagation(SEXP graph, SEXP weights, SEXP initial, SEXP fixed) {
+SEXP R_igraph_community_label_propagation(SEXP graph, SEXP weights, SEXP initial, SEXP fixed, SEXP mode) {
                                         /* Declarations */
   igraph_t c_graph;
   igraph_vector_t c_membership;
@@ -12953,6 +13231,7 @@ SEXP R_igraph_community_label_propagation(SEXP graph, SEXP weights, SEXP initial
   igraph_vector_t c_initial;
   igraph_vector_bool_t c_fixed;
   igraph_real_t c_modularity;
+  igraph_lpa_mode_t c_mode;
   SEXP membership;
   SEXP modularity;
 
@@ -12966,8 +13245,9 @@ SEXP R_igraph_community_label_propagation(SEXP graph, SEXP weights, SEXP initial
   if (!isNull(weights)) { R_SEXP_to_vector(weights, &c_weights); }
   if (!isNull(initial)) { R_SEXP_to_vector(initial, &c_initial); }
   if (!isNull(fixed)) { R_SEXP_to_vector_bool(fixed, &c_fixed); }
+  c_mode=(igraph_lpa_mode_t) REAL(mode)[0];
                                         /* Call igraph */
-  igraph_community_label_propagation(&c_graph, &c_membership, (isNull(weights) ? 0 : &c_weights), (isNull(initial) ? 0 : &c_initial), (isNull(fixed) ? 0 : &c_fixed), &c_modularity);
+  igraph_community_label_propagation(&c_graph, &c_membership, (isNull(weights) ? 0 : &c_weights), (isNull(initial) ? 0 : &c_initial), (isNull(fixed) ? 0 : &c_fixed), &c_modularity, c_mode);
 
                                         /* Convert output */
   PROTECT(result=NEW_LIST(2));
@@ -12991,10 +13271,73 @@ SEXP R_igraph_community_label_propagation(SEXP graph, SEXP weights, SEXP initial
 /*-------------------------------------------/
 / igraph_community_multilevel                /
 /-------------------------------------------*/
-SEXP R_igraph_community_multilevel(SEXP graph, SEXP weights) {
+SEXP R_igraph_community_multilevel(SEXP graph, SEXP weights, SEXP parallel) {
+                                        /* Declarations */
+  igraph_t c_graph;
+  igraph_vector_t c_weights;
+  igraph_vector_t c_membership;
+  igraph_matrix_t c_memberships;
+  igraph_vector_t c_modularity;
+  igraph_bool_t c_parallel;
+  SEXP membership;
+  SEXP memberships;
+  SEXP modularity;
+
+  SEXP result, names;
+                                        /* Convert input */
+  R_SEXP_to_igraph(graph, &c_graph);
+  if (!isNull(weights)) { R_SEXP_to_vector(weights, &c_weights); }
+  if (0 != igraph_vector_init(&c_membership, 0)) { 
+  igraph_error("", __FILE__, __LINE__, IGRAPH_ENOMEM); 
+  } 
+  IGRAPH_FINALLY(igraph_vector_destroy, &c_membership);
+  if (0 != igraph_matrix_init(&c_memberships, 0, 0)) { 
+  igraph_error("", __FILE__, __LINE__, IGRAPH_ENOMEM); 
+  } 
+  IGRAPH_FINALLY(igraph_matrix_destroy, &c_memberships); 
+  memberships=NEW_NUMERIC(0); /* hack to have a non-NULL value */
+  if (0 != igraph_vector_init(&c_modularity, 0)) { 
+  igraph_error("", __FILE__, __LINE__, IGRAPH_ENOMEM); 
+  } 
+  IGRAPH_FINALLY(igraph_vector_destroy, &c_modularity); 
+  modularity=NEW_NUMERIC(0); /* hack to have a non-NULL value */
+  c_parallel=LOGICAL(parallel)[0];
+                                        /* Call igraph */
+  igraph_community_multilevel(&c_graph, (isNull(weights) ? 0 : &c_weights), &c_membership, (isNull(memberships) ? 0 : &c_memberships), (isNull(modularity) ? 0 : &c_modularity), c_parallel);
+
+                                        /* Convert output */
+  PROTECT(result=NEW_LIST(3));
+  PROTECT(names=NEW_CHARACTER(3));
+  PROTECT(membership=R_igraph_vector_to_SEXP(&c_membership)); 
+  igraph_vector_destroy(&c_membership); 
+  IGRAPH_FINALLY_CLEAN(1);
+  PROTECT(memberships=R_igraph_0ormatrix_to_SEXP(&c_memberships)); 
+  igraph_matrix_destroy(&c_memberships); 
+  IGRAPH_FINALLY_CLEAN(1);
+  PROTECT(modularity=R_igraph_0orvector_to_SEXP(&c_modularity)); 
+  igraph_vector_destroy(&c_modularity); 
+  IGRAPH_FINALLY_CLEAN(1);
+  SET_VECTOR_ELT(result, 0, membership);
+  SET_VECTOR_ELT(result, 1, memberships);
+  SET_VECTOR_ELT(result, 2, modularity);
+  SET_STRING_ELT(names, 0, CREATE_STRING_VECTOR("membership"));
+  SET_STRING_ELT(names, 1, CREATE_STRING_VECTOR("memberships"));
+  SET_STRING_ELT(names, 2, CREATE_STRING_VECTOR("modularity"));
+  SET_NAMES(result, names);
+  UNPROTECT(4);
+
+  UNPROTECT(1);
+  return(result);
+}
+
+/*-------------------------------------------/
+/ igraph_community_leiden                    /
+/-------------------------------------------*/
+SEXP R_igraph_community_leiden(SEXP graph, SEXP weights, SEXP resolution) {
                                         /* Declarations */
   igraph_t c_graph;
   igraph_vector_t c_weights;
+  igraph_real_t c_resolution;
   igraph_vector_t c_membership;
   igraph_matrix_t c_memberships;
   igraph_vector_t c_modularity;
@@ -13006,6 +13349,7 @@ SEXP R_igraph_community_multilevel(SEXP graph, SEXP weights) {
                                         /* Convert input */
   R_SEXP_to_igraph(graph, &c_graph);
   if (!isNull(weights)) { R_SEXP_to_vector(weights, &c_weights); }
+  c_resolution=REAL(resolution)[0];
   if (0 != igraph_vector_init(&c_membership, 0)) { 
   igraph_error("", __FILE__, __LINE__, IGRAPH_ENOMEM); 
   } 
@@ -13021,7 +13365,7 @@ SEXP R_igraph_community_multilevel(SEXP graph, SEXP weights) {
   IGRAPH_FINALLY(igraph_vector_destroy, &c_modularity); 
   modularity=NEW_NUMERIC(0); /* hack to have a non-NULL value */
                                         /* Call igraph */
-  igraph_community_multilevel(&c_graph, (isNull(weights) ? 0 : &c_weights), &c_membership, (isNull(memberships) ? 0 : &c_memberships), (isNull(modularity) ? 0 : &c_modularity));
+  igraph_community_leiden(&c_graph, (isNull(weights) ? 0 : &c_weights), c_resolution, &c_membership, (isNull(memberships) ? 0 : &c_memberships), (isNull(modularity) ? 0 : &c_modularity));
 
                                         /* Convert output */
   PROTECT(result=NEW_LIST(3));
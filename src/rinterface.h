@@ -25,5 +25,6 @@
 
 #define R_IGRAPH_TYPE_VERSION "0.8.0"
 #define R_IGRAPH_VERSION_VAR ".__igraph_version__."
+#define R_IGRAPH_CACHE_VAR ".__igraph_cache__."
 
 SEXP R_igraph_add_env(SEXP graph);
@@ -42,6 +42,7 @@
 #include "igraph_neighborhood.h"
 #include "igraph_topology.h"
 #include "igraph_qsort.h"
+#include "igraph_threading.h"
 #include "config.h"
 #include "structural_properties_internal.h"
 
@@ -56,6 +57,101 @@
  * of a graph, like its diameter, the degree of the nodes, etc.</para>
  */
 
+/* Per thread results of the unweighted and weighted diameter. Each
+   thread keeps the first (in source order) largest distance. */
+
+typedef struct igraph_i_diameter_t {
+  igraph_real_t *res;
+  long int *from, *to;
+  igraph_bool_t *unconn;
+  long int no_of_nodes;
+} igraph_i_diameter_t;
+
+static void igraph_i_diameter_cb(int thread, long int index, 
+				 long int source, const long int *order,
+				 const igraph_real_t *dist, 
+				 long int reached, void *extra) {
+  igraph_i_diameter_t *data=(igraph_i_diameter_t *) extra;
+  long int j;
+  IGRAPH_UNUSED(index);
+  for (j=0; j<reached; j++) {
+    if (dist[order[j]] > data->res[thread]) {
+      data->res[thread]=dist[order[j]];
+      data->from[thread]=source;
+      data->to[thread]=order[j];
+    }
+  }
+  if (reached != data->no_of_nodes) {
+    data->unconn[thread]=1;
+  }
+}
+
+/* Runs the diameter calculation, 'res' is the initial (smallest)
+   diameter. Sets 'notconn' if the graph is not (strongly)
+   connected. If 'unconn' is false, the result is not needed for
+   such graphs, so connectedness is checked first, and the searches
+   are not started at all for them. */
+
+static int igraph_i_diameter(const igraph_t *graph, 
+			     const igraph_vector_t *weights,
+			     igraph_neimode_t dirmode, 
+			     igraph_bool_t unconn,
+			     const char *message,
+			     igraph_real_t *res, long int *from, long int *to,
+			     igraph_bool_t *notconn) {
+  int nthreads=igraph_get_num_threads(), t;
+  igraph_i_diameter_t data;
+  igraph_vector_t vres;
+  igraph_vector_long_t vfrom, vto;
+  igraph_vector_bool_t vunconn;
+
+  if (!unconn) {
+    igraph_bool_t conn;
+    IGRAPH_CHECK(igraph_is_connected(graph, &conn, dirmode == IGRAPH_ALL ?
+				     IGRAPH_WEAK : IGRAPH_STRONG));
+    if (!conn) {
+      *notconn=1;
+      return 0;
+    }
+  }
+
+  IGRAPH_VECTOR_INIT_FINALLY(&vres, nthreads);
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&vfrom, nthreads);
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&vto, nthreads);
+  IGRAPH_VECTOR_BOOL_INIT_FINALLY(&vunconn, nthreads);
+  igraph_vector_fill(&vres, *res);
+  igraph_vector_long_fill(&vfrom, *from);
+  igraph_vector_long_fill(&vto, *to);
+  data.res=VECTOR(vres);
+  data.from=VECTOR(vfrom);
+  data.to=VECTOR(vto);
+  data.unconn=VECTOR(vunconn);
+  data.no_of_nodes=igraph_vcount(graph);
+
+  IGRAPH_CHECK(igraph_i_sssp(graph, igraph_vss_all(), dirmode, weights,
+			     igraph_i_diameter_cb, &data, nthreads, message));
+
+  /* The first largest one, as in the serial order */
+  *notconn=0;
+  for (t=0; t<nthreads; t++) {
+    if (VECTOR(vres)[t] > *res || 
+	(VECTOR(vres)[t] == *res && VECTOR(vfrom)[t] < *from)) {
+      *res=VECTOR(vres)[t];
+      *from=VECTOR(vfrom)[t];
+      *to=VECTOR(vto)[t];
+    }
+    if (VECTOR(vunconn)[t]) { *notconn=1; }
+  }
+
+  igraph_vector_bool_destroy(&vunconn);
+  igraph_vector_long_destroy(&vto);
+  igraph_vector_long_destroy(&vfrom);
+  igraph_vector_destroy(&vres);
+  IGRAPH_FINALLY_CLEAN(4);
+
+  return 0;
+}
+
 /**
  * \ingroup structural
  * \function igraph_diameter
@@ -95,70 +191,23 @@ int igraph_diameter(const igraph_t *graph, igraph_integer_t *pres,
 		    igraph_bool_t directed, igraph_bool_t unconn) {
 
   long int no_of_nodes=igraph_vcount(graph);
-  long int i, j, n;
-  long int *already_added;
-  long int nodes_reached;
   long int from=0, to=0;
-  long int res=0;
-
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  igraph_vector_int_t *neis;
+  igraph_real_t res=0;
+  igraph_bool_t notconn;
   igraph_neimode_t dirmode;
-  igraph_adjlist_t allneis;
-  
+
   if (directed) { dirmode=IGRAPH_OUT; } else { dirmode=IGRAPH_ALL; }
-  already_added=igraph_Calloc(no_of_nodes, long int);
-  if (already_added==0) {
-    IGRAPH_ERROR("diameter failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(igraph_free, already_added);
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-  
-  IGRAPH_CHECK(igraph_adjlist_init(graph, &allneis, dirmode));
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &allneis);
-  
-  for (i=0; i<no_of_nodes; i++) {
-    nodes_reached=1;
-    IGRAPH_CHECK(igraph_dqueue_push(&q, i));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    already_added[i]=i+1;
 
-    IGRAPH_PROGRESS("Diameter: ", 100.0*i/no_of_nodes, NULL);
+  IGRAPH_CHECK(igraph_i_diameter(graph, /*weights=*/ 0, dirmode, unconn,
+				 "Diameter: ", &res, &from, &to, &notconn));
 
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-      if (actdist>res) { 
-        res=actdist; 
-        from=i;
-        to=actnode;
-      }
-      
-      neis=igraph_adjlist_get(&allneis, actnode);
-      n=igraph_vector_int_size(neis);
-      for (j=0; j<n; j++) {
-	long int neighbor=(long int) VECTOR(*neis)[j];
-	if (already_added[neighbor] == i+1) { continue; }
-	already_added[neighbor]=i+1;
-	nodes_reached++;
-	IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-	IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
-      }
-    } /* while !igraph_dqueue_empty */
-    
-    /* not connected, return largest possible */
-    if (nodes_reached != no_of_nodes && !unconn) {
-      res=no_of_nodes;
-      from=-1;
-      to=-1;
-      break;
-    }
-  } /* for i<no_of_nodes */
+  /* not connected, return largest possible */
+  if (notconn && !unconn) {
+    res=no_of_nodes;
+    from=-1;
+    to=-1;
+  }
 
-  IGRAPH_PROGRESS("Diameter: ", 100.0, NULL);
-  
   /* return the requested info */
   if (pres != 0) {
     *pres=(igraph_integer_t) res;
@@ -186,15 +235,36 @@ int igraph_diameter(const igraph_t *graph, igraph_integer_t *pres,
     }
   }
   
-  /* clean */
-  igraph_Free(already_added);
-  igraph_dqueue_destroy(&q);
-  igraph_adjlist_destroy(&allneis);
-  IGRAPH_FINALLY_CLEAN(3);
-
   return 0;
 }
 
+/* Per thread sums for the average path length, these are sums of
+   integers, so the result does not depend on the number of threads */
+
+typedef struct igraph_i_average_path_length_t {
+  igraph_real_t *sum, *normfact, *reached;
+} igraph_i_average_path_length_t;
+
+static void igraph_i_average_path_length_cb(int thread, long int first,
+					    int nsrc, long int level,
+					    const long int *reached,
+					    long int no_reached,
+					    const igraph_i_msbfs_word_t *bits,
+					    void *extra) {
+  igraph_i_average_path_length_t *data=
+    (igraph_i_average_path_length_t *) extra;
+  long int i, count=0;
+  IGRAPH_UNUSED(first); IGRAPH_UNUSED(nsrc);
+  for (i=0; i<no_reached; i++) {
+    count += IGRAPH_I_POPCOUNT(bits[reached[i]]);
+  }
+  if (level > 0) {
+    data->sum[thread] += (igraph_real_t) level * count;
+    data->normfact[thread] += count;
+  }
+  data->reached[thread] += count;
+}
+
 /**
  * \ingroup structural
  * \function igraph_average_path_length
@@ -214,6 +284,11 @@ int igraph_diameter(const igraph_t *graph, igraph_integer_t *pres,
  *         \c IGRAPH_ENOMEM, not enough memory for
  *         data structures 
  *
+ * </para><para>
+ * The breadth-first searches of 64 vertices are run together, with
+ * bit-parallel operations, and these groups are divided among the
+ * threads, see \ref igraph_set_num_threads().
+ *
  * Time complexity: O(|V||E|), the
  * number of vertices times the number of edges.
  * 
@@ -222,78 +297,79 @@ int igraph_diameter(const igraph_t *graph, igraph_integer_t *pres,
 
 int igraph_average_path_length(const igraph_t *graph, igraph_real_t *res,
 			       igraph_bool_t directed, igraph_bool_t unconn) {
-  long int no_of_nodes=igraph_vcount(graph);
-  long int i, j, n;
-  long int *already_added;
-  long int nodes_reached=0;
-  igraph_real_t normfact=0.0;
-
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  igraph_vector_int_t *neis;
+  igraph_real_t no_of_nodes=igraph_vcount(graph);
+  int nthreads=igraph_get_num_threads(), t;
+  igraph_i_average_path_length_t data;
+  igraph_vector_t sum, normfact, reached;
+  igraph_real_t normfactsum=0.0, unreached;
   igraph_neimode_t dirmode;
-  igraph_adjlist_t allneis;
 
   *res=0;  
   if (directed) { dirmode=IGRAPH_OUT; } else { dirmode=IGRAPH_ALL; }
-  already_added=igraph_Calloc(no_of_nodes, long int);
-  if (already_added==0) {
-    IGRAPH_ERROR("average path length failed", IGRAPH_ENOMEM);
-  }
-  IGRAPH_FINALLY(free, already_added); /* TODO: hack */
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
 
-  igraph_adjlist_init(graph, &allneis, dirmode);
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &allneis);
+  IGRAPH_VECTOR_INIT_FINALLY(&sum, nthreads);
+  IGRAPH_VECTOR_INIT_FINALLY(&normfact, nthreads);
+  IGRAPH_VECTOR_INIT_FINALLY(&reached, nthreads);
+  data.sum=VECTOR(sum);
+  data.normfact=VECTOR(normfact);
+  data.reached=VECTOR(reached);
 
-  for (i=0; i<no_of_nodes; i++) {
-    nodes_reached=0;
-    IGRAPH_CHECK(igraph_dqueue_push(&q, i));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    already_added[i]=i+1;
+  IGRAPH_CHECK(igraph_i_msbfs(graph, igraph_vss_all(), dirmode, 
+			      /*cutoff=*/ -1, igraph_i_average_path_length_cb,
+			      &data, nthreads, /*message=*/ 0));
 
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-    
-      neis=igraph_adjlist_get(&allneis, actnode);
-      n=igraph_vector_int_size(neis);
-      for (j=0; j<n; j++) {
-	long int neighbor=(long int) VECTOR(*neis)[j];
-	if (already_added[neighbor] == i+1) { continue; }
-	already_added[neighbor]=i+1;
-	nodes_reached++;
-	*res += actdist+1;
-	normfact+=1;
-	IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-	IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
-      }
-    } /* while !igraph_dqueue_empty */
-    
-    /* not connected, return largest possible */
-    if (!unconn) {
-      *res += (no_of_nodes * (no_of_nodes-1-nodes_reached));
-      normfact += no_of_nodes-1-nodes_reached;
-    }    
-  } /* for i<no_of_nodes */
+  unreached=no_of_nodes * no_of_nodes;
+  for (t=0; t<nthreads; t++) {
+    *res += VECTOR(sum)[t];
+    normfactsum += VECTOR(normfact)[t];
+    unreached -= VECTOR(reached)[t];
+  }
 
+  /* not connected, return largest possible */
+  if (!unconn) {
+    *res += no_of_nodes * unreached;
+    normfactsum += unreached;
+  }
   
-  if (normfact > 0) {
-    *res /= normfact;
+  if (normfactsum > 0) {
+    *res /= normfactsum;
   } else {
     *res = IGRAPH_NAN;
   }
 
-  /* clean */
-  igraph_Free(already_added);
-  igraph_dqueue_destroy(&q);
-  igraph_adjlist_destroy(&allneis);
+  igraph_vector_destroy(&reached);
+  igraph_vector_destroy(&normfact);
+  igraph_vector_destroy(&sum);
   IGRAPH_FINALLY_CLEAN(3);
 
   return 0;
 }
 
+/* Per thread histograms, each has room for all possible lengths */
+
+typedef struct igraph_i_path_length_hist_t {
+  igraph_real_t *hist, *reached;
+  long int no_of_nodes;
+} igraph_i_path_length_hist_t;
+
+static void igraph_i_path_length_hist_cb(int thread, long int first,
+					 int nsrc, long int level,
+					 const long int *reached,
+					 long int no_reached,
+					 const igraph_i_msbfs_word_t *bits,
+					 void *extra) {
+  igraph_i_path_length_hist_t *data=(igraph_i_path_length_hist_t *) extra;
+  long int i, count=0;
+  IGRAPH_UNUSED(first); IGRAPH_UNUSED(nsrc);
+  for (i=0; i<no_reached; i++) {
+    count += IGRAPH_I_POPCOUNT(bits[reached[i]]);
+  }
+  if (level > 0) {
+    data->hist[ (size_t) thread * data->no_of_nodes + level - 1 ] += count;
+  }
+  data->reached[thread] += count;
+}
+
 /**
  * \function igraph_path_length_hist
  * Create a histogram of all shortest path lengths.
@@ -315,6 +391,10 @@ int igraph_average_path_length(const igraph_t *graph, igraph_real_t *res,
  *     graphs.
  * \return Error code.
  * 
+ * </para><para>
+ * The calculation is parallelized the same way as in \ref
+ * igraph_average_path_length().
+ * 
  * Time complexity: O(|V||E|), the number of vertices times the number
  * of edges.
  * 
@@ -325,67 +405,38 @@ int igraph_path_length_hist(const igraph_t *graph, igraph_vector_t *res,
 			    igraph_real_t *unconnected, igraph_bool_t directed) {
 
   long int no_of_nodes=igraph_vcount(graph);
-  long int i,j,n;
-  igraph_vector_long_t already_added;
-  long int nodes_reached;
-  
-  igraph_dqueue_t q=IGRAPH_DQUEUE_NULL;
-  igraph_vector_int_t *neis;
+  int nthreads=igraph_get_num_threads(), t;
+  igraph_i_path_length_hist_t data;
+  igraph_vector_t hist, vreached;
   igraph_neimode_t dirmode;
-  igraph_adjlist_t allneis;
   igraph_real_t unconn = 0;
-  long int ressize;
+  long int i, ressize;
   
   if (directed) { dirmode=IGRAPH_OUT; } else { dirmode=IGRAPH_ALL; }
 
-  IGRAPH_CHECK(igraph_vector_long_init(&already_added, no_of_nodes));
-  IGRAPH_FINALLY(igraph_vector_long_destroy, &already_added);
-  IGRAPH_DQUEUE_INIT_FINALLY(&q, 100);
-  IGRAPH_CHECK(igraph_adjlist_init(graph, &allneis, dirmode));
-  IGRAPH_FINALLY(igraph_adjlist_destroy, &allneis);
-  
-  IGRAPH_CHECK(igraph_vector_resize(res, 0));
-  ressize=0;
-  
-  for (i=0; i<no_of_nodes; i++) {
-    nodes_reached=1;		/* itself */
-    IGRAPH_CHECK(igraph_dqueue_push(&q, i));
-    IGRAPH_CHECK(igraph_dqueue_push(&q, 0));
-    VECTOR(already_added)[i]=i+1;
-    
-    IGRAPH_PROGRESS("Path-hist: ", 100.0*i/no_of_nodes, NULL);
+  IGRAPH_VECTOR_INIT_FINALLY(&hist, (long int) nthreads * no_of_nodes);
+  IGRAPH_VECTOR_INIT_FINALLY(&vreached, nthreads);
+  data.hist=VECTOR(hist);
+  data.reached=VECTOR(vreached);
+  data.no_of_nodes=no_of_nodes;
 
-    IGRAPH_ALLOW_INTERRUPTION();
-    
-    while (!igraph_dqueue_empty(&q)) {
-      long int actnode=(long int) igraph_dqueue_pop(&q);
-      long int actdist=(long int) igraph_dqueue_pop(&q);
-      
-      neis=igraph_adjlist_get(&allneis, actnode);
-      n=igraph_vector_int_size(neis);
-      for (j=0; j<n; j++) {
-	long int neighbor=(long int) VECTOR(*neis)[j];
-	if (VECTOR(already_added)[neighbor] == i+1) { continue; }
-	VECTOR(already_added)[neighbor] = i+1;
-	nodes_reached++;
-	if (actdist+1 > ressize) {
-	  IGRAPH_CHECK(igraph_vector_resize(res, actdist+1));
-	  for (; ressize<actdist+1; ressize++) {
-	    VECTOR(*res)[ressize]=0;
-	  }
-	}
-	VECTOR(*res)[actdist] += 1;
-
-	IGRAPH_CHECK(igraph_dqueue_push(&q, neighbor));
-	IGRAPH_CHECK(igraph_dqueue_push(&q, actdist+1));
-      }
-    } /* while !igraph_dqueue_empty */
-
-    unconn += (no_of_nodes-nodes_reached);
+  IGRAPH_CHECK(igraph_i_msbfs(graph, igraph_vss_all(), dirmode, 
+			      /*cutoff=*/ -1, igraph_i_path_length_hist_cb, 
+			      &data, nthreads, "Path-hist: "));
 
-  } /* for i<no_of_nodes */
-
-  IGRAPH_PROGRESS("Path-hist: ", 100.0, NULL);
+  /* All lengths up to the longest one occur */
+  IGRAPH_CHECK(igraph_vector_resize(res, no_of_nodes));
+  igraph_vector_null(res);
+  unconn = (igraph_real_t) no_of_nodes * no_of_nodes;
+  for (t=0; t<nthreads; t++) {
+    for (i=0; i<no_of_nodes; i++) {
+      VECTOR(*res)[i] += VECTOR(hist)[ (long int) t * no_of_nodes + i ];
+    }
+    unconn -= VECTOR(vreached)[t];
+  }
+  for (ressize=0; ressize < no_of_nodes && VECTOR(*res)[ressize] != 0; 
+       ressize++) ;
+  IGRAPH_CHECK(igraph_vector_resize(res, ressize));
 
   /* count every pair only once for an undirected graph */
   if (!directed || !igraph_is_directed(graph)) {
@@ -395,10 +446,9 @@ int igraph_path_length_hist(const igraph_t *graph, igraph_vector_t *res,
     unconn /= 2;
   }
 
-  igraph_vector_long_destroy(&already_added);
-  igraph_dqueue_destroy(&q);
-  igraph_adjlist_destroy(&allneis);
-  IGRAPH_FINALLY_CLEAN(3);
+  igraph_vector_destroy(&vreached);
+  igraph_vector_destroy(&hist);
+  IGRAPH_FINALLY_CLEAN(2);
 
   if (unconnected)
 	*unconnected = unconn;
@@ -406,6 +456,36 @@ int igraph_path_length_hist(const igraph_t *graph, igraph_vector_t *res,
   return 0;
 }
 
+/* Distances from some sources to all vertices, the rows of the
+   matrix are written by the threads that run the searches */
+
+static void igraph_i_shortest_paths_cb(int thread, long int index, 
+				       long int source, const long int *order,
+				       const igraph_real_t *dist, 
+				       long int reached, void *extra) {
+  igraph_matrix_t *res=(igraph_matrix_t *) extra;
+  long int j;
+  IGRAPH_UNUSED(thread); IGRAPH_UNUSED(source);
+  for (j=0; j<reached; j++) {
+    MATRIX(*res, index, order[j]) = dist[order[j]];
+  }
+}
+
+static int igraph_i_shortest_paths_all(const igraph_t *graph,
+				       igraph_matrix_t *res,
+				       const igraph_vs_t from,
+				       const igraph_vector_t *weights,
+				       igraph_neimode_t mode) {
+  igraph_integer_t no_of_from;
+  IGRAPH_CHECK(igraph_vs_size(graph, &from, &no_of_from));
+  IGRAPH_CHECK(igraph_matrix_resize(res, no_of_from, igraph_vcount(graph)));
+  igraph_matrix_fill(res, IGRAPH_INFINITY);
+  IGRAPH_CHECK(igraph_i_sssp(graph, from, mode, weights, 
+			     igraph_i_shortest_paths_cb, res,
+			     igraph_get_num_threads(), /*message=*/ 0));
+  return 0;
+}
+
 /**
  * \ingroup structural
  * \function igraph_shortest_paths
@@ -479,6 +559,11 @@ int igraph_shortest_paths(const igraph_t *graph, igraph_matrix_t *res,
     IGRAPH_ERROR("Invalid mode argument", IGRAPH_EINVMODE);
   }
 
+  if (igraph_vs_is_all(&to)) {
+    return igraph_i_shortest_paths_all(graph, res, from, /*weights=*/ 0, 
+				       mode);
+  }
+
   IGRAPH_CHECK(igraph_vit_create(graph, from, &fromvit));
   IGRAPH_FINALLY(igraph_vit_destroy, &fromvit);
   no_of_from=IGRAPH_VIT_SIZE(fromvit);
@@ -4295,6 +4380,10 @@ int igraph_shortest_paths_dijkstra(const igraph_t *graph,
     IGRAPH_ERROR("Weight vector must be non-negative", IGRAPH_EINVAL);
   }
 
+  if (igraph_vs_is_all(&to)) {
+    return igraph_i_shortest_paths_all(graph, res, from, weights, mode);
+  }
+
   IGRAPH_CHECK(igraph_vit_create(graph, from, &fromvit));
   IGRAPH_FINALLY(igraph_vit_destroy, &fromvit);
   no_of_from=IGRAPH_VIT_SIZE(fromvit);
@@ -6096,32 +6185,16 @@ int igraph_diameter_dijkstra(const igraph_t *graph,
 			     igraph_bool_t directed,
 			     igraph_bool_t unconn) {
 
-  /* Implementation details. This is the basic Dijkstra algorithm, 
-     with a binary heap. The heap is indexed, i.e. it stores not only
-     the distances, but also which vertex they belong to.
-
-     From now on we use a 2-way heap, so the distances can be queried
-     directly from the heap.
-
-     Dirty tricks:
-     - the opposite of the distance is stored in the heap, as it is a
-       maximum heap and we need a minimum heap.
-     - we don't use IGRAPH_INFINITY during the computation, as IGRAPH_FINITE()
-       might involve a function call and we want to spare that. -1 will denote
-       infinity instead.
-  */
+  /* Implementation details. A Dijkstra search is started from every
+     vertex, in parallel, see igraph_i_sssp(). Each thread keeps the
+     longest finite distance it has seen. */
   
-  long int no_of_nodes=igraph_vcount(graph);
   long int no_of_edges=igraph_ecount(graph);
-
-  igraph_2wheap_t Q;
-  igraph_inclist_t inclist;
-  long int source, j;
   igraph_neimode_t dirmode = directed ? IGRAPH_OUT : IGRAPH_ALL;
 
   long int from=-1, to=-1;
-  igraph_real_t res=0;
-  long int nodes_reached=0;
+  igraph_real_t res=-1;
+  igraph_bool_t notconn;
   
   if (!weights) {
     igraph_integer_t diameter;
@@ -6139,73 +6212,17 @@ int igraph_diameter_dijkstra(const igraph_t *graph,
   if (igraph_vector_min(weights) < 0) {
     IGRAPH_ERROR("Weight vector must be non-negative", IGRAPH_EINVAL);
   }
-  
-  IGRAPH_CHECK(igraph_2wheap_init(&Q, no_of_nodes));
-  IGRAPH_FINALLY(igraph_2wheap_destroy, &Q);
-  IGRAPH_CHECK(igraph_inclist_init(graph, &inclist, dirmode));
-  IGRAPH_FINALLY(igraph_inclist_destroy, &inclist);
-  
-  for (source=0; source < no_of_nodes; source++) {
-
-    IGRAPH_PROGRESS("Weighted diameter: ", source*100.0/no_of_nodes, NULL);
-    IGRAPH_ALLOW_INTERRUPTION();
-
-    igraph_2wheap_clear(&Q);
-    igraph_2wheap_push_with_index(&Q, source, -1.0);
 
-    nodes_reached = 0.0;
+  IGRAPH_CHECK(igraph_i_diameter(graph, weights, dirmode, unconn,
+				 "Weighted diameter: ", &res, &from, &to,
+				 &notconn));
 
-    while (!igraph_2wheap_empty(&Q)) {
-      long int minnei=igraph_2wheap_max_index(&Q);
-      igraph_real_t mindist=-igraph_2wheap_deactivate_max(&Q);
-      igraph_vector_int_t *neis;
-      long int nlen;
-      
-      if (mindist > res) {
-	res=mindist; from=source; to=minnei;
-      }
-      nodes_reached++;
-
-      /* Now check all neighbors of 'minnei' for a shorter path */
-      neis=igraph_inclist_get(&inclist, minnei);
-      nlen=igraph_vector_int_size(neis);
-      for (j=0; j<nlen; j++) {
-	long int edge=(long int) VECTOR(*neis)[j];
-	long int tto=IGRAPH_OTHER(graph, edge, minnei);
-	igraph_real_t altdist = mindist + VECTOR(*weights)[edge];
-        igraph_bool_t active = igraph_2wheap_has_active(&Q, tto);
-        igraph_bool_t has = igraph_2wheap_has_elem(&Q, tto);
-	igraph_real_t curdist = active ? -igraph_2wheap_get(&Q, tto) : 0.0;
-	
-	if (!has) {
-	  /* First finite distance */
-	  IGRAPH_CHECK(igraph_2wheap_push_with_index(&Q, tto, -altdist));
-	} else if (altdist < curdist) {
-	  /* A shorter path */
-	  IGRAPH_CHECK(igraph_2wheap_modify(&Q, tto, -altdist));
-	}
-      }
-      
-    } /* !igraph_2wheap_empty(&Q) */
-
-    /* not connected, return infinity */
-    if (nodes_reached != no_of_nodes && !unconn) {
-      res=IGRAPH_INFINITY;
-      from=to=-1;
-      break;
-    }
-    
-  } /* source < no_of_nodes */
-
-  /* Compensate for the +1 that we have added to distances */
-  res -= 1;
-
-  igraph_inclist_destroy(&inclist);
-  igraph_2wheap_destroy(&Q);
-  IGRAPH_FINALLY_CLEAN(2);
+  /* not connected, return infinity */
+  if (notconn && !unconn) {
+    res=IGRAPH_INFINITY;
+    from=to=-1;
+  }
 
-  IGRAPH_PROGRESS("Weighted diameter: ", 100.0, NULL);
-  
   if (pres) {
     *pres=res;
   }
@@ -26,6 +26,8 @@
 
 #include "igraph_constants.h"
 #include "igraph_types.h"
+#include "igraph_datatype.h"
+#include "igraph_iterators.h"
 
 int igraph_i_induced_subgraph_suggest_implementation(
     const igraph_t *graph, const igraph_vs_t vids,
@@ -43,4 +45,44 @@ int igraph_i_subgraph_create_from_scratch(const igraph_t *graph,
 					  igraph_vector_t *map,
 					  igraph_vector_t *invmap);
 
+/* Shortest paths from many sources, in parallel, see distances.c */
+
+typedef void igraph_i_sssp_callback_t(int thread, long int index, 
+				      long int source, const long int *order,
+				      const igraph_real_t *dist, 
+				      long int reached, void *extra);
+
+int igraph_i_sssp(const igraph_t *graph, const igraph_vs_t sources,
+		  igraph_neimode_t mode, const igraph_vector_t *weights,
+		  igraph_i_sssp_callback_t *callback, void *extra,
+		  int nthreads, const char *message);
+
+/* Bit-parallel breadth-first search from many sources, see distances.c */
+
+typedef unsigned long long igraph_i_msbfs_word_t;
+
+#define IGRAPH_I_MSBFS_BITS 64
+
+#if defined(__GNUC__)
+#define IGRAPH_I_POPCOUNT(x) __builtin_popcountll(x)
+#define IGRAPH_I_CTZ(x) __builtin_ctzll(x)
+#else
+#define IGRAPH_I_POPCOUNT(x) igraph_i_popcount(x)
+#define IGRAPH_I_CTZ(x) igraph_i_ctz(x)
+int igraph_i_popcount(igraph_i_msbfs_word_t x);
+int igraph_i_ctz(igraph_i_msbfs_word_t x);
+#endif
+
+typedef void igraph_i_msbfs_callback_t(int thread, long int first, 
+				       int nsrc, long int level,
+				       const long int *reached,
+				       long int no_reached,
+				       const igraph_i_msbfs_word_t *bits,
+				       void *extra);
+
+int igraph_i_msbfs(const igraph_t *graph, const igraph_vs_t sources,
+		   igraph_neimode_t mode, igraph_real_t cutoff,
+		   igraph_i_msbfs_callback_t *callback, void *extra,
+		   int nthreads, const char *message);
+
 #endif
@@ -0,0 +1,113 @@
+/* -*- mode: C -*-  */
+/* 
+   IGraph library.
+   Copyright (C) 2018  Gabor Csardi <csardi.gabor@gmail.com>
+   334 Harvard street, Cambridge, MA 02139 USA
+   
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 
+   02110-1301 USA
+
+*/
+
+#include "igraph_threading_internal.h"
+#include "igraph_error.h"
+#include "config.h"
+
+/* This is a process-wide setting, not a thread-local one. */
+
+static int igraph_i_num_threads=1;
+
+/**
+ * \function igraph_set_num_threads
+ * Set the number of threads for parallel algorithms
+ * 
+ * Some igraph functions can use multiple threads if igraph was
+ * compiled with OpenMP support. This function sets the largest number
+ * of threads they are allowed to use. The default is one, i.e. no
+ * parallelism at all.
+ * 
+ * </para><para>
+ * Most results do not depend on the number of threads. Randomized
+ * functions, e.g. \ref igraph_community_infomap(), \ref
+ * igraph_community_label_propagation(), \ref
+ * igraph_community_spinglass() with replicas and \ref
+ * igraph_betweenness_approx(), draw the same random numbers from the
+ * random number generator for any number of threads, outside of the
+ * parallel parts, so its state afterwards is the same, too. The exceptions are \ref igraph_betweenness() and \ref
+ * igraph_edge_betweenness() and their variants, which add up partial
+ * results in a different order, so the scores can differ in the last
+ * bits, and \ref igraph_community_edge_betweenness(), which can
+ * remove a different one of several edges with (almost) the same
+ * betweenness. The parallel variant of \ref
+ * igraph_community_multilevel() differs from the sequential one, but
+ * it does not depend on the number of threads either.
+ * 
+ * </para><para>
+ * The threads never call the error, warning or interruption handlers,
+ * and they never use the default random number generator, so this
+ * setting can be used in builds that are not thread-safe, see
+ * \ref IGRAPH_THREAD_SAFE.
+ * 
+ * \param num_threads The number of threads, it must be positive.
+ * \return Error code.
+ * 
+ * Time complexity: O(1).
+ */
+
+int igraph_set_num_threads(int num_threads) {
+  if (num_threads < 1) {
+    IGRAPH_ERROR("Number of threads must be positive", IGRAPH_EINVAL);
+  }
+  igraph_i_num_threads=num_threads;
+  return 0;
+}
+
+/**
+ * \function igraph_get_num_threads
+ * Query the number of threads for parallel algorithms
+ * 
+ * \return The number of threads igraph functions may use, as set by
+ *    \ref igraph_set_num_threads(). This is always one if igraph was
+ *    compiled without OpenMP support.
+ * 
+ * Time complexity: O(1).
+ */
+
+int igraph_get_num_threads(void) {
+#ifdef _OPENMP
+  return igraph_i_num_threads;
+#else
+  return 1;
+#endif
+}
+
+/* The size of the last team of threads that recorded itself with
+   IGRAPH_I_RECORD_TEAM, for the tests. The master thread of the team
+   records it, this is the calling thread, so it is thread-local. It
+   is -1 if igraph was compiled without OpenMP. */
+
+static IGRAPH_THREAD_LOCAL int igraph_i_team_size=0;
+
+void igraph_i_record_team_size(int size) {
+  igraph_i_team_size=size;
+}
+
+int igraph_i_last_team_size(void) {
+#ifdef _OPENMP
+  return igraph_i_team_size;
+#else
+  return -1;
+#endif
+}
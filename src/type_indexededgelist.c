@@ -23,16 +23,30 @@
 
 #include "igraph_datatype.h"
 #include "igraph_interface.h"
+#include "igraph_adjlist_internal.h"
 #include "igraph_attributes.h"
 #include "igraph_memory.h"
+#include "igraph_qsort.h"
+#include "igraph_types_internal.h"
 #include <string.h>		/* memset & co. */
+#include <math.h>
 #include "config.h"
 
 /* Internal functions */
 
-int igraph_i_create_start(igraph_vector_t *res, igraph_vector_t *el, igraph_vector_t *index, 
+int igraph_i_create_start(igraph_i_graph_vector_t *res,
+			  igraph_i_graph_vector_t *el,
+			  igraph_i_graph_vector_t *index,
 			  igraph_integer_t nodes);
 
+#define IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(v, size) \
+  do { IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(v, size)); \
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), v); } while (0)
+
+static void igraph_i_add_edges_merge(igraph_t *graph, 
+				     igraph_vector_long_t *neworder,
+				     long int no_of_edges);
+
 /**
  * \section about_basic_interface
  *
@@ -123,16 +137,22 @@ int igraph_empty_attrs(igraph_t *graph, igraph_integer_t n, igraph_bool_t direct
 
   graph->n=0;
   graph->directed=directed;
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->from, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->to, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->oi, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->ii, 0);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->os, 1);
-  IGRAPH_VECTOR_INIT_FINALLY(&graph->is, 1);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&graph->from, 0);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&graph->to, 0);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&graph->oi, 0);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&graph->ii, 0);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&graph->os, 1);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&graph->is, 1);
 
   VECTOR(graph->os)[0]=0;
   VECTOR(graph->is)[0]=0;
 
+  graph->cache=igraph_i_adjcache_create(/*external=*/ 0);
+  if (!graph->cache) {
+    IGRAPH_ERROR("cannot create empty graph", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_i_adjcache_destroy, graph->cache);
+
   /* init attributes */
   graph->attr=0;
   IGRAPH_CHECK(igraph_i_attribute_init(graph, attr));
@@ -140,7 +160,7 @@ int igraph_empty_attrs(igraph_t *graph, igraph_integer_t n, igraph_bool_t direct
   /* add the vertices */
   IGRAPH_CHECK(igraph_add_vertices(graph, n, 0));
   
-  IGRAPH_FINALLY_CLEAN(6);
+  IGRAPH_FINALLY_CLEAN(7);
   return 0;
 }
 
@@ -165,12 +185,13 @@ int igraph_destroy(igraph_t *graph) {
 
   IGRAPH_I_ATTRIBUTE_DESTROY(graph);
 
-  igraph_vector_destroy(&graph->from);
-  igraph_vector_destroy(&graph->to);
-  igraph_vector_destroy(&graph->oi);
-  igraph_vector_destroy(&graph->ii);
-  igraph_vector_destroy(&graph->os);
-  igraph_vector_destroy(&graph->is);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->from);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->to);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->oi);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->ii);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->os);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->is);
+  igraph_i_adjcache_release(graph);
   
   return 0;
 }
@@ -204,22 +225,27 @@ int igraph_destroy(igraph_t *graph) {
 int igraph_copy(igraph_t *to, const igraph_t *from) {
   to->n=from->n;
   to->directed=from->directed;
-  IGRAPH_CHECK(igraph_vector_copy(&to->from, &from->from));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->from);
-  IGRAPH_CHECK(igraph_vector_copy(&to->to, &from->to));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->to);
-  IGRAPH_CHECK(igraph_vector_copy(&to->oi, &from->oi));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->oi);
-  IGRAPH_CHECK(igraph_vector_copy(&to->ii, &from->ii));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->ii);
-  IGRAPH_CHECK(igraph_vector_copy(&to->os, &from->os));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->os);
-  IGRAPH_CHECK(igraph_vector_copy(&to->is, &from->is));
-  IGRAPH_FINALLY(igraph_vector_destroy, &to->is);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(copy)(&to->from, &from->from));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &to->from);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(copy)(&to->to, &from->to));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &to->to);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(copy)(&to->oi, &from->oi));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &to->oi);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(copy)(&to->ii, &from->ii));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &to->ii);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(copy)(&to->os, &from->os));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &to->os);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(copy)(&to->is, &from->is));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &to->is);
+  to->cache=igraph_i_adjcache_create(/*external=*/ 0);
+  if (!to->cache) {
+    IGRAPH_ERROR("cannot copy graph", IGRAPH_ENOMEM);
+  }
+  IGRAPH_FINALLY(igraph_i_adjcache_destroy, to->cache);
 
   IGRAPH_I_ATTRIBUTE_COPY(to, from, 1,1,1); /* does IGRAPH_CHECK */
 
-  IGRAPH_FINALLY_CLEAN(6);
+  IGRAPH_FINALLY_CLEAN(7);
   return 0;
 }
 
@@ -248,22 +274,34 @@ int igraph_copy(igraph_t *to, const igraph_t *from) {
  * This function invalidates all iterators.
  *
  * </para><para>
+ * If only a few edges are added to a large graph, then the new edges
+ * are sorted separately and merged into the existing indices,
+ * instead of rebuilding the indices from scratch. This makes adding
+ * edges in small batches much cheaper.
+ *
+ * </para><para>
  * Time complexity: O(|V|+|E|) where
  * |V| is the number of vertices and
  * |E| is the number of
- * edges in the \em new, extended graph.
+ * edges in the \em new, extended graph. If only k edges are added,
+ * where k log(k) is smaller than |V|+|E|, then the indices are
+ * updated by merging, this is still O(|V|+|E|+k log(k)) in the worst
+ * case, but it only moves the index entries after the new edges and
+ * it has much better memory locality.
  * 
  * \example examples/simple/igraph_add_edges.c
  */
 int igraph_add_edges(igraph_t *graph, const igraph_vector_t *edges,
 		     void *attr) {
-  long int no_of_edges=igraph_vector_size(&graph->from);
+  long int no_of_edges=IGRAPH_I_GRAPH_VECTOR(size)(&graph->from);
   long int edges_to_add=igraph_vector_size(edges)/2;
   long int i=0;
   igraph_error_handler_t *oldhandler;
   int ret1, ret2;
-  igraph_vector_t newoi, newii;
+  igraph_i_graph_vector_t newoi, newii;
+  igraph_vector_long_t neworder;
   igraph_bool_t directed=igraph_is_directed(graph);
+  igraph_bool_t merge;
 
   if (igraph_vector_size(edges) % 2 != 0) {
     IGRAPH_ERROR("invalid (odd) length of edges vector", IGRAPH_EINVEVECTOR);
@@ -272,42 +310,69 @@ int igraph_add_edges(igraph_t *graph, const igraph_vector_t *edges,
     IGRAPH_ERROR("cannot add edges", IGRAPH_EINVVID);
   }
 
+  igraph_i_adjcache_invalidate(graph);
+
   /* from & to */
-  IGRAPH_CHECK(igraph_vector_reserve(&graph->from, no_of_edges+edges_to_add));
-  IGRAPH_CHECK(igraph_vector_reserve(&graph->to  , no_of_edges+edges_to_add));
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(reserve)(&graph->from, 
+					       no_of_edges+edges_to_add));
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(reserve)(&graph->to  , 
+					       no_of_edges+edges_to_add));
 
   while (i<edges_to_add*2) {
     if (directed || VECTOR(*edges)[i] > VECTOR(*edges)[i+1]) {
-      igraph_vector_push_back(&graph->from, VECTOR(*edges)[i++]); /* reserved */
-      igraph_vector_push_back(&graph->to,   VECTOR(*edges)[i++]); /* reserved */
+      IGRAPH_I_GRAPH_VECTOR(push_back)(&graph->from, VECTOR(*edges)[i++]); /* reserved */
+      IGRAPH_I_GRAPH_VECTOR(push_back)(&graph->to,   VECTOR(*edges)[i++]); /* reserved */
     } else {
-      igraph_vector_push_back(&graph->to,   VECTOR(*edges)[i++]); /* reserved */
-      igraph_vector_push_back(&graph->from, VECTOR(*edges)[i++]); /* reserved */
+      IGRAPH_I_GRAPH_VECTOR(push_back)(&graph->to,   VECTOR(*edges)[i++]); /* reserved */
+      IGRAPH_I_GRAPH_VECTOR(push_back)(&graph->from, VECTOR(*edges)[i++]); /* reserved */
     }      
   }
 
+  /* Merge the new edges into the existing indices, if sorting them
+     separately is cheaper than rebuilding the indices */
+  merge = no_of_edges > 0 && edges_to_add > 0 &&
+    edges_to_add * log((double) edges_to_add+1) / log(2.0) < 
+    no_of_edges + graph->n;
+
   /* disable the error handler temporarily */
   oldhandler=igraph_set_error_handler(igraph_error_handler_ignore);
-    
-  /* oi & ii */
-  ret1=igraph_vector_init(&newoi, no_of_edges);
-  ret2=igraph_vector_init(&newii, no_of_edges);
-  if (ret1 != 0 || ret2 != 0) {
-    igraph_vector_resize(&graph->from, no_of_edges); /* gets smaller */
-    igraph_vector_resize(&graph->to, no_of_edges);   /* gets smaller */
-    igraph_set_error_handler(oldhandler);
-    IGRAPH_ERROR("cannot add edges", IGRAPH_ERROR_SELECT_2(ret1, ret2));
-  }  
-  ret1=igraph_vector_order(&graph->from, &graph->to, &newoi, graph->n);
-  ret2=igraph_vector_order(&graph->to  , &graph->from, &newii, graph->n);
-  if (ret1 != 0 || ret2 != 0) {
-    igraph_vector_resize(&graph->from, no_of_edges);
-    igraph_vector_resize(&graph->to, no_of_edges);
-    igraph_vector_destroy(&newoi);
-    igraph_vector_destroy(&newii);
-    igraph_set_error_handler(oldhandler);
-    IGRAPH_ERROR("cannot add edges", IGRAPH_ERROR_SELECT_2(ret1, ret2));
-  }  
+
+  if (merge) {
+    /* make room in oi & ii, their contents do not change yet */
+    ret1=IGRAPH_I_GRAPH_VECTOR(reserve)(&graph->oi, no_of_edges+edges_to_add);
+    ret2=IGRAPH_I_GRAPH_VECTOR(reserve)(&graph->ii, no_of_edges+edges_to_add);
+    if (ret1 == 0 && ret2 == 0) {
+      ret1=igraph_vector_long_init(&neworder, edges_to_add);
+    }
+    if (ret1 != 0 || ret2 != 0) {
+      IGRAPH_I_GRAPH_VECTOR(resize)(&graph->from, no_of_edges);
+      IGRAPH_I_GRAPH_VECTOR(resize)(&graph->to, no_of_edges);
+      igraph_set_error_handler(oldhandler);
+      IGRAPH_ERROR("cannot add edges", IGRAPH_ERROR_SELECT_2(ret1, ret2));
+    }
+  } else {
+    /* oi & ii */
+    ret1=IGRAPH_I_GRAPH_VECTOR(init)(&newoi, no_of_edges);
+    ret2=IGRAPH_I_GRAPH_VECTOR(init)(&newii, no_of_edges);
+    if (ret1 != 0 || ret2 != 0) {
+      IGRAPH_I_GRAPH_VECTOR(resize)(&graph->from, no_of_edges); /* gets smaller */
+      IGRAPH_I_GRAPH_VECTOR(resize)(&graph->to, no_of_edges);   /* gets smaller */
+      igraph_set_error_handler(oldhandler);
+      IGRAPH_ERROR("cannot add edges", IGRAPH_ERROR_SELECT_2(ret1, ret2));
+    }  
+    ret1=IGRAPH_I_GRAPH_VECTOR(order)(&graph->from, &graph->to, &newoi,
+				      graph->n);
+    ret2=IGRAPH_I_GRAPH_VECTOR(order)(&graph->to  , &graph->from, &newii,
+				      graph->n);
+    if (ret1 != 0 || ret2 != 0) {
+      IGRAPH_I_GRAPH_VECTOR(resize)(&graph->from, no_of_edges);
+      IGRAPH_I_GRAPH_VECTOR(resize)(&graph->to, no_of_edges);
+      IGRAPH_I_GRAPH_VECTOR(destroy)(&newoi);
+      IGRAPH_I_GRAPH_VECTOR(destroy)(&newii);
+      igraph_set_error_handler(oldhandler);
+      IGRAPH_ERROR("cannot add edges", IGRAPH_ERROR_SELECT_2(ret1, ret2));
+    }  
+  }
 
   /* Attributes */
   if (graph->attr) { 
@@ -315,22 +380,34 @@ int igraph_add_edges(igraph_t *graph, const igraph_vector_t *edges,
     ret1=igraph_i_attribute_add_edges(graph, edges, attr);
     igraph_set_error_handler(igraph_error_handler_ignore);
     if (ret1 != 0) {
-      igraph_vector_resize(&graph->from, no_of_edges);
-      igraph_vector_resize(&graph->to, no_of_edges);
-      igraph_vector_destroy(&newoi);
-      igraph_vector_destroy(&newii);
+      IGRAPH_I_GRAPH_VECTOR(resize)(&graph->from, no_of_edges);
+      IGRAPH_I_GRAPH_VECTOR(resize)(&graph->to, no_of_edges);
+      if (merge) {
+	igraph_vector_long_destroy(&neworder);
+      } else {
+	IGRAPH_I_GRAPH_VECTOR(destroy)(&newoi);
+	IGRAPH_I_GRAPH_VECTOR(destroy)(&newii);
+      }
       igraph_set_error_handler(oldhandler);
       IGRAPH_ERROR("cannot add edges", ret1);
     }  
   }
+
+  if (merge) {
+    /* everything is allocated, this is error safe */
+    igraph_i_add_edges_merge(graph, &neworder, no_of_edges);
+    igraph_vector_long_destroy(&neworder);
+    igraph_set_error_handler(oldhandler);
+    return 0;
+  }
   
   /* os & is, its length does not change, error safe */
   igraph_i_create_start(&graph->os, &graph->from, &newoi, graph->n);
   igraph_i_create_start(&graph->is, &graph->to  , &newii, graph->n);
 
   /* everything went fine  */
-  igraph_vector_destroy(&graph->oi);
-  igraph_vector_destroy(&graph->ii);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->oi);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->ii);
   graph->oi=newoi;
   graph->ii=newii;
   igraph_set_error_handler(oldhandler);
@@ -338,6 +415,151 @@ int igraph_add_edges(igraph_t *graph, const igraph_vector_t *edges,
   return 0;
 }
 
+/* Makes 'from' and 'to' the edge list of 'graph', which must not
+   have edges yet, and builds the indices for it. The two vectors are
+   taken over without copying, they are left empty; for undirected
+   graphs the endpoints of the edges might be swapped even if there
+   is an error. This is for the readers that collect the endpoints
+   themselves, the edges get no attributes. */
+
+int igraph_i_add_edges_take(igraph_t *graph, igraph_i_graph_vector_t *from,
+			    igraph_i_graph_vector_t *to) {
+  long int no_of_edges=IGRAPH_I_GRAPH_VECTOR(size)(from);
+  igraph_i_graph_vector_t newoi, newii, tmp;
+  long int i;
+
+  if (IGRAPH_I_GRAPH_VECTOR(size)(&graph->from) != 0) {
+    IGRAPH_ERROR("cannot take edges, graph has edges", IGRAPH_EINVAL);
+  }
+  if (IGRAPH_I_GRAPH_VECTOR(size)(to) != no_of_edges) {
+    IGRAPH_ERROR("cannot take edges, lengths differ", IGRAPH_EINVAL);
+  }
+  if (no_of_edges > 0 &&
+      (IGRAPH_I_GRAPH_VECTOR(min)(from) < 0 ||
+       IGRAPH_I_GRAPH_VECTOR(min)(to) < 0 ||
+       IGRAPH_I_GRAPH_VECTOR(max)(from) >= graph->n ||
+       IGRAPH_I_GRAPH_VECTOR(max)(to) >= graph->n)) {
+    IGRAPH_ERROR("cannot take edges", IGRAPH_EINVVID);
+  }
+
+  if (!igraph_is_directed(graph)) {
+    for (i=0; i<no_of_edges; i++) {
+      if (VECTOR(*from)[i] < VECTOR(*to)[i]) {
+	igraph_real_t t=VECTOR(*from)[i];
+	VECTOR(*from)[i]=VECTOR(*to)[i];
+	VECTOR(*to)[i]=t;
+      }
+    }
+  }
+
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(&newoi, no_of_edges));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &newoi);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(init)(&newii, no_of_edges));
+  IGRAPH_FINALLY(IGRAPH_I_GRAPH_VECTOR(destroy), &newii);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(order)(from, to, &newoi, graph->n));
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(order)(to, from, &newii, graph->n));
+
+  /* nothing can fail from here, os & is keep their length */
+  igraph_i_adjcache_invalidate(graph);
+  tmp=graph->from; graph->from=*from; *from=tmp;
+  tmp=graph->to; graph->to=*to; *to=tmp;
+  tmp=graph->oi; graph->oi=newoi; newoi=tmp;
+  tmp=graph->ii; graph->ii=newii; newii=tmp;
+  igraph_i_create_start(&graph->os, &graph->from, &graph->oi, graph->n);
+  igraph_i_create_start(&graph->is, &graph->to, &graph->ii, graph->n);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&newoi);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&newii);
+  IGRAPH_FINALLY_CLEAN(2);
+
+  return 0;
+}
+
+/* Sort edge ids according to a primary and a secondary key, i.e. the
+   two columns of the edge list. Ties are broken by decreasing edge
+   ids, igraph_vector_order() orders them this way, too. */
+
+typedef struct {
+  const igraph_i_graph_vector_t *key1, *key2;
+} igraph_i_add_edges_cmp_t;
+
+static int igraph_i_add_edges_cmp(void *extra, const void *a,
+				  const void *b) {
+  igraph_i_add_edges_cmp_t *data=(igraph_i_add_edges_cmp_t*) extra;
+  long int ea=*(const long int*) a, eb=*(const long int*) b;
+  long int a1=(long int) VECTOR(*data->key1)[ea];
+  long int b1=(long int) VECTOR(*data->key1)[eb];
+  long int a2, b2;
+  if (a1 != b1) { return a1 < b1 ? -1 : 1; }
+  a2=(long int) VECTOR(*data->key2)[ea];
+  b2=(long int) VECTOR(*data->key2)[eb];
+  if (a2 != b2) { return a2 < b2 ? -1 : 1; }
+  return ea < eb ? 1 : (ea > eb ? -1 : 0);
+}
+
+/* Merge the sorted new edges into an index (oi or ii), and update the
+   corresponding start vector (os or is). The index must have room for
+   the new edges. This goes backwards, so the old entries before the
+   first new edge are not touched at all. */
+
+static void igraph_i_add_edges_merge_index(igraph_t *graph,
+					   igraph_i_graph_vector_t *index,
+					   igraph_i_graph_vector_t *start,
+					   const igraph_i_graph_vector_t *key1,
+					   const igraph_i_graph_vector_t *key2,
+					   igraph_vector_long_t *neworder,
+					   long int no_of_edges) {
+  long int edges_to_add=igraph_vector_long_size(neworder);
+  long int no_of_nodes=graph->n;
+  long int i=no_of_edges-1, j=edges_to_add-1, w=no_of_edges+edges_to_add-1;
+  igraph_i_add_edges_cmp_t data = { key1, key2 };
+  long int v, p;
+
+  igraph_qsort_r(VECTOR(*neworder), (size_t) edges_to_add, 
+		 sizeof(long int), &data, igraph_i_add_edges_cmp);
+
+  IGRAPH_I_GRAPH_VECTOR(resize)(index, no_of_edges+edges_to_add); /* reserved */
+  while (j >= 0) {
+    long int newe=VECTOR(*neworder)[j];
+    if (i >= 0) {
+      long int olde=(long int) VECTOR(*index)[i];
+      long int o1=(long int) VECTOR(*key1)[olde];
+      long int n1=(long int) VECTOR(*key1)[newe];
+      if (o1 > n1 || (o1 == n1 && VECTOR(*key2)[olde] >= VECTOR(*key2)[newe])) {
+	VECTOR(*index)[w--]=olde;
+	i--;
+	continue;
+      }
+    }
+    VECTOR(*index)[w--]=newe;
+    j--;
+  }
+
+  /* Every vertex gets the number of new edges with a smaller key */
+  for (v=0, p=0; v<=no_of_nodes; v++) {
+    while (p < edges_to_add && 
+	   VECTOR(*key1)[ VECTOR(*neworder)[p] ] < v) {
+      p++;
+    }
+    VECTOR(*start)[v] += p;
+  }
+}
+
+static void igraph_i_add_edges_merge(igraph_t *graph, 
+				     igraph_vector_long_t *neworder,
+				     long int no_of_edges) {
+  long int i, edges_to_add=igraph_vector_long_size(neworder);
+
+  for (i=0; i<edges_to_add; i++) {
+    VECTOR(*neworder)[i] = no_of_edges + i;
+  }
+  igraph_i_add_edges_merge_index(graph, &graph->oi, &graph->os, 
+				 &graph->from, &graph->to, neworder,
+				 no_of_edges);
+  igraph_i_add_edges_merge_index(graph, &graph->ii, &graph->is,
+				 &graph->to, &graph->from, neworder,
+				 no_of_edges);
+}
+
 /**
  * \ingroup interface
  * \function igraph_add_vertices
@@ -369,11 +591,13 @@ int igraph_add_vertices(igraph_t *graph, igraph_integer_t nv, void *attr) {
     IGRAPH_ERROR("cannot add negative number of vertices", IGRAPH_EINVAL);
   }
 
-  IGRAPH_CHECK(igraph_vector_reserve(&graph->os, graph->n+nv+1));
-  IGRAPH_CHECK(igraph_vector_reserve(&graph->is, graph->n+nv+1));
+  igraph_i_adjcache_invalidate(graph);
+
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(reserve)(&graph->os, graph->n+nv+1));
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(reserve)(&graph->is, graph->n+nv+1));
   
-  igraph_vector_resize(&graph->os, graph->n+nv+1); /* reserved */
-  igraph_vector_resize(&graph->is, graph->n+nv+1); /* reserved */
+  IGRAPH_I_GRAPH_VECTOR(resize)(&graph->os, graph->n+nv+1); /* reserved */
+  IGRAPH_I_GRAPH_VECTOR(resize)(&graph->is, graph->n+nv+1); /* reserved */
   for (i=graph->n+1; i<graph->n+nv+1; i++) {
     VECTOR(graph->os)[i]=ec;
     VECTOR(graph->is)[i]=ec;
@@ -420,7 +644,7 @@ int igraph_delete_edges(igraph_t *graph, igraph_es_t edges) {
   long int remaining_edges;
   igraph_eit_t eit;
   
-  igraph_vector_t newfrom, newto, newoi;
+  igraph_i_graph_vector_t newfrom, newto, newoi;
 
   int *mark;
   long int i, j;
@@ -447,8 +671,8 @@ int igraph_delete_edges(igraph_t *graph, igraph_es_t edges) {
   igraph_eit_destroy(&eit);
   IGRAPH_FINALLY_CLEAN(1);
 
-  IGRAPH_VECTOR_INIT_FINALLY(&newfrom, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newto, remaining_edges);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newfrom, remaining_edges);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newto, remaining_edges);
   
   /* Actually remove the edges, move from pos i to pos j in newfrom/newto */
   for (i=0,j=0; j<remaining_edges; i++) {
@@ -460,9 +684,11 @@ int igraph_delete_edges(igraph_t *graph, igraph_es_t edges) {
   }
 
   /* Create index, this might require additional memory */
-  IGRAPH_VECTOR_INIT_FINALLY(&newoi, remaining_edges);
-  IGRAPH_CHECK(igraph_vector_order(&newfrom, &newto, &newoi, no_of_nodes));
-  IGRAPH_CHECK(igraph_vector_order(&newto, &newfrom, &graph->ii, no_of_nodes));
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newoi, remaining_edges);
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(order)(&newfrom, &newto, &newoi,
+					     no_of_nodes));
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(order)(&newto, &newfrom, &graph->ii,
+					     no_of_nodes));
 
   /* Edge attributes, we need an index that gives the ids of the 
      original edges for every new edge. 
@@ -481,9 +707,10 @@ int igraph_delete_edges(igraph_t *graph, igraph_es_t edges) {
   }
 
   /* Ok, we've all memory needed, free the old structure  */
-  igraph_vector_destroy(&graph->from);
-  igraph_vector_destroy(&graph->to);
-  igraph_vector_destroy(&graph->oi);
+  igraph_i_adjcache_invalidate(graph);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->from);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->to);
+  IGRAPH_I_GRAPH_VECTOR(destroy)(&graph->oi);
   graph->from=newfrom;
   graph->to=newto;
   graph->oi=newoi;
@@ -578,8 +805,8 @@ int igraph_delete_vertices_idx(igraph_t *graph, const igraph_vs_t vertices,
   }
   /* create edge recoding vector */
   for (remaining_edges=0, i=0; i<no_of_edges; i++) {
-    long int from=(long int) VECTOR(graph->from)[i];
-    long int to=(long int) VECTOR(graph->to)[i];
+    long int from=IGRAPH_FROM(graph, i);
+    long int to=IGRAPH_TO(graph, i);
     if (VECTOR(*my_vertex_recoding)[from] != 0 &&
 	VECTOR(*my_vertex_recoding)[to  ] != 0) {
       VECTOR(edge_recoding)[i]=remaining_edges+1;
@@ -590,30 +817,33 @@ int igraph_delete_vertices_idx(igraph_t *graph, const igraph_vs_t vertices,
   /* start creating the graph */
   newgraph.n=(igraph_integer_t) remaining_vertices;
   newgraph.directed=graph->directed;  
+  newgraph.cache=0;
 
   /* allocate vectors */
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.from, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.to, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.oi, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.ii, remaining_edges);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.os, remaining_vertices+1);
-  IGRAPH_VECTOR_INIT_FINALLY(&newgraph.is, remaining_vertices+1);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newgraph.from, remaining_edges);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newgraph.to, remaining_edges);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newgraph.oi, remaining_edges);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newgraph.ii, remaining_edges);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newgraph.os, remaining_vertices+1);
+  IGRAPH_I_GRAPH_VECTOR_INIT_FINALLY(&newgraph.is, remaining_vertices+1);
   
   /* Add the edges */
   for (i=0, j=0; j<remaining_edges; i++) {
     if (VECTOR(edge_recoding)[i]>0) {
-      long int from=(long int) VECTOR(graph->from)[i];
-      long int to=(long int) VECTOR(graph->to  )[i];
-      VECTOR(newgraph.from)[j]=VECTOR(*my_vertex_recoding)[from]-1;
-      VECTOR(newgraph.to  )[j]=VECTOR(*my_vertex_recoding)[to]-1;
+      long int from=IGRAPH_FROM(graph, i);
+      long int to=IGRAPH_TO(graph, i);
+      VECTOR(newgraph.from)[j]=(long int) VECTOR(*my_vertex_recoding)[from]-1;
+      VECTOR(newgraph.to  )[j]=(long int) VECTOR(*my_vertex_recoding)[to]-1;
       j++;
     }
   }
   /* update oi & ii */
-  IGRAPH_CHECK(igraph_vector_order(&newgraph.from, &newgraph.to, &newgraph.oi, 
-				   remaining_vertices));
-  IGRAPH_CHECK(igraph_vector_order(&newgraph.to, &newgraph.from, &newgraph.ii, 
-				   remaining_vertices));  
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(order)(&newgraph.from, &newgraph.to,
+					     &newgraph.oi,
+					     remaining_vertices));
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(order)(&newgraph.to, &newgraph.from,
+					     &newgraph.ii,
+					     remaining_vertices));
 
   IGRAPH_CHECK(igraph_i_create_start(&newgraph.os, &newgraph.from, 
 				     &newgraph.oi, (igraph_integer_t) 
@@ -654,6 +884,10 @@ int igraph_delete_vertices_idx(igraph_t *graph, const igraph_vs_t vertices,
 	       
   igraph_vit_destroy(&vit);
   igraph_vector_destroy(&edge_recoding);
+  /* the cache moves to the new graph, but it is dropped */
+  igraph_i_adjcache_invalidate(graph);
+  newgraph.cache=graph->cache;
+  graph->cache=0;
   igraph_destroy(graph);
   *graph=newgraph;
 
@@ -703,7 +937,7 @@ igraph_integer_t igraph_vcount(const igraph_t *graph) {
  * Time complexity: O(1)
  */
 igraph_integer_t igraph_ecount(const igraph_t *graph) {
-  return (igraph_integer_t) igraph_vector_size(&graph->from);
+  return (igraph_integer_t) IGRAPH_I_GRAPH_VECTOR(size)(&graph->from);
 }
 
 /**
@@ -761,10 +995,10 @@ int igraph_neighbors(const igraph_t *graph, igraph_vector_t *neis, igraph_intege
   /* Calculate needed space first & allocate it*/
 
   if (mode & IGRAPH_OUT) {
-    length += (VECTOR(graph->os)[node+1] - VECTOR(graph->os)[node]);
+    length += (IGRAPH_OS(graph, node+1) - IGRAPH_OS(graph, node));
   }
   if (mode & IGRAPH_IN) {
-    length += (VECTOR(graph->is)[node+1] - VECTOR(graph->is)[node]);
+    length += (IGRAPH_IS(graph, node+1) - IGRAPH_IS(graph, node));
   }
   
   IGRAPH_CHECK(igraph_vector_resize(neis, length));
@@ -772,31 +1006,27 @@ int igraph_neighbors(const igraph_t *graph, igraph_vector_t *neis, igraph_intege
   if (!igraph_is_directed(graph) || mode != IGRAPH_ALL) {
 
     if (mode & IGRAPH_OUT) {
-      j=(long int) VECTOR(graph->os)[node+1];
-      for (i=(long int) VECTOR(graph->os)[node]; i<j; i++) {
-	VECTOR(*neis)[idx++] = 
-	  VECTOR(graph->to)[ (long int)VECTOR(graph->oi)[i] ];
+      j=IGRAPH_OS(graph, node+1);
+      for (i=IGRAPH_OS(graph, node); i<j; i++) {
+	VECTOR(*neis)[idx++] = IGRAPH_TO(graph, IGRAPH_OI(graph, i));
       }
     }
     if (mode & IGRAPH_IN) {
-      j=(long int) VECTOR(graph->is)[node+1];
-      for (i=(long int) VECTOR(graph->is)[node]; i<j; i++) {
-	VECTOR(*neis)[idx++] =
-	  VECTOR(graph->from)[ (long int)VECTOR(graph->ii)[i] ];
+      j=IGRAPH_IS(graph, node+1);
+      for (i=IGRAPH_IS(graph, node); i<j; i++) {
+	VECTOR(*neis)[idx++] = IGRAPH_FROM(graph, IGRAPH_II(graph, i));
       }
     }
   } else {
     /* both in- and out- neighbors in a directed graph,
        we need to merge the two 'vectors' */
-    long int jj1=(long int) VECTOR(graph->os)[node+1];
-    long int j2=(long int) VECTOR(graph->is)[node+1];
-    long int i1=(long int) VECTOR(graph->os)[node];
-    long int i2=(long int) VECTOR(graph->is)[node];
+    long int jj1=IGRAPH_OS(graph, node+1);
+    long int j2=IGRAPH_IS(graph, node+1);
+    long int i1=IGRAPH_OS(graph, node);
+    long int i2=IGRAPH_IS(graph, node);
     while (i1 < jj1 && i2 < j2) {
-      long int n1=(long int) VECTOR(graph->to)[ 
-		       (long int)VECTOR(graph->oi)[i1] ];
-      long int n2=(long int) VECTOR(graph->from)[
-		       (long int)VECTOR(graph->ii)[i2] ];
+      long int n1=IGRAPH_TO(graph, IGRAPH_OI(graph, i1));
+      long int n2=IGRAPH_FROM(graph, IGRAPH_II(graph, i2));
       if (n1<n2) {
 	VECTOR(*neis)[idx++]=n1;
 	i1++;
@@ -811,14 +1041,12 @@ int igraph_neighbors(const igraph_t *graph, igraph_vector_t *neis, igraph_intege
       }
     }
     while (i1 < jj1) {
-      long int n1=(long int) VECTOR(graph->to)[ 
-		       (long int)VECTOR(graph->oi)[i1] ];
+      long int n1=IGRAPH_TO(graph, IGRAPH_OI(graph, i1));
       VECTOR(*neis)[idx++]=n1;
       i1++;
     }
     while (i2 < j2) {
-      long int n2=(long int) VECTOR(graph->from)[ 
-		       (long int)VECTOR(graph->ii)[i2] ];
+      long int n2=IGRAPH_FROM(graph, IGRAPH_II(graph, i2));
       VECTOR(*neis)[idx++]=n2;
       i2++;
     }
@@ -832,39 +1060,41 @@ int igraph_neighbors(const igraph_t *graph, igraph_vector_t *neis, igraph_intege
  * 
  */
 
-int igraph_i_create_start(igraph_vector_t *res, igraph_vector_t *el, igraph_vector_t *iindex, 
+int igraph_i_create_start(igraph_i_graph_vector_t *res,
+			  igraph_i_graph_vector_t *el,
+			  igraph_i_graph_vector_t *iindex, 
 			  igraph_integer_t nodes) {
   
-# define EDGE(i) (VECTOR(*el)[ (long int) VECTOR(*iindex)[(i)] ])
+# define EDGE(i) ((long int) VECTOR(*el)[ (long int) VECTOR(*iindex)[(i)] ])
   
   long int no_of_nodes;
   long int no_of_edges;
   long int i, j, idx;
   
   no_of_nodes=nodes;
-  no_of_edges=igraph_vector_size(el);
+  no_of_edges=IGRAPH_I_GRAPH_VECTOR(size)(el);
   
   /* result */
   
-  IGRAPH_CHECK(igraph_vector_resize(res, nodes+1));
+  IGRAPH_CHECK(IGRAPH_I_GRAPH_VECTOR(resize)(res, nodes+1));
   
   /* create the index */
 
-  if (igraph_vector_size(el)==0) {
+  if (no_of_edges==0) {
     /* empty graph */
-    igraph_vector_null(res);
+    IGRAPH_I_GRAPH_VECTOR(null)(res);
   } else {
     idx=-1;
     for (i=0; i<=EDGE(0); i++) {
       idx++; VECTOR(*res)[idx]=0;
     }
     for (i=1; i<no_of_edges; i++) {
-      long int n=(long int) (EDGE(i) - EDGE((long int)VECTOR(*res)[idx]));
+      long int n=EDGE(i) - EDGE((long int)VECTOR(*res)[idx]);
       for (j=0; j<n; j++) {
 	idx++; VECTOR(*res)[idx]=i;
       }
     }
-    j=(long int) EDGE((long int)VECTOR(*res)[idx]);
+    j=EDGE((long int)VECTOR(*res)[idx]);
     for (i=0; i<no_of_nodes-j; i++) {
       idx++; VECTOR(*res)[idx]=no_of_edges;
     }
@@ -961,7 +1191,7 @@ int igraph_degree(const igraph_t *graph, igraph_vector_t *res,
 	   !IGRAPH_VIT_END(vit); 
 	   IGRAPH_VIT_NEXT(vit), i++) {
 	long int vid=IGRAPH_VIT_GET(vit);
-	VECTOR(*res)[i] += (VECTOR(graph->os)[vid+1]-VECTOR(graph->os)[vid]);
+	VECTOR(*res)[i] += (IGRAPH_OS(graph, vid+1)-IGRAPH_OS(graph, vid));
       }
     }
     if (mode & IGRAPH_IN) {
@@ -969,7 +1199,7 @@ int igraph_degree(const igraph_t *graph, igraph_vector_t *res,
 	   !IGRAPH_VIT_END(vit); 
 	   IGRAPH_VIT_NEXT(vit), i++) {
 	long int vid=IGRAPH_VIT_GET(vit);
-	VECTOR(*res)[i] += (VECTOR(graph->is)[vid+1]-VECTOR(graph->is)[vid]);
+	VECTOR(*res)[i] += (IGRAPH_IS(graph, vid+1)-IGRAPH_IS(graph, vid));
       }
     }
   } else { /* no loops */
@@ -978,10 +1208,9 @@ int igraph_degree(const igraph_t *graph, igraph_vector_t *res,
 	   !IGRAPH_VIT_END(vit); 
 	   IGRAPH_VIT_NEXT(vit), i++) {
 	long int vid=IGRAPH_VIT_GET(vit);
-	VECTOR(*res)[i] += (VECTOR(graph->os)[vid+1]-VECTOR(graph->os)[vid]);
-	for (j=(long int) VECTOR(graph->os)[vid]; 
-	     j<VECTOR(graph->os)[vid+1]; j++) {
-	  if (VECTOR(graph->to)[ (long int)VECTOR(graph->oi)[j] ]==vid) {
+	VECTOR(*res)[i] += (IGRAPH_OS(graph, vid+1)-IGRAPH_OS(graph, vid));
+	for (j=IGRAPH_OS(graph, vid); j<IGRAPH_OS(graph, vid+1); j++) {
+	  if (IGRAPH_TO(graph, IGRAPH_OI(graph, j))==vid) {
 	    VECTOR(*res)[i] -= 1;
 	  }
 	}
@@ -992,10 +1221,9 @@ int igraph_degree(const igraph_t *graph, igraph_vector_t *res,
 	   !IGRAPH_VIT_END(vit);
 	   IGRAPH_VIT_NEXT(vit), i++) {
 	long int vid=IGRAPH_VIT_GET(vit);
-	VECTOR(*res)[i] += (VECTOR(graph->is)[vid+1]-VECTOR(graph->is)[vid]);
-	for (j=(long int) VECTOR(graph->is)[vid]; 
-	     j<VECTOR(graph->is)[vid+1]; j++) {
-	  if (VECTOR(graph->from)[ (long int)VECTOR(graph->ii)[j] ]==vid) {
+	VECTOR(*res)[i] += (IGRAPH_IS(graph, vid+1)-IGRAPH_IS(graph, vid));
+	for (j=IGRAPH_IS(graph, vid); j<IGRAPH_IS(graph, vid+1); j++) {
+	  if (IGRAPH_FROM(graph, IGRAPH_II(graph, j))==vid) {
 	    VECTOR(*res)[i] -= 1;
 	  }
 	}
@@ -1094,11 +1322,11 @@ int igraph_edges(const igraph_t *graph, igraph_es_t eids,
 
 #define FIND_DIRECTED_EDGE(graph,xfrom,xto,eid)                     \
   do {                                                              \
-    long int start=(long int) VECTOR(graph->os)[xfrom];		    \
-    long int end=(long int) VECTOR(graph->os)[xfrom+1];		    \
+    long int start=IGRAPH_OS(graph, xfrom);			    \
+    long int end=IGRAPH_OS(graph, xfrom+1);			    \
     long int N=end;                                                 \
-    long int start2=(long int) VECTOR(graph->is)[xto];		    \
-    long int end2=(long int) VECTOR(graph->is)[xto+1];		    \
+    long int start2=IGRAPH_IS(graph, xto);			    \
+    long int end2=IGRAPH_IS(graph, xto+1);			    \
     long int N2=end2;                                               \
     if (end-start<end2-start2) {                                    \
       BINSEARCH(start,end,xto,graph->oi,graph->to,N,eid);           \
@@ -1395,11 +1623,11 @@ int igraph_get_eids(const igraph_t *graph, igraph_vector_t *eids,
 
 #define FIND_DIRECTED_EDGE(graph,xfrom,xto,eid,seen)		    \
   do {                                                              \
-    long int start=(long int) VECTOR(graph->os)[xfrom];		    \
-    long int end=(long int) VECTOR(graph->os)[xfrom+1];		    \
+    long int start=IGRAPH_OS(graph, xfrom);			    \
+    long int end=IGRAPH_OS(graph, xfrom+1);			    \
     long int N=end;                                                 \
-    long int start2=(long int) VECTOR(graph->is)[xto];		    \
-    long int end2=(long int) VECTOR(graph->is)[xto+1];		    \
+    long int start2=IGRAPH_IS(graph, xto);			    \
+    long int end2=IGRAPH_IS(graph, xto+1);			    \
     long int N2=end2;                                               \
     if (end-start<end2-start2) {                                    \
       BINSEARCH(start,end,xto,graph->oi,graph->to,N,eid,seen);	    \
@@ -1684,24 +1912,24 @@ int igraph_incident(const igraph_t *graph, igraph_vector_t *eids,
   /* Calculate needed space first & allocate it*/
 
   if (mode & IGRAPH_OUT) {
-    length += (VECTOR(graph->os)[node+1] - VECTOR(graph->os)[node]);
+    length += (IGRAPH_OS(graph, node+1) - IGRAPH_OS(graph, node));
   }
   if (mode & IGRAPH_IN) {
-    length += (VECTOR(graph->is)[node+1] - VECTOR(graph->is)[node]);
+    length += (IGRAPH_IS(graph, node+1) - IGRAPH_IS(graph, node));
   }
   
   IGRAPH_CHECK(igraph_vector_resize(eids, length));
   
   if (mode & IGRAPH_OUT) {
-    j=(long int) VECTOR(graph->os)[node+1];
-    for (i=(long int) VECTOR(graph->os)[node]; i<j; i++) {
-      VECTOR(*eids)[idx++] = VECTOR(graph->oi)[i];
+    j=IGRAPH_OS(graph, node+1);
+    for (i=IGRAPH_OS(graph, node); i<j; i++) {
+      VECTOR(*eids)[idx++] = IGRAPH_OI(graph, i);
     }
   }
   if (mode & IGRAPH_IN) {
-    j=(long int) VECTOR(graph->is)[node+1];
-    for (i=(long int) VECTOR(graph->is)[node]; i<j; i++) {
-      VECTOR(*eids)[idx++] = VECTOR(graph->ii)[i];
+    j=IGRAPH_IS(graph, node+1);
+    for (i=IGRAPH_IS(graph, node); i<j; i++) {
+      VECTOR(*eids)[idx++] = IGRAPH_II(graph, i);
     }
   }
 
@@ -25,8 +25,10 @@
 #include "igraph_types_internal.h"
 #include "igraph_complex.h"
 #include "bigint.h"
+#include "igraph_threading_internal.h"
 #include "config.h"
 #include <float.h>
+#include <string.h>
 
 #define BASE_IGRAPH_REAL
 #include "igraph_pmt.h"
@@ -116,6 +118,82 @@ int igraph_vector_order2(igraph_vector_t *v) {
   return 0;
 }
 
+/* 
+ * Counting sort, used by the igraph_vector_order*() functions.
+ *
+ * One pass sorts 'n' indices stably according to 'key'. The input
+ * indices are taken from 'in', or if it is NULL, then they are
+ * n-1, n-2, ..., 0, so ties are broken by decreasing index. This is
+ * the order the original linked list implementation produced, and
+ * some code (e.g. the edge indices of the graph) relies on it.
+ *
+ * The input is cut into contiguous chunks, one per thread. Every
+ * thread counts the keys in its chunk, then the counts are turned
+ * into starting positions with a prefix sum, first over keys and
+ * then over threads, so the sort remains stable. Finally every
+ * thread scatters its own chunk. The chunks follow the actual number
+ * of threads. 'count' must have room for nthreads*(nodes+1)
+ * elements. This function cannot fail, so it is safe to run it in
+ * parallel.
+ */
+
+#define IGRAPH_I_ORDER_PASS(NAME, KEY_T, IDX_T)				\
+static void NAME(const KEY_T *key, const IDX_T *in, IDX_T *out,		\
+		 long int n, long int nodes, long int *count,		\
+		 int nthreads) {						\
+  IGRAPH_I_PARALLEL(nthreads)						\
+  {									\
+    int t=IGRAPH_I_THREAD_NUM, nth=IGRAPH_I_NUM_THREADS;		\
+    long int from=(long int) ((double) n * t / nth);			\
+    long int to=(long int) ((double) n * (t+1) / nth);			\
+    long int *mycount=count + t * (nodes+1);				\
+    long int p;								\
+    memset(mycount, 0, sizeof(long int) * (size_t) (nodes+1));		\
+    for (p=from; p<to; p++) {						\
+      long int e= in ? (long int) in[p] : n-1-p;			\
+      mycount[ (long int) key[e] ] ++;					\
+    }									\
+    IGRAPH_I_BARRIER							\
+    IGRAPH_I_SINGLE							\
+    {									\
+      long int b, tt, sum=0;						\
+      for (b=0; b<=nodes; b++) {					\
+	for (tt=0; tt<nth; tt++) {					\
+	  long int tmp=count[tt * (nodes+1) + b];			\
+	  count[tt * (nodes+1) + b] = sum;				\
+	  sum += tmp;							\
+	}								\
+      }									\
+    }									\
+    for (p=from; p<to; p++) {						\
+      long int e= in ? (long int) in[p] : n-1-p;			\
+      out[ mycount[ (long int) key[e] ]++ ] = (IDX_T) e;		\
+    }									\
+  }									\
+}
+
+IGRAPH_I_ORDER_PASS(igraph_i_order_pass, igraph_real_t, igraph_real_t)
+IGRAPH_I_ORDER_PASS(igraph_i_order_pass_int, int, int)
+IGRAPH_I_ORDER_PASS(igraph_i_order_pass_real_int, igraph_real_t, int)
+
+/* Number of threads to use for sorting 'n' elements with keys in
+   [0,nodes]. Small inputs are not worth the overhead, and the count
+   arrays, one per thread, should not be much larger than the input. */
+
+static int igraph_i_order_threads(long int n, long int nodes) {
+#ifdef _OPENMP
+  int nthreads=igraph_get_num_threads();
+  if (n < 100000) { return 1; }
+  while (nthreads > 1 && (double) nthreads * (nodes+1) > n) {
+    nthreads--;
+  }
+  return nthreads < 1 ? 1 : nthreads;
+#else
+  IGRAPH_UNUSED(n); IGRAPH_UNUSED(nodes);
+  return 1;
+#endif
+}
+
 /**
  * \ingroup vector
  * \function igraph_vector_order
@@ -123,7 +201,12 @@ int igraph_vector_order2(igraph_vector_t *v) {
  *
  * </para><para>
  * The smallest element will have order zero, the second smallest
- * order one, etc.
+ * order one, etc. Elements with the same primary and secondary key
+ * are ordered by decreasing index.
+ * 
+ * </para><para>
+ * This is a two pass counting sort, the passes are done in parallel,
+ * if the vector is large, see \ref igraph_set_num_threads().
  * \param v The original \type igraph_vector_t object.
  * \param v2 A secondary key, another \type igraph_vector_t object.
  * \param res An initialized \type igraph_vector_t object, it will be
@@ -133,70 +216,83 @@ int igraph_vector_order2(igraph_vector_t *v) {
  * \return Error code:
  *         \c IGRAPH_ENOMEM: out of memory
  *
- * Time complexity: O()
+ * Time complexity: O(n+nodes), n is the length of the vector.
  */
 
 int igraph_vector_order(const igraph_vector_t* v,
 			const igraph_vector_t *v2,
 			igraph_vector_t* res, igraph_real_t nodes) {
   long int edges=igraph_vector_size(v);
-  igraph_vector_t ptr;
-  igraph_vector_t rad;
-  long int i, j;
+  long int no_of_nodes=(long int) nodes;
+  int nthreads=igraph_i_order_threads(edges, no_of_nodes);
+  igraph_vector_long_t count;
+  igraph_vector_t tmp;
 
   assert(v!=NULL);
   assert(v->stor_begin != NULL);
 
-  IGRAPH_VECTOR_INIT_FINALLY(&ptr, (long int) nodes+1);
-  IGRAPH_VECTOR_INIT_FINALLY(&rad, edges);
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&count, nthreads * (no_of_nodes+1));
+  IGRAPH_VECTOR_INIT_FINALLY(&tmp, edges);
   IGRAPH_CHECK(igraph_vector_resize(res, edges));
 
-  for (i=0; i<edges; i++) {
-    long int radix=(long int) v2->stor_begin[i];
-    if (VECTOR(ptr)[radix]!=0) {
-      VECTOR(rad)[i]=VECTOR(ptr)[radix];
-    }
-    VECTOR(ptr)[radix]=i+1;
-  }
+  igraph_i_order_pass(VECTOR(*v2), 0, VECTOR(tmp), edges, no_of_nodes,
+		      VECTOR(count), nthreads);
+  igraph_i_order_pass(VECTOR(*v), VECTOR(tmp), VECTOR(*res), edges, 
+		      no_of_nodes, VECTOR(count), nthreads);
 
-  j=0;
-  for (i=0; i<nodes+1; i++) {
-    if (VECTOR(ptr)[i] != 0) {
-      long int next=(long int) VECTOR(ptr)[i]-1;
-      res->stor_begin[j++]=next;
-      while (VECTOR(rad)[next] != 0) {
-	next=(long int) VECTOR(rad)[next]-1;
-	res->stor_begin[j++]=next;
-      }
-    }
-  }
+  igraph_vector_destroy(&tmp);
+  igraph_vector_long_destroy(&count);
+  IGRAPH_FINALLY_CLEAN(2);
 
-  igraph_vector_null(&ptr);
-  igraph_vector_null(&rad);
+  return 0;
+}
 
-  for (i=0; i<edges; i++) {
-    long int edge=(long int) VECTOR(*res)[edges-i-1];
-    long int radix=(long int) VECTOR(*v)[edge];
-    if (VECTOR(ptr)[radix]!= 0) {
-      VECTOR(rad)[edge]=VECTOR(ptr)[radix];
-    }
-    VECTOR(ptr)[radix]=edge+1;
-  }
+/**
+ * \ingroup vector
+ * \function igraph_vector_int_order
+ * \brief Calculate the order of the elements in an integer vector.
+ *
+ * </para><para>
+ * The same as \ref igraph_vector_order(), but for \type
+ * igraph_vector_int_t keys and result. This is used to build the
+ * indices of the graph, if it is stored in compact form, see
+ * \type igraph_i_graph_vector_t.
+ * \param v The original \type igraph_vector_int_t object.
+ * \param v2 A secondary key, another \type igraph_vector_int_t object.
+ * \param res An initialized \type igraph_vector_int_t object, it will be
+ *    resized to match the size of \p v. The
+ *    result of the computation will be stored here.
+ * \param nodes Hint, the largest element in \p v.
+ * \return Error code:
+ *         \c IGRAPH_ENOMEM: out of memory
+ *
+ * Time complexity: O(n+nodes), n is the length of the vector.
+ */
 
-  j=0;
-  for (i=0; i<nodes+1; i++) {
-    if (VECTOR(ptr)[i] != 0) {
-      long int next=(long int) VECTOR(ptr)[i]-1;
-      res->stor_begin[j++]=next;
-      while (VECTOR(rad)[next] != 0) {
-	next=(long int) VECTOR(rad)[next]-1;
-	res->stor_begin[j++]=next;
-      }
-    }
-  }
+int igraph_vector_int_order(const igraph_vector_int_t* v,
+			    const igraph_vector_int_t *v2,
+			    igraph_vector_int_t* res, igraph_real_t nodes) {
+  long int edges=igraph_vector_int_size(v);
+  long int no_of_nodes=(long int) nodes;
+  int nthreads=igraph_i_order_threads(edges, no_of_nodes);
+  igraph_vector_long_t count;
+  igraph_vector_int_t tmp;
 
-  igraph_vector_destroy(&ptr);
-  igraph_vector_destroy(&rad);
+  assert(v!=NULL);
+  assert(v->stor_begin != NULL);
+
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&count, nthreads * (no_of_nodes+1));
+  IGRAPH_CHECK(igraph_vector_int_init(&tmp, edges));
+  IGRAPH_FINALLY(igraph_vector_int_destroy, &tmp);
+  IGRAPH_CHECK(igraph_vector_int_resize(res, edges));
+
+  igraph_i_order_pass_int(VECTOR(*v2), 0, VECTOR(tmp), edges, no_of_nodes,
+			  VECTOR(count), nthreads);
+  igraph_i_order_pass_int(VECTOR(*v), VECTOR(tmp), VECTOR(*res), edges, 
+			  no_of_nodes, VECTOR(count), nthreads);
+
+  igraph_vector_int_destroy(&tmp);
+  igraph_vector_long_destroy(&count);
   IGRAPH_FINALLY_CLEAN(2);
 
   return 0;
@@ -205,82 +301,44 @@ int igraph_vector_order(const igraph_vector_t* v,
 int igraph_vector_order1(const igraph_vector_t* v,
 			 igraph_vector_t* res, igraph_real_t nodes) {
   long int edges=igraph_vector_size(v);
-  igraph_vector_t ptr;
-  igraph_vector_t rad;
-  long int i, j;
+  long int no_of_nodes=(long int) nodes;
+  int nthreads=igraph_i_order_threads(edges, no_of_nodes);
+  igraph_vector_long_t count;
 
   assert(v!=NULL);
   assert(v->stor_begin != NULL);
 
-  IGRAPH_VECTOR_INIT_FINALLY(&ptr, (long int) nodes+1);
-  IGRAPH_VECTOR_INIT_FINALLY(&rad, edges);
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&count, nthreads * (no_of_nodes+1));
   IGRAPH_CHECK(igraph_vector_resize(res, edges));
 
-  for (i=0; i<edges; i++) {
-    long int radix=(long int) v->stor_begin[i];
-    if (VECTOR(ptr)[radix]!=0) {
-      VECTOR(rad)[i]=VECTOR(ptr)[radix];
-    }
-    VECTOR(ptr)[radix]=i+1;
-  }
+  igraph_i_order_pass(VECTOR(*v), 0, VECTOR(*res), edges, no_of_nodes,
+		      VECTOR(count), nthreads);
 
-  j=0;
-  for (i=0; i<nodes+1; i++) {
-    if (VECTOR(ptr)[i] != 0) {
-      long int next=(long int) VECTOR(ptr)[i]-1;
-      res->stor_begin[j++]=next;
-      while (VECTOR(rad)[next] != 0) {
-	next=(long int) VECTOR(rad)[next]-1;
-	res->stor_begin[j++]=next;
-      }
-    }
-  }
-
-  igraph_vector_destroy(&ptr);
-  igraph_vector_destroy(&rad);
-  IGRAPH_FINALLY_CLEAN(2);
+  igraph_vector_long_destroy(&count);
+  IGRAPH_FINALLY_CLEAN(1);
 
   return 0;
 }
 
 int igraph_vector_order1_int(const igraph_vector_t* v,
-														 igraph_vector_int_t* res,
-														 igraph_real_t nodes) {
+			     igraph_vector_int_t* res,
+			     igraph_real_t nodes) {
   long int edges=igraph_vector_size(v);
-  igraph_vector_t ptr;
-  igraph_vector_t rad;
-  long int i, j;
+  long int no_of_nodes=(long int) nodes;
+  int nthreads=igraph_i_order_threads(edges, no_of_nodes);
+  igraph_vector_long_t count;
 
   assert(v!=NULL);
   assert(v->stor_begin != NULL);
 
-  IGRAPH_VECTOR_INIT_FINALLY(&ptr, (long int) nodes+1);
-  IGRAPH_VECTOR_INIT_FINALLY(&rad, edges);
+  IGRAPH_VECTOR_LONG_INIT_FINALLY(&count, nthreads * (no_of_nodes+1));
   IGRAPH_CHECK(igraph_vector_int_resize(res, edges));
 
-  for (i=0; i<edges; i++) {
-    long int radix=(long int) v->stor_begin[i];
-    if (VECTOR(ptr)[radix]!=0) {
-      VECTOR(rad)[i]=VECTOR(ptr)[radix];
-    }
-    VECTOR(ptr)[radix]=i+1;
-  }
-
-  j=0;
-  for (i=0; i<nodes+1; i++) {
-    if (VECTOR(ptr)[i] != 0) {
-      long int next=(long int) VECTOR(ptr)[i]-1;
-      res->stor_begin[j++]=next;
-      while (VECTOR(rad)[next] != 0) {
-				next=(long int) VECTOR(rad)[next]-1;
-				res->stor_begin[j++]=next;
-      }
-    }
-  }
+  igraph_i_order_pass_real_int(VECTOR(*v), 0, VECTOR(*res), edges, 
+			       no_of_nodes, VECTOR(count), nthreads);
 
-  igraph_vector_destroy(&ptr);
-  igraph_vector_destroy(&rad);
-  IGRAPH_FINALLY_CLEAN(2);
+  igraph_vector_long_destroy(&count);
+  IGRAPH_FINALLY_CLEAN(1);
 
   return 0;
 }
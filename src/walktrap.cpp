@@ -88,6 +88,15 @@ using namespace igraph::walktrap;
  * in the graph and they are assumed to have a single incident loop edge with
  * weight 1.
  *
+ * </para><para>
+ * Most of the memory is used by the probability vectors of the
+ * communities. If \p max_memory is given, then the vectors of the
+ * communities that are the farthest from being merged are deleted
+ * when the limit is reached, and they are computed again from the
+ * graph if they are needed later. This is slower, but it allows
+ * running the algorithm on large graphs in a bounded amount of
+ * memory. The vectors are stored in single precision.
+ *
  * \param graph The input graph, edge directions are ignored.
  * \param weights Numeric vector giving the weights of the edges. 
  *     If it is a NULL pointer then all edges will have equal
@@ -111,6 +120,13 @@ using namespace igraph::walktrap;
  *     the membership vector corresponding to the maximal modularity
  *     score is stored here. If it is not a NULL pointer, then neither
  *     \p modularity nor \p merges may be NULL.
+ * \param max_memory The memory limit in bytes, it includes the
+ *     data structures that do not depend on it, these take
+ *     O(|V|+|E|) memory. Negative values mean no limit.
+ * \param recomputations Pointer to an integer. If not NULL, then the
+ *     number of probability vectors that were computed again, because
+ *     of the memory limit, is stored here. It is always zero if there
+ *     is no limit.
  * \return Error code.
  * 
  * \sa \ref igraph_community_spinglass(), \ref
@@ -127,11 +143,13 @@ int igraph_community_walktrap(const igraph_t *graph,
 			      int steps,
 			      igraph_matrix_t *merges,
 			      igraph_vector_t *modularity, 
-			      igraph_vector_t *membership) {
+			      igraph_vector_t *membership,
+			      igraph_real_t max_memory,
+			      igraph_integer_t *recomputations) {
 
   long int no_of_nodes=(long int)igraph_vcount(graph);
   int length=steps;
-  long max_memory=-1;
+  long memory_limit= max_memory < 0 ? -1 : (long) max_memory;
 
   if (membership && !(modularity && merges)) {
     IGRAPH_ERROR("Cannot calculate membership without modularity or merges",
@@ -152,12 +170,16 @@ int igraph_community_walktrap(const igraph_t *graph,
     IGRAPH_CHECK(igraph_vector_resize(modularity, no_of_nodes));
 	igraph_vector_null(modularity);
   }
-  Communities C(G, length, max_memory, merges, modularity);
+  Communities C(G, length, memory_limit, merges, modularity);
   
   while (!C.H->is_empty()) {
     IGRAPH_ALLOW_INTERRUPTION();
     C.merge_nearest_communities();
   }
+
+  if (recomputations) {
+    *recomputations = (igraph_integer_t) C.nb_recomputations;
+  }
   
   delete G;
 
@@ -58,6 +58,7 @@
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <cstring>
 
 #include "config.h"
 
@@ -75,6 +76,69 @@ IGRAPH_THREAD_LOCAL int* Probabilities::vertices2 = 0;
 IGRAPH_THREAD_LOCAL int Probabilities::current_id = 0;
 
 
+Probability_pool::Probability_pool() {
+  for(int i = 0; i < nb_classes; i++) free_blocks[i] = 0;
+  reserved = 0;
+  free_bytes = 0;
+  caching = true;
+}
+
+Probability_pool::~Probability_pool() {
+  trim();
+}
+
+long Probability_pool::block_size(int block_class) {
+  if(block_class == 0) return 32;
+  int k = (block_class - 1)/4 + 5;
+  int m = (block_class - 1)%4 + 1;
+  return (1L << k) + long(m)*(1L << (k-2));
+}
+
+char* Probability_pool::allocate(long bytes, int &block_class) {
+  if(bytes <= 32) block_class = 0;
+  else {
+    int k = 5;					// 2^k < bytes <= 2^(k+1)
+    while((1L << (k+1)) < bytes) k++;
+    long step = 1L << (k-2);
+    block_class = (k-5)*4 + int((bytes - (1L << k) + step - 1)/step);
+  }
+
+  char* block = free_blocks[block_class];
+  if(block) {
+    memcpy(&free_blocks[block_class], block, sizeof(char*));
+    free_bytes -= block_size(block_class);
+    return block;
+  }
+  block = new char[block_size(block_class)];
+  reserved += block_size(block_class);
+  return block;
+}
+
+void Probability_pool::release(char* block, int block_class) {
+  long s = block_size(block_class);
+  if(caching && free_bytes + s <= (reserved - free_bytes)/8) {
+    memcpy(block, &free_blocks[block_class], sizeof(char*));
+    free_blocks[block_class] = block;
+    free_bytes += s;
+  }
+  else {
+    delete[] block;
+    reserved -= s;
+  }
+}
+
+void Probability_pool::trim() {
+  for(int i = 0; i < nb_classes; i++) {
+    while(free_blocks[i]) {
+      char* block = free_blocks[i];
+      memcpy(&free_blocks[i], block, sizeof(char*));
+      delete[] block;
+      reserved -= block_size(i);
+    }
+  }
+  free_bytes = 0;
+}
+
 Neighbor::Neighbor() {
   next_community1 = 0;
   previous_community1 = 0;
@@ -84,9 +148,16 @@ Neighbor::Neighbor() {
 }
 
 Probabilities::~Probabilities() {
-  C->memory_used -= memory();
-  if(P) delete[] P;
-  if(vertices) delete[] vertices;
+  C->memory_used -= sizeof(Probabilities);
+  C->pool->release((char*) P, block_class);
+}
+
+void Probabilities::allocate(int n, bool partial) {
+  long bytes = long(n)*long(partial ? sizeof(float) + sizeof(int) : sizeof(float));
+  char* block = C->pool->allocate(bytes, block_class);
+  size = n;
+  P = (float*) block;
+  vertices = partial ? (int*) (block + long(n)*sizeof(float)) : 0;
 }
 
 Probabilities::Probabilities(int community) {
@@ -152,9 +223,7 @@ Probabilities::Probabilities(int community) {
   }
 
   if(nb_vertices1 > (G->nb_vertices/2)) {
-    P = new float[G->nb_vertices];
-    size = G->nb_vertices;
-    vertices = 0;
+    allocate(G->nb_vertices, false);
     if(nb_vertices1 == G->nb_vertices) {
       for(int i = 0; i < G->nb_vertices; i++)
 	P[i] = tmp_vector1[i]/sqrt(G->vertices[i].total_weight);
@@ -167,9 +236,7 @@ Probabilities::Probabilities(int community) {
     }
   }
   else {
-    P = new float[nb_vertices1];
-    size = nb_vertices1;
-    vertices = new int[nb_vertices1];
+    allocate(nb_vertices1, true);
     int j = 0;
     for(int i = 0; i < G->nb_vertices; i++) {
       if(id[i] == current_id) {
@@ -179,7 +246,7 @@ Probabilities::Probabilities(int community) {
       }
     }
   }
-  C->memory_used += memory();
+  C->memory_used += sizeof(Probabilities);
 }
 
 Probabilities::Probabilities(int community1, int community2) {
@@ -193,9 +260,7 @@ Probabilities::Probabilities(int community1, int community2) {
 
 
   if(P1->size == C->G->nb_vertices) {
-    P = new float[C->G->nb_vertices];
-    size = C->G->nb_vertices;
-    vertices = 0;
+    allocate(C->G->nb_vertices, false);
     
     if(P2->size == C->G->nb_vertices) {	// two full vectors
       for(int i = 0; i < C->G->nb_vertices; i++)
@@ -215,9 +280,7 @@ Probabilities::Probabilities(int community1, int community2) {
   }
   else {
     if(P2->size == C->G->nb_vertices) { // P1 partial vector, P2 full vector
-      P = new float[C->G->nb_vertices];
-      size = C->G->nb_vertices;
-      vertices = 0;
+      allocate(C->G->nb_vertices, false);
 
       int j = 0;
       for(int i = 0; i < P1->size; i++) {
@@ -265,18 +328,14 @@ Probabilities::Probabilities(int community1, int community2) {
       }
 
       if(nb_vertices1 > (C->G->nb_vertices/2)) {
-	P = new float[C->G->nb_vertices];
-	size = C->G->nb_vertices;
-	vertices = 0;
+	allocate(C->G->nb_vertices, false);
 	for(int i = 0; i < C->G->nb_vertices; i++)
 	  P[i] = 0.;
 	for(int i = 0; i < nb_vertices1; i++)
 	  P[vertices1[i]] = tmp_vector1[vertices1[i]];
       }
       else {
-	P = new float[nb_vertices1];
-	size = nb_vertices1;
-	vertices = new int[nb_vertices1];
+	allocate(nb_vertices1, true);
 	for(int i = 0; i < nb_vertices1; i++) {
 	  vertices[i] = vertices1[i];
 	  P[i] = tmp_vector1[vertices1[i]];
@@ -285,7 +344,7 @@ Probabilities::Probabilities(int community1, int community2) {
     }
   }
 
-  C->memory_used += memory();
+  C->memory_used += sizeof(Probabilities);
 }
 
 double Probabilities::compute_distance(const Probabilities* P2) const {
@@ -352,14 +411,12 @@ double Probabilities::compute_distance(const Probabilities* P2) const {
 }
 
 long Probabilities::memory() {
-  if(vertices)
-    return (sizeof(Probabilities) + long(size)*(sizeof(float) + sizeof(int)));
-  else
-    return (sizeof(Probabilities) + long(size)*sizeof(float));
+  return (sizeof(Probabilities) + Probability_pool::block_size(block_class));
 }
 
 Community::Community() {
   P = 0;
+  evicted = false;
   first_neighbor = 0;
   last_neighbor = 0;
   sub_community_of = -1;
@@ -380,6 +437,8 @@ Communities::Communities(Graph* graph, int random_walks_length,
 			 igraph_vector_t *pmodularity) {
   max_memory = m;
   memory_used = 0;
+  nb_recomputations = 0;
+  pool = new Probability_pool;
   G = graph;
   merges=pmerges;
   mergeidx=0;
@@ -438,6 +497,7 @@ Communities::Communities(Graph* graph, int random_walks_length,
     memory_used += min_delta_sigma->memory();
     memory_used += 2*long(G->nb_vertices)*sizeof(Community);
     memory_used += long(G->nb_vertices)*(2*sizeof(float) + 3*sizeof(int)); // the static data of Probabilities class
+    memory_used += sizeof(Probability_pool);
     memory_used += H->memory() + long(G->nb_edges)*sizeof(Neighbor);
     memory_used += G->memory();    
   }
@@ -466,6 +526,7 @@ Communities::Communities(Graph* graph, int random_walks_length,
 Communities::~Communities() {
   delete[] members;
   delete[] communities;
+  delete pool;
   delete H;
   if(min_delta_sigma) delete min_delta_sigma;
   
@@ -614,13 +675,24 @@ void Communities::update_neighbor(Neighbor* N, float new_delta_sigma) {
   }
 }
 
+long Communities::memory() {
+  return memory_used + pool->reserved;
+}
+
+// Drop the probability vectors of the communities that are the
+// farthest from being merged, until the memory limit is satisfied.
 void Communities::manage_memory() {
-  while((memory_used > max_memory) && !min_delta_sigma->is_empty()) {
+  if(memory() <= max_memory) return;
+  pool->trim();
+  pool->caching = false;
+  while((memory() > max_memory) && !min_delta_sigma->is_empty()) {
     int c = min_delta_sigma->get_max_community();
     delete communities[c].P;
     communities[c].P = 0;
+    communities[c].evicted = true;
     min_delta_sigma->remove_community(c);
   }  
+  pool->caching = true;
 }
 
 
@@ -828,11 +900,15 @@ double Communities::merge_nearest_communities() {
 }
 
 double Communities::compute_delta_sigma(int community1, int community2) {
+  // Without a memory limit only the vectors of the single vertices are
+  // computed from the graph, the others are merged from them.
   if(!communities[community1].P) {
+    if(communities[community1].evicted || community1 >= G->nb_vertices) nb_recomputations++;
     communities[community1].P = new Probabilities(community1);
     if(max_memory != -1) min_delta_sigma->update(community1);
   }
   if(!communities[community2].P) {
+    if(communities[community2].evicted || community2 >= G->nb_vertices) nb_recomputations++;
     communities[community2].P = new Probabilities(community2);
     if(max_memory != -1) min_delta_sigma->update(community2);
   }
@@ -68,6 +68,30 @@ namespace igraph {
 namespace walktrap {
 
 class Communities;
+
+// The storage of the probability vectors. The blocks are rounded up to
+// size classes, four per power of two, and the freed blocks are kept
+// for reuse, up to an eighth of the memory in use. 'reserved' is the
+// exact number of bytes allocated from the system.
+class Probability_pool {
+private:
+  static const int nb_classes = 240;
+  char* free_blocks[nb_classes];    // freed blocks of each class, chained through their first bytes
+
+public:
+  long reserved;		    // bytes of all blocks, in use or free
+  long free_bytes;		    // bytes of the free blocks
+  bool caching;			    // whether freed blocks are kept for reuse
+
+  static long block_size(int block_class);
+  char* allocate(long bytes, int &block_class);	    // a block of at least 'bytes' bytes
+  void release(char* block, int block_class);
+  void trim();			    // give the free blocks back to the system
+
+  Probability_pool();
+  ~Probability_pool();
+};
+
 class Probabilities {
 public:
   static IGRAPH_THREAD_LOCAL float* tmp_vector1;	// 
@@ -84,7 +108,9 @@ public:
   int size;						    // number of probabilities stored
   int* vertices;					    // the vertices corresponding to the stored probabilities, 0 if all the probabilities are stored
   float* P;						    // the probabilities
+  int block_class;					    // the size class of the block of P and vertices in the pool
   
+  void allocate(int n, bool partial);			    // allocate P (and vertices if partial) for n probabilities
   long memory();					    // the memory (in Bytes) used by the object
   double compute_distance(const Probabilities* P2) const;   // compute the squared distance r^2 between this probability vector and P2
   Probabilities(int community);				    // compute the probability vector of a community
@@ -106,6 +132,7 @@ public:
   int size;			// number of members of the community
   
   Probabilities* P;		// the probability vector, 0 if not stored.  
+  bool evicted;			// true if P was deleted to save memory
 
 
   float sigma;			// sigma(C) of the community
@@ -135,7 +162,9 @@ private:
   
 public:
   
-  long memory_used;				    // in bytes
+  long memory_used;				    // in bytes, without the blocks of the probability vectors
+  long nb_recomputations;			    // number of probability vectors computed again because of the memory limit
+  Probability_pool* pool;			    // the blocks of the probability vectors
   Min_delta_sigma_heap* min_delta_sigma;    	    // the min delta_sigma of the community with a saved probability vector (for memory management)
   
   Graph* G;		    // the graph
@@ -166,6 +195,7 @@ public:
   void add_neighbor(Neighbor* N);
   void update_neighbor(Neighbor* N, float new_delta_sigma);
 
+  long memory();			// the memory used, in bytes
   void manage_memory();
   
 };